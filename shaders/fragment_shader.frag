@@ -25,6 +25,14 @@ layout (set = 0, binding = 0) uniform GlobalUniformBuffer
     vec4 pointLightCol; // w is intensity
 } ubo;
 
+// Material of the sub mesh being drawn, selected through a dynamic offset
+layout (set = 1, binding = 0) uniform MaterialBuffer
+{
+    vec4 diffuse;  // w is the dissolve
+    vec4 specular; // w is the shininess
+    vec4 emissive;
+} material;
+
 void main()
 {
     vec3 directionToLight = ubo.pointLightPos - fragmentWorldPos; // do not consider w
@@ -42,5 +50,5 @@ void main()
     vec3 diffuseLight = lightColor * max(dot(normalize(fragmentWorldNormal), normalize(directionToLight)), 0);
 
     // Compute final color
-    outColor = vec4((diffuseLight * ambientLight) * fragmentColor,  1.0);
+    outColor = vec4((diffuseLight * ambientLight) * fragmentColor * material.diffuse.xyz + material.emissive.xyz,  1.0);
 }
@@ -21,6 +21,8 @@
 #include "LavaCamera.hpp"
 #include "KeyboardMovementController.hpp"
 #include "LavaTypes.hpp"
+#include "LavaMeshOptimizer.hpp"
+#include "LavaPackage.hpp"
 
 namespace lava {
 
@@ -28,6 +30,13 @@ namespace lava {
 
 Application::Application()
 {
+    // Shipped builds hold their shaders and cooked meshes in a single package, loose files are used for the rest
+    const std::filesystem::path PackagePath = std::filesystem::absolute(std::string("assets") + LavaPackage::Extension);
+    if (std::filesystem::exists(PackagePath) && !LavaPackage::Mount(PackagePath.string()))
+    {
+        std::cout << "Unable to mount " << PackagePath.string() << ", loose files are used instead" << std::endl;
+    }
+
     GlobalPool = LavaDescriptorPool::Builder(Device)
         .setMaxSets(LavaSwapChain::MAX_FRAMES_IN_FLIGHT)
         // Cannot repeat the operation by adding another uniform buffer because they are enough, 
@@ -99,6 +108,9 @@ void Application::Run()
         
         // Eventually limit the DeltaTime to a max value in order to work while resizing the window
         
+        // Models whose upload completed become visible from this frame
+        ModelLoader.Update();
+
         CameraController.MoveInPlaneXZ(Window.GetGLFWwindow(), DeltaTime, ViewerObject);
         Camera.SetViewYX(ViewerObject.Transform.Translation, ViewerObject.Transform.Rotation);
         
@@ -140,7 +152,7 @@ void Application::Run()
 void Application::LoadGameObjects()
 {
     const std::filesystem::path modelPath = std::filesystem::absolute("models/smooth_vase.obj");
-    const std::shared_ptr<LavaModel> Model = LavaModel::CreateModelFromFile(Device, modelPath);
+    const std::shared_ptr<LavaModelHandle> Model = ModelLoader.LoadAsync(modelPath);
     LavaGameObject GameObject = LavaGameObject::CreateGameObject();
     GameObject.SetModel(Model);
     
@@ -155,7 +167,8 @@ void Application::LoadGameObjects()
 
     // Floor object
     const std::filesystem::path FloorModelPath = std::filesystem::absolute("models/quad.obj");
-    const std::shared_ptr<LavaModel> FloorModel = LavaModel::CreateModelFromFile(Device, FloorModelPath);
+    // A single quad has nothing to optimize
+    const std::shared_ptr<LavaModelHandle> FloorModel = ModelLoader.LoadAsync(FloorModelPath, MeshOptimizationSettings::None());
     LavaGameObject FloorGameObject = LavaGameObject::CreateGameObject();
     FloorGameObject.SetModel(FloorModel);
     FloorGameObject.Transform.Translation = {0.5f, 0.5f, 0.f};
@@ -0,0 +1,137 @@
+//
+//  LavaBounds.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaBounds.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LAVA_BOUNDS_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#define LAVA_BOUNDS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace lava
+{
+
+namespace
+{
+
+const float* Advance(const float* Position, size_t Stride)
+{
+    return reinterpret_cast<const float*>(reinterpret_cast<const char*>(Position) + Stride);
+}
+
+}
+
+BoundingBox LavaBounds::ComputeBox(const float* Positions, size_t Count, size_t Stride)
+{
+    BoundingBox Box{};
+    if (Count == 0)
+        return Box;
+
+    // The fourth lane holds whatever follows the position and is never stored. The accumulators are the second
+    // operand of min and max, which is the one returned when the position is NaN
+#if defined(LAVA_BOUNDS_SSE)
+    __m128 Min0 = _mm_set1_ps(INFINITY), Min1 = Min0;
+    __m128 Max0 = _mm_set1_ps(-INFINITY), Max1 = Max0;
+
+    const float* Position = Positions;
+    size_t Idx = 0;
+    for (; Idx + 2 <= Count; Idx += 2)
+    {
+        const __m128 A = _mm_loadu_ps(Position);
+        const __m128 B = _mm_loadu_ps(Advance(Position, Stride));
+        Min0 = _mm_min_ps(A, Min0);
+        Max0 = _mm_max_ps(A, Max0);
+        Min1 = _mm_min_ps(B, Min1);
+        Max1 = _mm_max_ps(B, Max1);
+        Position = Advance(Position, Stride * 2);
+    }
+
+    if (Idx < Count)
+    {
+        const __m128 A = _mm_loadu_ps(Position);
+        Min0 = _mm_min_ps(A, Min0);
+        Max0 = _mm_max_ps(A, Max0);
+    }
+
+    alignas(16) float MinLanes[4];
+    alignas(16) float MaxLanes[4];
+    _mm_store_ps(MinLanes, _mm_min_ps(Min0, Min1));
+    _mm_store_ps(MaxLanes, _mm_max_ps(Max0, Max1));
+
+    Box.Min = {MinLanes[0], MinLanes[1], MinLanes[2]};
+    Box.Max = {MaxLanes[0], MaxLanes[1], MaxLanes[2]};
+#elif defined(LAVA_BOUNDS_NEON)
+    // vminq and vmaxq propagate NaNs, so positions are checked against themselves first
+    float32x4_t Min = vdupq_n_f32(INFINITY);
+    float32x4_t Max = vdupq_n_f32(-INFINITY);
+
+    const float* Position = Positions;
+    for (size_t Idx = 0; Idx < Count; ++Idx)
+    {
+        const float32x4_t A = vld1q_f32(Position);
+        const uint32x4_t bValid = vceqq_f32(A, A);
+        Min = vbslq_f32(bValid, vminq_f32(A, Min), Min);
+        Max = vbslq_f32(bValid, vmaxq_f32(A, Max), Max);
+        Position = Advance(Position, Stride);
+    }
+
+    float MinLanes[4];
+    float MaxLanes[4];
+    vst1q_f32(MinLanes, Min);
+    vst1q_f32(MaxLanes, Max);
+
+    Box.Min = {MinLanes[0], MinLanes[1], MinLanes[2]};
+    Box.Max = {MaxLanes[0], MaxLanes[1], MaxLanes[2]};
+#else
+    Box.Min = glm::vec3{INFINITY};
+    Box.Max = glm::vec3{-INFINITY};
+
+    const float* Position = Positions;
+    for (size_t Idx = 0; Idx < Count; ++Idx)
+    {
+        for (int Axis = 0; Axis < 3; ++Axis)
+        {
+            Box.Min[Axis] = Position[Axis] < Box.Min[Axis] ? Position[Axis] : Box.Min[Axis];
+            Box.Max[Axis] = Position[Axis] > Box.Max[Axis] ? Position[Axis] : Box.Max[Axis];
+        }
+        Position = Advance(Position, Stride);
+    }
+#endif
+
+    // Only NaN positions
+    if (Box.Min.x > Box.Max.x || Box.Min.y > Box.Max.y || Box.Min.z > Box.Max.z)
+    {
+        Box = BoundingBox{};
+    }
+
+    return Box;
+}
+
+BoundingSphere LavaBounds::ComputeSphere(const float* Positions, size_t Count, size_t Stride, const BoundingBox& Box)
+{
+    BoundingSphere Sphere{Box.GetCenter(), 0.f};
+
+    float MaxDistance2 = 0.f;
+    const float* Position = Positions;
+    for (size_t Idx = 0; Idx < Count; ++Idx)
+    {
+        const glm::vec3 Delta = glm::vec3{Position[0], Position[1], Position[2]} - Sphere.Center;
+        MaxDistance2 = std::max(MaxDistance2, glm::dot(Delta, Delta));
+        Position = Advance(Position, Stride);
+    }
+
+    Sphere.Radius = std::sqrt(MaxDistance2);
+    return Sphere;
+}
+
+}
@@ -39,34 +39,36 @@ namespace lava
     {
         alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         bufferSize = alignmentSize * instanceCount;
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation);
     }
 
     LavaBuffer::~LavaBuffer()
     {
         unmap();
         vkDestroyBuffer(Device.device(), buffer, nullptr);
-        vkFreeMemory(Device.device(), memory, nullptr);
+        Device.freeMemory(allocation);
     }
 
     VkResult LavaBuffer::map(VkDeviceSize size, VkDeviceSize offset)
     {
-        assert(buffer && memory && "Called map on buffer before create");
-        
+        assert(buffer && allocation.IsValid() && "Called map on buffer before create");
+
+        // The block the buffer lives in is already mapped, if its memory is host visible
+        if (!allocation.Mapped)
+        {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+
         const bool bWholeSize = size == VK_WHOLE_SIZE;
-        const VkDeviceSize& CurrentSize = bWholeSize ? bufferSize : size;
         const VkDeviceSize& CurrentOffset = bWholeSize ? 0 : offset;
 
-        return vkMapMemory(Device.device(), memory, CurrentOffset, CurrentSize, 0, &mapped);
+        mapped = static_cast<char*>(allocation.Mapped) + CurrentOffset;
+        return VK_SUCCESS;
     }
 
     void LavaBuffer::unmap()
     {
-        if (mapped)
-        {
-            vkUnmapMemory(Device.device(), memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     }
 
     void LavaBuffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset)
@@ -87,23 +89,13 @@ namespace lava
 
     VkResult LavaBuffer::flush(VkDeviceSize size, VkDeviceSize offset)
     {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-
+        const VkMappedMemoryRange mappedRange = Device.memoryAllocator().GetMappedRange(allocation, size, offset);
         return vkFlushMappedMemoryRanges(Device.device(), 1, &mappedRange);
     }
 
     VkResult LavaBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
     {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        
+        const VkMappedMemoryRange mappedRange = Device.memoryAllocator().GetMappedRange(allocation, size, offset);
         return vkInvalidateMappedMemoryRanges(Device.device(), 1, &mappedRange);
     }
 
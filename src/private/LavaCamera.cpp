@@ -78,6 +78,8 @@ void LavaCamera::SetViewYX(glm::vec3 Position, glm::vec3 Rotation)
 
 void LavaCamera::PopulateViewMatrix(const glm::vec3 Position, const glm::vec3& u, const glm::vec3& v, const glm::vec3& w)
 {
+    this->Position = Position;
+
     ViewMatrix = glm::mat4{1.f};
     ViewMatrix[0][0] = u.x;
     ViewMatrix[1][0] = u.y;
@@ -93,4 +95,42 @@ void LavaCamera::PopulateViewMatrix(const glm::vec3 Position, const glm::vec3& u
     ViewMatrix[3][2] = -glm::dot(w, Position);
 }
 
+std::array<glm::vec4, 6> LavaCamera::GetFrustumPlanes() const
+{
+    // Gribb-Hartmann extraction: each plane is a combination of the rows of the view projection matrix.
+    // Depth goes from 0 to 1, so the near plane is the third row alone
+    const glm::mat4 ViewProjection = ProjectionMat * ViewMatrix;
+    const auto Row = [&ViewProjection](const int Idx)
+    {
+        return glm::vec4{ViewProjection[0][Idx], ViewProjection[1][Idx], ViewProjection[2][Idx], ViewProjection[3][Idx]};
+    };
+
+    std::array<glm::vec4, 6> Planes
+    {
+        Row(3) + Row(0),
+        Row(3) - Row(0),
+        Row(3) + Row(1),
+        Row(3) - Row(1),
+        Row(2),
+        Row(3) - Row(2)
+    };
+
+    for (glm::vec4& Plane : Planes)
+    {
+        Plane = Plane / glm::length(glm::vec3{Plane});
+    }
+
+    return Planes;
+}
+
+float LavaCamera::GetScreenScale(const float Distance) const
+{
+    // Clip space spans 2 units vertically. Orthographic projections have no perspective divide
+    const float VerticalScale = glm::abs(ProjectionMat[1][1]) * .5f;
+    if (ProjectionMat[2][3] == 0.f)
+        return VerticalScale;
+
+    return VerticalScale / glm::max(Distance, std::numeric_limits<float>::epsilon());
+}
+
 }
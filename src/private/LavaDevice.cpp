@@ -1,4 +1,5 @@
 #include "LavaDevice.hpp"
+#include "LavaUploadBatch.hpp"
 
 // std headers
 #include <cstring>
@@ -74,10 +75,18 @@ LavaDevice::LavaDevice(LavaWindow &window) : window{window}
     // Descrubes the physical functions we want to use from GPU
     createLogicalDevice();
     createCommandPool();
+
+    // Every buffer and image gets its memory from there
+    allocator = std::make_unique<LavaMemoryAllocator>(physicalDevice, device_);
+    stagingRing_ = std::make_unique<LavaStagingRing>(*this);
+    geometryPool_ = std::make_unique<LavaGeometryPool>(*this);
 }
 
 LavaDevice::~LavaDevice()
 {
+  geometryPool_.reset();
+  stagingRing_.reset();
+  allocator.reset();
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -171,7 +180,7 @@ void LavaDevice::createLogicalDevice()
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily, indices.transferFamily};
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -216,6 +225,7 @@ void LavaDevice::createLogicalDevice()
 
     vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+    vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
 }
 
 void LavaDevice::createCommandPool()
@@ -390,10 +400,13 @@ QueueFamilyIndices LavaDevice::findQueueFamilies(VkPhysicalDevice device) {
       std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
       vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
+      // Transfer only families (DMA engines) are preferred over the ones also supporting compute
+      bool transferFamilyHasCompute = false;
+
       int i = 0;
       for (const auto &queueFamily : queueFamilies)
       {
-          if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+          if (!indices.isComplete() && queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
           {
             indices.graphicsFamily = i;
               indices.graphicsFamilyHasValue = true;
@@ -401,20 +414,33 @@ QueueFamilyIndices LavaDevice::findQueueFamilies(VkPhysicalDevice device) {
           
           VkBool32 presentSupport = false;
           vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-          if (queueFamily.queueCount > 0 && presentSupport)
+          if (!indices.isComplete() && queueFamily.queueCount > 0 && presentSupport)
           {
               indices.presentFamily = i;
               indices.presentFamilyHasValue = true;
           }
-          
-          if (indices.isComplete())
+
+          const bool bHasCompute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+          if (queueFamily.queueCount > 0
+              && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT
+              && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+              && (!indices.transferFamilyHasValue || (transferFamilyHasCompute && !bHasCompute)))
           {
-              break;
+              indices.transferFamily = i;
+              indices.transferFamilyHasValue = true;
+              transferFamilyHasCompute = bHasCompute;
           }
 
           i++;
         }
 
+        // Graphics queues support transfers too
+        if (!indices.transferFamilyHasValue && indices.graphicsFamilyHasValue)
+        {
+            indices.transferFamily = indices.graphicsFamily;
+            indices.transferFamilyHasValue = true;
+        }
+
         return indices;
 }
 
@@ -486,7 +512,7 @@ void LavaDevice::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory)
+    LavaMemoryAllocation &bufferAllocation)
 {
       VkBufferCreateInfo bufferInfo{};
       bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -502,17 +528,8 @@ void LavaDevice::createBuffer(
       VkMemoryRequirements memRequirements;
       vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-      VkMemoryAllocateInfo allocInfo{};
-      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      allocInfo.allocationSize = memRequirements.size;
-      allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-      if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-      {
-          throw std::runtime_error("failed to allocate vertex buffer memory!");
-      }
-
-      vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+      bufferAllocation = allocator->Allocate(memRequirements, properties, true);
+      vkBindBufferMemory(device_, buffer, bufferAllocation.Memory, bufferAllocation.Offset);
 }
 
 VkCommandBuffer LavaDevice::beginSingleTimeCommands()
@@ -543,29 +560,40 @@ void LavaDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer)
       submitInfo.commandBufferCount = 1;
       submitInfo.pCommandBuffers = &commandBuffer;
 
-      vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-      vkQueueWaitIdle(graphicsQueue_);
+      // Only waits for these commands, the frames in flight keep running
+      VkFenceCreateInfo fenceInfo{};
+      fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+      VkFence fence;
+      if (vkCreateFence(device_, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+      {
+          throw std::runtime_error("failed to create single time commands fence!");
+      }
+
+      vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence);
+      vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
 
+      vkDestroyFence(device_, fence, nullptr);
       vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
 void LavaDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
 {
-      VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+      LavaUploadBatch batch{*this};
 
       VkBufferCopy copyRegion{};
       copyRegion.srcOffset = 0;  // Optional
       copyRegion.dstOffset = 0;  // Optional
       copyRegion.size = size;
-      vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+      batch.AddBufferCopy(srcBuffer, dstBuffer, copyRegion);
 
-      endSingleTimeCommands(commandBuffer);
+      stagingRing_->Wait(batch.Submit());
 }
 
 void LavaDevice::copyBufferToImage(
     VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount)
 {
-      VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+      LavaUploadBatch batch{*this};
 
       VkBufferImageCopy region{};
       region.bufferOffset = 0;
@@ -580,21 +608,16 @@ void LavaDevice::copyBufferToImage(
       region.imageOffset = {0, 0, 0};
       region.imageExtent = {width, height, 1};
 
-      vkCmdCopyBufferToImage(
-          commandBuffer,
-          buffer,
-          image,
-          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-          1,
-          &region);
-      endSingleTimeCommands(commandBuffer);
+      // Left in the transfer layout, for the caller to transition
+      batch.AddImageCopy(buffer, image, region, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+      stagingRing_->Wait(batch.Submit());
 }
 
 void LavaDevice::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory)
+    LavaMemoryAllocation &imageAllocation)
 {
       if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS)
       {
@@ -604,17 +627,8 @@ void LavaDevice::createImageWithInfo(
       VkMemoryRequirements memRequirements;
       vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-      VkMemoryAllocateInfo allocInfo{};
-      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      allocInfo.allocationSize = memRequirements.size;
-      allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-      if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-      {
-          throw std::runtime_error("failed to allocate image memory!");
-      }
-
-      if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS)
+      imageAllocation = allocator->Allocate(memRequirements, properties, imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
+      if (vkBindImageMemory(device_, image, imageAllocation.Memory, imageAllocation.Offset) != VK_SUCCESS)
       {
           throw std::runtime_error("failed to bind image memory!");
       }
@@ -0,0 +1,833 @@
+//
+//  LavaFileReader.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaFileReader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LAVA_HAS_PREAD 1
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define LAVA_HAS_PREAD 0
+#endif
+
+// io_uring is driven through its system calls, so that no library is needed on top of the kernel headers
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define LAVA_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#else
+#define LAVA_HAS_IO_URING 0
+#endif
+
+namespace lava
+{
+
+namespace
+{
+
+// Reads are split into chunks of this size, which is also how long a cancelled read keeps going
+constexpr size_t ReadChunkSize = 16 << 20;
+
+// Threads are only waiting on the device, but past a few of them they stop adding throughput
+constexpr uint32_t MaxThreadCount = 8;
+
+FileReadResult MakeResult(uint64_t RequestId, uint64_t UserData, const std::string& Filepath, FileReadStatus Status, const std::string& Error = {})
+{
+    FileReadResult Result{};
+    Result.RequestId = RequestId;
+    Result.UserData = UserData;
+    Result.Filepath = Filepath;
+    Result.Status = Status;
+    Result.Error = Error;
+    return Result;
+}
+
+#if LAVA_HAS_PREAD
+
+// Opens Filepath and returns its size, or an error message
+bool OpenForReading(const std::string& Filepath, int& FileDesc, size_t& Size, std::string& Error)
+{
+    FileDesc = open(Filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (FileDesc < 0)
+    {
+        Error = "Failed to open file: " + Filepath + " (" + std::strerror(errno) + ")";
+        return false;
+    }
+
+    struct stat FileStat{};
+    if (fstat(FileDesc, &FileStat) != 0)
+    {
+        Error = "Failed to open file: " + Filepath + " (" + std::strerror(errno) + ")";
+        close(FileDesc);
+        FileDesc = -1;
+        return false;
+    }
+
+    Size = static_cast<size_t>(FileStat.st_size);
+    return true;
+}
+
+#endif
+
+// Blocking read used by the thread pool. IsCancelled is checked between two chunks
+bool ReadWholeFile(const std::string& Filepath, std::vector<char>& Data, std::string& Error, const std::function<bool()>& IsCancelled)
+{
+#if LAVA_HAS_PREAD
+    int FileDesc = -1;
+    size_t Size = 0;
+    if (!OpenForReading(Filepath, FileDesc, Size, Error))
+        return false;
+
+    Data.resize(Size);
+    size_t Offset = 0;
+    while (Offset < Size && !IsCancelled())
+    {
+        const ssize_t BytesRead = pread(FileDesc, Data.data() + Offset, std::min(Size - Offset, ReadChunkSize), static_cast<off_t>(Offset));
+        if (BytesRead < 0 && errno == EINTR)
+            continue;
+
+        if (BytesRead <= 0)
+        {
+            Error = "Failed to read file: " + Filepath + (BytesRead < 0 ? std::string(" (") + std::strerror(errno) + ")" : std::string(" (truncated)"));
+            close(FileDesc);
+            return false;
+        }
+
+        Offset += static_cast<size_t>(BytesRead);
+    }
+
+    close(FileDesc);
+    return true;
+#else
+    std::ifstream FileStream(Filepath, std::ios::ate | std::ios::binary);
+    if (!FileStream.is_open())
+    {
+        Error = "Failed to open file: " + Filepath;
+        return false;
+    }
+
+    const size_t Size = static_cast<size_t>(FileStream.tellg());
+    Data.resize(Size);
+    FileStream.seekg(0);
+
+    for (size_t Offset = 0; Offset < Size && !IsCancelled(); Offset += ReadChunkSize)
+    {
+        if (!FileStream.read(Data.data() + Offset, static_cast<std::streamsize>(std::min(Size - Offset, ReadChunkSize))))
+        {
+            Error = "Failed to read file: " + Filepath;
+            return false;
+        }
+    }
+
+    return true;
+#endif
+}
+
+}
+
+#if LAVA_HAS_IO_URING
+
+// Submission and completion rings of an io_uring instance, shared with the kernel. Only used by the thread driving it
+class IoRing
+{
+public:
+
+    // nullptr when the kernel does not provide io_uring, or does not support reads through it
+    static std::unique_ptr<IoRing> Create(uint32_t Entries)
+    {
+        io_uring_params Params{};
+        const int RingFd = static_cast<int>(syscall(__NR_io_uring_setup, Entries, &Params));
+        if (RingFd < 0)
+            return nullptr;
+
+        std::unique_ptr<IoRing> Ring{new IoRing{}};
+        Ring->RingFd = RingFd;
+
+        Ring->SqRingSize = Params.sq_off.array + Params.sq_entries * sizeof(uint32_t);
+        Ring->CqRingSize = Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+        Ring->bSingleMapping = (Params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (Ring->bSingleMapping)
+        {
+            Ring->SqRingSize = Ring->CqRingSize = std::max(Ring->SqRingSize, Ring->CqRingSize);
+        }
+
+        Ring->SqRing = mmap(nullptr, Ring->SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_SQ_RING);
+        if (Ring->SqRing == MAP_FAILED)
+            return nullptr;
+
+        Ring->CqRing = Ring->bSingleMapping
+            ? Ring->SqRing
+            : mmap(nullptr, Ring->CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_CQ_RING);
+        if (Ring->CqRing == MAP_FAILED)
+            return nullptr;
+
+        Ring->SqesSize = Params.sq_entries * sizeof(io_uring_sqe);
+        void* Sqes = mmap(nullptr, Ring->SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_SQES);
+        if (Sqes == MAP_FAILED)
+            return nullptr;
+        Ring->Sqes = static_cast<io_uring_sqe*>(Sqes);
+
+        char* const Sq = static_cast<char*>(Ring->SqRing);
+        Ring->SqHead = reinterpret_cast<uint32_t*>(Sq + Params.sq_off.head);
+        Ring->SqTail = reinterpret_cast<uint32_t*>(Sq + Params.sq_off.tail);
+        Ring->SqMask = *reinterpret_cast<uint32_t*>(Sq + Params.sq_off.ring_mask);
+        Ring->SqArray = reinterpret_cast<uint32_t*>(Sq + Params.sq_off.array);
+        Ring->SqEntries = Params.sq_entries;
+        Ring->LocalTail = *Ring->SqTail;
+
+        char* const Cq = static_cast<char*>(Ring->CqRing);
+        Ring->CqHead = reinterpret_cast<uint32_t*>(Cq + Params.cq_off.head);
+        Ring->CqTail = reinterpret_cast<uint32_t*>(Cq + Params.cq_off.tail);
+        Ring->CqMask = *reinterpret_cast<uint32_t*>(Cq + Params.cq_off.ring_mask);
+        Ring->Cqes = reinterpret_cast<io_uring_cqe*>(Cq + Params.cq_off.cqes);
+
+        // IORING_OP_READ needs a 5.6 kernel, which is also the first one able to report the supported operations
+        constexpr uint32_t ProbeOpCount = 256;
+        std::vector<char> ProbeStorage(sizeof(io_uring_probe) + ProbeOpCount * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* Probe = reinterpret_cast<io_uring_probe*>(ProbeStorage.data());
+        if (syscall(__NR_io_uring_register, RingFd, IORING_REGISTER_PROBE, Probe, ProbeOpCount) < 0
+            || Probe->last_op < IORING_OP_READ
+            || (Probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) == 0)
+            return nullptr;
+
+        Ring->WakeFd = eventfd(0, EFD_CLOEXEC);
+        if (Ring->WakeFd < 0)
+            return nullptr;
+
+        return Ring;
+    }
+
+    ~IoRing()
+    {
+        if (Sqes)
+        {
+            munmap(Sqes, SqesSize);
+        }
+        if (CqRing != MAP_FAILED && !bSingleMapping)
+        {
+            munmap(CqRing, CqRingSize);
+        }
+        if (SqRing != MAP_FAILED)
+        {
+            munmap(SqRing, SqRingSize);
+        }
+        if (RingFd >= 0)
+        {
+            close(RingFd);
+        }
+        if (WakeFd >= 0)
+        {
+            close(WakeFd);
+        }
+    }
+
+    // Zeroed submission entry, published by the next Submit. The ring is sized so that it never runs out
+    io_uring_sqe* GetSqe()
+    {
+        if (LocalTail - __atomic_load_n(SqHead, __ATOMIC_ACQUIRE) >= SqEntries)
+            return nullptr;
+
+        const uint32_t Idx = LocalTail & SqMask;
+        SqArray[Idx] = Idx;
+        ++LocalTail;
+
+        std::memset(&Sqes[Idx], 0, sizeof(io_uring_sqe));
+        return &Sqes[Idx];
+    }
+
+    // Submits the new entries and waits for at least one completion. Returns a negative errno on failure
+    int SubmitAndWait()
+    {
+        __atomic_store_n(SqTail, LocalTail, __ATOMIC_RELEASE);
+        const uint32_t ToSubmit = LocalTail - __atomic_load_n(SqHead, __ATOMIC_ACQUIRE);
+
+        const long Result = syscall(__NR_io_uring_enter, RingFd, ToSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        return Result < 0 ? -errno : static_cast<int>(Result);
+    }
+
+    // Waits for at least one completion without submitting anything. Returns a negative errno on failure
+    int Wait()
+    {
+        const long Result = syscall(__NR_io_uring_enter, RingFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        return Result < 0 ? -errno : static_cast<int>(Result);
+    }
+
+    // Visits the user data of the entries the kernel has not consumed yet, which it is never going to touch
+    template <typename VisitorType>
+    void ForEachUnsubmitted(VisitorType&& Visit) const
+    {
+        for (uint32_t Entry = __atomic_load_n(SqHead, __ATOMIC_ACQUIRE); Entry != LocalTail; ++Entry)
+        {
+            Visit(Sqes[SqArray[Entry & SqMask]].user_data);
+        }
+    }
+
+    template <typename VisitorType>
+    void ForEachCompletion(VisitorType&& Visit)
+    {
+        uint32_t Head = *CqHead;
+        while (Head != __atomic_load_n(CqTail, __ATOMIC_ACQUIRE))
+        {
+            // Copied, so that the entry can be released before the visitor queues new reads
+            const io_uring_cqe Cqe = Cqes[Head & CqMask];
+            __atomic_store_n(CqHead, ++Head, __ATOMIC_RELEASE);
+            Visit(Cqe);
+        }
+    }
+
+    // Written by Wake, and read by the ring thread through a read always kept in flight
+    int WakeFd = -1;
+    uint64_t WakeValue = 0;
+    bool bWakeArmed = false;
+
+private:
+
+    IoRing() = default;
+
+    int RingFd = -1;
+
+    void* SqRing = MAP_FAILED;
+    void* CqRing = MAP_FAILED;
+    size_t SqRingSize = 0;
+    size_t CqRingSize = 0;
+    bool bSingleMapping = false;
+
+    io_uring_sqe* Sqes = nullptr;
+    size_t SqesSize = 0;
+
+    uint32_t* SqHead = nullptr;
+    uint32_t* SqTail = nullptr;
+    uint32_t* SqArray = nullptr;
+    uint32_t SqMask = 0;
+    uint32_t SqEntries = 0;
+    uint32_t LocalTail = 0;
+
+    uint32_t* CqHead = nullptr;
+    uint32_t* CqTail = nullptr;
+    uint32_t CqMask = 0;
+    io_uring_cqe* Cqes = nullptr;
+};
+
+#else
+
+class IoRing {};
+
+#endif
+
+#pragma region FileReadQueue
+
+void FileReadQueue::Push(FileReadResult&& Result)
+{
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        if (bClosed)
+            return;
+
+        Results.push_back(std::move(Result));
+    }
+    ResultAvailable.notify_one();
+}
+
+bool FileReadQueue::Pop(FileReadResult& Result)
+{
+    std::unique_lock<std::mutex> Lock{Mutex};
+    ResultAvailable.wait(Lock, [this]() { return bClosed || !Results.empty(); });
+
+    if (bClosed)
+        return false;
+
+    Result = std::move(Results.front());
+    Results.pop_front();
+    return true;
+}
+
+bool FileReadQueue::TryPop(FileReadResult& Result)
+{
+    std::lock_guard<std::mutex> Lock{Mutex};
+    if (bClosed || Results.empty())
+        return false;
+
+    Result = std::move(Results.front());
+    Results.pop_front();
+    return true;
+}
+
+void FileReadQueue::Close()
+{
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        bClosed = true;
+        Results.clear();
+    }
+    ResultAvailable.notify_all();
+}
+
+#pragma endregion
+
+LavaFileReader::LavaFileReader(uint32_t InQueueDepth, bool bAllowIoUring)
+    : QueueDepth(std::max(InQueueDepth, 1u))
+{
+#if LAVA_HAS_IO_URING
+    // One more entry for the read of the wake up event
+    if (bAllowIoUring)
+    {
+        Ring = IoRing::Create(QueueDepth + 1);
+    }
+
+    if (Ring)
+    {
+        Threads.emplace_back(&LavaFileReader::RingLoop, this);
+        return;
+    }
+#endif
+
+    const uint32_t ThreadCount = std::min(QueueDepth, MaxThreadCount);
+    for (uint32_t ThreadIdx = 0; ThreadIdx < ThreadCount; ++ThreadIdx)
+    {
+        Threads.emplace_back(&LavaFileReader::WorkerLoop, this);
+    }
+}
+
+LavaFileReader::~LavaFileReader()
+{
+    std::vector<Request> Cancelled{};
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        bStopping = true;
+
+        for (std::deque<Request>& Requests : Pending)
+        {
+            std::move(Requests.begin(), Requests.end(), std::back_inserter(Cancelled));
+            Requests.clear();
+        }
+    }
+
+    for (const Request& Dropped : Cancelled)
+    {
+        Dropped.Completions->Push(MakeResult(Dropped.Id, Dropped.UserData, Dropped.Filepath, FileReadStatus::Cancelled));
+    }
+
+    RequestAvailable.notify_all();
+    Wake();
+
+    for (std::thread& Thread : Threads)
+    {
+        Thread.join();
+    }
+}
+
+uint64_t LavaFileReader::Read(const std::string& Filepath, FileReadQueue& Completions, FileReadPriority Priority, uint64_t UserData)
+{
+    uint64_t RequestId = 0;
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        RequestId = NextRequestId++;
+        Pending[static_cast<size_t>(Priority)].push_back({RequestId, Filepath, &Completions, UserData});
+    }
+
+    Wake();
+    return RequestId;
+}
+
+bool LavaFileReader::Cancel(uint64_t RequestId)
+{
+    Request Dropped{};
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        if (InFlight.count(RequestId) > 0)
+        {
+            CancelledInFlight.insert(RequestId);
+            return true;
+        }
+
+        bool bFound = false;
+        for (std::deque<Request>& Requests : Pending)
+        {
+            const auto Found = std::find_if(Requests.begin(), Requests.end(), [RequestId](const Request& Queued) { return Queued.Id == RequestId; });
+            if (Found != Requests.end())
+            {
+                Dropped = std::move(*Found);
+                Requests.erase(Found);
+                bFound = true;
+                break;
+            }
+        }
+
+        if (!bFound)
+            return false;
+    }
+
+    Dropped.Completions->Push(MakeResult(Dropped.Id, Dropped.UserData, Dropped.Filepath, FileReadStatus::Cancelled));
+    return true;
+}
+
+std::vector<std::vector<char>> LavaFileReader::ReadFiles(const std::vector<std::string>& Filepaths)
+{
+    FileReadQueue Completions{};
+    LavaFileReader& Reader = GetShared();
+    for (size_t FileIdx = 0; FileIdx < Filepaths.size(); ++FileIdx)
+    {
+        Reader.Read(Filepaths[FileIdx], Completions, FileReadPriority::Urgent, FileIdx);
+    }
+
+    // Every result is waited for before throwing, since they are pushed into the local queue
+    std::vector<std::vector<char>> Contents(Filepaths.size());
+    std::string Error{};
+    for (size_t Completed = 0; Completed < Filepaths.size(); ++Completed)
+    {
+        FileReadResult Result{};
+        Completions.Pop(Result);
+
+        if (Result.Status == FileReadStatus::Completed)
+        {
+            Contents[Result.UserData] = std::move(Result.Data);
+        }
+        else if (Error.empty())
+        {
+            Error = Result.Error.empty() ? "Failed to open file: " + Result.Filepath : Result.Error;
+        }
+    }
+
+    if (!Error.empty())
+    {
+        throw std::runtime_error(Error);
+    }
+
+    return Contents;
+}
+
+LavaFileReader& LavaFileReader::GetShared()
+{
+    static LavaFileReader Shared{MaxThreadCount};
+    return Shared;
+}
+
+bool LavaFileReader::PopPendingLocked(Request& Out)
+{
+    for (size_t Priority = static_cast<size_t>(FileReadPriority::Count); Priority-- > 0;)
+    {
+        if (!Pending[Priority].empty())
+        {
+            Out = std::move(Pending[Priority].front());
+            Pending[Priority].pop_front();
+            InFlight.insert(Out.Id);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void LavaFileReader::Complete(const Request& Started, FileReadResult&& Result)
+{
+    bool bCancelled = false;
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        InFlight.erase(Started.Id);
+        bCancelled = CancelledInFlight.erase(Started.Id) > 0;
+    }
+
+    if (bCancelled)
+    {
+        Result = MakeResult(Started.Id, Started.UserData, Started.Filepath, FileReadStatus::Cancelled);
+    }
+
+    Started.Completions->Push(std::move(Result));
+}
+
+void LavaFileReader::Wake()
+{
+#if LAVA_HAS_IO_URING
+    if (Ring && !bRingFailed)
+    {
+        const uint64_t Increment = 1;
+        while (write(Ring->WakeFd, &Increment, sizeof(Increment)) < 0 && errno == EINTR) {}
+        return;
+    }
+#endif
+
+    RequestAvailable.notify_one();
+}
+
+void LavaFileReader::WorkerLoop()
+{
+    while (true)
+    {
+        Request Started{};
+        {
+            std::unique_lock<std::mutex> Lock{Mutex};
+            while (!bStopping && !PopPendingLocked(Started))
+            {
+                RequestAvailable.wait(Lock);
+            }
+
+            if (bStopping)
+                return;
+        }
+
+        const auto IsCancelled = [this, &Started]()
+        {
+            std::lock_guard<std::mutex> Lock{Mutex};
+            return CancelledInFlight.count(Started.Id) > 0;
+        };
+
+        FileReadResult Result = MakeResult(Started.Id, Started.UserData, Started.Filepath, FileReadStatus::Completed);
+        if (!ReadWholeFile(Started.Filepath, Result.Data, Result.Error, IsCancelled))
+        {
+            Result.Status = FileReadStatus::Failed;
+            Result.Data.clear();
+        }
+
+        Complete(Started, std::move(Result));
+    }
+}
+
+void LavaFileReader::RingLoop()
+{
+#if LAVA_HAS_IO_URING
+    struct InFlightRead
+    {
+        Request Started{};
+        int FileDesc = -1;
+        std::vector<char> Data{};
+        size_t Offset = 0;
+    };
+
+    // Reads are identified by their slot, the wake up event by a tag no slot can have
+    constexpr uint64_t WakeTag = ~0ull;
+
+    std::vector<InFlightRead> Slots(QueueDepth);
+    std::vector<uint32_t> FreeSlots{};
+    for (uint32_t SlotIdx = QueueDepth; SlotIdx-- > 0;)
+    {
+        FreeSlots.push_back(SlotIdx);
+    }
+
+    const auto ArmWake = [this]()
+    {
+        io_uring_sqe* Sqe = Ring->GetSqe();
+        Sqe->opcode = IORING_OP_READ;
+        Sqe->fd = Ring->WakeFd;
+        Sqe->addr = reinterpret_cast<uint64_t>(&Ring->WakeValue);
+        Sqe->len = sizeof(Ring->WakeValue);
+        Sqe->user_data = WakeTag;
+        Ring->bWakeArmed = true;
+    };
+
+    // Each read has a single chunk in flight, so the ring never holds more than QueueDepth + 1 entries
+    const auto QueueChunk = [this, &Slots](uint32_t SlotIdx)
+    {
+        InFlightRead& Read = Slots[SlotIdx];
+        io_uring_sqe* Sqe = Ring->GetSqe();
+        Sqe->opcode = IORING_OP_READ;
+        Sqe->fd = Read.FileDesc;
+        Sqe->off = Read.Offset;
+        Sqe->addr = reinterpret_cast<uint64_t>(Read.Data.data() + Read.Offset);
+        Sqe->len = static_cast<uint32_t>(std::min(Read.Data.size() - Read.Offset, ReadChunkSize));
+        Sqe->user_data = SlotIdx;
+    };
+
+    const auto Finish = [this, &Slots, &FreeSlots](uint32_t SlotIdx, FileReadStatus Status, const std::string& Error)
+    {
+        InFlightRead& Read = Slots[SlotIdx];
+        if (Read.FileDesc >= 0)
+        {
+            close(Read.FileDesc);
+        }
+
+        FileReadResult Result = MakeResult(Read.Started.Id, Read.Started.UserData, Read.Started.Filepath, Status, Error);
+        if (Status == FileReadStatus::Completed)
+        {
+            Result.Data = std::move(Read.Data);
+        }
+
+        Complete(Read.Started, std::move(Result));
+
+        Read = InFlightRead{};
+        FreeSlots.push_back(SlotIdx);
+    };
+
+    const auto IsCancelled = [this](uint64_t RequestId)
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        return CancelledInFlight.count(RequestId) > 0;
+    };
+
+    // Called once io_uring_enter fails for good. The reads the kernel holds are waited for as long as the ring lets
+    // us, then every read in flight fails. The buffers the kernel might still write into are leaked, not freed
+    const auto AbandonRing = [&]()
+    {
+        std::vector<bool> bInKernel(QueueDepth, false);
+        for (uint32_t SlotIdx = 0; SlotIdx < QueueDepth; ++SlotIdx)
+        {
+            bInKernel[SlotIdx] = Slots[SlotIdx].Started.Completions != nullptr;
+        }
+
+        Ring->ForEachUnsubmitted([&bInKernel](uint64_t UserData)
+        {
+            if (UserData != WakeTag)
+            {
+                bInKernel[UserData] = false;
+            }
+        });
+
+        size_t InKernelCount = std::count(bInKernel.begin(), bInKernel.end(), true);
+        while (InKernelCount > 0)
+        {
+            const int Waited = Ring->Wait();
+            if (Waited < 0 && Waited != -EINTR)
+                break;
+
+            Ring->ForEachCompletion([&](const io_uring_cqe& Cqe)
+            {
+                if (Cqe.user_data != WakeTag && bInKernel[Cqe.user_data])
+                {
+                    bInKernel[Cqe.user_data] = false;
+                    --InKernelCount;
+                }
+            });
+        }
+
+        for (uint32_t SlotIdx = 0; SlotIdx < QueueDepth; ++SlotIdx)
+        {
+            InFlightRead& Read = Slots[SlotIdx];
+            if (!Read.Started.Completions)
+                continue;
+
+            if (bInKernel[SlotIdx])
+            {
+                static_cast<void>(new std::vector<char>(std::move(Read.Data)));
+            }
+
+            Finish(SlotIdx, FileReadStatus::Failed, "Failed to read file: " + Read.Started.Filepath + " (io_uring failure)");
+        }
+    };
+
+    ArmWake();
+    while (true)
+    {
+        // Files are opened on this thread, which is cheap next to reading them
+        std::vector<Request> Started{};
+        bool bStop = false;
+        {
+            std::lock_guard<std::mutex> Lock{Mutex};
+            Request Next{};
+            while (!bStopping && Started.size() < FreeSlots.size() && PopPendingLocked(Next))
+            {
+                Started.push_back(std::move(Next));
+            }
+            bStop = bStopping;
+        }
+
+        for (Request& Next : Started)
+        {
+            const uint32_t SlotIdx = FreeSlots.back();
+            FreeSlots.pop_back();
+
+            InFlightRead& Read = Slots[SlotIdx];
+            Read.Started = std::move(Next);
+
+            size_t Size = 0;
+            std::string Error{};
+            if (!OpenForReading(Read.Started.Filepath, Read.FileDesc, Size, Error))
+            {
+                Finish(SlotIdx, FileReadStatus::Failed, Error);
+                continue;
+            }
+
+            Read.Data.resize(Size);
+            if (Size == 0)
+            {
+                Finish(SlotIdx, FileReadStatus::Completed, {});
+                continue;
+            }
+
+            QueueChunk(SlotIdx);
+        }
+
+        // Reads in flight write into their buffers until they complete, so they are always waited for
+        if (bStop && FreeSlots.size() == QueueDepth && !Ring->bWakeArmed)
+            break;
+
+        const int Submitted = Ring->SubmitAndWait();
+        if (Submitted < 0 && Submitted != -EINTR && Submitted != -EAGAIN && Submitted != -EBUSY)
+        {
+            std::cout << "io_uring_enter failed: " << std::strerror(-Submitted) << ", falling back to blocking reads" << std::endl;
+            AbandonRing();
+
+            // Wake now notifies the condition variable, which the requests queued from here on are signaled with
+            bRingFailed = true;
+            WorkerLoop();
+            return;
+        }
+
+        Ring->ForEachCompletion([&](const io_uring_cqe& Cqe)
+        {
+            if (Cqe.user_data == WakeTag)
+            {
+                Ring->bWakeArmed = false;
+                return;
+            }
+
+            const uint32_t SlotIdx = static_cast<uint32_t>(Cqe.user_data);
+            InFlightRead& Read = Slots[SlotIdx];
+
+            if (Cqe.res == -EINTR || Cqe.res == -EAGAIN)
+            {
+                QueueChunk(SlotIdx);
+                return;
+            }
+
+            if (Cqe.res <= 0)
+            {
+                const std::string Reason = Cqe.res < 0 ? std::strerror(-Cqe.res) : "truncated";
+                Finish(SlotIdx, FileReadStatus::Failed, "Failed to read file: " + Read.Started.Filepath + " (" + Reason + ")");
+                return;
+            }
+
+            Read.Offset += static_cast<size_t>(Cqe.res);
+            if (Read.Offset == Read.Data.size())
+            {
+                Finish(SlotIdx, FileReadStatus::Completed, {});
+            }
+            else if (IsCancelled(Read.Started.Id))
+            {
+                Finish(SlotIdx, FileReadStatus::Cancelled, {});
+            }
+            else
+            {
+                QueueChunk(SlotIdx);
+            }
+        });
+
+        // The wake up that signaled the stop must not be followed by a read nobody is going to complete
+        if (!Ring->bWakeArmed)
+        {
+            std::lock_guard<std::mutex> Lock{Mutex};
+            if (!bStopping)
+            {
+                ArmWake();
+            }
+        }
+    }
+#endif
+}
+
+}
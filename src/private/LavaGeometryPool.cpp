@@ -0,0 +1,401 @@
+//
+//  LavaGeometryPool.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaGeometryPool.hpp"
+#include "LavaDevice.hpp"
+#include "LavaBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <limits>
+#include <map>
+
+namespace lava
+{
+
+// One buffer of a heap
+struct LavaGeometryPage
+{
+    std::unique_ptr<LavaBuffer> Buffer{};
+
+    // In elements
+    uint32_t Capacity = 0;
+    uint32_t UsedCount = 0;
+
+    // First element of each free range, and its length. Ranges never touch, they are merged when freed
+    std::map<uint32_t, uint32_t> FreeRanges{};
+};
+
+// Pages of the allocations sharing a usage and an element size
+struct LavaGeometryHeap
+{
+    VkBufferUsageFlags Usage = 0;
+    uint32_t ElementSize = 0;
+
+    // Elements of a regular page, larger allocations get a page of their exact size
+    uint32_t PageCapacity = 0;
+
+    std::vector<std::unique_ptr<LavaGeometryPage>> Pages{};
+};
+
+namespace
+{
+
+// Carves Count elements out of the first free range of Page they fit in
+bool TakeRange(LavaGeometryPage& Page, const uint32_t Count, uint32_t& OutFirst)
+{
+    for (auto It = Page.FreeRanges.begin(); It != Page.FreeRanges.end(); ++It)
+    {
+        if (It->second < Count)
+            continue;
+
+        const uint32_t RangeFirst = It->first;
+        const uint32_t RangeCount = It->second;
+        Page.FreeRanges.erase(It);
+
+        if (RangeCount > Count)
+        {
+            Page.FreeRanges.emplace(RangeFirst + Count, RangeCount - Count);
+        }
+
+        Page.UsedCount += Count;
+        OutFirst = RangeFirst;
+        return true;
+    }
+
+    return false;
+}
+
+LavaGeometryPage* TakeRange(const std::vector<std::unique_ptr<LavaGeometryPage>>& Pages, const uint32_t Count, uint32_t& OutFirst)
+{
+    for (const std::unique_ptr<LavaGeometryPage>& Page : Pages)
+    {
+        if (TakeRange(*Page, Count, OutFirst))
+            return Page.get();
+    }
+
+    return nullptr;
+}
+
+void GiveRange(LavaGeometryPage& Page, const uint32_t First, const uint32_t Count)
+{
+    uint32_t RangeFirst = First;
+    uint32_t RangeCount = Count;
+
+    auto Next = Page.FreeRanges.lower_bound(First);
+    if (Next != Page.FreeRanges.begin())
+    {
+        auto Previous = std::prev(Next);
+        if (Previous->first + Previous->second == First)
+        {
+            RangeFirst = Previous->first;
+            RangeCount += Previous->second;
+            Page.FreeRanges.erase(Previous);
+        }
+    }
+
+    if (Next != Page.FreeRanges.end() && Next->first == First + Count)
+    {
+        RangeCount += Next->second;
+        Page.FreeRanges.erase(Next);
+    }
+
+    Page.FreeRanges.emplace(RangeFirst, RangeCount);
+    Page.UsedCount -= Count;
+}
+
+uint32_t GetIndexSize(const VkIndexType Type)
+{
+    return Type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+}
+
+LavaGeometryPool::LavaGeometryPool(LavaDevice& InDevice, VkDeviceSize InPageSize)
+    : Device(InDevice)
+    , PageSize(InPageSize)
+{
+}
+
+LavaGeometryPool::~LavaGeometryPool()
+{
+}
+
+LavaGeometryAllocation LavaGeometryPool::AllocateVertices(const uint32_t Stride, const uint32_t Count)
+{
+    return Allocate(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, Stride, Count);
+}
+
+LavaGeometryAllocation LavaGeometryPool::AllocateIndices(const VkIndexType Type, const uint32_t Count)
+{
+    return Allocate(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, GetIndexSize(Type), Count);
+}
+
+LavaGeometryAllocation LavaGeometryPool::Allocate(const VkBufferUsageFlags Usage, const uint32_t ElementSize, const uint32_t Count)
+{
+    assert(ElementSize > 0 && Count > 0 && "NOTE: allocating empty geometry");
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    auto HeapIt = std::find_if(Heaps.begin(), Heaps.end(), [Usage, ElementSize](const std::unique_ptr<LavaGeometryHeap>& Candidate)
+    {
+        return Candidate->Usage == Usage && Candidate->ElementSize == ElementSize;
+    });
+
+    if (HeapIt == Heaps.end())
+    {
+        Heaps.push_back(std::make_unique<LavaGeometryHeap>());
+        HeapIt = std::prev(Heaps.end());
+
+        std::unique_ptr<LavaGeometryHeap>& Heap = *HeapIt;
+        Heap->Usage = Usage;
+        Heap->ElementSize = ElementSize;
+
+        const VkDeviceSize PageElements = std::min<VkDeviceSize>(PageSize / ElementSize, std::numeric_limits<uint32_t>::max());
+        Heap->PageCapacity = static_cast<uint32_t>(std::max<VkDeviceSize>(PageElements, 1));
+    }
+
+    LavaGeometryHeap* Heap = HeapIt->get();
+
+    uint32_t First = 0;
+    LavaGeometryPage* Page = TakeRange(Heap->Pages, Count, First);
+    if (!Page)
+    {
+        Heap->Pages.push_back(CreatePage(*Heap, Count));
+        Page = Heap->Pages.back().get();
+        TakeRange(*Page, Count, First);
+    }
+
+    LavaGeometrySlot* Slot = nullptr;
+    if (FreeSlots.empty())
+    {
+        Slots.emplace_back();
+        Slot = &Slots.back();
+    }
+    else
+    {
+        Slot = FreeSlots.back();
+        FreeSlots.pop_back();
+    }
+
+    Slot->Buffer = Page->Buffer->getBuffer();
+    Slot->First = First;
+    Slot->Count = Count;
+    Slot->ElementSize = ElementSize;
+    Slot->Heap = Heap;
+    Slot->Page = Page;
+    Slot->bUsed = true;
+
+    LavaGeometryAllocation Allocation{};
+    Allocation.Slot = Slot;
+    return Allocation;
+}
+
+void LavaGeometryPool::Free(LavaGeometryAllocation& Allocation)
+{
+    if (!Allocation.IsValid())
+        return;
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    LavaGeometrySlot& Slot = *Allocation.Slot;
+    LavaGeometryHeap& Heap = *Slot.Heap;
+    LavaGeometryPage& Page = *Slot.Page;
+    GiveRange(Page, Slot.First, Slot.Count);
+
+    // A single regular page is kept once empty, so that releasing and loading models in turn does not create a
+    // buffer every time
+    if (Page.UsedCount == 0)
+    {
+        const bool bHasEmptyPage = std::any_of(Heap.Pages.begin(), Heap.Pages.end(), [&Page](const std::unique_ptr<LavaGeometryPage>& Other)
+        {
+            return Other.get() != &Page && Other->UsedCount == 0;
+        });
+
+        if (bHasEmptyPage || Page.Capacity > Heap.PageCapacity)
+        {
+            Heap.Pages.erase(std::find_if(Heap.Pages.begin(), Heap.Pages.end(), [&Page](const std::unique_ptr<LavaGeometryPage>& Other)
+            {
+                return Other.get() == &Page;
+            }));
+        }
+    }
+
+    Slot = LavaGeometrySlot{};
+    FreeSlots.push_back(&Slot);
+    Allocation.Slot = nullptr;
+}
+
+void LavaGeometryPool::Compact()
+{
+    // Nothing can read or write the pages while their content moves. The uploads not recorded yet only resolve their
+    // destination when they are, so they follow the move
+    LavaStagingRing& StagingRing = Device.stagingRing();
+    StagingRing.Wait(StagingRing.Submit());
+    vkDeviceWaitIdle(Device.device());
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    std::map<const LavaGeometryHeap*, std::vector<LavaGeometrySlot*>> HeapSlots;
+    for (LavaGeometrySlot& Slot : Slots)
+    {
+        if (Slot.bUsed)
+        {
+            HeapSlots[Slot.Heap].push_back(&Slot);
+        }
+    }
+
+    // Copies from each old page to each new one, in a single command
+    std::map<std::pair<VkBuffer, VkBuffer>, std::vector<VkBufferCopy>> Copies;
+
+    // Destroyed once the copies reading them have completed
+    std::vector<std::unique_ptr<LavaGeometryPage>> RetiredPages;
+
+    for (const std::unique_ptr<LavaGeometryHeap>& HeapPtr : Heaps)
+    {
+        LavaGeometryHeap& Heap = *HeapPtr;
+        if (!IsFragmented(Heap))
+            continue;
+
+        std::map<const LavaGeometryPage*, size_t> PageOrder;
+        for (size_t PageIdx = 0; PageIdx < Heap.Pages.size(); ++PageIdx)
+        {
+            PageOrder[Heap.Pages[PageIdx].get()] = PageIdx;
+        }
+
+        // Allocations keep their order, so that the models loaded together stay next to each other
+        std::vector<LavaGeometrySlot*>& Live = HeapSlots[&Heap];
+        std::sort(Live.begin(), Live.end(), [&PageOrder](const LavaGeometrySlot* A, const LavaGeometrySlot* B)
+        {
+            const size_t PageA = PageOrder[A->Page];
+            const size_t PageB = PageOrder[B->Page];
+            return PageA != PageB ? PageA < PageB : A->First < B->First;
+        });
+
+        std::vector<std::unique_ptr<LavaGeometryPage>> Packed;
+        for (LavaGeometrySlot* Slot : Live)
+        {
+            uint32_t First = 0;
+            LavaGeometryPage* Page = TakeRange(Packed, Slot->Count, First);
+            if (!Page)
+            {
+                Packed.push_back(CreatePage(Heap, Slot->Count));
+                Page = Packed.back().get();
+                TakeRange(*Page, Slot->Count, First);
+            }
+
+            VkBufferCopy Region{};
+            Region.srcOffset = static_cast<VkDeviceSize>(Slot->First) * Heap.ElementSize;
+            Region.dstOffset = static_cast<VkDeviceSize>(First) * Heap.ElementSize;
+            Region.size = static_cast<VkDeviceSize>(Slot->Count) * Heap.ElementSize;
+            Copies[{Slot->Buffer, Page->Buffer->getBuffer()}].push_back(Region);
+
+            Slot->Buffer = Page->Buffer->getBuffer();
+            Slot->First = First;
+            Slot->Page = Page;
+        }
+
+        std::move(Heap.Pages.begin(), Heap.Pages.end(), std::back_inserter(RetiredPages));
+        Heap.Pages = std::move(Packed);
+    }
+
+    if (Copies.empty())
+        return;
+
+    // The pages belong to the graphics family, the uploads acquired them there
+    VkCommandBuffer CommandBuffer = Device.beginSingleTimeCommands();
+
+    for (const auto& Copy : Copies)
+    {
+        vkCmdCopyBuffer(CommandBuffer, Copy.first.first, Copy.first.second, static_cast<uint32_t>(Copy.second.size()), Copy.second.data());
+    }
+
+    VkMemoryBarrier Barrier{};
+    Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+
+    vkCmdPipelineBarrier
+        ( CommandBuffer
+        , VK_PIPELINE_STAGE_TRANSFER_BIT
+        , VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+        , 0
+        , 1, &Barrier
+        , 0, nullptr
+        , 0, nullptr );
+
+    Device.endSingleTimeCommands(CommandBuffer);
+}
+
+bool LavaGeometryPool::IsFragmented(const LavaGeometryHeap& Heap) const
+{
+    // Packed pages have no hole, and at most one of them is not full
+    uint32_t PartialPageCount = 0;
+    for (const std::unique_ptr<LavaGeometryPage>& Page : Heap.Pages)
+    {
+        for (const auto& Range : Page->FreeRanges)
+        {
+            if (Range.first + Range.second != Page->Capacity)
+                return true;
+        }
+
+        if (Page->UsedCount < Page->Capacity)
+        {
+            ++PartialPageCount;
+        }
+    }
+
+    return PartialPageCount > 1;
+}
+
+std::unique_ptr<LavaGeometryPage> LavaGeometryPool::CreatePage(const LavaGeometryHeap& Heap, const uint32_t Count)
+{
+    std::unique_ptr<LavaGeometryPage> Page = std::make_unique<LavaGeometryPage>();
+    Page->Capacity = std::max(Count, Heap.PageCapacity);
+
+    // Source of the copies when the pool is compacted
+    Page->Buffer = std::make_unique<LavaBuffer>
+        ( Device
+        , Heap.ElementSize
+        , Page->Capacity
+        , Heap.Usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+        , VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+
+    Page->FreeRanges.emplace(0, Page->Capacity);
+    return Page;
+}
+
+LavaGeometryStats LavaGeometryPool::GetStats() const
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    LavaGeometryStats Stats{};
+    for (const std::unique_ptr<LavaGeometryHeap>& HeapPtr : Heaps)
+    {
+        const LavaGeometryHeap& Heap = *HeapPtr;
+        for (const std::unique_ptr<LavaGeometryPage>& Page : Heap.Pages)
+        {
+            ++Stats.PageCount;
+            Stats.UsedSize += static_cast<VkDeviceSize>(Page->UsedCount) * Heap.ElementSize;
+            Stats.ReservedSize += static_cast<VkDeviceSize>(Page->Capacity) * Heap.ElementSize;
+
+            for (const auto& Range : Page->FreeRanges)
+            {
+                if (Range.first + Range.second != Page->Capacity)
+                {
+                    ++Stats.FreeRangeCount;
+                }
+            }
+        }
+    }
+
+    Stats.AllocationCount = static_cast<uint32_t>(Slots.size() - FreeSlots.size());
+    return Stats;
+}
+
+}
@@ -0,0 +1,892 @@
+//
+//  LavaGltfParser.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaGltfParser.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+namespace lava
+{
+
+namespace
+{
+
+// Minimal JSON document. Only the JSON chunk of the file, which is usually a few kilobytes, is parsed into it
+struct JsonValue
+{
+    enum class Kind
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Kind Type = Kind::Null;
+    bool bBool = false;
+    double Number = 0.0;
+    std::string String{};
+
+    // Elements of the arrays, values of the objects
+    std::vector<JsonValue> Elements{};
+
+    // Keys of the objects, in the same order as their values
+    std::vector<std::string> Keys{};
+
+    bool IsNumber() const { return Type == Kind::Number; }
+    bool IsArray() const { return Type == Kind::Array; }
+    bool IsObject() const { return Type == Kind::Object; }
+
+    size_t Size() const { return Elements.size(); }
+
+    // Member of an object, nullptr when missing
+    const JsonValue* Find(const char* Key) const
+    {
+        for (size_t Idx = 0; Idx < Keys.size(); ++Idx)
+        {
+            if (Keys[Idx] == Key)
+                return &Elements[Idx];
+        }
+
+        return nullptr;
+    }
+
+    double GetNumber(const char* Key, double Default) const
+    {
+        const JsonValue* Value = Find(Key);
+        return Value && Value->IsNumber() ? Value->Number : Default;
+    }
+
+    // Non negative integer member, Default when missing. Throws when the value cannot be an index or a size
+    uint32_t GetIndex(const char* Key, uint32_t Default) const
+    {
+        const JsonValue* Value = Find(Key);
+        if (!Value)
+            return Default;
+
+        if (!Value->IsNumber() || Value->Number < 0.0 || Value->Number > 4294967295.0 || Value->Number != std::floor(Value->Number))
+        {
+            throw std::runtime_error(std::string("glTF: invalid value of ") + Key);
+        }
+
+        return static_cast<uint32_t>(Value->Number);
+    }
+
+    // Reads Count numbers from an array member into Out, leaving Out untouched (and returning false) when the member is missing
+    bool GetNumbers(const char* Key, float* Out, size_t Count) const
+    {
+        const JsonValue* Value = Find(Key);
+        if (!Value || !Value->IsArray() || Value->Size() < Count)
+            return false;
+
+        for (size_t Idx = 0; Idx < Count; ++Idx)
+        {
+            Out[Idx] = static_cast<float>(Value->Elements[Idx].Number);
+        }
+
+        return true;
+    }
+};
+
+class JsonReader
+{
+public:
+
+    JsonReader(const char* Begin, const char* End) : Cursor(Begin), End(End) {}
+
+    JsonValue ParseDocument()
+    {
+        JsonValue Root = ParseValue(0);
+        SkipWhitespace();
+        if (Cursor != End)
+        {
+            Fail("trailing characters");
+        }
+
+        return Root;
+    }
+
+private:
+
+    // Nesting of glTF documents is shallow, deeper ones are malformed
+    static constexpr int MaxDepth = 64;
+
+    const char* Cursor;
+    const char* End;
+
+    [[noreturn]] void Fail(const char* Reason) const
+    {
+        throw std::runtime_error(std::string("glTF: invalid JSON, ") + Reason);
+    }
+
+    void SkipWhitespace()
+    {
+        // The chunk is padded with spaces, and some exporters pad it with zeros
+        while (Cursor < End && (*Cursor == ' ' || *Cursor == '\t' || *Cursor == '\n' || *Cursor == '\r' || *Cursor == '\0'))
+            ++Cursor;
+    }
+
+    bool Consume(char Expected)
+    {
+        SkipWhitespace();
+        if (Cursor < End && *Cursor == Expected)
+        {
+            ++Cursor;
+            return true;
+        }
+
+        return false;
+    }
+
+    void Expect(char Expected)
+    {
+        if (!Consume(Expected))
+        {
+            Fail("unexpected character");
+        }
+    }
+
+    bool ConsumeLiteral(const char* Literal)
+    {
+        const size_t Length = std::strlen(Literal);
+        if (static_cast<size_t>(End - Cursor) < Length || std::memcmp(Cursor, Literal, Length) != 0)
+            return false;
+
+        Cursor += Length;
+        return true;
+    }
+
+    JsonValue ParseValue(int Depth)
+    {
+        if (Depth > MaxDepth)
+        {
+            Fail("too deeply nested");
+        }
+
+        SkipWhitespace();
+        if (Cursor == End)
+        {
+            Fail("unexpected end");
+        }
+
+        JsonValue Value{};
+        switch (*Cursor)
+        {
+        case '{':
+        {
+            ++Cursor;
+            Value.Type = JsonValue::Kind::Object;
+            if (Consume('}'))
+                break;
+
+            do
+            {
+                SkipWhitespace();
+                Value.Keys.push_back(ParseString());
+                Expect(':');
+                Value.Elements.push_back(ParseValue(Depth + 1));
+            }
+            while (Consume(','));
+
+            Expect('}');
+            break;
+        }
+        case '[':
+        {
+            ++Cursor;
+            Value.Type = JsonValue::Kind::Array;
+            if (Consume(']'))
+                break;
+
+            do
+            {
+                Value.Elements.push_back(ParseValue(Depth + 1));
+            }
+            while (Consume(','));
+
+            Expect(']');
+            break;
+        }
+        case '"':
+            Value.Type = JsonValue::Kind::String;
+            Value.String = ParseString();
+            break;
+        case 't':
+        case 'f':
+            Value.Type = JsonValue::Kind::Bool;
+            Value.bBool = *Cursor == 't';
+            if (!ConsumeLiteral(Value.bBool ? "true" : "false"))
+            {
+                Fail("unknown literal");
+            }
+            break;
+        case 'n':
+            if (!ConsumeLiteral("null"))
+            {
+                Fail("unknown literal");
+            }
+            break;
+        default:
+            Value.Type = JsonValue::Kind::Number;
+            Value.Number = ParseNumber();
+            break;
+        }
+
+        return Value;
+    }
+
+    double ParseNumber()
+    {
+        // strtod needs a terminated string, and numbers are short
+        char Buffer[64];
+        size_t Length = 0;
+        while (Cursor < End && Length + 1 < sizeof(Buffer) && (std::isdigit(static_cast<unsigned char>(*Cursor)) || (*Cursor != '\0' && std::strchr("+-.eE", *Cursor))))
+        {
+            Buffer[Length++] = *Cursor++;
+        }
+        Buffer[Length] = '\0';
+
+        char* NumberEnd = nullptr;
+        const double Number = std::strtod(Buffer, &NumberEnd);
+        if (Length == 0 || NumberEnd != Buffer + Length)
+        {
+            Fail("malformed number");
+        }
+
+        return Number;
+    }
+
+    uint32_t ParseHexDigits()
+    {
+        if (End - Cursor < 4)
+        {
+            Fail("truncated escape");
+        }
+
+        uint32_t CodePoint = 0;
+        for (int Digit = 0; Digit < 4; ++Digit)
+        {
+            const char C = *Cursor++;
+            CodePoint <<= 4;
+            if (C >= '0' && C <= '9')      CodePoint |= static_cast<uint32_t>(C - '0');
+            else if (C >= 'a' && C <= 'f') CodePoint |= static_cast<uint32_t>(C - 'a' + 10);
+            else if (C >= 'A' && C <= 'F') CodePoint |= static_cast<uint32_t>(C - 'A' + 10);
+            else Fail("malformed escape");
+        }
+
+        return CodePoint;
+    }
+
+    static void AppendUtf8(std::string& Out, uint32_t CodePoint)
+    {
+        if (CodePoint < 0x80)
+        {
+            Out += static_cast<char>(CodePoint);
+        }
+        else if (CodePoint < 0x800)
+        {
+            Out += static_cast<char>(0xC0 | (CodePoint >> 6));
+            Out += static_cast<char>(0x80 | (CodePoint & 0x3F));
+        }
+        else if (CodePoint < 0x10000)
+        {
+            Out += static_cast<char>(0xE0 | (CodePoint >> 12));
+            Out += static_cast<char>(0x80 | ((CodePoint >> 6) & 0x3F));
+            Out += static_cast<char>(0x80 | (CodePoint & 0x3F));
+        }
+        else
+        {
+            Out += static_cast<char>(0xF0 | (CodePoint >> 18));
+            Out += static_cast<char>(0x80 | ((CodePoint >> 12) & 0x3F));
+            Out += static_cast<char>(0x80 | ((CodePoint >> 6) & 0x3F));
+            Out += static_cast<char>(0x80 | (CodePoint & 0x3F));
+        }
+    }
+
+    std::string ParseString()
+    {
+        if (Cursor == End || *Cursor != '"')
+        {
+            Fail("expected a string");
+        }
+        ++Cursor;
+
+        std::string Out;
+        while (Cursor < End && *Cursor != '"')
+        {
+            if (*Cursor != '\\')
+            {
+                Out += *Cursor++;
+                continue;
+            }
+
+            ++Cursor;
+            if (Cursor == End)
+                break;
+
+            const char Escape = *Cursor++;
+            switch (Escape)
+            {
+            case 'b': Out += '\b'; break;
+            case 'f': Out += '\f'; break;
+            case 'n': Out += '\n'; break;
+            case 'r': Out += '\r'; break;
+            case 't': Out += '\t'; break;
+            case 'u':
+            {
+                uint32_t CodePoint = ParseHexDigits();
+
+                // Surrogate pair
+                if (CodePoint >= 0xD800 && CodePoint < 0xDC00 && End - Cursor >= 6 && Cursor[0] == '\\' && Cursor[1] == 'u')
+                {
+                    Cursor += 2;
+                    const uint32_t Low = ParseHexDigits();
+                    CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (Low - 0xDC00);
+                }
+
+                AppendUtf8(Out, CodePoint);
+                break;
+            }
+            default:
+                Out += Escape;
+                break;
+            }
+        }
+
+        if (Cursor == End)
+        {
+            Fail("unterminated string");
+        }
+        ++Cursor;
+
+        return Out;
+    }
+};
+
+uint32_t ReadU32(const char* Data)
+{
+    uint32_t Value;
+    std::memcpy(&Value, Data, sizeof(Value));
+    return Value;
+}
+
+uint32_t GetComponentSize(GltfComponentType Type)
+{
+    switch (Type)
+    {
+    case GltfComponentType::Byte:
+    case GltfComponentType::UnsignedByte:
+        return 1;
+    case GltfComponentType::Short:
+    case GltfComponentType::UnsignedShort:
+        return 2;
+    case GltfComponentType::UnsignedInt:
+    case GltfComponentType::Float:
+        return 4;
+    }
+
+    return 0;
+}
+
+uint32_t GetComponentCount(const std::string& Type)
+{
+    if (Type == "SCALAR") return 1;
+    if (Type == "VEC2")   return 2;
+    if (Type == "VEC3")   return 3;
+    if (Type == "VEC4")   return 4;
+    if (Type == "MAT2")   return 4;
+    if (Type == "MAT3")   return 9;
+    if (Type == "MAT4")   return 16;
+    return 0;
+}
+
+// Resolves accessors and buffer views against the binary chunk, checking that every element lies inside it
+class AccessorResolver
+{
+public:
+
+    AccessorResolver(const JsonValue& Document, const char* InBinData, size_t InBinSize)
+        : Accessors(Document.Find("accessors"))
+        , BufferViews(Document.Find("bufferViews"))
+        , BinData(InBinData)
+        , BinSize(InBinSize)
+    {
+        if (const JsonValue* Buffers = Document.Find("buffers"))
+        {
+            for (size_t Idx = 0; Idx < Buffers->Size(); ++Idx)
+            {
+                // Only the first buffer can be the binary chunk, the others are external files
+                const JsonValue& Buffer = Buffers->Elements[Idx];
+                if (Idx > 0 || Buffer.Find("uri"))
+                {
+                    throw std::runtime_error("glTF: external buffers are not supported");
+                }
+
+                if (Buffer.GetIndex("byteLength", 0) > BinSize)
+                {
+                    throw std::runtime_error("glTF: buffer larger than the binary chunk");
+                }
+            }
+        }
+    }
+
+    GltfAccessor Resolve(uint32_t AccessorIdx) const
+    {
+        if (!Accessors || AccessorIdx >= Accessors->Size())
+        {
+            throw std::runtime_error("glTF: accessor out of range");
+        }
+
+        const JsonValue& Accessor = Accessors->Elements[AccessorIdx];
+        if (Accessor.Find("sparse"))
+        {
+            throw std::runtime_error("glTF: sparse accessors are not supported");
+        }
+
+        const uint32_t ViewIdx = Accessor.GetIndex("bufferView", ~0u);
+        if (!BufferViews || ViewIdx >= BufferViews->Size())
+        {
+            // Accessors without a view are all zeros, which is never useful for geometry
+            throw std::runtime_error("glTF: accessor without a buffer view");
+        }
+
+        const JsonValue& View = BufferViews->Elements[ViewIdx];
+        if (View.GetIndex("buffer", 0) != 0)
+        {
+            throw std::runtime_error("glTF: external buffers are not supported");
+        }
+
+        const JsonValue* Type = Accessor.Find("type");
+
+        GltfAccessor Resolved{};
+        Resolved.Count = Accessor.GetIndex("count", 0);
+        Resolved.ComponentType = static_cast<GltfComponentType>(Accessor.GetIndex("componentType", 0));
+        Resolved.ComponentCount = Type ? GetComponentCount(Type->String) : 0;
+        Resolved.bNormalized = Accessor.Find("normalized") && Accessor.Find("normalized")->bBool;
+
+        const uint32_t ComponentSize = GetComponentSize(Resolved.ComponentType);
+        if (ComponentSize == 0 || Resolved.ComponentCount == 0)
+        {
+            throw std::runtime_error("glTF: unknown accessor type");
+        }
+
+        const uint64_t ElementSize = static_cast<uint64_t>(ComponentSize) * Resolved.ComponentCount;
+        Resolved.Stride = View.GetIndex("byteStride", static_cast<uint32_t>(ElementSize));
+
+        const uint64_t ViewOffset = View.GetIndex("byteOffset", 0);
+        const uint64_t ViewLength = View.GetIndex("byteLength", 0);
+        const uint64_t AccessorOffset = Accessor.GetIndex("byteOffset", 0);
+        const uint64_t AccessorLength = Resolved.Count > 0 ? static_cast<uint64_t>(Resolved.Count - 1) * Resolved.Stride + ElementSize : 0;
+
+        if (Resolved.Stride < ElementSize || ViewOffset + ViewLength > BinSize || AccessorOffset + AccessorLength > ViewLength)
+        {
+            throw std::runtime_error("glTF: accessor outside of the binary chunk");
+        }
+
+        Resolved.Data = BinData + ViewOffset + AccessorOffset;
+        return Resolved;
+    }
+
+    // Vector of Components floats at Key of the accessor, used for its bounds. Returns false when it is missing
+    bool ReadBound(uint32_t AccessorIdx, const char* Key, float* Out, size_t Components) const
+    {
+        return Accessors->Elements[AccessorIdx].GetNumbers(Key, Out, Components);
+    }
+
+private:
+
+    const JsonValue* Accessors;
+    const JsonValue* BufferViews;
+    const char* BinData;
+    size_t BinSize;
+};
+
+Material ToMaterial(const JsonValue& Source)
+{
+    glm::vec4 BaseColor{1.f};
+    float Metallic = 1.f;
+    float Roughness = 1.f;
+    if (const JsonValue* Pbr = Source.Find("pbrMetallicRoughness"))
+    {
+        Pbr->GetNumbers("baseColorFactor", &BaseColor.x, 4);
+        Metallic = static_cast<float>(Pbr->GetNumber("metallicFactor", 1.0));
+        Roughness = static_cast<float>(Pbr->GetNumber("roughnessFactor", 1.0));
+    }
+
+    // Opaque materials ignore the alpha of their base color
+    const JsonValue* AlphaMode = Source.Find("alphaMode");
+    if (!AlphaMode || AlphaMode->String == "OPAQUE")
+    {
+        BaseColor.w = 1.f;
+    }
+
+    // Metals reflect with their own color, dielectrics with about 4%. The roughness is mapped to the Blinn-Phong
+    // exponent with the same lobe width, clamped to the range of the .mtl shininess
+    const glm::vec3 Specular = glm::vec3{0.04f} + (glm::vec3{BaseColor} - glm::vec3{0.04f}) * std::clamp(Metallic, 0.f, 1.f);
+    const float Roughness2 = std::max(Roughness * Roughness, 1e-3f);
+    const float Shininess = std::clamp(2.f / (Roughness2 * Roughness2) - 2.f, 0.f, 1000.f);
+
+    Material Constants{};
+    Constants.Diffuse = BaseColor;
+    Constants.Specular = glm::vec4{Specular, Shininess};
+    Source.GetNumbers("emissiveFactor", &Constants.Emissive.x, 3);
+    return Constants;
+}
+
+// Column major matrix, or translation, rotation and scale, of a node
+glm::mat4 GetLocalTransform(const JsonValue& Node)
+{
+    glm::mat4 Transform{1.f};
+    if (const JsonValue* Matrix = Node.Find("matrix"))
+    {
+        if (Matrix->Size() == 16)
+        {
+            for (int Column = 0; Column < 4; ++Column)
+                for (int Row = 0; Row < 4; ++Row)
+                    Transform[Column][Row] = static_cast<float>(Matrix->Elements[Column * 4 + Row].Number);
+        }
+        return Transform;
+    }
+
+    glm::vec3 Translation{0.f};
+    glm::vec4 Rotation{0.f, 0.f, 0.f, 1.f}; // xyzw quaternion
+    glm::vec3 Scale{1.f};
+    Node.GetNumbers("translation", &Translation.x, 3);
+    Node.GetNumbers("rotation", &Rotation.x, 4);
+    Node.GetNumbers("scale", &Scale.x, 3);
+
+    const float X = Rotation.x, Y = Rotation.y, Z = Rotation.z, W = Rotation.w;
+    Transform[0] = glm::vec4{1.f - 2.f * (Y * Y + Z * Z), 2.f * (X * Y + Z * W), 2.f * (X * Z - Y * W), 0.f} * Scale.x;
+    Transform[1] = glm::vec4{2.f * (X * Y - Z * W), 1.f - 2.f * (X * X + Z * Z), 2.f * (Y * Z + X * W), 0.f} * Scale.y;
+    Transform[2] = glm::vec4{2.f * (X * Z + Y * W), 2.f * (Y * Z - X * W), 1.f - 2.f * (X * X + Y * Y), 0.f} * Scale.z;
+    Transform[3] = glm::vec4{Translation, 1.f};
+    return Transform;
+}
+
+}
+
+glm::vec4 GltfAccessor::ReadFloat(const uint32_t Idx) const
+{
+    glm::vec4 Value{0.f, 0.f, 0.f, 1.f};
+    const char* Element = Data + static_cast<size_t>(Idx) * Stride;
+    const uint32_t Components = std::min(ComponentCount, 4u);
+
+    for (uint32_t Component = 0; Component < Components; ++Component)
+    {
+        switch (ComponentType)
+        {
+        case GltfComponentType::Float:
+        {
+            std::memcpy(&Value[Component], Element + Component * 4, 4);
+            break;
+        }
+        case GltfComponentType::Byte:
+        {
+            const int8_t Raw = static_cast<int8_t>(Element[Component]);
+            Value[Component] = bNormalized ? std::max(Raw / 127.f, -1.f) : static_cast<float>(Raw);
+            break;
+        }
+        case GltfComponentType::UnsignedByte:
+        {
+            const uint8_t Raw = static_cast<uint8_t>(Element[Component]);
+            Value[Component] = bNormalized ? Raw / 255.f : static_cast<float>(Raw);
+            break;
+        }
+        case GltfComponentType::Short:
+        {
+            int16_t Raw;
+            std::memcpy(&Raw, Element + Component * 2, 2);
+            Value[Component] = bNormalized ? std::max(Raw / 32767.f, -1.f) : static_cast<float>(Raw);
+            break;
+        }
+        case GltfComponentType::UnsignedShort:
+        {
+            uint16_t Raw;
+            std::memcpy(&Raw, Element + Component * 2, 2);
+            Value[Component] = bNormalized ? Raw / 65535.f : static_cast<float>(Raw);
+            break;
+        }
+        case GltfComponentType::UnsignedInt:
+        {
+            Value[Component] = static_cast<float>(ReadU32(Element + Component * 4));
+            break;
+        }
+        }
+    }
+
+    return Value;
+}
+
+uint32_t GltfAccessor::ReadIndex(const uint32_t Idx) const
+{
+    const char* Element = Data + static_cast<size_t>(Idx) * Stride;
+    switch (ComponentType)
+    {
+    case GltfComponentType::UnsignedByte:
+        return static_cast<uint8_t>(*Element);
+    case GltfComponentType::UnsignedShort:
+    {
+        uint16_t Index;
+        std::memcpy(&Index, Element, sizeof(Index));
+        return Index;
+    }
+    default:
+        return ReadU32(Element);
+    }
+}
+
+bool GltfData::HasIdentityTransforms() const
+{
+    return std::all_of(Instances.begin(), Instances.end(), [](const GltfMeshInstance& Instance)
+    {
+        return Instance.Transform == glm::mat4{1.f};
+    });
+}
+
+bool LavaGltfParser::IsGltfFile(const std::string& Filepath)
+{
+    std::string Extension = std::filesystem::path(Filepath).extension().string();
+    std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](unsigned char Char) { return static_cast<char>(std::tolower(Char)); });
+    return Extension == ".glb";
+}
+
+GltfData LavaGltfParser::ParseFile(const std::string& Filepath)
+{
+    GltfData Data{};
+    if (!Data.File.Open(Filepath))
+    {
+        throw std::runtime_error("Failed to open file: " + Filepath);
+    }
+
+    const char* FileData = Data.File.GetData();
+    const size_t FileSize = Data.File.GetSize();
+
+    // 12 bytes header, followed by the JSON chunk and the optional binary chunk, each with an 8 bytes header
+    if (FileSize < 20 || ReadU32(FileData) != Magic || ReadU32(FileData + 4) != 2 || ReadU32(FileData + 8) > FileSize)
+    {
+        throw std::runtime_error("Not a binary glTF 2.0 file: " + Filepath);
+    }
+
+    const size_t TotalSize = ReadU32(FileData + 8);
+    const char* JsonData = nullptr;
+    size_t JsonSize = 0;
+    const char* BinData = nullptr;
+    size_t BinSize = 0;
+
+    for (size_t Offset = 12; Offset + 8 <= TotalSize;)
+    {
+        const size_t ChunkSize = ReadU32(FileData + Offset);
+        const uint32_t ChunkType = ReadU32(FileData + Offset + 4);
+        if (ChunkSize > TotalSize - Offset - 8)
+        {
+            throw std::runtime_error("Truncated glTF chunk: " + Filepath);
+        }
+
+        if (ChunkType == JsonChunkType && !JsonData)
+        {
+            JsonData = FileData + Offset + 8;
+            JsonSize = ChunkSize;
+        }
+        else if (ChunkType == BinChunkType && !BinData)
+        {
+            BinData = FileData + Offset + 8;
+            BinSize = ChunkSize;
+        }
+
+        // Chunks are 4 bytes aligned, unknown ones are skipped
+        Offset += 8 + ((ChunkSize + 3) & ~size_t{3});
+    }
+
+    if (!JsonData)
+    {
+        throw std::runtime_error("Missing glTF JSON chunk: " + Filepath);
+    }
+
+    const JsonValue Document = JsonReader{JsonData, JsonData + JsonSize}.ParseDocument();
+
+    if (const JsonValue* Required = Document.Find("extensionsRequired"))
+    {
+        for (const JsonValue& Extension : Required->Elements)
+        {
+            // Quantized attributes are converted like any other integer attribute
+            if (Extension.String != "KHR_mesh_quantization")
+            {
+                throw std::runtime_error("Unsupported glTF extension " + Extension.String + ": " + Filepath);
+            }
+        }
+    }
+
+    if (const JsonValue* Materials = Document.Find("materials"))
+    {
+        for (const JsonValue& Source : Materials->Elements)
+        {
+            Data.Materials.push_back(ToMaterial(Source));
+        }
+    }
+
+    const AccessorResolver Resolver{Document, BinData, BinSize};
+
+    // Primitives of all the meshes are flattened, each mesh owning a contiguous range of them
+    std::vector<std::pair<uint32_t, uint32_t>> MeshPrimitives;
+    if (const JsonValue* Meshes = Document.Find("meshes"))
+    {
+        for (const JsonValue& Mesh : Meshes->Elements)
+        {
+            const uint32_t FirstPrimitive = static_cast<uint32_t>(Data.Primitives.size());
+
+            const JsonValue* Primitives = Mesh.Find("primitives");
+            for (size_t Idx = 0; Primitives && Idx < Primitives->Size(); ++Idx)
+            {
+                const JsonValue& Source = Primitives->Elements[Idx];
+                const JsonValue* Attributes = Source.Find("attributes");
+                if (Source.GetIndex("mode", 4) != 4 || !Attributes || !Attributes->Find("POSITION"))
+                {
+                    std::cout << "Skipping a glTF primitive that is not made of triangles" << std::endl;
+                    continue;
+                }
+
+                GltfPrimitive Primitive{};
+                const uint32_t PositionsIdx = Attributes->GetIndex("POSITION", 0);
+                Primitive.Positions = Resolver.Resolve(PositionsIdx);
+
+                // Position bounds are required by the format, but are computed for the files that omit them
+                if (!Resolver.ReadBound(PositionsIdx, "min", &Primitive.BoundsMin.x, 3) || !Resolver.ReadBound(PositionsIdx, "max", &Primitive.BoundsMax.x, 3))
+                {
+                    Primitive.BoundsMin = glm::vec3{INFINITY};
+                    Primitive.BoundsMax = glm::vec3{-INFINITY};
+                    for (uint32_t Idx = 0; Idx < Primitive.Positions.Count; ++Idx)
+                    {
+                        const glm::vec3 Position{Primitive.Positions.ReadFloat(Idx)};
+                        Primitive.BoundsMin = glm::min(Primitive.BoundsMin, Position);
+                        Primitive.BoundsMax = glm::max(Primitive.BoundsMax, Position);
+                    }
+                }
+
+                if (Attributes->Find("NORMAL"))     Primitive.Normals = Resolver.Resolve(Attributes->GetIndex("NORMAL", 0));
+                if (Attributes->Find("TEXCOORD_0")) Primitive.TexCoords = Resolver.Resolve(Attributes->GetIndex("TEXCOORD_0", 0));
+                if (Attributes->Find("COLOR_0"))    Primitive.Colors = Resolver.Resolve(Attributes->GetIndex("COLOR_0", 0));
+                if (Source.Find("indices"))         Primitive.Indices = Resolver.Resolve(Source.GetIndex("indices", 0));
+
+                const uint32_t VertexCount = Primitive.Positions.Count;
+                for (const GltfAccessor* Attribute : {&Primitive.Normals, &Primitive.TexCoords, &Primitive.Colors})
+                {
+                    if (Attribute->IsValid() && Attribute->Count != VertexCount)
+                    {
+                        throw std::runtime_error("glTF attributes with different counts: " + Filepath);
+                    }
+                }
+
+                if (Primitive.Positions.ComponentCount != 3)
+                {
+                    throw std::runtime_error("glTF positions must have 3 components: " + Filepath);
+                }
+
+                if (Primitive.Indices.IsValid())
+                {
+                    const GltfComponentType IndexType = Primitive.Indices.ComponentType;
+                    if (Primitive.Indices.ComponentCount != 1
+                        || (IndexType != GltfComponentType::UnsignedByte && IndexType != GltfComponentType::UnsignedShort && IndexType != GltfComponentType::UnsignedInt))
+                    {
+                        throw std::runtime_error("Invalid glTF index accessor: " + Filepath);
+                    }
+
+                    // Indices may end up in a GPU buffer as they are, so they are checked once here
+                    for (uint32_t Corner = 0; Corner < Primitive.Indices.Count; ++Corner)
+                    {
+                        if (Primitive.Indices.ReadIndex(Corner) >= VertexCount)
+                        {
+                            throw std::runtime_error("glTF index out of range: " + Filepath);
+                        }
+                    }
+                }
+
+                const uint32_t MaterialIdx = Source.GetIndex("material", ~0u);
+                Primitive.Material = MaterialIdx < Data.Materials.size() ? static_cast<int32_t>(MaterialIdx) : -1;
+
+                Data.Primitives.push_back(Primitive);
+            }
+
+            MeshPrimitives.emplace_back(FirstPrimitive, static_cast<uint32_t>(Data.Primitives.size()) - FirstPrimitive);
+        }
+    }
+
+    // Meshes are placed by the nodes of the default scene. Files without scenes are libraries of meshes,
+    // in which case each mesh is placed once at the origin
+    const JsonValue* Nodes = Document.Find("nodes");
+    const JsonValue* Scenes = Document.Find("scenes");
+    if (Scenes && Scenes->Size() > 0 && Nodes)
+    {
+        const uint32_t SceneIdx = std::min<uint32_t>(Document.GetIndex("scene", 0), static_cast<uint32_t>(Scenes->Size()) - 1);
+
+        struct PendingNode
+        {
+            uint32_t NodeIdx;
+            glm::mat4 ParentTransform;
+        };
+
+        // Children are pushed in reverse, so that instances follow the order of the file
+        std::vector<PendingNode> Stack;
+        const auto PushNodes = [&Stack](const JsonValue* Indices, const glm::mat4& ParentTransform)
+        {
+            for (size_t Idx = Indices ? Indices->Size() : 0; Idx-- > 0;)
+            {
+                const double NodeIdx = Indices->Elements[Idx].Number;
+                Stack.push_back({NodeIdx >= 0.0 && NodeIdx < 4294967295.0 ? static_cast<uint32_t>(NodeIdx) : ~0u, ParentTransform});
+            }
+        };
+
+        PushNodes(Scenes->Elements[SceneIdx].Find("nodes"), glm::mat4{1.f});
+
+        // Nodes have at most one parent, so a node reached twice means the hierarchy has a cycle
+        std::vector<bool> Visited(Nodes->Size(), false);
+        while (!Stack.empty())
+        {
+            const PendingNode Pending = Stack.back();
+            Stack.pop_back();
+
+            if (Pending.NodeIdx >= Nodes->Size() || Visited[Pending.NodeIdx])
+            {
+                throw std::runtime_error("Invalid glTF node hierarchy: " + Filepath);
+            }
+            Visited[Pending.NodeIdx] = true;
+
+            const JsonValue& Node = Nodes->Elements[Pending.NodeIdx];
+            const glm::mat4 Transform = Pending.ParentTransform * GetLocalTransform(Node);
+
+            const uint32_t MeshIdx = Node.GetIndex("mesh", ~0u);
+            if (MeshIdx < MeshPrimitives.size() && MeshPrimitives[MeshIdx].second > 0)
+            {
+                Data.Instances.push_back({MeshPrimitives[MeshIdx].first, MeshPrimitives[MeshIdx].second, Transform});
+            }
+
+            PushNodes(Node.Find("children"), Transform);
+        }
+    }
+    else
+    {
+        for (const auto& [FirstPrimitive, PrimitiveCount] : MeshPrimitives)
+        {
+            if (PrimitiveCount > 0)
+            {
+                Data.Instances.push_back({FirstPrimitive, PrimitiveCount, glm::mat4{1.f}});
+            }
+        }
+    }
+
+    return Data;
+}
+
+}
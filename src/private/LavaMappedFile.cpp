@@ -0,0 +1,150 @@
+//
+//  LavaMappedFile.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaMappedFile.hpp"
+
+#include <fstream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LAVA_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define LAVA_HAS_MMAP 0
+#endif
+
+namespace lava
+{
+
+LavaMappedFile::LavaMappedFile(const std::string& Filepath)
+{
+    Open(Filepath);
+}
+
+LavaMappedFile::LavaMappedFile(std::vector<char>&& Contents)
+    : FallbackBuffer(std::move(Contents))
+{
+    Data = FallbackBuffer.empty() ? nullptr : FallbackBuffer.data();
+    Size = FallbackBuffer.size();
+    bIsOpen = true;
+}
+
+LavaMappedFile::LavaMappedFile(std::shared_ptr<const LavaMappedFile> InSource, size_t Offset, size_t InSize)
+    : Source(std::move(InSource))
+{
+    Data = InSize > 0 ? Source->GetData() + Offset : nullptr;
+    Size = InSize;
+    bIsOpen = true;
+}
+
+LavaMappedFile::~LavaMappedFile()
+{
+    Close();
+}
+
+LavaMappedFile::LavaMappedFile(LavaMappedFile&& Other) noexcept
+{
+    *this = std::move(Other);
+}
+
+LavaMappedFile& LavaMappedFile::operator=(LavaMappedFile&& Other) noexcept
+{
+    if (this != &Other)
+    {
+        Close();
+
+        const bool bOtherUsesFallback = !Other.FallbackBuffer.empty();
+        FallbackBuffer = std::move(Other.FallbackBuffer);
+        Source = std::move(Other.Source);
+        Data = bOtherUsesFallback ? FallbackBuffer.data() : Other.Data;
+        Size = Other.Size;
+        bIsOpen = Other.bIsOpen;
+
+        Other.Data = nullptr;
+        Other.Size = 0;
+        Other.bIsOpen = false;
+    }
+
+    return *this;
+}
+
+bool LavaMappedFile::Open(const std::string& Filepath)
+{
+    Close();
+
+#if LAVA_HAS_MMAP
+    const int FileDesc = open(Filepath.c_str(), O_RDONLY);
+    if (FileDesc < 0)
+        return false;
+
+    struct stat FileStat{};
+    if (fstat(FileDesc, &FileStat) != 0)
+    {
+        close(FileDesc);
+        return false;
+    }
+
+    Size = static_cast<size_t>(FileStat.st_size);
+    bIsOpen = true;
+
+    // Mapping a zero-sized file is an error, but an empty file is still a valid (empty) view
+    if (Size > 0)
+    {
+        void* Mapping = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, FileDesc, 0);
+        if (Mapping == MAP_FAILED)
+        {
+            close(FileDesc);
+            Size = 0;
+            bIsOpen = false;
+            return false;
+        }
+
+        // The whole file is going to be streamed front to back
+        madvise(Mapping, Size, MADV_SEQUENTIAL);
+        Data = static_cast<const char*>(Mapping);
+    }
+
+    // The mapping keeps its own reference to the file
+    close(FileDesc);
+    return true;
+#else
+    std::ifstream FileStream(Filepath, std::ios::ate | std::ios::binary);
+    if (!FileStream.is_open())
+        return false;
+
+    Size = static_cast<size_t>(FileStream.tellg());
+    FallbackBuffer.resize(Size);
+
+    FileStream.seekg(0);
+    FileStream.read(FallbackBuffer.data(), Size);
+
+    Data = FallbackBuffer.data();
+    bIsOpen = true;
+    return true;
+#endif
+}
+
+void LavaMappedFile::Close()
+{
+#if LAVA_HAS_MMAP
+    if (Data && FallbackBuffer.empty() && !Source)
+    {
+        munmap(const_cast<char*>(Data), Size);
+    }
+#endif
+
+    FallbackBuffer.clear();
+    Source.reset();
+    Data = nullptr;
+    Size = 0;
+    bIsOpen = false;
+}
+
+}
@@ -0,0 +1,543 @@
+//
+//  LavaMemoryAllocator.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaMemoryAllocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace lava
+{
+
+namespace
+{
+
+// Every power of two is split into 16 size classes, so that a free range is never more than 1/16 larger than the
+// smallest one of its class
+constexpr uint32_t SecondLevelBits = 4;
+constexpr uint32_t SecondLevelCount = 1u << SecondLevelBits;
+constexpr uint32_t FirstLevelCount = 32;
+
+constexpr uint32_t InvalidRange = UINT32_MAX;
+
+VkDeviceSize AlignUp(VkDeviceSize Value, VkDeviceSize Alignment)
+{
+    return (Value + Alignment - 1) & ~(Alignment - 1);
+}
+
+VkDeviceSize AlignDown(VkDeviceSize Value, VkDeviceSize Alignment)
+{
+    return Value & ~(Alignment - 1);
+}
+
+uint32_t FindLowestBit(uint32_t Mask)
+{
+#if defined(_MSC_VER)
+    unsigned long Index;
+    _BitScanForward(&Index, Mask);
+    return static_cast<uint32_t>(Index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(Mask));
+#endif
+}
+
+uint32_t FloorLog2(uint64_t Value)
+{
+#if defined(_MSC_VER)
+    unsigned long Index;
+    _BitScanReverse64(&Index, Value);
+    return static_cast<uint32_t>(Index);
+#else
+    return 63u - static_cast<uint32_t>(__builtin_clzll(Value));
+#endif
+}
+
+// Size class of a free range of Units granules. Small ranges get a class per size
+void GetSizeClass(uint64_t Units, uint32_t& OutFirst, uint32_t& OutSecond)
+{
+    if (Units < SecondLevelCount)
+    {
+        OutFirst = 0;
+        OutSecond = static_cast<uint32_t>(Units);
+        return;
+    }
+
+    const uint32_t Log = FloorLog2(Units);
+    OutFirst = Log - SecondLevelBits + 1;
+    OutSecond = static_cast<uint32_t>(Units >> (Log - SecondLevelBits)) ^ SecondLevelCount;
+}
+
+// Rounds Units up to the smallest size of the next class, so that every range of the class found for it fits
+uint64_t RoundUpToClass(uint64_t Units)
+{
+    if (Units >= SecondLevelCount)
+    {
+        Units += (1ull << (FloorLog2(Units) - SecondLevelBits)) - 1;
+    }
+
+    return Units;
+}
+
+}
+
+/**
+ Single memory object split into ranges by a two-level segregated fit allocator. Ranges are linked to their physical
+ neighbours, so that freed ranges merge back, and free ranges are also linked in the list of their size class
+ */
+class LavaMemoryBlock
+{
+public:
+
+    LavaMemoryBlock(VkDeviceMemory InMemory, VkDeviceSize InSize, void* InMapped, uint32_t InPoolIdx)
+        : Memory{InMemory}, Size{InSize}, Mapped{InMapped}, PoolIdx{InPoolIdx}
+    {
+        for (uint32_t First = 0; First < FirstLevelCount; ++First)
+        {
+            std::fill(FreeHeads[First], FreeHeads[First] + SecondLevelCount, InvalidRange);
+        }
+
+        InsertFree(CreateRange(0, Size));
+    }
+
+    /** Places Size bytes aligned to Alignment, both multiples of MinAlignment. Returns false if no free range fits */
+    bool Allocate(VkDeviceSize AllocationSize, VkDeviceSize Alignment, VkDeviceSize& OutOffset, uint32_t& OutRangeIdx)
+    {
+        // Free ranges only start on MinAlignment, larger alignments may need some padding in front
+        const VkDeviceSize SearchSize = AllocationSize + Alignment - LavaMemoryAllocator::MinAlignment;
+
+        uint32_t First, Second;
+        GetSizeClass(RoundUpToClass(SearchSize / LavaMemoryAllocator::MinAlignment), First, Second);
+        if (First >= FirstLevelCount)
+            return false;
+
+        uint32_t RangeIdx = FindFreeRange(First, Second);
+        if (RangeIdx == InvalidRange)
+            return false;
+
+        RemoveFree(RangeIdx);
+
+        const VkDeviceSize AlignedOffset = AlignUp(Ranges[RangeIdx].Offset, Alignment);
+        if (AlignedOffset > Ranges[RangeIdx].Offset)
+        {
+            const uint32_t PaddingIdx = Split(RangeIdx, AlignedOffset - Ranges[RangeIdx].Offset);
+            InsertFree(RangeIdx);
+            RangeIdx = PaddingIdx;
+        }
+
+        if (Ranges[RangeIdx].Size > AllocationSize)
+        {
+            InsertFree(Split(RangeIdx, AllocationSize));
+        }
+
+        ++AllocationCount;
+        UsedSize += AllocationSize;
+
+        OutOffset = Ranges[RangeIdx].Offset;
+        OutRangeIdx = RangeIdx;
+        return true;
+    }
+
+    void Free(uint32_t RangeIdx)
+    {
+        assert(!Ranges[RangeIdx].bIsFree && "NOTE: memory range freed twice");
+
+        --AllocationCount;
+        UsedSize -= Ranges[RangeIdx].Size;
+
+        const uint32_t NextIdx = Ranges[RangeIdx].NextPhysical;
+        if (NextIdx != InvalidRange && Ranges[NextIdx].bIsFree)
+        {
+            RemoveFree(NextIdx);
+            Merge(RangeIdx, NextIdx);
+        }
+
+        const uint32_t PreviousIdx = Ranges[RangeIdx].PreviousPhysical;
+        if (PreviousIdx != InvalidRange && Ranges[PreviousIdx].bIsFree)
+        {
+            RemoveFree(PreviousIdx);
+            Merge(PreviousIdx, RangeIdx);
+            RangeIdx = PreviousIdx;
+        }
+
+        InsertFree(RangeIdx);
+    }
+
+    bool IsEmpty() const { return AllocationCount == 0; }
+
+    const VkDeviceMemory Memory;
+    const VkDeviceSize Size;
+    void* const Mapped;
+    const uint32_t PoolIdx;
+
+    uint32_t AllocationCount = 0;
+    VkDeviceSize UsedSize = 0;
+
+private:
+
+    struct Range
+    {
+        VkDeviceSize Offset;
+        VkDeviceSize Size;
+
+        uint32_t PreviousPhysical;
+        uint32_t NextPhysical;
+
+        // Links in the list of the size class, free ranges only
+        uint32_t PreviousFree;
+        uint32_t NextFree;
+
+        bool bIsFree;
+    };
+
+    uint32_t CreateRange(VkDeviceSize Offset, VkDeviceSize RangeSize)
+    {
+        const Range NewRange{Offset, RangeSize, InvalidRange, InvalidRange, InvalidRange, InvalidRange, false};
+        if (!UnusedRanges.empty())
+        {
+            const uint32_t RangeIdx = UnusedRanges.back();
+            UnusedRanges.pop_back();
+            Ranges[RangeIdx] = NewRange;
+            return RangeIdx;
+        }
+
+        Ranges.push_back(NewRange);
+        return static_cast<uint32_t>(Ranges.size() - 1);
+    }
+
+    // Cuts RangeIdx after its first FrontSize bytes, returns the range of the remaining ones
+    uint32_t Split(uint32_t RangeIdx, VkDeviceSize FrontSize)
+    {
+        const uint32_t BackIdx = CreateRange(Ranges[RangeIdx].Offset + FrontSize, Ranges[RangeIdx].Size - FrontSize);
+        Range& Front = Ranges[RangeIdx];
+        Range& Back = Ranges[BackIdx];
+
+        Front.Size = FrontSize;
+        Back.PreviousPhysical = RangeIdx;
+        Back.NextPhysical = Front.NextPhysical;
+        if (Front.NextPhysical != InvalidRange)
+        {
+            Ranges[Front.NextPhysical].PreviousPhysical = BackIdx;
+        }
+        Front.NextPhysical = BackIdx;
+
+        return BackIdx;
+    }
+
+    // Grows FrontIdx over BackIdx, its next physical neighbour, which is released
+    void Merge(uint32_t FrontIdx, uint32_t BackIdx)
+    {
+        Range& Front = Ranges[FrontIdx];
+        const Range& Back = Ranges[BackIdx];
+
+        Front.Size += Back.Size;
+        Front.NextPhysical = Back.NextPhysical;
+        if (Back.NextPhysical != InvalidRange)
+        {
+            Ranges[Back.NextPhysical].PreviousPhysical = FrontIdx;
+        }
+
+        UnusedRanges.push_back(BackIdx);
+    }
+
+    uint32_t FindFreeRange(uint32_t First, uint32_t Second) const
+    {
+        uint32_t SecondMap = SecondLevelMaps[First] & (~0u << Second);
+        if (SecondMap == 0)
+        {
+            const uint32_t FirstMap = First + 1 < FirstLevelCount ? FirstLevelMap & (~0u << (First + 1)) : 0;
+            if (FirstMap == 0)
+                return InvalidRange;
+
+            First = FindLowestBit(FirstMap);
+            SecondMap = SecondLevelMaps[First];
+        }
+
+        return FreeHeads[First][FindLowestBit(SecondMap)];
+    }
+
+    void InsertFree(uint32_t RangeIdx)
+    {
+        uint32_t First, Second;
+        GetSizeClass(Ranges[RangeIdx].Size / LavaMemoryAllocator::MinAlignment, First, Second);
+
+        Range& FreeRange = Ranges[RangeIdx];
+        FreeRange.bIsFree = true;
+        FreeRange.PreviousFree = InvalidRange;
+        FreeRange.NextFree = FreeHeads[First][Second];
+        if (FreeRange.NextFree != InvalidRange)
+        {
+            Ranges[FreeRange.NextFree].PreviousFree = RangeIdx;
+        }
+
+        FreeHeads[First][Second] = RangeIdx;
+        FirstLevelMap |= 1u << First;
+        SecondLevelMaps[First] |= 1u << Second;
+    }
+
+    void RemoveFree(uint32_t RangeIdx)
+    {
+        uint32_t First, Second;
+        GetSizeClass(Ranges[RangeIdx].Size / LavaMemoryAllocator::MinAlignment, First, Second);
+
+        Range& FreeRange = Ranges[RangeIdx];
+        FreeRange.bIsFree = false;
+        if (FreeRange.PreviousFree != InvalidRange)
+        {
+            Ranges[FreeRange.PreviousFree].NextFree = FreeRange.NextFree;
+        }
+        else
+        {
+            FreeHeads[First][Second] = FreeRange.NextFree;
+        }
+
+        if (FreeRange.NextFree != InvalidRange)
+        {
+            Ranges[FreeRange.NextFree].PreviousFree = FreeRange.PreviousFree;
+        }
+
+        if (FreeHeads[First][Second] == InvalidRange)
+        {
+            SecondLevelMaps[First] &= ~(1u << Second);
+            if (SecondLevelMaps[First] == 0)
+            {
+                FirstLevelMap &= ~(1u << First);
+            }
+        }
+    }
+
+    std::vector<Range> Ranges{};
+    std::vector<uint32_t> UnusedRanges{};
+
+    // Bit per non-empty size class
+    uint32_t FirstLevelMap = 0;
+    uint32_t SecondLevelMaps[FirstLevelCount] = {};
+    uint32_t FreeHeads[FirstLevelCount][SecondLevelCount];
+};
+
+LavaMemoryAllocator::LavaMemoryAllocator(VkPhysicalDevice PhysicalDevice, VkDevice InDevice) : Device{InDevice}
+{
+    vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &MemoryProperties);
+
+    VkPhysicalDeviceProperties Properties;
+    vkGetPhysicalDeviceProperties(PhysicalDevice, &Properties);
+    NonCoherentAtomSize = std::max<VkDeviceSize>(Properties.limits.nonCoherentAtomSize, 1);
+
+    Pools.resize(MemoryProperties.memoryTypeCount * 2);
+    for (uint32_t MemoryType = 0; MemoryType < MemoryProperties.memoryTypeCount; ++MemoryType)
+    {
+        // Small heaps, such as the host visible window of the device memory, are not filled by a couple of blocks
+        const VkDeviceSize HeapSize = MemoryProperties.memoryHeaps[MemoryProperties.memoryTypes[MemoryType].heapIndex].size;
+        const VkDeviceSize PoolBlockSize = AlignDown(std::max(std::min(BlockSize, HeapSize / 8), MinAlignment * SecondLevelCount), MinAlignment);
+
+        Pools[MemoryType * 2].BlockSize = PoolBlockSize;
+        Pools[MemoryType * 2 + 1].BlockSize = PoolBlockSize;
+    }
+}
+
+LavaMemoryAllocator::~LavaMemoryAllocator()
+{
+    for (MemoryPool& Pool : Pools)
+    {
+        for (const std::unique_ptr<LavaMemoryBlock>& Block : Pool.Blocks)
+        {
+            assert(Block->IsEmpty() && "NOTE: device memory still in use when destroying the allocator");
+            FreeMemory(Block->Memory, Block->Mapped);
+        }
+    }
+}
+
+LavaMemoryAllocation LavaMemoryAllocator::Allocate(const VkMemoryRequirements& Requirements, VkMemoryPropertyFlags Properties, bool bIsLinear)
+{
+    const uint32_t MemoryType = FindMemoryType(Requirements.memoryTypeBits, Properties);
+    const VkMemoryPropertyFlags TypeFlags = MemoryProperties.memoryTypes[MemoryType].propertyFlags;
+
+    VkDeviceSize Alignment = std::max(Requirements.alignment, MinAlignment);
+    VkDeviceSize Size = AlignUp(Requirements.size, MinAlignment);
+
+    // Non coherent memory is flushed by whole atoms, which must not reach into the neighbouring allocations
+    if ((TypeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(TypeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        Alignment = std::max(Alignment, NonCoherentAtomSize);
+        Size = AlignUp(Size, NonCoherentAtomSize);
+    }
+
+    const uint32_t PoolIdx = MemoryType * 2 + (bIsLinear ? 0 : 1);
+    MemoryPool& Pool = Pools[PoolIdx];
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    LavaMemoryAllocation Allocation{};
+    Allocation.Size = Size;
+
+    // Large resources would leave most of a block unusable
+    if (Size <= Pool.BlockSize / 2)
+    {
+        for (const std::unique_ptr<LavaMemoryBlock>& Block : Pool.Blocks)
+        {
+            if (Block->Allocate(Size, Alignment, Allocation.Offset, Allocation.RangeIdx))
+            {
+                Allocation.Block = Block.get();
+                break;
+            }
+        }
+
+        if (!Allocation.Block)
+        {
+            void* Mapped = nullptr;
+            const VkDeviceMemory Memory = AllocateMemory(MemoryType, Pool.BlockSize, Mapped);
+            if (Memory != VK_NULL_HANDLE)
+            {
+                Pool.Blocks.push_back(std::make_unique<LavaMemoryBlock>(Memory, Pool.BlockSize, Mapped, PoolIdx));
+
+                const bool bAllocated = Pool.Blocks.back()->Allocate(Size, Alignment, Allocation.Offset, Allocation.RangeIdx);
+                assert(bAllocated && "NOTE: allocation does not fit in an empty block");
+                Allocation.Block = Pool.Blocks.back().get();
+            }
+        }
+    }
+
+    if (Allocation.Block)
+    {
+        Allocation.Memory = Allocation.Block->Memory;
+        Allocation.Mapped = Allocation.Block->Mapped ? static_cast<char*>(Allocation.Block->Mapped) + Allocation.Offset : nullptr;
+        return Allocation;
+    }
+
+    // Too large for a block, or no room left for a new one
+    Allocation.Offset = 0;
+    Allocation.Memory = AllocateMemory(MemoryType, Size, Allocation.Mapped);
+    if (Allocation.Memory == VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+
+    ++DedicatedCount;
+    DedicatedSize += Size;
+    return Allocation;
+}
+
+void LavaMemoryAllocator::Free(LavaMemoryAllocation& Allocation)
+{
+    if (!Allocation.IsValid())
+        return;
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    if (!Allocation.Block)
+    {
+        FreeMemory(Allocation.Memory, Allocation.Mapped);
+        --DedicatedCount;
+        DedicatedSize -= Allocation.Size;
+    }
+    else
+    {
+        LavaMemoryBlock* Block = Allocation.Block;
+        Block->Free(Allocation.RangeIdx);
+
+        // A single empty block is kept per pool, so that a resource created and destroyed in a loop does not
+        // allocate and free a block every time
+        if (Block->IsEmpty())
+        {
+            std::vector<std::unique_ptr<LavaMemoryBlock>>& Blocks = Pools[Block->PoolIdx].Blocks;
+            const auto IsEmpty = [](const std::unique_ptr<LavaMemoryBlock>& Other) { return Other->IsEmpty(); };
+            if (std::count_if(Blocks.begin(), Blocks.end(), IsEmpty) > 1)
+            {
+                FreeMemory(Block->Memory, Block->Mapped);
+                Blocks.erase(std::find_if(Blocks.begin(), Blocks.end(), [Block](const std::unique_ptr<LavaMemoryBlock>& Other) { return Other.get() == Block; }));
+            }
+        }
+    }
+
+    Allocation = {};
+}
+
+VkMappedMemoryRange LavaMemoryAllocator::GetMappedRange(const LavaMemoryAllocation& Allocation, VkDeviceSize Size, VkDeviceSize Offset) const
+{
+    const VkDeviceSize End = Size == VK_WHOLE_SIZE ? Allocation.Size : std::min(Offset + Size, Allocation.Size);
+
+    VkMappedMemoryRange Range{};
+    Range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    Range.memory = Allocation.Memory;
+    Range.offset = Allocation.Offset + AlignDown(Offset, NonCoherentAtomSize);
+    Range.size = std::min(AlignUp(Allocation.Offset + End, NonCoherentAtomSize), Allocation.Offset + Allocation.Size) - Range.offset;
+    return Range;
+}
+
+uint32_t LavaMemoryAllocator::FindMemoryType(uint32_t TypeFilter, VkMemoryPropertyFlags Properties) const
+{
+    for (uint32_t MemoryType = 0; MemoryType < MemoryProperties.memoryTypeCount; ++MemoryType)
+    {
+        if ((TypeFilter & (1u << MemoryType)) && (MemoryProperties.memoryTypes[MemoryType].propertyFlags & Properties) == Properties)
+            return MemoryType;
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+LavaMemoryStats LavaMemoryAllocator::GetStats() const
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    LavaMemoryStats Stats{};
+    Stats.DedicatedCount = DedicatedCount;
+    Stats.AllocationCount = DedicatedCount;
+    Stats.UsedSize = DedicatedSize;
+    Stats.ReservedSize = DedicatedSize;
+
+    for (const MemoryPool& Pool : Pools)
+    {
+        for (const std::unique_ptr<LavaMemoryBlock>& Block : Pool.Blocks)
+        {
+            ++Stats.BlockCount;
+            Stats.AllocationCount += Block->AllocationCount;
+            Stats.UsedSize += Block->UsedSize;
+            Stats.ReservedSize += Block->Size;
+        }
+    }
+
+    return Stats;
+}
+
+VkDeviceMemory LavaMemoryAllocator::AllocateMemory(uint32_t MemoryType, VkDeviceSize Size, void*& OutMapped)
+{
+    VkMemoryAllocateInfo AllocInfo{};
+    AllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    AllocInfo.allocationSize = Size;
+    AllocInfo.memoryTypeIndex = MemoryType;
+
+    VkDeviceMemory Memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(Device, &AllocInfo, nullptr, &Memory) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+
+    // Host visible memory is mapped once for good, every allocation of the block then shares the mapping
+    OutMapped = nullptr;
+    if ((MemoryProperties.memoryTypes[MemoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        && vkMapMemory(Device, Memory, 0, VK_WHOLE_SIZE, 0, &OutMapped) != VK_SUCCESS)
+    {
+        vkFreeMemory(Device, Memory, nullptr);
+        return VK_NULL_HANDLE;
+    }
+
+    return Memory;
+}
+
+void LavaMemoryAllocator::FreeMemory(VkDeviceMemory Memory, void* Mapped)
+{
+    if (Mapped)
+    {
+        vkUnmapMemory(Device, Memory);
+    }
+
+    vkFreeMemory(Device, Memory, nullptr);
+}
+
+}
@@ -0,0 +1,630 @@
+//
+//  LavaMeshCache.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaMeshCache.hpp"
+
+#include <assert.h>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <system_error>
+
+#include "LavaUtils.hpp"
+#include "LavaPackage.hpp"
+#include "LavaMeshCodec.hpp"
+#include "LavaMeshOptimizer.hpp"
+
+namespace lava
+{
+
+namespace
+{
+
+constexpr uint64_t SectionAlignment = 16;
+
+std::vector<VkVertexInputAttributeDescription> GetFormatAttributeDescs(const VertexFormat Format)
+{
+    return Format == VertexFormat::Compact ? CompactVertex::GetAttributeDescs() : Vertex::GetAttributeDescs();
+}
+
+uint32_t GetFormatStride(const VertexFormat Format)
+{
+    return Format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+}
+
+uint64_t AlignSectionOffset(const uint64_t Offset)
+{
+    return (Offset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+}
+
+struct SectionPayload
+{
+    MeshCacheSection Section;
+    const void* Data;
+
+    // 32 bit indices stored as 16 bit ones, narrowed while being hashed or written
+    bool bNarrowIndices = false;
+};
+
+// Calls Task with consecutive blocks of Indices narrowed to 16 bits, so that no full copy is ever built
+template<typename TaskType>
+void ForEachNarrowedBlock(const uint32_t* Indices, size_t Count, TaskType&& Task)
+{
+    constexpr size_t BlockSize = 4096;
+    uint16_t Block[BlockSize];
+
+    for (size_t First = 0; First < Count; First += BlockSize)
+    {
+        const size_t BlockCount = std::min(BlockSize, Count - First);
+        for (size_t i = 0; i < BlockCount; ++i)
+        {
+            Block[i] = static_cast<uint16_t>(Indices[First + i]);
+        }
+
+        Task(Block, BlockCount);
+    }
+}
+
+// Sections describing Builder, in the order they are written
+std::vector<SectionPayload> GatherPayloads(const Builder& Builder)
+{
+    const bool bIsCompact = Builder.Format == VertexFormat::Compact;
+    const uint32_t VertexStride = GetFormatStride(Builder.Format);
+    const size_t VertexCount = bIsCompact ? Builder.CompactVertices.size() : Builder.Vertices.size();
+    const void* VertexData = bIsCompact ? static_cast<const void*>(Builder.CompactVertices.data()) : static_cast<const void*>(Builder.Vertices.data());
+
+    // Indices are stored in the type they are going to be uploaded with
+    const bool bShortIndices = Builder.GetIndexType() == VK_INDEX_TYPE_UINT16;
+    const uint32_t IndexSize = bShortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    std::vector<SectionPayload> Payloads =
+    {
+        {{MeshCacheSectionType::Vertices, VertexStride, 0, VertexCount * VertexStride}, VertexData},
+        {{MeshCacheSectionType::Indices, IndexSize, 0, Builder.Indices.size() * IndexSize}, Builder.Indices.data(), bShortIndices}
+    };
+
+    if (!Builder.SubMeshes.empty())
+    {
+        Payloads.push_back({{MeshCacheSectionType::SubMeshes, sizeof(SubMesh), 0, Builder.SubMeshes.size() * sizeof(SubMesh)}, Builder.SubMeshes.data()});
+    }
+
+    if (!Builder.Meshlets.empty())
+    {
+        Payloads.push_back({{MeshCacheSectionType::Meshlets, sizeof(Meshlet), 0, Builder.Meshlets.size() * sizeof(Meshlet)}, Builder.Meshlets.data()});
+    }
+
+    if (!Builder.Lods.empty())
+    {
+        Payloads.push_back({{MeshCacheSectionType::Lods, sizeof(LodLevel), 0, Builder.Lods.size() * sizeof(LodLevel)}, Builder.Lods.data()});
+    }
+
+    if (!Builder.Materials.empty())
+    {
+        Payloads.push_back({{MeshCacheSectionType::Materials, sizeof(Material), 0, Builder.Materials.size() * sizeof(Material)}, Builder.Materials.data()});
+    }
+
+    return Payloads;
+}
+
+// Everything that ends up on the GPU, so that two meshes with the same hash can share their buffers. Bounds are
+// included as they are needed to dequantize compact vertices
+uint64_t HashContent(const Builder& Builder, const std::vector<SectionPayload>& Payloads)
+{
+    const float Bounds[6] = {Builder.BoundsMin.x, Builder.BoundsMin.y, Builder.BoundsMin.z, Builder.BoundsMax.x, Builder.BoundsMax.y, Builder.BoundsMax.z};
+    uint64_t Hash = HashBytes(Bounds, sizeof(Bounds));
+    for (const SectionPayload& Payload : Payloads)
+    {
+        Hash = HashBytes(&Payload.Section.Type, sizeof(Payload.Section.Type), Hash);
+        Hash = HashBytes(&Payload.Section.ElementSize, sizeof(Payload.Section.ElementSize), Hash);
+
+        if (Payload.bNarrowIndices)
+        {
+            ForEachNarrowedBlock(static_cast<const uint32_t*>(Payload.Data), Payload.Section.Size / sizeof(uint16_t), [&Hash](const uint16_t* Block, size_t Count)
+            {
+                Hash = HashBytes(Block, Count * sizeof(uint16_t), Hash);
+            });
+        }
+        else
+        {
+            Hash = HashBytes(Payload.Data, Payload.Section.Size, Hash);
+        }
+    }
+
+    return Hash;
+}
+
+}
+
+std::string LavaMeshCache::CacheDirectory{};
+
+void LavaMeshCache::SetCacheDirectory(const std::string& Directory)
+{
+    CacheDirectory = Directory;
+}
+
+std::string LavaMeshCache::GetCachePath(const std::string& SourcePath)
+{
+    if (CacheDirectory.empty())
+        return SourcePath + Extension;
+
+    // Flattens the source path so that sources with the same name in different folders do not collide
+    std::string FlatName = std::filesystem::absolute(SourcePath).lexically_normal().string();
+    for (char& Char : FlatName)
+    {
+        if (Char == '/' || Char == '\\' || Char == ':')
+        {
+            Char = '_';
+        }
+    }
+
+    return (std::filesystem::path(CacheDirectory) / (FlatName + Extension)).string();
+}
+
+MeshSourceStamp LavaMeshCache::GetSourceStamp(const std::string& SourcePath, bool bComputeHash)
+{
+    MeshSourceStamp Stamp{};
+
+    std::error_code Error;
+    Stamp.Size = std::filesystem::file_size(SourcePath, Error);
+    if (Error)
+        return {};
+
+    Stamp.ModifiedTime = static_cast<int64_t>(std::filesystem::last_write_time(SourcePath, Error).time_since_epoch().count());
+
+    if (bComputeHash)
+    {
+        const LavaMappedFile Source{SourcePath};
+        if (Source.IsOpen())
+        {
+            Stamp.Hash = HashBytes(Source.GetData(), Source.GetSize());
+        }
+    }
+
+    return Stamp;
+}
+
+uint64_t LavaMeshCache::ComputeContentHash(const Builder& Builder)
+{
+    return HashContent(Builder, GatherPayloads(Builder));
+}
+
+bool LavaMeshCache::Write(const std::string& CachePath, const Builder& Builder, const MeshSourceStamp& Source, const MeshOptimizationSettings& Settings)
+{
+    const std::vector<VkVertexInputAttributeDescription> AttributeDescs = GetFormatAttributeDescs(Builder.Format);
+    assert(AttributeDescs.size() <= MeshCacheHeader::MaxAttributes && "NOTE: too many vertex attributes for the mesh cache");
+
+    MeshCacheHeader Header{};
+    Header.Magic = Magic;
+    Header.Version = Version;
+    Header.Source = Source;
+    Header.ProcessingFlags = Settings.GetFlags();
+    Header.SettingsHash = Settings.GetHash();
+    Header.Format = Builder.Format;
+    Header.VertexStride = GetFormatStride(Builder.Format);
+    Header.AttributeCount = static_cast<uint32_t>(AttributeDescs.size());
+    for (uint32_t i = 0; i < Header.AttributeCount; ++i)
+    {
+        Header.Attributes[i] = {AttributeDescs[i].location, static_cast<uint32_t>(AttributeDescs[i].format), AttributeDescs[i].offset};
+    }
+
+    Header.VertexCount = static_cast<uint32_t>(Builder.Format == VertexFormat::Compact ? Builder.CompactVertices.size() : Builder.Vertices.size());
+    Header.IndexCount = static_cast<uint32_t>(Builder.Indices.size());
+    for (int Axis = 0; Axis < 3; ++Axis)
+    {
+        Header.BoundsMin[Axis] = Builder.BoundsMin[Axis];
+        Header.BoundsMax[Axis] = Builder.BoundsMax[Axis];
+        Header.Sphere[Axis] = Builder.Sphere.Center[Axis];
+    }
+    Header.Sphere[3] = Builder.Sphere.Radius;
+
+    std::vector<SectionPayload> Payloads = GatherPayloads(Builder);
+
+    // Computed by CookFile, before encoding, so that the mesh is shared with its plain copies
+    Header.ContentHash = Builder.ContentHash != 0 ? Builder.ContentHash : HashContent(Builder, Payloads);
+
+    std::vector<uint8_t> EncodedVertices{};
+    std::vector<uint8_t> EncodedIndices{};
+    if (Settings.bEncodeMesh && LavaMeshCodec::CanEncodeVertices(Header.VertexStride))
+    {
+        SectionPayload& Vertices = Payloads[0];
+        EncodedVertices = LavaMeshCodec::EncodeVertices(Vertices.Data, Header.VertexCount, Header.VertexStride);
+        Vertices = {{MeshCacheSectionType::EncodedVertices, Vertices.Section.ElementSize, 0, EncodedVertices.size()}, EncodedVertices.data()};
+
+        // The encoder needs the indices in their final type
+        SectionPayload& Indices = Payloads[1];
+        std::vector<uint16_t> ShortIndices{};
+        if (Indices.bNarrowIndices)
+        {
+            ShortIndices.assign(Builder.Indices.begin(), Builder.Indices.end());
+        }
+
+        EncodedIndices = LavaMeshCodec::EncodeIndices(Indices.bNarrowIndices ? ShortIndices.data() : Indices.Data, Header.IndexCount, Indices.Section.ElementSize);
+        Indices = {{MeshCacheSectionType::EncodedIndices, Indices.Section.ElementSize, 0, EncodedIndices.size()}, EncodedIndices.data()};
+    }
+
+    Header.SectionCount = static_cast<uint32_t>(Payloads.size());
+
+    std::vector<MeshCacheSection> Sections{};
+    uint64_t Offset = sizeof(MeshCacheHeader) + Payloads.size() * sizeof(MeshCacheSection);
+    for (const SectionPayload& Payload : Payloads)
+    {
+        Offset = AlignSectionOffset(Offset);
+        Sections.push_back(Payload.Section);
+        Sections.back().Offset = Offset;
+        Offset += Payload.Section.Size;
+    }
+
+    std::error_code Error;
+    const std::filesystem::path FinalPath{CachePath};
+    if (FinalPath.has_parent_path())
+    {
+        std::filesystem::create_directories(FinalPath.parent_path(), Error);
+    }
+
+    const std::string TempPath = MakeTempPath(CachePath);
+    {
+        std::ofstream FileStream(TempPath, std::ios::binary | std::ios::trunc);
+        if (!FileStream.is_open())
+            return false;
+
+        FileStream.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+        FileStream.write(reinterpret_cast<const char*>(Sections.data()), Sections.size() * sizeof(MeshCacheSection));
+
+        const char Zeros[SectionAlignment] = {};
+        for (size_t i = 0; i < Payloads.size(); ++i)
+        {
+            const uint64_t Padding = Sections[i].Offset - static_cast<uint64_t>(FileStream.tellp());
+            FileStream.write(Zeros, Padding);
+
+            if (Payloads[i].bNarrowIndices)
+            {
+                ForEachNarrowedBlock(static_cast<const uint32_t*>(Payloads[i].Data), Header.IndexCount, [&FileStream](const uint16_t* Block, size_t Count)
+                {
+                    FileStream.write(reinterpret_cast<const char*>(Block), Count * sizeof(uint16_t));
+                });
+            }
+            else
+            {
+                FileStream.write(static_cast<const char*>(Payloads[i].Data), Payloads[i].Section.Size);
+            }
+        }
+
+        if (!FileStream.good())
+        {
+            FileStream.close();
+            std::filesystem::remove(TempPath, Error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(TempPath, FinalPath, Error);
+    if (Error)
+    {
+        std::filesystem::remove(TempPath, Error);
+        return false;
+    }
+
+    return true;
+}
+
+bool LavaMeshCache::Open(const std::string& SourcePath, uint64_t SettingsHash, LavaMappedFile CookedFile)
+{
+    // Meshes shipped in a mounted package come first. The cache file is only used when no package has the mesh, or
+    // when the packaged copy is outdated
+    LavaMappedFile PackagedFile{};
+    if (LavaPackage::OpenMounted(SourcePath + Extension, PackagedFile) && OpenCooked(SourcePath, SettingsHash, std::move(PackagedFile), {}))
+        return true;
+
+    return OpenCooked(SourcePath, SettingsHash, std::move(CookedFile), GetCachePath(SourcePath));
+}
+
+bool LavaMeshCache::OpenCooked(const std::string& SourcePath, uint64_t SettingsHash, LavaMappedFile&& CookedFile, const std::string& CachePath)
+{
+    Header = nullptr;
+    Sections = nullptr;
+
+    File = std::move(CookedFile);
+    if ((!File.IsOpen() && (CachePath.empty() || !File.Open(CachePath))) || !IsValid() || Header->SettingsHash != SettingsHash)
+    {
+        File.Close();
+        return false;
+    }
+
+    // When the source is not there anymore the cooked data is all we have. A source emptied since is checked like any
+    // other change
+    std::error_code Error;
+    if (!std::filesystem::exists(SourcePath, Error) && !Error)
+        return true;
+
+    const MeshSourceStamp Source = GetSourceStamp(SourcePath, false);
+
+    if (Source.Size == Header->Source.Size && Source.ModifiedTime == Header->Source.ModifiedTime)
+        return true;
+
+    // The source has been touched, but its content might still be the same (a fresh checkout for instance)
+    if (Source.Size == Header->Source.Size && GetSourceStamp(SourcePath, true).Hash == Header->Source.Hash)
+    {
+        // Stores the new modification time so that the hash is not computed again on the next load. Packages are
+        // never written to
+        if (!CachePath.empty())
+        {
+            std::fstream FileStream(CachePath, std::ios::binary | std::ios::in | std::ios::out);
+            if (FileStream.is_open())
+            {
+                FileStream.seekp(offsetof(MeshCacheHeader, Source) + offsetof(MeshSourceStamp, ModifiedTime));
+                FileStream.write(reinterpret_cast<const char*>(&Source.ModifiedTime), sizeof(Source.ModifiedTime));
+            }
+        }
+
+        return true;
+    }
+
+    Header = nullptr;
+    Sections = nullptr;
+    File.Close();
+    return false;
+}
+
+bool LavaMeshCache::IsValid()
+{
+    if (File.GetSize() < sizeof(MeshCacheHeader))
+        return false;
+
+    Header = reinterpret_cast<const MeshCacheHeader*>(File.GetData());
+    if (Header->Magic != Magic || Header->Version != Version)
+        return false;
+
+    if (Header->Format != VertexFormat::Full && Header->Format != VertexFormat::Compact)
+        return false;
+
+    // The data must have been cooked with the current layout of its vertex format
+    const std::vector<VkVertexInputAttributeDescription> AttributeDescs = GetFormatAttributeDescs(Header->Format);
+    if (Header->VertexStride != GetFormatStride(Header->Format) || Header->AttributeCount != AttributeDescs.size())
+        return false;
+
+    for (uint32_t i = 0; i < Header->AttributeCount; ++i)
+    {
+        const MeshCacheAttribute& Attribute = Header->Attributes[i];
+        if (Attribute.Location != AttributeDescs[i].location
+            || Attribute.Format != static_cast<uint32_t>(AttributeDescs[i].format)
+            || Attribute.Offset != AttributeDescs[i].offset)
+            return false;
+    }
+
+    const uint64_t SectionTableEnd = sizeof(MeshCacheHeader) + static_cast<uint64_t>(Header->SectionCount) * sizeof(MeshCacheSection);
+    if (SectionTableEnd > File.GetSize())
+        return false;
+
+    Sections = reinterpret_cast<const MeshCacheSection*>(File.GetData() + sizeof(MeshCacheHeader));
+    for (uint32_t i = 0; i < Header->SectionCount; ++i)
+    {
+        const MeshCacheSection& Section = Sections[i];
+        if (Section.Offset % SectionAlignment != 0 || Section.Offset > File.GetSize() || Section.Size > File.GetSize() - Section.Offset)
+            return false;
+    }
+
+    const MeshCacheSection* VertexSection = GetVertexSection();
+    const MeshCacheSection* IndexSection = GetIndexSection();
+
+    // Encoded sections are only validated when decoded, which fails on corrupted data
+    const bool bIsEncoded = IsEncoded();
+    if (!VertexSection || !IndexSection || (IndexSection->Type == MeshCacheSectionType::EncodedIndices) != bIsEncoded)
+        return false;
+
+    if (VertexSection->ElementSize != Header->VertexStride || (!bIsEncoded && VertexSection->Size != static_cast<uint64_t>(Header->VertexCount) * Header->VertexStride))
+        return false;
+
+    if ((IndexSection->ElementSize != sizeof(uint16_t) && IndexSection->ElementSize != sizeof(uint32_t))
+        || (!bIsEncoded && IndexSection->Size != static_cast<uint64_t>(Header->IndexCount) * IndexSection->ElementSize))
+        return false;
+
+    const MeshCacheSection* SubMeshSection = FindSection(MeshCacheSectionType::SubMeshes);
+    if (SubMeshSection && (SubMeshSection->ElementSize != sizeof(SubMesh) || SubMeshSection->Size % sizeof(SubMesh) != 0))
+        return false;
+
+    const MeshCacheSection* MeshletSection = FindSection(MeshCacheSectionType::Meshlets);
+    if (MeshletSection && (MeshletSection->ElementSize != sizeof(Meshlet) || MeshletSection->Size % sizeof(Meshlet) != 0))
+        return false;
+
+    const MeshCacheSection* MaterialSection = FindSection(MeshCacheSectionType::Materials);
+    if (MaterialSection && (MaterialSection->ElementSize != sizeof(Material) || MaterialSection->Size % sizeof(Material) != 0))
+        return false;
+
+    // Sub meshes of a mesh without materials all use the default one
+    const uint32_t MaterialCount = std::max(GetMaterialCount(), 1u);
+    for (uint32_t SubMeshIdx = 0; SubMeshIdx < GetSubMeshCount(); ++SubMeshIdx)
+    {
+        const SubMesh& Mesh = GetSubMeshes()[SubMeshIdx];
+        if (Mesh.Material >= MaterialCount
+            || static_cast<uint64_t>(Mesh.FirstIndex) + Mesh.IndexCount > Header->IndexCount
+            || Mesh.VertexOffset < 0 || static_cast<uint32_t>(Mesh.VertexOffset) > Header->VertexCount)
+            return false;
+    }
+
+    for (uint32_t MeshletIdx = 0; MeshletIdx < GetMeshletCount(); ++MeshletIdx)
+    {
+        const Meshlet& Cluster = GetMeshlets()[MeshletIdx];
+        // Meshlets index the vertices of their sub mesh, VertexCount only counts the distinct ones
+        if (static_cast<uint64_t>(Cluster.FirstIndex) + Cluster.IndexCount > Header->IndexCount
+            || Cluster.IndexCount % 3 != 0 || Cluster.IndexCount > Meshlet::MaxTriangles * 3
+            || Cluster.VertexCount > std::min(Meshlet::MaxVertices, Header->VertexCount)
+            || Cluster.VertexOffset < 0 || static_cast<uint32_t>(Cluster.VertexOffset) > Header->VertexCount)
+            return false;
+    }
+
+    // Encoded indices are checked once decoded, by ReadIndices
+    if (!bIsEncoded && !AreIndicesInRange(GetSectionData(*IndexSection)))
+        return false;
+
+    const MeshCacheSection* LodSection = FindSection(MeshCacheSectionType::Lods);
+    if (!LodSection)
+        return true;
+
+    if (LodSection->ElementSize != sizeof(LodLevel) || LodSection->Size % sizeof(LodLevel) != 0)
+        return false;
+
+    // Levels draw sub meshes, which must all exist
+    for (uint32_t LodIdx = 0; LodIdx < GetLodCount(); ++LodIdx)
+    {
+        const LodLevel& Level = GetLods()[LodIdx];
+        if (static_cast<uint64_t>(Level.FirstSubMesh) + Level.SubMeshCount > GetSubMeshCount())
+            return false;
+    }
+
+    return true;
+}
+
+const MeshCacheSection* LavaMeshCache::FindSection(const MeshCacheSectionType Type) const
+{
+    for (uint32_t i = 0; i < Header->SectionCount; ++i)
+    {
+        if (Sections[i].Type == Type)
+            return &Sections[i];
+    }
+
+    return nullptr;
+}
+
+const MeshCacheSection* LavaMeshCache::GetVertexSection() const
+{
+    const MeshCacheSection* Section = FindSection(MeshCacheSectionType::Vertices);
+    return Section ? Section : FindSection(MeshCacheSectionType::EncodedVertices);
+}
+
+const MeshCacheSection* LavaMeshCache::GetIndexSection() const
+{
+    const MeshCacheSection* Section = FindSection(MeshCacheSectionType::Indices);
+    return Section ? Section : FindSection(MeshCacheSectionType::EncodedIndices);
+}
+
+bool LavaMeshCache::ReadVertices(void* Destination) const
+{
+    const MeshCacheSection& Section = *GetVertexSection();
+    if (Section.Type == MeshCacheSectionType::EncodedVertices)
+        return LavaMeshCodec::DecodeVertices(Destination, Header->VertexCount, Header->VertexStride, GetSectionData(Section), Section.Size);
+
+    std::memcpy(Destination, GetSectionData(Section), Section.Size);
+    return true;
+}
+
+bool LavaMeshCache::ReadIndices(void* Destination) const
+{
+    const MeshCacheSection& Section = *GetIndexSection();
+    if (Section.Type == MeshCacheSectionType::EncodedIndices)
+    {
+        // Data decoding fine can still index vertices the mesh does not have
+        return LavaMeshCodec::DecodeIndices(Destination, Header->IndexCount, Section.ElementSize, GetSectionData(Section), Section.Size)
+            && AreIndicesInRange(Destination);
+    }
+
+    std::memcpy(Destination, GetSectionData(Section), Section.Size);
+    return true;
+}
+
+bool LavaMeshCache::AreIndicesInRange(const void* Indices) const
+{
+    const uint32_t IndexSize = GetIndexSection()->ElementSize;
+    const auto IsInRange = [&](uint32_t FirstIndex, uint32_t IndexCount, int32_t VertexOffset)
+    {
+        // Sub meshes and meshlets were range checked, so VertexOffset is within the vertices
+        const uint32_t Limit = Header->VertexCount - static_cast<uint32_t>(VertexOffset);
+        uint32_t MaxIndex = 0;
+
+        if (IndexSize == sizeof(uint16_t))
+        {
+            const uint16_t* Values = static_cast<const uint16_t*>(Indices) + FirstIndex;
+            for (uint32_t i = 0; i < IndexCount; ++i)
+                MaxIndex = std::max<uint32_t>(MaxIndex, Values[i]);
+        }
+        else
+        {
+            const uint32_t* Values = static_cast<const uint32_t*>(Indices) + FirstIndex;
+            for (uint32_t i = 0; i < IndexCount; ++i)
+                MaxIndex = std::max(MaxIndex, Values[i]);
+        }
+
+        return IndexCount == 0 || MaxIndex < Limit;
+    };
+
+    // Without sub meshes the whole buffer is drawn as it is
+    if (GetSubMeshCount() == 0)
+        return IsInRange(0, Header->IndexCount, 0);
+
+    for (uint32_t SubMeshIdx = 0; SubMeshIdx < GetSubMeshCount(); ++SubMeshIdx)
+    {
+        const SubMesh& Mesh = GetSubMeshes()[SubMeshIdx];
+        if (!IsInRange(Mesh.FirstIndex, Mesh.IndexCount, Mesh.VertexOffset))
+            return false;
+    }
+
+    for (uint32_t MeshletIdx = 0; MeshletIdx < GetMeshletCount(); ++MeshletIdx)
+    {
+        const Meshlet& Cluster = GetMeshlets()[MeshletIdx];
+        if (!IsInRange(Cluster.FirstIndex, Cluster.IndexCount, Cluster.VertexOffset))
+            return false;
+    }
+
+    return true;
+}
+
+VkIndexType LavaMeshCache::GetIndexType() const
+{
+    return GetIndexSection()->ElementSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+const SubMesh* LavaMeshCache::GetSubMeshes() const
+{
+    const MeshCacheSection* Section = FindSection(MeshCacheSectionType::SubMeshes);
+    return Section ? static_cast<const SubMesh*>(GetSectionData(*Section)) : nullptr;
+}
+
+uint32_t LavaMeshCache::GetSubMeshCount() const
+{
+    const MeshCacheSection* Section = FindSection(MeshCacheSectionType::SubMeshes);
+    return Section ? static_cast<uint32_t>(Section->Size / sizeof(SubMesh)) : 0;
+}
+
+const Meshlet* LavaMeshCache::GetMeshlets() const
+{
+    const MeshCacheSection* Section = FindSection(MeshCacheSectionType::Meshlets);
+    return Section ? static_cast<const Meshlet*>(GetSectionData(*Section)) : nullptr;
+}
+
+uint32_t LavaMeshCache::GetMeshletCount() const
+{
+    const MeshCacheSection* Section = FindSection(MeshCacheSectionType::Meshlets);
+    return Section ? static_cast<uint32_t>(Section->Size / sizeof(Meshlet)) : 0;
+}
+
+const LodLevel* LavaMeshCache::GetLods() const
+{
+    const MeshCacheSection* Section = FindSection(MeshCacheSectionType::Lods);
+    return Section ? static_cast<const LodLevel*>(GetSectionData(*Section)) : nullptr;
+}
+
+uint32_t LavaMeshCache::GetLodCount() const
+{
+    const MeshCacheSection* Section = FindSection(MeshCacheSectionType::Lods);
+    return Section ? static_cast<uint32_t>(Section->Size / sizeof(LodLevel)) : 0;
+}
+
+const Material* LavaMeshCache::GetMaterials() const
+{
+    const MeshCacheSection* Section = FindSection(MeshCacheSectionType::Materials);
+    return Section ? static_cast<const Material*>(GetSectionData(*Section)) : nullptr;
+}
+
+uint32_t LavaMeshCache::GetMaterialCount() const
+{
+    const MeshCacheSection* Section = FindSection(MeshCacheSectionType::Materials);
+    return Section ? static_cast<uint32_t>(Section->Size / sizeof(Material)) : 0;
+}
+
+}
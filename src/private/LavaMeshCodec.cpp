@@ -0,0 +1,590 @@
+//
+//  LavaMeshCodec.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaMeshCodec.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// Defining LAVA_NO_SIMD forces the scalar decoder, which is otherwise only used where neither SSE2 nor NEON exist
+#if !defined(LAVA_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define LAVA_CODEC_SSE2 1
+#include <emmintrin.h>
+#elif !defined(LAVA_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#define LAVA_CODEC_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace lava
+{
+
+namespace
+{
+
+constexpr size_t GroupSize = 16;
+
+// Bytes taken by a plane of 16 elements, by mode
+constexpr size_t ModeSizes[4] = {0, 4, 8, 16};
+
+#pragma region Encoding
+
+uint8_t ZigZag8(const uint8_t Delta)
+{
+    return static_cast<uint8_t>((Delta << 1) ^ (static_cast<int8_t>(Delta) >> 7));
+}
+
+uint32_t ZigZag32(const uint32_t Delta)
+{
+    return (Delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(Delta) >> 31);
+}
+
+uint32_t ZigZag16(const uint16_t Delta)
+{
+    return static_cast<uint16_t>((Delta << 1) ^ (static_cast<int16_t>(Delta) >> 15));
+}
+
+// Narrowest mode holding all the values
+uint32_t ChooseMode(const uint8_t Values[GroupSize])
+{
+    uint8_t Bits = 0;
+    for (size_t Idx = 0; Idx < GroupSize; ++Idx)
+    {
+        Bits |= Values[Idx];
+    }
+
+    return Bits == 0 ? 0 : Bits < 4 ? 1 : Bits < 16 ? 2 : 3;
+}
+
+// The first element of a byte goes into its highest bits, which is the order the decoders unpack them in
+void PackPlane(const uint8_t Values[GroupSize], const uint32_t Mode, std::vector<uint8_t>& Out)
+{
+    switch (Mode)
+    {
+        case 0:
+            break;
+        case 1:
+            for (size_t Idx = 0; Idx < GroupSize; Idx += 4)
+            {
+                Out.push_back(static_cast<uint8_t>((Values[Idx] << 6) | (Values[Idx + 1] << 4) | (Values[Idx + 2] << 2) | Values[Idx + 3]));
+            }
+            break;
+        case 2:
+            for (size_t Idx = 0; Idx < GroupSize; Idx += 2)
+            {
+                Out.push_back(static_cast<uint8_t>((Values[Idx] << 4) | Values[Idx + 1]));
+            }
+            break;
+        default:
+            Out.insert(Out.end(), Values, Values + GroupSize);
+            break;
+    }
+}
+
+uint32_t ReadIndex(const uint8_t* Indices, const size_t Idx, const size_t IndexSize)
+{
+    if (IndexSize == sizeof(uint16_t))
+    {
+        uint16_t Index;
+        std::memcpy(&Index, Indices + Idx * IndexSize, sizeof(Index));
+        return Index;
+    }
+
+    uint32_t Index;
+    std::memcpy(&Index, Indices + Idx * IndexSize, sizeof(Index));
+    return Index;
+}
+
+#pragma endregion
+
+#pragma region Decoding
+
+// Each backend provides the same primitives:
+// - LoadPlane: unpacks the 16 bytes of a plane stored in Mode
+// - DecodeBytePlane: undoes the zigzag and the byte deltas, starting from Carry
+// - StoreTransposed4 / StoreInterleaved2: interleaves 4 or 2 planes, so that Out holds whole elements
+// - DecodeIntegers32 / DecodeIntegers16: undoes the zigzag and the integer deltas of 16 elements in place
+
+#if LAVA_CODEC_SSE2
+
+using Plane = __m128i;
+
+Plane LoadPlane(const uint8_t* In, const uint32_t Mode)
+{
+    switch (Mode)
+    {
+        case 0:
+            return _mm_setzero_si128();
+        case 1:
+        {
+            int32_t Packed;
+            std::memcpy(&Packed, In, sizeof(Packed));
+            const __m128i Bytes = _mm_cvtsi32_si128(Packed);
+            const __m128i Mask = _mm_set1_epi8(3);
+
+            // 16 bit shifts leak bits across bytes, which the mask drops
+            const __m128i First = _mm_and_si128(_mm_srli_epi16(Bytes, 6), Mask);
+            const __m128i Second = _mm_and_si128(_mm_srli_epi16(Bytes, 4), Mask);
+            const __m128i Third = _mm_and_si128(_mm_srli_epi16(Bytes, 2), Mask);
+            const __m128i Fourth = _mm_and_si128(Bytes, Mask);
+
+            return _mm_unpacklo_epi16(_mm_unpacklo_epi8(First, Second), _mm_unpacklo_epi8(Third, Fourth));
+        }
+        case 2:
+        {
+            const __m128i Bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(In));
+            const __m128i Mask = _mm_set1_epi8(15);
+            return _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(Bytes, 4), Mask), _mm_and_si128(Bytes, Mask));
+        }
+        default:
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(In));
+    }
+}
+
+Plane DecodeBytePlane(Plane Values, const uint8_t Carry)
+{
+    const __m128i One = _mm_set1_epi8(1);
+    Values = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(Values, 1), _mm_set1_epi8(0x7F)), _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(Values, One)));
+
+    // Inclusive prefix sum of the deltas
+    Values = _mm_add_epi8(Values, _mm_slli_si128(Values, 1));
+    Values = _mm_add_epi8(Values, _mm_slli_si128(Values, 2));
+    Values = _mm_add_epi8(Values, _mm_slli_si128(Values, 4));
+    Values = _mm_add_epi8(Values, _mm_slli_si128(Values, 8));
+
+    return _mm_add_epi8(Values, _mm_set1_epi8(static_cast<char>(Carry)));
+}
+
+void StoreTransposed4(const Plane Planes[4], uint8_t* Out)
+{
+    const __m128i Low01 = _mm_unpacklo_epi8(Planes[0], Planes[1]);
+    const __m128i High01 = _mm_unpackhi_epi8(Planes[0], Planes[1]);
+    const __m128i Low23 = _mm_unpacklo_epi8(Planes[2], Planes[3]);
+    const __m128i High23 = _mm_unpackhi_epi8(Planes[2], Planes[3]);
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(Out), _mm_unpacklo_epi16(Low01, Low23));
+    _mm_store_si128(reinterpret_cast<__m128i*>(Out + 16), _mm_unpackhi_epi16(Low01, Low23));
+    _mm_store_si128(reinterpret_cast<__m128i*>(Out + 32), _mm_unpacklo_epi16(High01, High23));
+    _mm_store_si128(reinterpret_cast<__m128i*>(Out + 48), _mm_unpackhi_epi16(High01, High23));
+}
+
+void StoreInterleaved2(const Plane Planes[2], uint8_t* Out)
+{
+    _mm_store_si128(reinterpret_cast<__m128i*>(Out), _mm_unpacklo_epi8(Planes[0], Planes[1]));
+    _mm_store_si128(reinterpret_cast<__m128i*>(Out + 16), _mm_unpackhi_epi8(Planes[0], Planes[1]));
+}
+
+void DecodeIntegers32(uint8_t* Values, uint32_t& Carry)
+{
+    const __m128i One = _mm_set1_epi32(1);
+    for (size_t Row = 0; Row < 4; ++Row)
+    {
+        __m128i* RowPtr = reinterpret_cast<__m128i*>(Values + Row * 16);
+        __m128i Row32 = _mm_load_si128(RowPtr);
+        Row32 = _mm_xor_si128(_mm_srli_epi32(Row32, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(Row32, One)));
+        Row32 = _mm_add_epi32(Row32, _mm_slli_si128(Row32, 4));
+        Row32 = _mm_add_epi32(Row32, _mm_slli_si128(Row32, 8));
+        Row32 = _mm_add_epi32(Row32, _mm_set1_epi32(static_cast<int32_t>(Carry)));
+        _mm_store_si128(RowPtr, Row32);
+
+        Carry = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_shuffle_epi32(Row32, 0xFF)));
+    }
+}
+
+void DecodeIntegers16(uint8_t* Values, uint16_t& Carry)
+{
+    const __m128i One = _mm_set1_epi16(1);
+    for (size_t Row = 0; Row < 2; ++Row)
+    {
+        __m128i* RowPtr = reinterpret_cast<__m128i*>(Values + Row * 16);
+        __m128i Row16 = _mm_load_si128(RowPtr);
+        Row16 = _mm_xor_si128(_mm_srli_epi16(Row16, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(Row16, One)));
+        Row16 = _mm_add_epi16(Row16, _mm_slli_si128(Row16, 2));
+        Row16 = _mm_add_epi16(Row16, _mm_slli_si128(Row16, 4));
+        Row16 = _mm_add_epi16(Row16, _mm_slli_si128(Row16, 8));
+        Row16 = _mm_add_epi16(Row16, _mm_set1_epi16(static_cast<int16_t>(Carry)));
+        _mm_store_si128(RowPtr, Row16);
+
+        Carry = static_cast<uint16_t>(_mm_extract_epi16(Row16, 7));
+    }
+}
+
+#elif LAVA_CODEC_NEON
+
+using Plane = uint8x16_t;
+
+Plane LoadPlane(const uint8_t* In, const uint32_t Mode)
+{
+    switch (Mode)
+    {
+        case 0:
+            return vdupq_n_u8(0);
+        case 1:
+        {
+            uint32_t Packed;
+            std::memcpy(&Packed, In, sizeof(Packed));
+            const uint8x16_t Bytes = vreinterpretq_u8_u32(vsetq_lane_u32(Packed, vdupq_n_u32(0), 0));
+            const uint8x16_t Mask = vdupq_n_u8(3);
+
+            const uint8x16_t First = vshrq_n_u8(Bytes, 6);
+            const uint8x16_t Second = vandq_u8(vshrq_n_u8(Bytes, 4), Mask);
+            const uint8x16_t Third = vandq_u8(vshrq_n_u8(Bytes, 2), Mask);
+            const uint8x16_t Fourth = vandq_u8(Bytes, Mask);
+
+            return vreinterpretq_u8_u16(vzip1q_u16(vreinterpretq_u16_u8(vzip1q_u8(First, Second)), vreinterpretq_u16_u8(vzip1q_u8(Third, Fourth))));
+        }
+        case 2:
+        {
+            const uint8x16_t Bytes = vcombine_u8(vld1_u8(In), vdup_n_u8(0));
+            return vzip1q_u8(vshrq_n_u8(Bytes, 4), vandq_u8(Bytes, vdupq_n_u8(15)));
+        }
+        default:
+            return vld1q_u8(In);
+    }
+}
+
+Plane DecodeBytePlane(Plane Values, const uint8_t Carry)
+{
+    const uint8x16_t Zero = vdupq_n_u8(0);
+    Values = veorq_u8(vshrq_n_u8(Values, 1), vsubq_u8(Zero, vandq_u8(Values, vdupq_n_u8(1))));
+
+    // Inclusive prefix sum of the deltas
+    Values = vaddq_u8(Values, vextq_u8(Zero, Values, 15));
+    Values = vaddq_u8(Values, vextq_u8(Zero, Values, 14));
+    Values = vaddq_u8(Values, vextq_u8(Zero, Values, 12));
+    Values = vaddq_u8(Values, vextq_u8(Zero, Values, 8));
+
+    return vaddq_u8(Values, vdupq_n_u8(Carry));
+}
+
+void StoreTransposed4(const Plane Planes[4], uint8_t* Out)
+{
+    const uint16x8_t Low01 = vreinterpretq_u16_u8(vzip1q_u8(Planes[0], Planes[1]));
+    const uint16x8_t High01 = vreinterpretq_u16_u8(vzip2q_u8(Planes[0], Planes[1]));
+    const uint16x8_t Low23 = vreinterpretq_u16_u8(vzip1q_u8(Planes[2], Planes[3]));
+    const uint16x8_t High23 = vreinterpretq_u16_u8(vzip2q_u8(Planes[2], Planes[3]));
+
+    vst1q_u8(Out, vreinterpretq_u8_u16(vzip1q_u16(Low01, Low23)));
+    vst1q_u8(Out + 16, vreinterpretq_u8_u16(vzip2q_u16(Low01, Low23)));
+    vst1q_u8(Out + 32, vreinterpretq_u8_u16(vzip1q_u16(High01, High23)));
+    vst1q_u8(Out + 48, vreinterpretq_u8_u16(vzip2q_u16(High01, High23)));
+}
+
+void StoreInterleaved2(const Plane Planes[2], uint8_t* Out)
+{
+    vst1q_u8(Out, vzip1q_u8(Planes[0], Planes[1]));
+    vst1q_u8(Out + 16, vzip2q_u8(Planes[0], Planes[1]));
+}
+
+void DecodeIntegers32(uint8_t* Values, uint32_t& Carry)
+{
+    const uint32x4_t Zero = vdupq_n_u32(0);
+    for (size_t Row = 0; Row < 4; ++Row)
+    {
+        uint32_t* RowPtr = reinterpret_cast<uint32_t*>(Values + Row * 16);
+        uint32x4_t Row32 = vld1q_u32(RowPtr);
+        Row32 = veorq_u32(vshrq_n_u32(Row32, 1), vsubq_u32(Zero, vandq_u32(Row32, vdupq_n_u32(1))));
+        Row32 = vaddq_u32(Row32, vextq_u32(Zero, Row32, 3));
+        Row32 = vaddq_u32(Row32, vextq_u32(Zero, Row32, 2));
+        Row32 = vaddq_u32(Row32, vdupq_n_u32(Carry));
+        vst1q_u32(RowPtr, Row32);
+
+        Carry = vgetq_lane_u32(Row32, 3);
+    }
+}
+
+void DecodeIntegers16(uint8_t* Values, uint16_t& Carry)
+{
+    const uint16x8_t Zero = vdupq_n_u16(0);
+    for (size_t Row = 0; Row < 2; ++Row)
+    {
+        uint16_t* RowPtr = reinterpret_cast<uint16_t*>(Values + Row * 16);
+        uint16x8_t Row16 = vld1q_u16(RowPtr);
+        Row16 = veorq_u16(vshrq_n_u16(Row16, 1), vsubq_u16(Zero, vandq_u16(Row16, vdupq_n_u16(1))));
+        Row16 = vaddq_u16(Row16, vextq_u16(Zero, Row16, 7));
+        Row16 = vaddq_u16(Row16, vextq_u16(Zero, Row16, 6));
+        Row16 = vaddq_u16(Row16, vextq_u16(Zero, Row16, 4));
+        Row16 = vaddq_u16(Row16, vdupq_n_u16(Carry));
+        vst1q_u16(RowPtr, Row16);
+
+        Carry = vgetq_lane_u16(Row16, 7);
+    }
+}
+
+#else
+
+struct Plane
+{
+    uint8_t Bytes[GroupSize];
+};
+
+Plane LoadPlane(const uint8_t* In, const uint32_t Mode)
+{
+    Plane Values{};
+    const uint32_t Bits = Mode == 1 ? 2 : Mode == 2 ? 4 : 8;
+    const uint32_t PerByte = 8 / Bits;
+
+    for (size_t Idx = 0; Mode != 0 && Idx < GroupSize; ++Idx)
+    {
+        const uint32_t Shift = Bits * (PerByte - 1 - static_cast<uint32_t>(Idx % PerByte));
+        Values.Bytes[Idx] = static_cast<uint8_t>((In[Idx / PerByte] >> Shift) & ((1u << Bits) - 1));
+    }
+
+    return Values;
+}
+
+Plane DecodeBytePlane(Plane Values, uint8_t Carry)
+{
+    for (uint8_t& Byte : Values.Bytes)
+    {
+        Carry = static_cast<uint8_t>(Carry + ((Byte >> 1) ^ (0 - (Byte & 1))));
+        Byte = Carry;
+    }
+
+    return Values;
+}
+
+void StoreTransposed4(const Plane Planes[4], uint8_t* Out)
+{
+    for (size_t Idx = 0; Idx < GroupSize; ++Idx)
+    {
+        for (size_t PlaneIdx = 0; PlaneIdx < 4; ++PlaneIdx)
+        {
+            Out[Idx * 4 + PlaneIdx] = Planes[PlaneIdx].Bytes[Idx];
+        }
+    }
+}
+
+void StoreInterleaved2(const Plane Planes[2], uint8_t* Out)
+{
+    for (size_t Idx = 0; Idx < GroupSize; ++Idx)
+    {
+        Out[Idx * 2] = Planes[0].Bytes[Idx];
+        Out[Idx * 2 + 1] = Planes[1].Bytes[Idx];
+    }
+}
+
+void DecodeIntegers32(uint8_t* Values, uint32_t& Carry)
+{
+    for (size_t Idx = 0; Idx < GroupSize; ++Idx)
+    {
+        uint32_t Value;
+        std::memcpy(&Value, Values + Idx * 4, sizeof(Value));
+        Carry += (Value >> 1) ^ (0u - (Value & 1));
+        std::memcpy(Values + Idx * 4, &Carry, sizeof(Carry));
+    }
+}
+
+void DecodeIntegers16(uint8_t* Values, uint16_t& Carry)
+{
+    for (size_t Idx = 0; Idx < GroupSize; ++Idx)
+    {
+        uint16_t Value;
+        std::memcpy(&Value, Values + Idx * 2, sizeof(Value));
+        Carry = static_cast<uint16_t>(Carry + ((Value >> 1) ^ (0u - (Value & 1))));
+        std::memcpy(Values + Idx * 2, &Carry, sizeof(Carry));
+    }
+}
+
+#endif
+
+#pragma endregion
+
+}
+
+std::vector<uint8_t> LavaMeshCodec::EncodeVertices(const void* Vertices, size_t Count, size_t Stride)
+{
+    if (!CanEncodeVertices(Stride))
+        return {};
+
+    const uint8_t* Source = static_cast<const uint8_t*>(Vertices);
+    const size_t ModesSize = Stride / 4;
+
+    std::vector<uint8_t> Encoded{VertexVersion};
+    Encoded.reserve(1 + Count * Stride / 2);
+
+    for (size_t First = 0; First < Count; First += GroupSize)
+    {
+        const size_t ModesOffset = Encoded.size();
+        Encoded.resize(ModesOffset + ModesSize, 0);
+
+        for (size_t Byte = 0; Byte < Stride; ++Byte)
+        {
+            // Elements past the end repeat the last vertex, so their deltas are 0
+            uint8_t Values[GroupSize] = {};
+            for (size_t Idx = 0; Idx < GroupSize && First + Idx < Count; ++Idx)
+            {
+                const size_t Vertex = First + Idx;
+                const uint8_t Previous = Vertex > 0 ? Source[(Vertex - 1) * Stride + Byte] : 0;
+                Values[Idx] = ZigZag8(static_cast<uint8_t>(Source[Vertex * Stride + Byte] - Previous));
+            }
+
+            const uint32_t Mode = ChooseMode(Values);
+            Encoded[ModesOffset + Byte / 4] |= static_cast<uint8_t>(Mode << (2 * (Byte % 4)));
+            PackPlane(Values, Mode, Encoded);
+        }
+    }
+
+    return Encoded;
+}
+
+bool LavaMeshCodec::DecodeVertices(void* Destination, size_t Count, size_t Stride, const void* Encoded, size_t EncodedSize)
+{
+    if (!CanEncodeVertices(Stride) || EncodedSize == 0)
+        return false;
+
+    const uint8_t* In = static_cast<const uint8_t*>(Encoded);
+    const uint8_t* const End = In + EncodedSize;
+    uint8_t* Out = static_cast<uint8_t*>(Destination);
+
+    if (*In++ != VertexVersion)
+        return false;
+
+    // Groups are decoded aside and copied whole, as scattered writes are slow on write-combined memory. The last
+    // vertex of the previous group is where the deltas start from, zeros for the first group
+    alignas(16) uint8_t Group[GroupSize * MaxVertexStride] = {};
+    const uint8_t* const LastVertex = Group + (GroupSize - 1) * Stride;
+    const size_t ModesSize = Stride / 4;
+
+    for (size_t First = 0; First < Count; First += GroupSize)
+    {
+        if (static_cast<size_t>(End - In) < ModesSize)
+            return false;
+
+        const uint8_t* Modes = In;
+        In += ModesSize;
+
+        for (size_t Byte = 0; Byte < Stride; Byte += 4)
+        {
+            Plane Planes[4];
+            for (size_t PlaneIdx = 0; PlaneIdx < 4; ++PlaneIdx)
+            {
+                const uint32_t Mode = (Modes[Byte / 4] >> (2 * PlaneIdx)) & 3;
+                if (static_cast<size_t>(End - In) < ModeSizes[Mode])
+                    return false;
+
+                Planes[PlaneIdx] = DecodeBytePlane(LoadPlane(In, Mode), LastVertex[Byte + PlaneIdx]);
+                In += ModeSizes[Mode];
+            }
+
+            alignas(16) uint8_t Transposed[GroupSize * 4];
+            StoreTransposed4(Planes, Transposed);
+
+            for (size_t Idx = 0; Idx < GroupSize; ++Idx)
+            {
+                std::memcpy(Group + Idx * Stride + Byte, Transposed + Idx * 4, 4);
+            }
+        }
+
+        std::memcpy(Out + First * Stride, Group, std::min(GroupSize, Count - First) * Stride);
+    }
+
+    return In == End;
+}
+
+std::vector<uint8_t> LavaMeshCodec::EncodeIndices(const void* Indices, size_t Count, size_t IndexSize)
+{
+    if (IndexSize != sizeof(uint16_t) && IndexSize != sizeof(uint32_t))
+        return {};
+
+    const uint8_t* Source = static_cast<const uint8_t*>(Indices);
+
+    std::vector<uint8_t> Encoded{IndexVersion};
+    Encoded.reserve(1 + Count * IndexSize / 2);
+
+    for (size_t First = 0; First < Count; First += GroupSize)
+    {
+        uint8_t Planes[4][GroupSize] = {};
+        for (size_t Idx = 0; Idx < GroupSize && First + Idx < Count; ++Idx)
+        {
+            const size_t Index = First + Idx;
+            const uint32_t Delta = ReadIndex(Source, Index, IndexSize) - (Index > 0 ? ReadIndex(Source, Index - 1, IndexSize) : 0);
+            const uint32_t Value = IndexSize == sizeof(uint16_t) ? ZigZag16(static_cast<uint16_t>(Delta)) : ZigZag32(Delta);
+
+            for (size_t PlaneIdx = 0; PlaneIdx < IndexSize; ++PlaneIdx)
+            {
+                Planes[PlaneIdx][Idx] = static_cast<uint8_t>(Value >> (8 * PlaneIdx));
+            }
+        }
+
+        const size_t ModesOffset = Encoded.size();
+        Encoded.push_back(0);
+
+        for (size_t PlaneIdx = 0; PlaneIdx < IndexSize; ++PlaneIdx)
+        {
+            const uint32_t Mode = ChooseMode(Planes[PlaneIdx]);
+            Encoded[ModesOffset] |= static_cast<uint8_t>(Mode << (2 * PlaneIdx));
+            PackPlane(Planes[PlaneIdx], Mode, Encoded);
+        }
+    }
+
+    return Encoded;
+}
+
+bool LavaMeshCodec::DecodeIndices(void* Destination, size_t Count, size_t IndexSize, const void* Encoded, size_t EncodedSize)
+{
+    if ((IndexSize != sizeof(uint16_t) && IndexSize != sizeof(uint32_t)) || EncodedSize == 0)
+        return false;
+
+    const uint8_t* In = static_cast<const uint8_t*>(Encoded);
+    const uint8_t* const End = In + EncodedSize;
+    uint8_t* Out = static_cast<uint8_t*>(Destination);
+
+    if (*In++ != IndexVersion)
+        return false;
+
+    uint32_t Carry32 = 0;
+    uint16_t Carry16 = 0;
+
+    for (size_t First = 0; First < Count; First += GroupSize)
+    {
+        // The modes of the planes a 16 bit index does not have must be 0
+        if (In == End || (*In >> (2 * IndexSize)) != 0)
+            return false;
+
+        const uint8_t Modes = *In++;
+
+        Plane Planes[4];
+        for (size_t PlaneIdx = 0; PlaneIdx < IndexSize; ++PlaneIdx)
+        {
+            const uint32_t Mode = (Modes >> (2 * PlaneIdx)) & 3;
+            if (static_cast<size_t>(End - In) < ModeSizes[Mode])
+                return false;
+
+            Planes[PlaneIdx] = LoadPlane(In, Mode);
+            In += ModeSizes[Mode];
+        }
+
+        alignas(16) uint8_t Values[GroupSize * sizeof(uint32_t)];
+        if (IndexSize == sizeof(uint32_t))
+        {
+            StoreTransposed4(Planes, Values);
+            DecodeIntegers32(Values, Carry32);
+        }
+        else
+        {
+            StoreInterleaved2(Planes, Values);
+            DecodeIntegers16(Values, Carry16);
+        }
+
+        std::memcpy(Out + First * IndexSize, Values, std::min(GroupSize, Count - First) * IndexSize);
+    }
+
+    return In == End;
+}
+
+const char* LavaMeshCodec::GetDecoderName()
+{
+#if LAVA_CODEC_SSE2
+    return "SSE2";
+#elif LAVA_CODEC_NEON
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+}
@@ -0,0 +1,507 @@
+//
+//  LavaMeshOptimizer.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaMeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "LavaUtils.hpp"
+
+namespace lava
+{
+
+namespace
+{
+
+// Scoring parameters from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+constexpr float CacheDecayPower = 1.5f;
+constexpr float LastTriangleScore = 0.75f;
+constexpr float ValenceBoostScale = 2.f;
+constexpr float ValenceBoostPower = 0.5f;
+constexpr uint32_t MaxValence = 32;
+
+// Keeps track of the vertices that would be found in a FIFO cache. A vertex is in the cache if it has
+// been referenced less than CacheSize misses ago
+struct FifoCache
+{
+    FifoCache(size_t VertexCount, uint32_t InCacheSize)
+        : Timestamps(VertexCount, 0)
+        , CacheSize(InCacheSize)
+        , Timestamp(InCacheSize + 1)
+    {}
+
+    // Returns true on a cache miss
+    bool Access(uint32_t VertexIdx)
+    {
+        if (Timestamp - Timestamps[VertexIdx] > CacheSize)
+        {
+            Timestamps[VertexIdx] = Timestamp++;
+            return true;
+        }
+
+        return false;
+    }
+
+    uint32_t AccessTriangle(const uint32_t* Triangle)
+    {
+        return Access(Triangle[0]) + Access(Triangle[1]) + Access(Triangle[2]);
+    }
+
+    void Flush()
+    {
+        Timestamp += CacheSize + 1;
+    }
+
+    std::vector<uint32_t> Timestamps;
+    uint32_t CacheSize;
+    uint32_t Timestamp;
+};
+
+}
+
+uint64_t MeshOptimizationSettings::GetHash() const
+{
+    const uint32_t Flags = GetFlags();
+    uint64_t Hash = HashBytes(&Flags, sizeof(Flags));
+
+    // Fields are hashed one by one, padding bytes are not initialized
+    const auto HashValue = [&Hash](const auto& Value) { Hash = HashBytes(&Value, sizeof(Value), Hash); };
+
+    // Parameters of the disabled steps do not change the cooked data
+    if (bWeldVertices)
+    {
+        HashValue(WeldingTolerances.Position);
+        HashValue(WeldingTolerances.NormalAngle);
+        HashValue(WeldingTolerances.TexCoord);
+    }
+
+    if (bGenerateNormals)
+    {
+        HashValue(Normals.CreaseAngle);
+        HashValue(Normals.Weighting);
+    }
+
+    if (bOptimizeOverdraw)
+    {
+        HashValue(OverdrawThreshold);
+    }
+
+    return Hash;
+}
+
+#pragma region Analysis
+
+VertexCacheStats LavaMeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& Indices, size_t VertexCount, uint32_t CacheSize)
+{
+    VertexCacheStats Stats{};
+    if (Indices.empty() || VertexCount == 0)
+        return Stats;
+
+    FifoCache Cache{VertexCount, CacheSize};
+
+    size_t Misses = 0;
+    for (size_t i = 0; i + 2 < Indices.size(); i += 3)
+    {
+        Misses += Cache.AccessTriangle(&Indices[i]);
+    }
+
+    Stats.ACMR = static_cast<float>(Misses) / static_cast<float>(Indices.size() / 3);
+    Stats.ATVR = static_cast<float>(Misses) / static_cast<float>(VertexCount);
+    return Stats;
+}
+
+#pragma endregion
+
+void LavaMeshOptimizer::Optimize(Builder& Builder, const MeshOptimizationSettings& Settings)
+{
+    if (Builder.Indices.empty() || !(Settings.bOptimizeVertexCache || Settings.bOptimizeOverdraw || Settings.bOptimizeVertexFetch))
+        return;
+
+    const VertexCacheStats Before = AnalyzeVertexCache(Builder.Indices, Builder.Vertices.size());
+
+    if (Builder.SubMeshes.empty())
+    {
+        if (Settings.bOptimizeVertexCache)
+        {
+            OptimizeVertexCache(Builder.Indices, Builder.Vertices.size());
+        }
+
+        if (Settings.bOptimizeOverdraw)
+        {
+            OptimizeOverdraw(Builder.Indices, Builder.Vertices, Settings.OverdrawThreshold);
+        }
+    }
+    else
+    {
+        // Triangles are only reordered inside their own sub mesh, which would otherwise lose its material
+        std::vector<uint32_t> LocalOfVertex(Builder.Vertices.size(), UINT32_MAX);
+        std::vector<uint32_t> VertexOfLocal{};
+        std::vector<Vertex> LocalVertices{};
+
+        for (const SubMesh& Range : Builder.SubMeshes)
+        {
+            const auto First = Builder.Indices.begin() + Range.FirstIndex;
+            std::vector<uint32_t> LocalIndices(First, First + Range.IndexCount);
+
+            // Vertices are numbered locally, so that the per vertex state of the steps is only as large as the sub mesh
+            VertexOfLocal.clear();
+            LocalVertices.clear();
+            for (uint32_t& Index : LocalIndices)
+            {
+                const uint32_t VertexIdx = Index + Range.VertexOffset;
+                if (LocalOfVertex[VertexIdx] == UINT32_MAX)
+                {
+                    LocalOfVertex[VertexIdx] = static_cast<uint32_t>(VertexOfLocal.size());
+                    VertexOfLocal.push_back(VertexIdx);
+                    LocalVertices.push_back(Builder.Vertices[VertexIdx]);
+                }
+                Index = LocalOfVertex[VertexIdx];
+            }
+
+            if (Settings.bOptimizeVertexCache)
+            {
+                OptimizeVertexCache(LocalIndices, LocalVertices.size());
+            }
+
+            if (Settings.bOptimizeOverdraw)
+            {
+                OptimizeOverdraw(LocalIndices, LocalVertices, Settings.OverdrawThreshold);
+            }
+
+            std::transform(LocalIndices.begin(), LocalIndices.end(), First, [&](const uint32_t Local)
+            {
+                return VertexOfLocal[Local] - Range.VertexOffset;
+            });
+
+            for (const uint32_t VertexIdx : VertexOfLocal)
+            {
+                LocalOfVertex[VertexIdx] = UINT32_MAX;
+            }
+        }
+    }
+
+    if (Settings.bOptimizeVertexFetch)
+    {
+        OptimizeVertexFetch(Builder.Vertices, Builder.Indices);
+    }
+
+    const VertexCacheStats After = AnalyzeVertexCache(Builder.Indices, Builder.Vertices.size());
+
+    std::cout << "ACMR: " << Before.ACMR << " -> " << After.ACMR
+              << ", ATVR: " << Before.ATVR << " -> " << After.ATVR << std::endl;
+}
+
+#pragma region Vertex Cache
+
+void LavaMeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& Indices, size_t VertexCount)
+{
+    const size_t TriangleCount = Indices.size() / 3;
+    if (TriangleCount == 0)
+        return;
+
+    // Score of a vertex depending on its position in the cache (the last slot means "not in cache")
+    float CachePositionScores[ForsythCacheSize + 1];
+    for (uint32_t Position = 0; Position < ForsythCacheSize; ++Position)
+    {
+        // The vertices of the last triangle get a fixed score, to avoid using them again right away
+        // which would favor long thin strips
+        CachePositionScores[Position] = Position < 3
+            ? LastTriangleScore
+            : std::pow(1.f - static_cast<float>(Position - 3) / (ForsythCacheSize - 3), CacheDecayPower);
+    }
+    CachePositionScores[ForsythCacheSize] = 0.f;
+
+    // Vertices with only a few triangles left are boosted, so that they are removed from the mesh instead of leaving lonely triangles
+    float ValenceScores[MaxValence + 1];
+    ValenceScores[0] = 0.f;
+    for (uint32_t Valence = 1; Valence <= MaxValence; ++Valence)
+    {
+        ValenceScores[Valence] = ValenceBoostScale * std::pow(static_cast<float>(Valence), -ValenceBoostPower);
+    }
+
+    // Triangles referencing each vertex, as ranges inside AdjacentTriangles
+    std::vector<uint32_t> LiveTriangles(VertexCount, 0);
+    for (const uint32_t Index : Indices)
+    {
+        ++LiveTriangles[Index];
+    }
+
+    std::vector<uint32_t> AdjacencyOffsets(VertexCount + 1, 0);
+    for (size_t VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx)
+    {
+        AdjacencyOffsets[VertexIdx + 1] = AdjacencyOffsets[VertexIdx] + LiveTriangles[VertexIdx];
+    }
+
+    std::vector<uint32_t> AdjacentTriangles(Indices.size());
+    {
+        std::vector<uint32_t> Fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < Indices.size(); ++i)
+        {
+            AdjacentTriangles[Fill[Indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<uint32_t> CachePositions(VertexCount, ForsythCacheSize);
+    std::vector<float> VertexScores(VertexCount);
+    for (size_t VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx)
+    {
+        VertexScores[VertexIdx] = ValenceScores[std::min(LiveTriangles[VertexIdx], MaxValence)];
+    }
+
+    std::vector<bool> bEmitted(TriangleCount, false);
+    std::vector<uint32_t> Result{};
+    Result.reserve(Indices.size());
+
+    // The cache is temporarily allowed to grow by 3 vertices while a triangle is added
+    std::vector<uint32_t> Cache{};
+    std::vector<uint32_t> NextCache{};
+    Cache.reserve(ForsythCacheSize + 3);
+    NextCache.reserve(ForsythCacheSize + 3);
+
+    size_t BestTriangle = 0;
+    size_t Cursor = 0;
+
+    while (Result.size() < Indices.size())
+    {
+        if (BestTriangle == SIZE_MAX)
+        {
+            // No triangle touches the cache anymore, so we restart from the first one that has not been emitted
+            while (bEmitted[Cursor])
+            {
+                ++Cursor;
+            }
+            BestTriangle = Cursor;
+        }
+
+        const uint32_t* Triangle = &Indices[BestTriangle * 3];
+        Result.insert(Result.end(), Triangle, Triangle + 3);
+        bEmitted[BestTriangle] = true;
+
+        // Removes the triangle from the adjacency of its vertices
+        NextCache.clear();
+        for (int Corner = 0; Corner < 3; ++Corner)
+        {
+            const uint32_t VertexIdx = Triangle[Corner];
+            if (std::find(NextCache.begin(), NextCache.end(), VertexIdx) != NextCache.end())
+                continue;
+
+            NextCache.push_back(VertexIdx);
+
+            uint32_t* const Begin = &AdjacentTriangles[AdjacencyOffsets[VertexIdx]];
+            uint32_t* const End = std::remove(Begin, Begin + LiveTriangles[VertexIdx], static_cast<uint32_t>(BestTriangle));
+            LiveTriangles[VertexIdx] = static_cast<uint32_t>(End - Begin);
+        }
+
+        for (const uint32_t VertexIdx : Cache)
+        {
+            if (std::find(NextCache.begin(), NextCache.end(), VertexIdx) == NextCache.end())
+            {
+                NextCache.push_back(VertexIdx);
+            }
+        }
+
+        // Updates the scores of the vertices in the cache, including the ones that have just been evicted
+        for (uint32_t Position = 0; Position < NextCache.size(); ++Position)
+        {
+            const uint32_t VertexIdx = NextCache[Position];
+            CachePositions[VertexIdx] = std::min(Position, ForsythCacheSize);
+            VertexScores[VertexIdx] = LiveTriangles[VertexIdx] == 0
+                ? -1.f
+                : CachePositionScores[CachePositions[VertexIdx]] + ValenceScores[std::min(LiveTriangles[VertexIdx], MaxValence)];
+        }
+
+        // The next triangle is the best one among those referencing a cached vertex
+        BestTriangle = SIZE_MAX;
+        float BestScore = -1.f;
+        for (const uint32_t VertexIdx : NextCache)
+        {
+            const uint32_t* Adjacent = &AdjacentTriangles[AdjacencyOffsets[VertexIdx]];
+            for (uint32_t i = 0; i < LiveTriangles[VertexIdx]; ++i)
+            {
+                const uint32_t TriangleIdx = Adjacent[i];
+                const uint32_t* Other = &Indices[TriangleIdx * 3];
+
+                const float Score = VertexScores[Other[0]] + VertexScores[Other[1]] + VertexScores[Other[2]];
+
+                if (Score > BestScore)
+                {
+                    BestScore = Score;
+                    BestTriangle = TriangleIdx;
+                }
+            }
+        }
+
+        if (NextCache.size() > ForsythCacheSize)
+        {
+            NextCache.resize(ForsythCacheSize);
+        }
+        std::swap(Cache, NextCache);
+    }
+
+    Indices = std::move(Result);
+}
+
+#pragma endregion
+
+#pragma region Overdraw
+
+void LavaMeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& Indices, const std::vector<Vertex>& Vertices, float Threshold)
+{
+    const size_t TriangleCount = Indices.size() / 3;
+    if (TriangleCount == 0)
+        return;
+
+    // Hard boundaries are the triangles that miss the cache with all their vertices: the cache is
+    // "cold" there anyway, so starting a cluster costs nothing
+    std::vector<size_t> HardBoundaries{};
+    {
+        FifoCache Cache{Vertices.size(), ClusterCacheSize};
+        for (size_t TriangleIdx = 0; TriangleIdx < TriangleCount; ++TriangleIdx)
+        {
+            if (Cache.AccessTriangle(&Indices[TriangleIdx * 3]) == 3 || TriangleIdx == 0)
+            {
+                HardBoundaries.push_back(TriangleIdx);
+            }
+        }
+        HardBoundaries.push_back(TriangleCount);
+    }
+
+    // Soft boundaries split the hard clusters further, as long as the ACMR of the resulting
+    // clusters stays within Threshold times the ACMR of the whole hard cluster
+    std::vector<size_t> Clusters{};
+    {
+        FifoCache Cache{Vertices.size(), ClusterCacheSize};
+        for (size_t HardIdx = 0; HardIdx + 1 < HardBoundaries.size(); ++HardIdx)
+        {
+            const size_t Start = HardBoundaries[HardIdx];
+            const size_t End = HardBoundaries[HardIdx + 1];
+
+            Cache.Flush();
+            size_t ClusterMisses = 0;
+            for (size_t TriangleIdx = Start; TriangleIdx < End; ++TriangleIdx)
+            {
+                ClusterMisses += Cache.AccessTriangle(&Indices[TriangleIdx * 3]);
+            }
+
+            const float MaxACMR = Threshold * static_cast<float>(ClusterMisses) / static_cast<float>(End - Start);
+
+            Clusters.push_back(Start);
+
+            Cache.Flush();
+            size_t ClusterStart = Start;
+            size_t Misses = 0;
+            for (size_t TriangleIdx = Start; TriangleIdx + 1 < End; ++TriangleIdx)
+            {
+                Misses += Cache.AccessTriangle(&Indices[TriangleIdx * 3]);
+
+                if (static_cast<float>(Misses) / static_cast<float>(TriangleIdx + 1 - ClusterStart) <= MaxACMR)
+                {
+                    Clusters.push_back(TriangleIdx + 1);
+                    ClusterStart = TriangleIdx + 1;
+                    Misses = 0;
+                    Cache.Flush();
+                }
+            }
+        }
+        Clusters.push_back(TriangleCount);
+    }
+
+    glm::vec3 MeshCentroid{0.f};
+    for (const Vertex& V : Vertices)
+    {
+        MeshCentroid += V.position;
+    }
+    MeshCentroid /= static_cast<float>(std::max<size_t>(Vertices.size(), 1));
+
+    // Clusters facing away from the center of the mesh are on its outer shell, so they are drawn first
+    // as they are the most likely to occlude the rest
+    const size_t ClusterCount = Clusters.size() - 1;
+    std::vector<float> SortKeys(ClusterCount);
+    for (size_t ClusterIdx = 0; ClusterIdx < ClusterCount; ++ClusterIdx)
+    {
+        glm::vec3 Centroid{0.f};
+        glm::vec3 Normal{0.f};
+        float Area = 0.f;
+
+        for (size_t TriangleIdx = Clusters[ClusterIdx]; TriangleIdx < Clusters[ClusterIdx + 1]; ++TriangleIdx)
+        {
+            const glm::vec3& A = Vertices[Indices[TriangleIdx * 3]].position;
+            const glm::vec3& B = Vertices[Indices[TriangleIdx * 3 + 1]].position;
+            const glm::vec3& C = Vertices[Indices[TriangleIdx * 3 + 2]].position;
+
+            // The length of the cross product is twice the area of the triangle
+            const glm::vec3 Cross = glm::cross(B - A, C - A);
+            const float TriangleArea = glm::length(Cross);
+
+            Centroid += (A + B + C) * (TriangleArea / 3.f);
+            Normal += Cross;
+            Area += TriangleArea;
+        }
+
+        const float NormalLength = glm::length(Normal);
+        if (Area <= 0.f || NormalLength <= 0.f)
+        {
+            SortKeys[ClusterIdx] = 0.f;
+            continue;
+        }
+
+        SortKeys[ClusterIdx] = glm::dot(Centroid / Area - MeshCentroid, Normal / NormalLength);
+    }
+
+    std::vector<size_t> Order(ClusterCount);
+    for (size_t ClusterIdx = 0; ClusterIdx < ClusterCount; ++ClusterIdx)
+    {
+        Order[ClusterIdx] = ClusterIdx;
+    }
+
+    std::stable_sort(Order.begin(), Order.end(), [&SortKeys](const size_t A, const size_t B)
+    {
+        return SortKeys[A] > SortKeys[B];
+    });
+
+    std::vector<uint32_t> Result{};
+    Result.reserve(Indices.size());
+    for (const size_t ClusterIdx : Order)
+    {
+        Result.insert(Result.end(), Indices.begin() + Clusters[ClusterIdx] * 3, Indices.begin() + Clusters[ClusterIdx + 1] * 3);
+    }
+
+    Indices = std::move(Result);
+}
+
+#pragma endregion
+
+#pragma region Vertex Fetch
+
+void LavaMeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& Vertices, std::vector<uint32_t>& Indices)
+{
+    constexpr uint32_t Unassigned = UINT32_MAX;
+
+    std::vector<uint32_t> Remap(Vertices.size(), Unassigned);
+    std::vector<Vertex> Result{};
+    Result.reserve(Vertices.size());
+
+    for (uint32_t& Index : Indices)
+    {
+        if (Remap[Index] == Unassigned)
+        {
+            Remap[Index] = static_cast<uint32_t>(Result.size());
+            Result.push_back(Vertices[Index]);
+        }
+
+        Index = Remap[Index];
+    }
+
+    // Vertices never referenced by a triangle are dropped
+    Vertices = std::move(Result);
+}
+
+#pragma endregion
+
+}
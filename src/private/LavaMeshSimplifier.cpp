@@ -0,0 +1,355 @@
+//
+//  LavaMeshSimplifier.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaMeshSimplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lava
+{
+
+namespace
+{
+
+// Symmetric 4x4 matrix accumulating the squared distances from a set of planes, weighted by their area
+struct Quadric
+{
+    double A00 = 0, A01 = 0, A02 = 0, A03 = 0;
+    double A11 = 0, A12 = 0, A13 = 0;
+    double A22 = 0, A23 = 0;
+    double A33 = 0;
+    double Weight = 0;
+
+    static Quadric FromPlane(const glm::vec3& Normal, float Distance, float Weight)
+    {
+        const double A = Normal.x, B = Normal.y, C = Normal.z, D = Distance;
+
+        Quadric Result{};
+        Result.A00 = Weight * A * A; Result.A01 = Weight * A * B; Result.A02 = Weight * A * C; Result.A03 = Weight * A * D;
+        Result.A11 = Weight * B * B; Result.A12 = Weight * B * C; Result.A13 = Weight * B * D;
+        Result.A22 = Weight * C * C; Result.A23 = Weight * C * D;
+        Result.A33 = Weight * D * D;
+        Result.Weight = Weight;
+        return Result;
+    }
+
+    void Add(const Quadric& Other)
+    {
+        A00 += Other.A00; A01 += Other.A01; A02 += Other.A02; A03 += Other.A03;
+        A11 += Other.A11; A12 += Other.A12; A13 += Other.A13;
+        A22 += Other.A22; A23 += Other.A23;
+        A33 += Other.A33;
+        Weight += Other.Weight;
+    }
+
+    // Weighted average of the squared distances of Position from the planes
+    double Evaluate(const glm::vec3& Position) const
+    {
+        const double X = Position.x, Y = Position.y, Z = Position.z;
+
+        const double Result = A00 * X * X + 2 * A01 * X * Y + 2 * A02 * X * Z + 2 * A03 * X
+            + A11 * Y * Y + 2 * A12 * Y * Z + 2 * A13 * Y
+            + A22 * Z * Z + 2 * A23 * Z
+            + A33;
+
+        return Weight > 0 ? std::max(Result, 0.) / Weight : 0.;
+    }
+};
+
+struct Collapse
+{
+    uint32_t From;
+    uint32_t To;
+    float Error;
+};
+
+uint64_t MakeEdgeKey(uint32_t A, uint32_t B)
+{
+    return A < B ? (static_cast<uint64_t>(A) << 32) | B : (static_cast<uint64_t>(B) << 32) | A;
+}
+
+}
+
+std::vector<uint32_t> LavaMeshSimplifier::Simplify
+    ( const std::vector<uint32_t>& Indices
+    , const Vertex* Vertices
+    , size_t VertexCount
+    , size_t TargetIndexCount
+    , float TargetError
+    , float* OutError )
+{
+    std::vector<uint32_t> Result = Indices;
+    float MaxError = 0.f;
+
+    if (Result.size() <= TargetIndexCount)
+    {
+        if (OutError)
+            *OutError = MaxError;
+
+        return Result;
+    }
+
+    // Vertices sharing the same position are represented by the first of them. Quadrics and topology
+    // are computed on these representatives, so that attribute seams do not look like borders
+    std::vector<uint32_t> PositionRemap(VertexCount);
+    std::vector<bool> bLocked(VertexCount, false);
+    {
+        std::vector<uint32_t> Order(VertexCount);
+        for (uint32_t VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx)
+        {
+            Order[VertexIdx] = VertexIdx;
+        }
+
+        const auto LessPosition = [Vertices](const uint32_t A, const uint32_t B)
+        {
+            const glm::vec3& PosA = Vertices[A].position;
+            const glm::vec3& PosB = Vertices[B].position;
+            if (PosA.x != PosB.x) return PosA.x < PosB.x;
+            if (PosA.y != PosB.y) return PosA.y < PosB.y;
+            if (PosA.z != PosB.z) return PosA.z < PosB.z;
+            return A < B;
+        };
+
+        std::sort(Order.begin(), Order.end(), LessPosition);
+
+        for (size_t Begin = 0; Begin < Order.size(); )
+        {
+            size_t End = Begin + 1;
+            while (End < Order.size() && Vertices[Order[End]].position == Vertices[Order[Begin]].position)
+            {
+                ++End;
+            }
+
+            for (size_t i = Begin; i < End; ++i)
+            {
+                PositionRemap[Order[i]] = Order[Begin];
+
+                // Moving a seam vertex would tear the surface apart, as its twins would stay in place
+                bLocked[Order[i]] = End - Begin > 1;
+            }
+
+            Begin = End;
+        }
+    }
+
+    // Edges used by a single triangle are on an open border
+    {
+        std::vector<uint64_t> Edges{};
+        Edges.reserve(Result.size());
+        for (size_t i = 0; i + 2 < Result.size(); i += 3)
+        {
+            for (int Corner = 0; Corner < 3; ++Corner)
+            {
+                const uint32_t A = PositionRemap[Result[i + Corner]];
+                const uint32_t B = PositionRemap[Result[i + (Corner + 1) % 3]];
+                if (A != B)
+                {
+                    Edges.push_back(MakeEdgeKey(A, B));
+                }
+            }
+        }
+
+        std::sort(Edges.begin(), Edges.end());
+
+        std::vector<bool> bBorderPosition(VertexCount, false);
+        for (size_t Begin = 0; Begin < Edges.size(); )
+        {
+            size_t End = Begin + 1;
+            while (End < Edges.size() && Edges[End] == Edges[Begin])
+            {
+                ++End;
+            }
+
+            if (End - Begin == 1)
+            {
+                bBorderPosition[static_cast<uint32_t>(Edges[Begin] >> 32)] = true;
+                bBorderPosition[static_cast<uint32_t>(Edges[Begin] & 0xFFFFFFFF)] = true;
+            }
+
+            Begin = End;
+        }
+
+        for (uint32_t VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx)
+        {
+            if (bBorderPosition[PositionRemap[VertexIdx]])
+            {
+                bLocked[VertexIdx] = true;
+            }
+        }
+    }
+
+    std::vector<Quadric> Quadrics(VertexCount);
+    for (size_t i = 0; i + 2 < Result.size(); i += 3)
+    {
+        const glm::vec3& A = Vertices[Result[i]].position;
+        const glm::vec3& B = Vertices[Result[i + 1]].position;
+        const glm::vec3& C = Vertices[Result[i + 2]].position;
+
+        const glm::vec3 Cross = glm::cross(B - A, C - A);
+        const float DoubleArea = glm::length(Cross);
+        if (DoubleArea <= 0.f)
+            continue;
+
+        const glm::vec3 Normal = Cross / DoubleArea;
+        const Quadric Plane = Quadric::FromPlane(Normal, -glm::dot(Normal, A), DoubleArea * .5f);
+        for (int Corner = 0; Corner < 3; ++Corner)
+        {
+            Quadrics[PositionRemap[Result[i + Corner]]].Add(Plane);
+        }
+    }
+
+    std::vector<uint32_t> Remap(VertexCount);
+    std::vector<bool> bTouched(VertexCount);
+    std::vector<uint32_t> AdjacencyOffsets(VertexCount + 1);
+    std::vector<uint32_t> AdjacentTriangles{};
+    std::vector<Collapse> Collapses{};
+
+    while (Result.size() > TargetIndexCount)
+    {
+        const size_t TriangleCount = Result.size() / 3;
+
+        // Triangles referencing each vertex, used to check collapses for flipped triangles
+        std::fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end(), 0);
+        for (const uint32_t Index : Result)
+        {
+            ++AdjacencyOffsets[Index + 1];
+        }
+        for (size_t VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx)
+        {
+            AdjacencyOffsets[VertexIdx + 1] += AdjacencyOffsets[VertexIdx];
+        }
+
+        AdjacentTriangles.resize(Result.size());
+        {
+            std::vector<uint32_t> Fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < Result.size(); ++i)
+            {
+                AdjacentTriangles[Fill[Result[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // Every directed edge is a collapse candidate, as long as its source can move
+        Collapses.clear();
+        for (size_t i = 0; i < Result.size(); i += 3)
+        {
+            for (int Corner = 0; Corner < 3; ++Corner)
+            {
+                const uint32_t A = Result[i + Corner];
+                const uint32_t B = Result[i + (Corner + 1) % 3];
+                if (A == B)
+                    continue;
+
+                Quadric Merged = Quadrics[PositionRemap[A]];
+                Merged.Add(Quadrics[PositionRemap[B]]);
+
+                if (!bLocked[A])
+                {
+                    Collapses.push_back({A, B, static_cast<float>(std::sqrt(Merged.Evaluate(Vertices[B].position)))});
+                }
+
+                if (!bLocked[B])
+                {
+                    Collapses.push_back({B, A, static_cast<float>(std::sqrt(Merged.Evaluate(Vertices[A].position)))});
+                }
+            }
+        }
+
+        std::sort(Collapses.begin(), Collapses.end(), [](const Collapse& Left, const Collapse& Right)
+        {
+            return Left.Error < Right.Error;
+        });
+
+        for (uint32_t VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx)
+        {
+            Remap[VertexIdx] = VertexIdx;
+        }
+        std::fill(bTouched.begin(), bTouched.end(), false);
+
+        // Collapses in the same pass must not share any triangle, so that the flip test stays valid
+        size_t RemainingTriangles = TriangleCount;
+        size_t CollapseCount = 0;
+        for (const Collapse& Candidate : Collapses)
+        {
+            if (Candidate.Error > TargetError || RemainingTriangles * 3 <= TargetIndexCount)
+                break;
+
+            if (bTouched[Candidate.From] || bTouched[Candidate.To])
+                continue;
+
+            const uint32_t* Begin = &AdjacentTriangles[AdjacencyOffsets[Candidate.From]];
+            const uint32_t* End = &AdjacentTriangles[AdjacencyOffsets[Candidate.From + 1]];
+
+            bool bFlips = false;
+            size_t RemovedTriangles = 0;
+            for (const uint32_t* TriangleIdx = Begin; TriangleIdx != End && !bFlips; ++TriangleIdx)
+            {
+                const uint32_t* Triangle = &Result[*TriangleIdx * 3];
+                if (Triangle[0] == Candidate.To || Triangle[1] == Candidate.To || Triangle[2] == Candidate.To)
+                {
+                    ++RemovedTriangles;
+                    continue;
+                }
+
+                glm::vec3 Before[3];
+                glm::vec3 After[3];
+                for (int Corner = 0; Corner < 3; ++Corner)
+                {
+                    Before[Corner] = Vertices[Triangle[Corner]].position;
+                    After[Corner] = Vertices[Triangle[Corner] == Candidate.From ? Candidate.To : Triangle[Corner]].position;
+                }
+
+                const glm::vec3 NormalBefore = glm::cross(Before[1] - Before[0], Before[2] - Before[0]);
+                const glm::vec3 NormalAfter = glm::cross(After[1] - After[0], After[2] - After[0]);
+                bFlips = glm::dot(NormalBefore, NormalAfter) <= 0.f;
+            }
+
+            if (bFlips)
+                continue;
+
+            for (const uint32_t* TriangleIdx = Begin; TriangleIdx != End; ++TriangleIdx)
+            {
+                const uint32_t* Triangle = &Result[*TriangleIdx * 3];
+                bTouched[Triangle[0]] = bTouched[Triangle[1]] = bTouched[Triangle[2]] = true;
+            }
+
+            Remap[Candidate.From] = Candidate.To;
+            Quadrics[PositionRemap[Candidate.To]].Add(Quadrics[PositionRemap[Candidate.From]]);
+
+            MaxError = std::max(MaxError, Candidate.Error);
+            RemainingTriangles -= RemovedTriangles;
+            ++CollapseCount;
+        }
+
+        if (CollapseCount == 0)
+            break;
+
+        // Applies the collapses and drops the triangles that became degenerate
+        size_t WriteIdx = 0;
+        for (size_t i = 0; i < Result.size(); i += 3)
+        {
+            const uint32_t A = Remap[Result[i]];
+            const uint32_t B = Remap[Result[i + 1]];
+            const uint32_t C = Remap[Result[i + 2]];
+            if (A == B || B == C || C == A)
+                continue;
+
+            Result[WriteIdx++] = A;
+            Result[WriteIdx++] = B;
+            Result[WriteIdx++] = C;
+        }
+        Result.resize(WriteIdx);
+    }
+
+    if (OutError)
+        *OutError = MaxError;
+
+    return Result;
+}
+
+}
@@ -8,270 +8,568 @@
 #include "LavaModel.hpp"
 
 #include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <vector>
-#include <unordered_map>
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "TinyObjLoader.h"
 
+#include "LavaMeshCache.hpp"
+#include "LavaMeshOptimizer.hpp"
+#include "LavaGltfParser.hpp"
 #include "LavaUtils.hpp"
+#include "LavaUploadBatch.hpp"
 
-// Enable has functionality for glm::vec3
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+namespace lava
+{
 
-namespace std
+namespace
 {
-    template<>
-    struct hash<lava::Vertex>
-    {
-        // Used to insert Vertex elements inside a map
-        size_t operator()(const lava::Vertex& Vertex) const
-        {
-            size_t Seed = 0;
-            lava::HashCombine(Seed, Vertex.position, Vertex.color, Vertex.normal, Vertex.uv);
-            return Seed;
-        }
-    };
+
+// True when Settings enable no step that changes the vertices or the triangles, apart from the normal generation
+bool KeepsSourceData(const MeshOptimizationSettings& Settings)
+{
+    return !Settings.bWeldVertices
+        && !Settings.bOptimizeVertexCache
+        && !Settings.bOptimizeOverdraw
+        && !Settings.bOptimizeVertexFetch
+        && !Settings.bSplitForShortIndices
+        && !Settings.bBuildMeshlets
+        && Settings.LodCount <= 1
+        && Settings.Format == VertexFormat::Full;
 }
 
-namespace lava
+// True when cooking the file with Settings would only copy the primitives of the default scene one after the other
+bool CanUploadDirectly(const GltfData& Gltf, const MeshOptimizationSettings& Settings)
 {
+    if (!KeepsSourceData(Settings) || Gltf.Instances.empty() || !Gltf.HasIdentityTransforms())
+        return false;
 
-#pragma region Types
+    // Positions are read in place to compute the bounds
+    return std::all_of(Gltf.Primitives.begin(), Gltf.Primitives.end(), [&Settings](const GltfPrimitive& Primitive)
+    {
+        return Primitive.Positions.IsFloat(3) && (!Settings.bGenerateNormals || Primitive.Normals.IsValid());
+    });
+}
 
-std::vector<VkVertexInputBindingDescription> Vertex::GetBindingDesc()
+// True when the attributes of the primitive are interleaved exactly like Vertex
+bool HasVertexLayout(const GltfPrimitive& Primitive)
 {
-    // Binding description for a single vertex buffer
-    std::vector<VkVertexInputBindingDescription> BindingDescs(1);
-    BindingDescs[0].binding = 0;
-    BindingDescs[0].stride = sizeof(Vertex);
-    BindingDescs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    
-    return BindingDescs;
+    const char* Base = Primitive.Positions.Data;
+    const auto IsMember = [Base](const GltfAccessor& Attribute, size_t Offset, uint32_t Components)
+    {
+        return Attribute.IsFloat(Components) && Attribute.Stride == sizeof(Vertex) && Attribute.Data == Base + Offset;
+    };
+
+    return IsMember(Primitive.Positions, offsetof(Vertex, position), 3)
+        && IsMember(Primitive.Colors, offsetof(Vertex, color), 3)
+        && IsMember(Primitive.Normals, offsetof(Vertex, normal), 3)
+        && IsMember(Primitive.TexCoords, offsetof(Vertex, uv), 2);
 }
 
-std::vector<VkVertexInputAttributeDescription> Vertex::GetAttributeDescs()
+// Copies the first Components floats of an element, converting only the attributes that are not stored as floats
+void ReadAttribute(const GltfAccessor& Attribute, uint32_t Idx, float* Out, uint32_t Components)
 {
-    std::vector<VkVertexInputAttributeDescription> AttributeDescs{};
-    AttributeDescs.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
-    AttributeDescs.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
-    AttributeDescs.push_back({2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
-    AttributeDescs.push_back({3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)}); //uv are 2D
-    
-    return AttributeDescs;
+    if (Attribute.ComponentType == GltfComponentType::Float && Attribute.ComponentCount >= Components)
+    {
+        std::memcpy(Out, Attribute.Data + static_cast<size_t>(Idx) * Attribute.Stride, Components * sizeof(float));
+        return;
+    }
+
+    const glm::vec4 Value = Attribute.ReadFloat(Idx);
+    std::memcpy(Out, &Value.x, Components * sizeof(float));
+}
+
 }
 
-void Builder::LoadModel(const std::string& Filename)
+LavaModel::LavaModel(LavaDevice& InDevice, const Builder& Builder, std::vector<BufferUpload>* DeferredUploads)
+    : Device(InDevice)
+    , Bounds{Builder.BoundsMin, Builder.BoundsMax}
+    , Sphere(Builder.Sphere)
+    , Format(Builder.Format)
 {
-    tinyobj::attrib_t Attrib;
-    std::vector<tinyobj::shape_t> Shapes;
-    std::vector<tinyobj::material_t> Materials;
-    std::string Warning;
-    std::string Error;
+    if (Format == VertexFormat::Compact)
+    {
+        DequantizationMatrix = CompactVertex::GetDequantizationMatrix(Bounds.Min, Bounds.Max);
+    }
 
-    if (!tinyobj::LoadObj(&Attrib, &Shapes, &Materials, &Warning, &Error, Filename.c_str()))
+    // The builder writes its final data straight into the mapped staging memory. The destructor does not run when a
+    // constructor throws, so the ranges taken from the geometry pool are given back here
+    try
     {
-        throw std::runtime_error(Warning + Error);
+        Builder.WriteTo(*this);
+        SubmitUploads(DeferredUploads);
+    }
+    catch (...)
+    {
+        ReleaseGeometry();
+        throw;
     }
 
-    // Object loading succeded
-    Vertices.clear();
-    Indices.clear();
+    SubMeshes = Builder.SubMeshes;
+    Meshlets = Builder.Meshlets;
+    Lods = Builder.Lods;
+    Materials = Builder.Materials;
+    ContentHash = Builder.ContentHash != 0 ? Builder.ContentHash : LavaMeshCache::ComputeContentHash(Builder);
+    InitializeRanges();
+}
 
-    std::unordered_map<Vertex, uint32_t> UniqueVertices;
+LavaModel::LavaModel(LavaDevice& InDevice, const LavaMeshCache& CookedMesh, std::vector<BufferUpload>* DeferredUploads)
+    : Device(InDevice)
+    , Bounds{CookedMesh.GetBoundsMin(), CookedMesh.GetBoundsMax()}
+    , Sphere(CookedMesh.GetBoundingSphere())
+    , Format(CookedMesh.GetVertexFormat())
+{
+    if (Format == VertexFormat::Compact)
+    {
+        DequantizationMatrix = CompactVertex::GetDequantizationMatrix(Bounds.Min, Bounds.Max);
+    }
 
-    for (const auto& Shape : Shapes)
+    // Cooked data is read in place from the mapped file, and copied (or decoded) once into the mapped staging memory
+    try
     {
-        for (const auto& Index : Shape.mesh.indices)
+        if (!CookedMesh.ReadVertices(AcquireVertices(CookedMesh.GetVertexStride(), CookedMesh.GetVertexCount())))
+            throw std::runtime_error("Failed to decode the cooked vertices");
+
+        if (CookedMesh.GetIndexCount() > 0 && !CookedMesh.ReadIndices(AcquireIndices(CookedMesh.GetIndexType(), CookedMesh.GetIndexCount())))
+            throw std::runtime_error("Failed to decode the cooked indices");
+
+        SubmitUploads(DeferredUploads);
+    }
+    catch (...)
+    {
+        ReleaseGeometry();
+        throw;
+    }
+
+    SubMeshes.assign(CookedMesh.GetSubMeshes(), CookedMesh.GetSubMeshes() + CookedMesh.GetSubMeshCount());
+    Meshlets.assign(CookedMesh.GetMeshlets(), CookedMesh.GetMeshlets() + CookedMesh.GetMeshletCount());
+    Lods.assign(CookedMesh.GetLods(), CookedMesh.GetLods() + CookedMesh.GetLodCount());
+    Materials.assign(CookedMesh.GetMaterials(), CookedMesh.GetMaterials() + CookedMesh.GetMaterialCount());
+    ContentHash = CookedMesh.GetContentHash();
+    InitializeRanges();
+}
+
+LavaModel::LavaModel(LavaDevice& InDevice, const GltfData& Gltf, std::vector<BufferUpload>* DeferredUploads)
+    : Device(InDevice)
+{
+    // Each primitive keeps its own vertices and its indices are drawn with its vertex offset, so they never need
+    // to be rebased. 16 bit indices are used when every primitive fits in them
+    uint32_t TotalVertices = 0;
+    uint32_t TotalIndices = 0;
+    bool bShortIndices = true;
+    bool bDefaultMaterial = false;
+    for (const GltfMeshInstance& Instance : Gltf.Instances)
+    {
+        for (uint32_t PrimitiveIdx = Instance.FirstPrimitive; PrimitiveIdx < Instance.FirstPrimitive + Instance.PrimitiveCount; ++PrimitiveIdx)
         {
-            Vertex V{};
-            
-            // Suppose wa have faces defined as vertexIdx/normalIdx/uvIdx
+            const GltfPrimitive& Primitive = Gltf.Primitives[PrimitiveIdx];
+            const uint32_t CornerCount = Primitive.Indices.IsValid() ? Primitive.Indices.Count : Primitive.Positions.Count;
 
-            if (Index.vertex_index >= 0)
-            {
-                // Suppose each vertex is a vec3, then each component is in following positions
-                // with offset 0, 1 and 2 starting from the vertex index
-                const size_t startingIdx = 3 * Index.vertex_index;
-                V.position =
-                {
-                    Attrib.vertices[startingIdx],
-                    Attrib.vertices[startingIdx + 1], 
-                    Attrib.vertices[startingIdx + 2]
-                };        
+            // Primitives without a material use the default one, placed after the ones of the file
+            const uint32_t MaterialIdx = Primitive.Material >= 0 ? static_cast<uint32_t>(Primitive.Material) : static_cast<uint32_t>(Gltf.Materials.size());
 
-                // Supposed the provided file owns colors after vertices positions
-                V.color =
-                {
-                    Attrib.colors[startingIdx],
-                    Attrib.colors[startingIdx + 1], 
-                    Attrib.colors[startingIdx + 2]
-                }; 
-            }
+            SubMeshes.push_back({TotalIndices, CornerCount / 3 * 3, static_cast<int32_t>(TotalVertices), MaterialIdx});
+            TotalVertices += Primitive.Positions.Count;
+            TotalIndices += CornerCount / 3 * 3;
+            bShortIndices = bShortIndices && Primitive.Positions.Count <= Builder::MaxShortIndexVertices;
+            bDefaultMaterial = bDefaultMaterial || Primitive.Material < 0;
+        }
+    }
 
-            if (Index.normal_index >= 0)
-            {
-                const size_t startingIdx = 3 * Index.normal_index;
-                V.normal =
-                {
-                    Attrib.normals[startingIdx],
-                    Attrib.normals[startingIdx + 1], 
-                    Attrib.normals[startingIdx + 2]
-                };                
-            }
+    Materials = Gltf.Materials;
+    if (bDefaultMaterial && !Materials.empty())
+    {
+        Materials.push_back(Material{});
+    }
 
-            if (Index.texcoord_index >= 0)
+    try
+    {
+        char* VertexData = static_cast<char*>(AcquireVertices(sizeof(Vertex), TotalVertices));
+        char* IndexData = static_cast<char*>(AcquireIndices(bShortIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32, TotalIndices));
+        const GltfComponentType SourceIndexType = bShortIndices ? GltfComponentType::UnsignedShort : GltfComponentType::UnsignedInt;
+        const size_t IndexSize = bShortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+        uint32_t SubMeshIdx = 0;
+        for (const GltfMeshInstance& Instance : Gltf.Instances)
+        {
+            for (uint32_t PrimitiveIdx = Instance.FirstPrimitive; PrimitiveIdx < Instance.FirstPrimitive + Instance.PrimitiveCount; ++PrimitiveIdx)
             {
-                const size_t startingIdx = 2 * Index.texcoord_index;
-                V.uv =
+                const GltfPrimitive& Primitive = Gltf.Primitives[PrimitiveIdx];
+                const SubMesh& Mesh = SubMeshes[SubMeshIdx++];
+                const uint32_t Count = Primitive.Positions.Count;
+                char* Destination = VertexData + static_cast<size_t>(Mesh.VertexOffset) * sizeof(Vertex);
+
+                if (HasVertexLayout(Primitive))
+                {
+                    // The buffer view is already the vertex buffer of the primitive
+                    std::memcpy(Destination, Primitive.Positions.Data, static_cast<size_t>(Count) * sizeof(Vertex));
+                }
+                else
+                {
+                    // Vertices are assembled in a local copy, so that the mapped memory is only written sequentially
+                    for (uint32_t Idx = 0; Idx < Count; ++Idx)
+                    {
+                        Vertex V{};
+                        V.color = glm::vec3{1.f};
+                        ReadAttribute(Primitive.Positions, Idx, &V.position.x, 3);
+                        if (Primitive.Colors.IsValid())    ReadAttribute(Primitive.Colors, Idx, &V.color.x, 3);
+                        if (Primitive.Normals.IsValid())   ReadAttribute(Primitive.Normals, Idx, &V.normal.x, 3);
+                        if (Primitive.TexCoords.IsValid()) ReadAttribute(Primitive.TexCoords, Idx, &V.uv.x, 2);
+                        std::memcpy(Destination + static_cast<size_t>(Idx) * sizeof(Vertex), &V, sizeof(Vertex));
+                    }
+                }
+
+                char* IndexDestination = IndexData + static_cast<size_t>(Mesh.FirstIndex) * IndexSize;
+                const GltfAccessor& Indices = Primitive.Indices;
+                if (Indices.IsValid() && Indices.ComponentType == SourceIndexType && Indices.Stride == IndexSize)
                 {
-                    Attrib.texcoords[startingIdx],
-                    Attrib.texcoords[startingIdx + 1]
-                };    
+                    std::memcpy(IndexDestination, Indices.Data, Mesh.IndexCount * IndexSize);
+                }
+                else
+                {
+                    for (uint32_t Corner = 0; Corner < Mesh.IndexCount; ++Corner)
+                    {
+                        const uint32_t Index = Indices.IsValid() ? Indices.ReadIndex(Corner) : Corner;
+                        if (bShortIndices)
+                        {
+                            const uint16_t ShortIndex = static_cast<uint16_t>(Index);
+                            std::memcpy(IndexDestination + Corner * sizeof(uint16_t), &ShortIndex, sizeof(ShortIndex));
+                        }
+                        else
+                        {
+                            std::memcpy(IndexDestination + Corner * sizeof(uint32_t), &Index, sizeof(Index));
+                        }
+                    }
+                }
             }
+        }
 
-            if (UniqueVertices.count(V) == 0)
-            {
-                // If the Vertex V is not contained inside the map. We keep track of its position inside the Vertices vector
-                // by keeping track of how many vertices there currently are inside the vector
-                UniqueVertices[V] = static_cast<uint32_t>(Vertices.size());
-                Vertices.push_back(V);
-            }
+        SubmitUploads(DeferredUploads);
+    }
+    catch (...)
+    {
+        ReleaseGeometry();
+        throw;
+    }
 
-            // The index of the vertex is its position inside the Vertices array, stored in the UniqueVertices map
-            Indices.push_back(UniqueVertices[V]);
+    // The bounds of the positions are stored in the file, only the sphere has to go through them
+    Bounds = {Gltf.Primitives[Gltf.Instances[0].FirstPrimitive].BoundsMin, Gltf.Primitives[Gltf.Instances[0].FirstPrimitive].BoundsMax};
+    for (const GltfMeshInstance& Instance : Gltf.Instances)
+    {
+        for (uint32_t PrimitiveIdx = Instance.FirstPrimitive; PrimitiveIdx < Instance.FirstPrimitive + Instance.PrimitiveCount; ++PrimitiveIdx)
+        {
+            Bounds.Min = glm::min(Bounds.Min, Gltf.Primitives[PrimitiveIdx].BoundsMin);
+            Bounds.Max = glm::max(Bounds.Max, Gltf.Primitives[PrimitiveIdx].BoundsMax);
+        }
+    }
+
+    Sphere = {Bounds.GetCenter(), 0.f};
+    for (const GltfMeshInstance& Instance : Gltf.Instances)
+    {
+        for (uint32_t PrimitiveIdx = Instance.FirstPrimitive; PrimitiveIdx < Instance.FirstPrimitive + Instance.PrimitiveCount; ++PrimitiveIdx)
+        {
+            const GltfAccessor& Positions = Gltf.Primitives[PrimitiveIdx].Positions;
+            const BoundingSphere PrimitiveSphere = LavaBounds::ComputeSphere(reinterpret_cast<const float*>(Positions.Data), Positions.Count, Positions.Stride, Bounds);
+            Sphere.Radius = std::max(Sphere.Radius, PrimitiveSphere.Radius);
         }
     }
+
+    ContentHash = HashBytes(Gltf.File.GetData(), Gltf.File.GetSize());
+    InitializeRanges();
 }
 
-#pragma endregion
+LavaModel::~LavaModel()
+{
+    ReleaseGeometry();
+}
 
-LavaModel::LavaModel(LavaDevice& InDevice, const Builder& Builder)
-    : Device(InDevice)
-    , bHasIndexBuffer(false)
+void LavaModel::ReleaseGeometry()
 {
-    CreateVertexBuffers(Builder.Vertices);
-    CreateIndexBuffers(Builder.Indices);
+    Device.geometryPool().Free(VertexAllocation);
+    Device.geometryPool().Free(IndexAllocation);
 }
 
-LavaModel::~LavaModel() {}
+void LavaModel::InitializeRanges()
+{
+    if (SubMeshes.empty())
+    {
+        SubMeshes.push_back({0, IndexCount, 0});
+    }
+    if (Lods.empty())
+    {
+        Lods.push_back({0, static_cast<uint32_t>(SubMeshes.size()), 0.f});
+    }
+    if (Materials.empty())
+    {
+        Materials.push_back(Material{});
+    }
+
+    if (Meshlets.empty())
+        return;
+
+    // Meshlets are built sub mesh by sub mesh, in the same order, so each sub mesh owns a contiguous run of them
+    uint32_t MeshletIdx = 0;
+    for (uint32_t SubMeshIdx = Lods[0].FirstSubMesh; SubMeshIdx < Lods[0].FirstSubMesh + Lods[0].SubMeshCount; ++SubMeshIdx)
+    {
+        const SubMesh& Mesh = SubMeshes[SubMeshIdx];
+        while (MeshletIdx < Meshlets.size() && Meshlets[MeshletIdx].FirstIndex < Mesh.FirstIndex)
+        {
+            ++MeshletIdx;
+        }
+
+        const uint32_t First = MeshletIdx;
+        while (MeshletIdx < Meshlets.size() && Meshlets[MeshletIdx].FirstIndex < Mesh.FirstIndex + Mesh.IndexCount)
+        {
+            ++MeshletIdx;
+        }
+
+        SubMeshMeshlets.push_back({First, MeshletIdx});
+    }
+}
 
 std::unique_ptr<LavaModel> LavaModel::CreateModelFromFile(LavaDevice& Device, const std::string& Filepath)
 {
+    return CreateModelFromFile(Device, Filepath, MeshOptimizationSettings{});
+}
+
+std::unique_ptr<LavaModel> LavaModel::CreateModelFromFile
+    ( LavaDevice& Device
+    , const std::string& Filepath
+    , const MeshOptimizationSettings& Settings
+    , std::vector<BufferUpload>* DeferredUploads
+    , LavaMappedFile CookedFile )
+{
+    const auto StartTime = std::chrono::high_resolution_clock::now();
+    const auto GetElapsedMs = [&StartTime]()
+    {
+        return std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - StartTime).count();
+    };
+
+    // Nothing to cook, the primitives are uploaded from the buffer views of the file
+    if (LavaGltfParser::IsGltfFile(Filepath) && KeepsSourceData(Settings))
+    {
+        const GltfData Gltf = LavaGltfParser::ParseFile(Filepath);
+        if (CanUploadDirectly(Gltf, Settings))
+        {
+            auto Model = std::make_unique<LavaModel>(Device, Gltf, DeferredUploads);
+
+            std::cout << "Vertex count: " << Model->VertexCount << std::endl;
+            std::cout << "Load time: " << GetElapsedMs() << " ms (glTF)" << std::endl;
+
+            return Model;
+        }
+    }
+
+    LavaMeshCache CookedMesh{};
+    if (CookedMesh.Open(Filepath, Settings.GetHash(), std::move(CookedFile)))
+    {
+        std::cout << "Vertex count: " << CookedMesh.GetVertexCount() << std::endl;
+        std::cout << "Load time: " << GetElapsedMs() << " ms (cooked)" << std::endl;
+
+        return std::make_unique<LavaModel>(Device, CookedMesh, DeferredUploads);
+    }
+
     Builder ModelBuilder{};
-    ModelBuilder.LoadModel(Filepath);
+    ModelBuilder.CookFile(Filepath, Settings);
 
     std::cout << "Vertex count: " << ModelBuilder.Vertices.size() << std::endl;
+    std::cout << "Load time: " << GetElapsedMs() << " ms" << std::endl;
 
-    return std::make_unique<LavaModel>(Device, ModelBuilder);
+    return std::make_unique<LavaModel>(Device, ModelBuilder, DeferredUploads);
 }
 
 void LavaModel::Bind(const VkCommandBuffer& CommandBuffer)
 {
-    VkBuffer Buffers[] = {VertexBuffer->getBuffer()};
+    // Whole pool buffers, the draws reach the model through their vertex offset and first index
+    VkBuffer Buffers[] = {VertexAllocation.GetBuffer()};
     VkDeviceSize Offsets[] = {0};
     vkCmdBindVertexBuffers(CommandBuffer, 0, 1, Buffers, Offsets);
     
     if (bHasIndexBuffer)
     {
-        // 32bit index type for huge storing
-        vkCmdBindIndexBuffer(CommandBuffer, IndexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        // 16 bit indices whenever the model has few enough vertices (or has been split into sub meshes)
+        vkCmdBindIndexBuffer(CommandBuffer, IndexAllocation.GetBuffer(), 0, IndexType);
+    }
+}
+
+LavaGeometryBinding LavaModel::GetBinding() const
+{
+    LavaGeometryBinding Binding{};
+    Binding.VertexBuffer = VertexAllocation.GetBuffer();
+    if (bHasIndexBuffer)
+    {
+        Binding.IndexBuffer = IndexAllocation.GetBuffer();
+        Binding.IndexType = IndexType;
     }
+
+    return Binding;
 }
 
-void LavaModel::Draw(const VkCommandBuffer& CommandBuffer)
+void LavaModel::Draw(const VkCommandBuffer& CommandBuffer, const uint32_t Lod)
 {
     if (bHasIndexBuffer)
     {
-        // Index drawing
-        vkCmdDrawIndexed(CommandBuffer, IndexCount, 1, 0, 0, 0);
+        const LodLevel& Level = Lods[std::min(Lod, GetLodCount() - 1)];
+
+        // Index drawing, the vertex offset makes the indices of each sub mesh relative to its own vertices
+        for (uint32_t SubMeshIdx = Level.FirstSubMesh; SubMeshIdx < Level.FirstSubMesh + Level.SubMeshCount; ++SubMeshIdx)
+        {
+            const SubMesh& Mesh = SubMeshes[SubMeshIdx];
+            vkCmdDrawIndexed(CommandBuffer, Mesh.IndexCount, 1, IndexAllocation.GetFirst() + Mesh.FirstIndex, GetVertexBase() + Mesh.VertexOffset, 0);
+        }
     }
     else
     {
         // Vertex drawing
-        vkCmdDraw(CommandBuffer, VertexCount, 1, 0, 0);
+        vkCmdDraw(CommandBuffer, VertexCount, 1, VertexAllocation.GetFirst(), 0);
     }
 }
 
-void LavaModel::ClearBufferAndMemory(VkBuffer& Buffer, VkDeviceMemory& Memory)
+void LavaModel::DrawSubMesh(const VkCommandBuffer& CommandBuffer, const uint32_t SubMeshIdx)
 {
-    vkDestroyBuffer(Device.device(), Buffer, nullptr);
-    vkFreeMemory(Device.device(), Memory, nullptr);
+    if (bHasIndexBuffer)
+    {
+        const SubMesh& Mesh = SubMeshes[SubMeshIdx];
+        vkCmdDrawIndexed(CommandBuffer, Mesh.IndexCount, 1, IndexAllocation.GetFirst() + Mesh.FirstIndex, GetVertexBase() + Mesh.VertexOffset, 0);
+    }
+    else
+    {
+        vkCmdDraw(CommandBuffer, VertexCount, 1, VertexAllocation.GetFirst(), 0);
+    }
+}
+
+void LavaModel::DrawMeshlets(const VkCommandBuffer& CommandBuffer, const std::function<bool(const Meshlet&)>& IsVisible)
+{
+    if (!bHasIndexBuffer || Meshlets.empty())
+    {
+        Draw(CommandBuffer);
+        return;
+    }
+
+    DrawMeshletRange(CommandBuffer, 0, static_cast<uint32_t>(Meshlets.size()), IsVisible);
+}
+
+void LavaModel::DrawMeshlets(const VkCommandBuffer& CommandBuffer, const uint32_t SubMeshIdx, const std::function<bool(const Meshlet&)>& IsVisible)
+{
+    const uint32_t LevelIdx = SubMeshIdx - Lods[0].FirstSubMesh;
+    if (!bHasIndexBuffer || LevelIdx >= SubMeshMeshlets.size())
+    {
+        DrawSubMesh(CommandBuffer, SubMeshIdx);
+        return;
+    }
+
+    DrawMeshletRange(CommandBuffer, SubMeshMeshlets[LevelIdx].first, SubMeshMeshlets[LevelIdx].second, IsVisible);
+}
+
+void LavaModel::DrawMeshletRange(const VkCommandBuffer& CommandBuffer, const uint32_t First, const uint32_t Last, const std::function<bool(const Meshlet&)>& IsVisible)
+{
+    const uint32_t IndexBase = IndexAllocation.GetFirst();
+    const int32_t VertexBase = GetVertexBase();
+
+    // Visible meshlets that follow each other in the index buffer are drawn together
+    uint32_t RunFirstIndex = 0;
+    uint32_t RunIndexCount = 0;
+    int32_t RunVertexOffset = 0;
+
+    for (uint32_t MeshletIdx = First; MeshletIdx < Last; ++MeshletIdx)
+    {
+        const Meshlet& Cluster = Meshlets[MeshletIdx];
+        if (!IsVisible(Cluster))
+            continue;
+
+        if (RunIndexCount > 0 && Cluster.FirstIndex == RunFirstIndex + RunIndexCount && Cluster.VertexOffset == RunVertexOffset)
+        {
+            RunIndexCount += Cluster.IndexCount;
+            continue;
+        }
+
+        if (RunIndexCount > 0)
+        {
+            vkCmdDrawIndexed(CommandBuffer, RunIndexCount, 1, IndexBase + RunFirstIndex, VertexBase + RunVertexOffset, 0);
+        }
+
+        RunFirstIndex = Cluster.FirstIndex;
+        RunIndexCount = Cluster.IndexCount;
+        RunVertexOffset = Cluster.VertexOffset;
+    }
+
+    if (RunIndexCount > 0)
+    {
+        vkCmdDrawIndexed(CommandBuffer, RunIndexCount, 1, IndexBase + RunFirstIndex, VertexBase + RunVertexOffset, 0);
+    }
+}
+
+void LavaModel::SubmitUploads(std::vector<BufferUpload>* DeferredUploads)
+{
+    if (DeferredUploads)
+    {
+        std::move(PendingUploads.begin(), PendingUploads.end(), std::back_inserter(*DeferredUploads));
+    }
+    else
+    {
+        // All the copies of the model go in a single submission, which has to complete before it can be drawn
+        LavaUploadBatch Batch{Device};
+        for (BufferUpload& Upload : PendingUploads)
+        {
+            Batch.AddUpload(std::move(Upload.Staging), Upload.Dst.GetBuffer(), Upload.Dst.GetOffset());
+        }
+
+        Device.stagingRing().Wait(Batch.Submit());
+    }
+
+    PendingUploads.clear();
 }
 
 #pragma region Vertices
 
-void LavaModel::CreateVertexBuffers(const std::vector<Vertex>& Vertices)
+void* LavaModel::AcquireVertices(const uint32_t Stride, const uint32_t Count)
 {
-    VertexCount = static_cast<uint32_t>(Vertices.size());
+    VertexCount = Count;
     // We check to have at least 3 elements, meaning that the model represents a triangle
     assert(VertexCount >= 3 && "NOTE: Vertex count must be at least 3");
     
     // Compute the total number of bytes required to store the current model
-    const VkDeviceSize BufferSize = sizeof(Vertices[0]) * VertexCount;
-
-    const uint32_t VertexSize = sizeof(Vertices[0]);
-
-    // Copies data from CPU to GPU
-    LavaBuffer StagingBuffer
-        { Device
-        , VertexSize
-        , VertexCount
-        , VK_BUFFER_USAGE_TRANSFER_SRC_BIT
-        , VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-
-    StagingBuffer.map();
-    StagingBuffer.writeToBuffer((void*) Vertices.data());
-
-    VertexBuffer = std::make_unique<LavaBuffer>
-        ( Device
-        , VertexSize
-        , VertexCount
-        , VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
-        , VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-    
-    Device.copyBuffer(StagingBuffer.getBuffer(), VertexBuffer->getBuffer(), BufferSize);
+    const VkDeviceSize BufferSize = static_cast<VkDeviceSize>(Stride) * VertexCount;
+
+    const uint32_t VertexSize = Stride;
+
+    // Copies data from CPU to GPU through space claimed in the persistently mapped staging ring
+    StagingRegion Staging = Device.stagingRing().Claim(BufferSize);
+    void* MappedMemory = Staging.GetData();
+
+    // Shared with the other models of the same format
+    VertexAllocation = Device.geometryPool().AllocateVertices(VertexSize, VertexCount);
+
+    PendingUploads.push_back({std::move(Staging), VertexAllocation});
+    return MappedMemory;
 }
 
 #pragma endregion
 
 #pragma region Indices
 
-void LavaModel::CreateIndexBuffers(const std::vector<uint32_t>& Indices)
+void* LavaModel::AcquireIndices(const VkIndexType Type, const uint32_t Count)
 {
-    IndexCount = static_cast<uint32_t>(Indices.size());
+    IndexCount = Count;
+    IndexType = Type;
     
     bHasIndexBuffer = IndexCount > 0;
-    if (!bHasIndexBuffer)
-        return;
+    assert(bHasIndexBuffer && "NOTE: Index count must be at least 1");
     
-    VkDeviceSize BufferSize = sizeof(Indices[0]) * IndexCount;
+    const uint64_t IndexSize = IndexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
 
-    const uint64_t IndexSize = sizeof(Indices[0]);
+    VkDeviceSize BufferSize = IndexSize * IndexCount;
 
-    LavaBuffer StagingBuffer
-        { Device
-        , IndexSize
-        , IndexCount
-        , VK_BUFFER_USAGE_TRANSFER_SRC_BIT
-        , VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-    
-    StagingBuffer.map();
-    StagingBuffer.writeToBuffer((void*) Indices.data());
+    StagingRegion Staging = Device.stagingRing().Claim(BufferSize);
+    void* MappedMemory = Staging.GetData();
 
-    IndexBuffer = std::make_unique<LavaBuffer>
-        ( Device
-        , IndexSize
-        , IndexCount
-        , VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
-        , VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+    IndexAllocation = Device.geometryPool().AllocateIndices(IndexType, IndexCount);
 
-    Device.copyBuffer(StagingBuffer.getBuffer(), IndexBuffer->getBuffer(), BufferSize);
+    PendingUploads.push_back({std::move(Staging), IndexAllocation});
+    return MappedMemory;
 }
 
 #pragma endregion
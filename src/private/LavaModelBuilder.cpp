@@ -0,0 +1,1034 @@
+//
+//  LavaModelBuilder.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+// CPU side of the models: parsing, processing and cooking. It never touches the device, so that offline
+// tools can link it without Vulkan
+
+#include "LavaModel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <vector>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "TinyObjLoader.h"
+
+#include "LavaUtils.hpp"
+#include "LavaObjParser.hpp"
+#include "LavaGltfParser.hpp"
+#include "LavaMeshCache.hpp"
+#include "LavaVertexWelder.hpp"
+#include "LavaNormalGenerator.hpp"
+#include "LavaMeshOptimizer.hpp"
+#include "LavaMeshSimplifier.hpp"
+
+namespace lava
+{
+
+namespace
+{
+
+int16_t ToSnorm16(float Value)
+{
+    return static_cast<int16_t>(std::lround(std::clamp(Value, -1.f, 1.f) * 32767.f));
+}
+
+uint8_t ToUnorm8(float Value)
+{
+    return static_cast<uint8_t>(std::lround(std::clamp(Value, 0.f, 1.f) * 255.f));
+}
+
+// IEEE 754 binary16 conversion, rounding to nearest even. Overflows become infinities
+uint16_t ToHalf(float Value)
+{
+    uint32_t Bits;
+    std::memcpy(&Bits, &Value, sizeof(Bits));
+
+    const uint32_t Sign = (Bits >> 16) & 0x8000;
+    const int32_t Exponent = static_cast<int32_t>((Bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t Mantissa = Bits & 0x7FFFFF;
+
+    // NaN and infinity
+    if (((Bits >> 23) & 0xFF) == 0xFF)
+        return static_cast<uint16_t>(Sign | 0x7C00 | (Mantissa ? 0x200 : 0));
+
+    if (Exponent >= 31)
+        return static_cast<uint16_t>(Sign | 0x7C00);
+
+    // Subnormal halves, or zero when too small
+    if (Exponent <= 0)
+    {
+        if (Exponent < -10)
+            return static_cast<uint16_t>(Sign);
+
+        Mantissa |= 0x800000;
+        const uint32_t Shift = static_cast<uint32_t>(14 - Exponent);
+        const uint32_t Half = Mantissa >> Shift;
+        const uint32_t Remainder = Mantissa & ((1u << Shift) - 1);
+        const uint32_t Midpoint = 1u << (Shift - 1);
+        return static_cast<uint16_t>(Sign | (Half + (Remainder > Midpoint || (Remainder == Midpoint && (Half & 1)))));
+    }
+
+    const uint32_t Half = (static_cast<uint32_t>(Exponent) << 10) | (Mantissa >> 13);
+    const uint32_t Remainder = Mantissa & 0x1FFF;
+
+    // A carry out of the mantissa correctly increments the exponent
+    return static_cast<uint16_t>(Sign | (Half + (Remainder > 0x1000 || (Remainder == 0x1000 && (Half & 1)))));
+}
+
+// Below this size a copy is not worth the threads
+constexpr size_t MinParallelCopyBytes = 1 << 20;
+
+// Copies Size bytes from Source, splitting the copy between threads when it is large enough
+void CopyParallel(void* Destination, const void* Source, size_t Size)
+{
+    ParallelFor(Size, MinParallelCopyBytes, [&](size_t Begin, size_t End)
+    {
+        std::memcpy(static_cast<char*>(Destination) + Begin, static_cast<const char*>(Source) + Begin, End - Begin);
+    });
+}
+
+}
+
+#pragma region Types
+
+namespace
+{
+
+Material ToMaterial(const tinyobj::material_t& Source)
+{
+    Material Result{};
+    Result.Diffuse = {Source.diffuse[0], Source.diffuse[1], Source.diffuse[2], Source.dissolve};
+    Result.Specular = {Source.specular[0], Source.specular[1], Source.specular[2], Source.shininess};
+    Result.Emissive = {Source.emission[0], Source.emission[1], Source.emission[2], 0.f};
+    return Result;
+}
+
+}
+
+std::vector<VkVertexInputBindingDescription> Vertex::GetBindingDesc()
+{
+    // Binding description for a single vertex buffer
+    std::vector<VkVertexInputBindingDescription> BindingDescs(1);
+    BindingDescs[0].binding = 0;
+    BindingDescs[0].stride = sizeof(Vertex);
+    BindingDescs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    
+    return BindingDescs;
+}
+
+std::vector<VkVertexInputAttributeDescription> Vertex::GetAttributeDescs()
+{
+    std::vector<VkVertexInputAttributeDescription> AttributeDescs{};
+    AttributeDescs.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
+    AttributeDescs.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
+    AttributeDescs.push_back({2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
+    AttributeDescs.push_back({3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)}); //uv are 2D
+    
+    return AttributeDescs;
+}
+
+std::vector<VkVertexInputBindingDescription> CompactVertex::GetBindingDesc()
+{
+    std::vector<VkVertexInputBindingDescription> BindingDescs(1);
+    BindingDescs[0].binding = 0;
+    BindingDescs[0].stride = sizeof(CompactVertex);
+    BindingDescs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return BindingDescs;
+}
+
+std::vector<VkVertexInputAttributeDescription> CompactVertex::GetAttributeDescs()
+{
+    // Same locations of Vertex, normalized formats are expanded to floats by the input assembler
+    std::vector<VkVertexInputAttributeDescription> AttributeDescs{};
+    AttributeDescs.push_back({0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(CompactVertex, position)});
+    AttributeDescs.push_back({1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactVertex, color)});
+    AttributeDescs.push_back({2, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, normal)});
+    AttributeDescs.push_back({3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, uv)});
+
+    return AttributeDescs;
+}
+
+CompactVertex CompactVertex::Encode(const Vertex& V, const glm::vec3& BoundsCenter, const glm::vec3& InverseBoundsExtent)
+{
+    CompactVertex Result{};
+
+    const glm::vec3 Position = (V.position - BoundsCenter) * InverseBoundsExtent;
+    Result.position[0] = ToSnorm16(Position.x);
+    Result.position[1] = ToSnorm16(Position.y);
+    Result.position[2] = ToSnorm16(Position.z);
+
+    // Octahedral encoding: the normal is projected on the octahedron |x| + |y| + |z| = 1, whose lower half
+    // is then folded over the upper one, so that the whole sphere is mapped onto the [-1, 1] square
+    const float L1Norm = std::abs(V.normal.x) + std::abs(V.normal.y) + std::abs(V.normal.z);
+    if (L1Norm > 0.f)
+    {
+        float X = V.normal.x / L1Norm;
+        float Y = V.normal.y / L1Norm;
+        if (V.normal.z < 0.f)
+        {
+            const float FoldedX = (1.f - std::abs(Y)) * (X >= 0.f ? 1.f : -1.f);
+            const float FoldedY = (1.f - std::abs(X)) * (Y >= 0.f ? 1.f : -1.f);
+            X = FoldedX;
+            Y = FoldedY;
+        }
+
+        Result.normal[0] = ToSnorm16(X);
+        Result.normal[1] = ToSnorm16(Y);
+    }
+
+    Result.color[0] = ToUnorm8(V.color.x);
+    Result.color[1] = ToUnorm8(V.color.y);
+    Result.color[2] = ToUnorm8(V.color.z);
+    Result.color[3] = 255;
+
+    Result.uv[0] = ToHalf(V.uv.x);
+    Result.uv[1] = ToHalf(V.uv.y);
+
+    return Result;
+}
+
+glm::mat4 CompactVertex::GetDequantizationMatrix(const glm::vec3& BoundsMin, const glm::vec3& BoundsMax)
+{
+    const glm::vec3 Center = (BoundsMin + BoundsMax) * .5f;
+    const glm::vec3 Extent = glm::max((BoundsMax - BoundsMin) * .5f, glm::vec3{1e-8f});
+
+    // Scale by the extent, then translate to the center
+    glm::mat4 Dequantization{1.f};
+    Dequantization[0][0] = Extent.x;
+    Dequantization[1][1] = Extent.y;
+    Dequantization[2][2] = Extent.z;
+    Dequantization[3] = glm::vec4{Center, 1.f};
+
+    return Dequantization;
+}
+
+void Builder::LoadModel(const std::string& Filename, const ObjLoader Loader)
+{
+    // Everything derived from a previous model goes as well, so that a builder can load and cook several files
+    Vertices.clear();
+    Indices.clear();
+    SubMeshes.clear();
+    Materials.clear();
+    Meshlets.clear();
+    Lods.clear();
+    CompactVertices.clear();
+    Format = VertexFormat::Full;
+    ContentHash = 0;
+    BoundsMin = glm::vec3{};
+    BoundsMax = glm::vec3{};
+    Sphere = BoundingSphere{};
+
+    if (LavaGltfParser::IsGltfFile(Filename))
+    {
+        const GltfData Data = LavaGltfParser::ParseFile(Filename);
+
+        std::vector<int32_t> TriangleMaterials;
+        AppendGltf(Data, TriangleMaterials);
+
+        GroupByMaterial(Data.Materials, TriangleMaterials);
+        ComputeBounds();
+        return;
+    }
+
+    // Material libraries are looked up next to the .obj file
+    const std::string BaseDir = std::filesystem::path(Filename).parent_path().string();
+
+    std::vector<tinyobj::material_t> SourceMaterials;
+
+    // Index inside SourceMaterials of each triangle, -1 for the ones without a material (or with an unknown one)
+    std::vector<int32_t> TriangleMaterials;
+
+    if (Loader == ObjLoader::TinyObj)
+    {
+        tinyobj::attrib_t Attrib;
+        std::vector<tinyobj::shape_t> Shapes;
+        std::string Warning;
+        std::string Error;
+
+        if (!tinyobj::LoadObj(&Attrib, &Shapes, &SourceMaterials, &Warning, &Error, Filename.c_str(), BaseDir.c_str()))
+        {
+            throw std::runtime_error(Warning + Error);
+        }
+
+        // Object loading succeded. Vertices are shared between all the shapes
+        std::vector<tinyobj::index_t> Corners;
+        for (const auto& Shape : Shapes)
+        {
+            Corners.insert(Corners.end(), Shape.mesh.indices.begin(), Shape.mesh.indices.end());
+            TriangleMaterials.insert(TriangleMaterials.end(), Shape.mesh.material_ids.begin(), Shape.mesh.material_ids.end());
+        }
+
+        AppendCorners(Attrib.vertices, Attrib.colors, Attrib.normals, Attrib.texcoords, Corners);
+    }
+    else
+    {
+        const ObjData Data = LavaObjParser::ParseFile(Filename);
+        AppendCorners(Data.Positions, Data.Colors, Data.Normals, Data.TexCoords, Data.Corners);
+
+        // Only the geometry is parsed by LavaObjParser, material libraries are still read by tinyobj
+        std::map<std::string, int> MaterialIds;
+        tinyobj::MaterialFileReader ReadMaterials{BaseDir.empty() ? BaseDir : BaseDir + "/"};
+        for (const std::string& Library : Data.MaterialLibraries)
+        {
+            std::string Warning;
+            std::string Error;
+            if (!ReadMaterials(Library, &SourceMaterials, &MaterialIds, &Warning, &Error))
+            {
+                std::cout << Warning << Error;
+            }
+        }
+
+        TriangleMaterials.reserve(Data.TriangleMaterials.size());
+        for (const int32_t NameIdx : Data.TriangleMaterials)
+        {
+            const auto Found = NameIdx >= 0 ? MaterialIds.find(Data.MaterialNames[NameIdx]) : MaterialIds.end();
+            TriangleMaterials.push_back(Found != MaterialIds.end() ? Found->second : -1);
+        }
+    }
+
+    std::vector<Material> MaterialConstants{};
+    std::transform(SourceMaterials.begin(), SourceMaterials.end(), std::back_inserter(MaterialConstants), ToMaterial);
+
+    GroupByMaterial(MaterialConstants, TriangleMaterials);
+    ComputeBounds();
+}
+
+void Builder::GroupByMaterial(const std::vector<Material>& SourceMaterials, const std::vector<int32_t>& TriangleMaterials)
+{
+    const size_t TriangleCount = Indices.size() / 3;
+    if (SourceMaterials.empty() || TriangleMaterials.size() != TriangleCount)
+        return;
+
+    // Slot 0 collects the triangles without a material, the others are shifted by one
+    std::vector<uint32_t> SlotCounts(SourceMaterials.size() + 1, 0);
+    for (const int32_t MaterialId : TriangleMaterials)
+    {
+        ++SlotCounts[MaterialId + 1];
+    }
+
+    // Only the materials that are actually used end up in the table, the triangles without one get the default material
+    std::vector<uint32_t> SlotMaterials(SlotCounts.size(), 0);
+    for (size_t Slot = 0; Slot < SlotCounts.size(); ++Slot)
+    {
+        if (SlotCounts[Slot] == 0)
+            continue;
+
+        const Material Constants = Slot > 0 ? SourceMaterials[Slot - 1] : Material{};
+
+        // Materials with different names but the same constants are drawn as one
+        const auto Found = std::find(Materials.begin(), Materials.end(), Constants);
+        SlotMaterials[Slot] = static_cast<uint32_t>(Found - Materials.begin());
+        if (Found == Materials.end())
+        {
+            Materials.push_back(Constants);
+        }
+    }
+
+    // A single material needs no sub mesh, the whole mesh already uses it
+    if (Materials.size() <= 1)
+        return;
+
+    // Stable counting sort of the triangles by material, so that each material covers a single range of indices
+    std::vector<uint32_t> MaterialOffsets(Materials.size() + 1, 0);
+    for (size_t Slot = 0; Slot < SlotCounts.size(); ++Slot)
+    {
+        MaterialOffsets[SlotMaterials[Slot] + 1] += SlotCounts[Slot];
+    }
+    for (size_t MaterialIdx = 0; MaterialIdx < Materials.size(); ++MaterialIdx)
+    {
+        MaterialOffsets[MaterialIdx + 1] += MaterialOffsets[MaterialIdx];
+    }
+
+    std::vector<uint32_t> Grouped(Indices.size());
+    std::vector<uint32_t> Cursors(MaterialOffsets.begin(), MaterialOffsets.end() - 1);
+    for (size_t TriangleIdx = 0; TriangleIdx < TriangleCount; ++TriangleIdx)
+    {
+        const uint32_t Target = Cursors[SlotMaterials[TriangleMaterials[TriangleIdx] + 1]]++;
+        std::copy_n(Indices.begin() + TriangleIdx * 3, 3, Grouped.begin() + Target * 3);
+    }
+    Indices = std::move(Grouped);
+
+    for (uint32_t MaterialIdx = 0; MaterialIdx < Materials.size(); ++MaterialIdx)
+    {
+        const uint32_t FirstIndex = MaterialOffsets[MaterialIdx] * 3;
+        SubMeshes.push_back({FirstIndex, MaterialOffsets[MaterialIdx + 1] * 3 - FirstIndex, 0, MaterialIdx});
+    }
+}
+
+void Builder::ComputeBounds()
+{
+    static_assert(offsetof(Vertex, position) + 4 * sizeof(float) <= sizeof(Vertex), "NOTE: LavaBounds reads 4 floats from each position");
+
+    const float* Positions = Vertices.empty() ? nullptr : &Vertices[0].position.x;
+    const BoundingBox Box = LavaBounds::ComputeBox(Positions, Vertices.size(), sizeof(Vertex));
+
+    BoundsMin = Box.Min;
+    BoundsMax = Box.Max;
+    Sphere = LavaBounds::ComputeSphere(Positions, Vertices.size(), sizeof(Vertex), Box);
+}
+
+void Builder::AppendGltf(const GltfData& Data, std::vector<int32_t>& TriangleMaterials)
+{
+    for (const GltfMeshInstance& Instance : Data.Instances)
+    {
+        const glm::mat3 Linear{Instance.Transform};
+        const glm::vec3 Translation{Instance.Transform[3]};
+
+        // Normals are transformed by the cofactor matrix, which is the inverse transpose scaled by the determinant.
+        // Mirroring transforms flip the winding, which is restored by swapping two corners of each triangle
+        const float Determinant = glm::dot(Linear[0], glm::cross(Linear[1], Linear[2]));
+        const float NormalSign = Determinant < 0.f ? -1.f : 1.f;
+        const glm::mat3 NormalMatrix
+        {
+            glm::cross(Linear[1], Linear[2]) * NormalSign,
+            glm::cross(Linear[2], Linear[0]) * NormalSign,
+            glm::cross(Linear[0], Linear[1]) * NormalSign
+        };
+
+        for (uint32_t PrimitiveIdx = Instance.FirstPrimitive; PrimitiveIdx < Instance.FirstPrimitive + Instance.PrimitiveCount; ++PrimitiveIdx)
+        {
+            const GltfPrimitive& Primitive = Data.Primitives[PrimitiveIdx];
+            const uint32_t BaseVertex = static_cast<uint32_t>(Vertices.size());
+            const uint32_t VertexCount = Primitive.Positions.Count;
+
+            Vertices.resize(Vertices.size() + VertexCount);
+            for (uint32_t Idx = 0; Idx < VertexCount; ++Idx)
+            {
+                Vertex& V = Vertices[BaseVertex + Idx];
+                V.position = Linear * glm::vec3{Primitive.Positions.ReadFloat(Idx)} + Translation;
+                V.color = Primitive.Colors.IsValid() ? glm::vec3{Primitive.Colors.ReadFloat(Idx)} : glm::vec3{1.f};
+
+                // Missing normals stay at zero, so that GenerateNormals can fill them in
+                if (Primitive.Normals.IsValid())
+                {
+                    const glm::vec3 Normal = NormalMatrix * glm::vec3{Primitive.Normals.ReadFloat(Idx)};
+                    const float Length = glm::length(Normal);
+                    V.normal = Length > 0.f ? Normal / Length : Normal;
+                }
+
+                if (Primitive.TexCoords.IsValid())
+                {
+                    V.uv = glm::vec2{Primitive.TexCoords.ReadFloat(Idx)};
+                }
+            }
+
+            // Primitives without indices are drawn in order
+            const uint32_t CornerCount = (Primitive.Indices.IsValid() ? Primitive.Indices.Count : VertexCount) / 3 * 3;
+            const size_t FirstCorner = Indices.size();
+            Indices.resize(FirstCorner + CornerCount);
+            for (uint32_t Corner = 0; Corner < CornerCount; ++Corner)
+            {
+                Indices[FirstCorner + Corner] = BaseVertex + (Primitive.Indices.IsValid() ? Primitive.Indices.ReadIndex(Corner) : Corner);
+            }
+
+            if (Determinant < 0.f)
+            {
+                for (size_t Corner = FirstCorner; Corner < Indices.size(); Corner += 3)
+                {
+                    std::swap(Indices[Corner + 1], Indices[Corner + 2]);
+                }
+            }
+
+            TriangleMaterials.insert(TriangleMaterials.end(), CornerCount / 3, Primitive.Material);
+        }
+    }
+}
+
+template <typename IndexType>
+void Builder::AppendCorners
+    ( const std::vector<float>& Positions
+    , const std::vector<float>& Colors
+    , const std::vector<float>& Normals
+    , const std::vector<float>& TexCoords
+    , const std::vector<IndexType>& Corners )
+{
+    // Every triangle adds at most 3 new vertices, but in a connected mesh most of them are shared
+    LavaVertexWelder Welder{Vertices, Corners.size() / 3};
+    Indices.reserve(Indices.size() + Corners.size());
+
+    for (const auto& Index : Corners)
+    {
+        Vertex V{};
+
+        // Suppose wa have faces defined as vertexIdx/normalIdx/uvIdx
+
+        if (Index.vertex_index >= 0)
+        {
+            // Suppose each vertex is a vec3, then each component is in following positions
+            // with offset 0, 1 and 2 starting from the vertex index
+            const size_t startingIdx = 3 * Index.vertex_index;
+            V.position =
+            {
+                Positions[startingIdx],
+                Positions[startingIdx + 1],
+                Positions[startingIdx + 2]
+            };
+
+            // Supposed the provided file owns colors after vertices positions
+            V.color =
+            {
+                Colors[startingIdx],
+                Colors[startingIdx + 1],
+                Colors[startingIdx + 2]
+            };
+        }
+
+        if (Index.normal_index >= 0)
+        {
+            const size_t startingIdx = 3 * Index.normal_index;
+            V.normal =
+            {
+                Normals[startingIdx],
+                Normals[startingIdx + 1],
+                Normals[startingIdx + 2]
+            };
+        }
+
+        if (Index.texcoord_index >= 0)
+        {
+            const size_t startingIdx = 2 * Index.texcoord_index;
+            V.uv =
+            {
+                TexCoords[startingIdx],
+                TexCoords[startingIdx + 1]
+            };
+        }
+
+        // The index of the vertex is its position inside the Vertices array. V is appended only if it is not there yet
+        Indices.push_back(Welder.Insert(V));
+    }
+}
+
+uint32_t Builder::GenerateNormals(const NormalSettings& Settings)
+{
+    const uint32_t GeneratedCount = LavaNormalGenerator::Generate(Vertices, Indices, Settings);
+    if (GeneratedCount > 0)
+    {
+        std::cout << "Generated the normals of " << GeneratedCount << " vertices" << std::endl;
+    }
+
+    return GeneratedCount;
+}
+
+uint32_t Builder::WeldVertices(const WeldTolerances& Tolerances)
+{
+    const size_t VertexCount = Vertices.size();
+    const uint32_t RemovedCount = LavaVertexWelder::WeldNearby(Vertices, Indices, Tolerances, &SubMeshes);
+
+    if (RemovedCount > 0)
+    {
+        ComputeBounds();
+        std::cout << "Welded " << RemovedCount << " of " << VertexCount << " vertices" << std::endl;
+    }
+
+    return RemovedCount;
+}
+
+void Builder::Quantize()
+{
+    const glm::vec3 Center = (BoundsMin + BoundsMax) * .5f;
+    const glm::vec3 Extent = glm::max((BoundsMax - BoundsMin) * .5f, glm::vec3{1e-8f});
+    const glm::vec3 InverseExtent = 1.f / Extent;
+
+    CompactVertices.resize(Vertices.size());
+    for (size_t i = 0; i < Vertices.size(); ++i)
+    {
+        CompactVertices[i] = CompactVertex::Encode(Vertices[i], Center, InverseExtent);
+    }
+
+    Format = VertexFormat::Compact;
+}
+
+void Builder::SplitIntoSubMeshes(uint32_t MaxVertices)
+{
+    if (Vertices.size() <= MaxVertices)
+        return;
+
+    constexpr uint32_t NotInSubMesh = UINT32_MAX;
+
+    // Material ranges are split on their own, so that each resulting sub mesh keeps a single material
+    std::vector<SubMesh> Ranges{};
+    Ranges.swap(SubMeshes);
+    if (Ranges.empty())
+    {
+        Ranges.push_back({0, static_cast<uint32_t>(Indices.size()), 0});
+    }
+
+    // Index of the last sub mesh each vertex has been added to, and its local index in there
+    std::vector<uint32_t> SubMeshOfVertex(Vertices.size(), NotInSubMesh);
+    std::vector<uint32_t> LocalIndices(Vertices.size());
+
+    std::vector<Vertex> SplitVertices{};
+    SplitVertices.reserve(Vertices.size());
+
+    uint32_t CurrentIdx = 0;
+
+    for (const SubMesh& Range : Ranges)
+    {
+        const uint32_t RangeEnd = Range.FirstIndex + Range.IndexCount;
+
+        SubMesh Current{Range.FirstIndex, 0, static_cast<int32_t>(SplitVertices.size()), Range.Material};
+        uint32_t LocalVertexCount = 0;
+
+        for (size_t i = Range.FirstIndex; i + 2 < RangeEnd; i += 3)
+        {
+            const uint32_t* Triangle = &Indices[i];
+
+            uint32_t NewVertices = 0;
+            for (int Corner = 0; Corner < 3; ++Corner)
+            {
+                const bool bRepeated = (Corner > 0 && Triangle[Corner] == Triangle[0]) || (Corner > 1 && Triangle[Corner] == Triangle[1]);
+                NewVertices += !bRepeated && SubMeshOfVertex[Triangle[Corner]] != CurrentIdx;
+            }
+
+            if (LocalVertexCount + NewVertices > MaxVertices)
+            {
+                Current.IndexCount = static_cast<uint32_t>(i) - Current.FirstIndex;
+                SubMeshes.push_back(Current);
+
+                Current.FirstIndex = static_cast<uint32_t>(i);
+                Current.VertexOffset = static_cast<int32_t>(SplitVertices.size());
+                ++CurrentIdx;
+                LocalVertexCount = 0;
+            }
+
+            for (int Corner = 0; Corner < 3; ++Corner)
+            {
+                const uint32_t VertexIdx = Indices[i + Corner];
+                if (SubMeshOfVertex[VertexIdx] != CurrentIdx)
+                {
+                    SubMeshOfVertex[VertexIdx] = CurrentIdx;
+                    LocalIndices[VertexIdx] = LocalVertexCount++;
+                    SplitVertices.push_back(Vertices[VertexIdx]);
+                }
+
+                Indices[i + Corner] = LocalIndices[VertexIdx];
+            }
+        }
+
+        Current.IndexCount = RangeEnd - Current.FirstIndex;
+        SubMeshes.push_back(Current);
+        ++CurrentIdx;
+    }
+
+    Vertices = std::move(SplitVertices);
+}
+
+void Builder::BuildMeshlets()
+{
+    constexpr uint32_t NotInMeshlet = UINT32_MAX;
+    constexpr uint32_t MaxCandidatesPerVertex = 32;
+
+    Meshlets.clear();
+
+    // Meshlets never cross sub meshes, as they must share the vertex offset of their triangles
+    std::vector<SubMesh> Ranges = SubMeshes;
+    if (Ranges.empty())
+    {
+        Ranges.push_back({0, static_cast<uint32_t>(Indices.size()), 0});
+    }
+
+    std::vector<uint32_t> Result{};
+    Result.reserve(Indices.size());
+
+    std::vector<uint32_t> MeshletVertices{};
+    std::vector<uint32_t> Candidates{};
+
+    for (const SubMesh& Range : Ranges)
+    {
+        const uint32_t* RangeIndices = Indices.data() + Range.FirstIndex;
+        const uint32_t TriangleCount = Range.IndexCount / 3;
+        const Vertex* RangeVertices = Vertices.data() + Range.VertexOffset;
+
+        uint32_t VertexCount = 0;
+        for (uint32_t i = 0; i < TriangleCount * 3; ++i)
+        {
+            VertexCount = std::max(VertexCount, RangeIndices[i] + 1);
+        }
+
+        // Triangles referencing each vertex
+        std::vector<uint32_t> AdjacencyOffsets(VertexCount + 1, 0);
+        for (uint32_t i = 0; i < TriangleCount * 3; ++i)
+        {
+            ++AdjacencyOffsets[RangeIndices[i] + 1];
+        }
+        for (uint32_t VertexIdx = 0; VertexIdx < VertexCount; ++VertexIdx)
+        {
+            AdjacencyOffsets[VertexIdx + 1] += AdjacencyOffsets[VertexIdx];
+        }
+
+        std::vector<uint32_t> AdjacentTriangles(TriangleCount * 3);
+        {
+            std::vector<uint32_t> Fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+            for (uint32_t i = 0; i < TriangleCount * 3; ++i)
+            {
+                AdjacentTriangles[Fill[RangeIndices[i]]++] = i / 3;
+            }
+        }
+
+        // First adjacent triangle of each vertex that might not have been used yet
+        std::vector<uint32_t> AdjacencyCursors(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+
+        std::vector<bool> bUsed(TriangleCount, false);
+        std::vector<uint32_t> MeshletOfVertex(VertexCount, NotInMeshlet);
+
+        const auto GetTriangleCentroid = [&](const uint32_t TriangleIdx)
+        {
+            const uint32_t* Triangle = RangeIndices + TriangleIdx * 3;
+            return (RangeVertices[Triangle[0]].position + RangeVertices[Triangle[1]].position + RangeVertices[Triangle[2]].position) / 3.f;
+        };
+
+        uint32_t Cursor = 0;
+        uint32_t Remaining = TriangleCount;
+
+        while (Remaining > 0)
+        {
+            const uint32_t MeshletIdx = static_cast<uint32_t>(Meshlets.size());
+
+            Meshlet Current{};
+            Current.FirstIndex = static_cast<uint32_t>(Result.size());
+            Current.VertexOffset = Range.VertexOffset;
+
+            MeshletVertices.clear();
+            Candidates.clear();
+            glm::vec3 PositionSum{0.f};
+            uint32_t MeshletTriangles = 0;
+
+            const auto AddTriangle = [&](const uint32_t TriangleIdx)
+            {
+                const uint32_t* Triangle = RangeIndices + TriangleIdx * 3;
+                for (int Corner = 0; Corner < 3; ++Corner)
+                {
+                    const uint32_t VertexIdx = Triangle[Corner];
+                    if (MeshletOfVertex[VertexIdx] != MeshletIdx)
+                    {
+                        MeshletOfVertex[VertexIdx] = MeshletIdx;
+                        MeshletVertices.push_back(VertexIdx);
+                        PositionSum += RangeVertices[VertexIdx].position;
+
+                        // The meshlet grows over the triangles that share its vertices. Only a few of them are considered
+                        // for each vertex, so that vertices shared by thousands of triangles do not make the search quadratic
+                        uint32_t& First = AdjacencyCursors[VertexIdx];
+                        while (First < AdjacencyOffsets[VertexIdx + 1] && bUsed[AdjacentTriangles[First]])
+                        {
+                            ++First;
+                        }
+
+                        const uint32_t Last = std::min(First + MaxCandidatesPerVertex, AdjacencyOffsets[VertexIdx + 1]);
+                        Candidates.insert(Candidates.end(), AdjacentTriangles.begin() + First, AdjacentTriangles.begin() + Last);
+                    }
+
+                    Result.push_back(VertexIdx);
+                }
+
+                bUsed[TriangleIdx] = true;
+                ++MeshletTriangles;
+                --Remaining;
+            };
+
+            // Meshlets are seeded in the current triangle order, to keep the benefits of the previous optimizations
+            while (bUsed[Cursor])
+            {
+                ++Cursor;
+            }
+            AddTriangle(Cursor);
+
+            while (MeshletTriangles < Meshlet::MaxTriangles)
+            {
+                const glm::vec3 Center = PositionSum / static_cast<float>(MeshletVertices.size());
+
+                // Prefers the triangles adding the fewest vertices, and then the closest to the meshlet center
+                uint32_t BestTriangle = NotInMeshlet;
+                uint32_t BestNewVertices = 4;
+                float BestDistance = 0.f;
+
+                for (size_t CandidateIdx = 0; CandidateIdx < Candidates.size(); )
+                {
+                    const uint32_t TriangleIdx = Candidates[CandidateIdx];
+                    if (bUsed[TriangleIdx])
+                    {
+                        Candidates[CandidateIdx] = Candidates.back();
+                        Candidates.pop_back();
+                        continue;
+                    }
+                    ++CandidateIdx;
+
+                    const uint32_t* Triangle = RangeIndices + TriangleIdx * 3;
+                    uint32_t NewVertices = 0;
+                    for (int Corner = 0; Corner < 3; ++Corner)
+                    {
+                        const bool bRepeated = (Corner > 0 && Triangle[Corner] == Triangle[0]) || (Corner > 1 && Triangle[Corner] == Triangle[1]);
+                        NewVertices += !bRepeated && MeshletOfVertex[Triangle[Corner]] != MeshletIdx;
+                    }
+
+                    if (MeshletVertices.size() + NewVertices > Meshlet::MaxVertices || NewVertices > BestNewVertices)
+                        continue;
+
+                    const glm::vec3 Offset = GetTriangleCentroid(TriangleIdx) - Center;
+                    const float Distance = glm::dot(Offset, Offset);
+                    if (NewVertices < BestNewVertices || Distance < BestDistance)
+                    {
+                        BestTriangle = TriangleIdx;
+                        BestNewVertices = NewVertices;
+                        BestDistance = Distance;
+                    }
+                }
+
+                if (BestTriangle == NotInMeshlet)
+                    break;
+
+                AddTriangle(BestTriangle);
+            }
+
+            Current.IndexCount = MeshletTriangles * 3;
+            Current.VertexCount = static_cast<uint32_t>(MeshletVertices.size());
+
+            // Bounding sphere around the center of the bounding box
+            glm::vec3 Min = RangeVertices[MeshletVertices[0]].position;
+            glm::vec3 Max = Min;
+            for (const uint32_t VertexIdx : MeshletVertices)
+            {
+                Min = glm::min(Min, RangeVertices[VertexIdx].position);
+                Max = glm::max(Max, RangeVertices[VertexIdx].position);
+            }
+
+            Current.Center = (Min + Max) * .5f;
+            for (const uint32_t VertexIdx : MeshletVertices)
+            {
+                Current.Radius = std::max(Current.Radius, glm::length(RangeVertices[VertexIdx].position - Current.Center));
+            }
+
+            // Normal cone around the average triangle normal. Its cutoff is the sine of the angle between
+            // the axis and the farthest normal, which is what the center based culling test needs
+            std::vector<glm::vec3> Normals{};
+            glm::vec3 AxisSum{0.f};
+            for (uint32_t i = Current.FirstIndex; i < Current.FirstIndex + Current.IndexCount; i += 3)
+            {
+                const glm::vec3 Cross = glm::cross
+                    ( RangeVertices[Result[i + 1]].position - RangeVertices[Result[i]].position
+                    , RangeVertices[Result[i + 2]].position - RangeVertices[Result[i]].position );
+
+                const float Length = glm::length(Cross);
+                if (Length > 0.f)
+                {
+                    Normals.push_back(Cross / Length);
+                    AxisSum += Normals.back();
+                }
+            }
+
+            const float AxisLength = glm::length(AxisSum);
+            if (AxisLength > 0.f)
+            {
+                Current.ConeAxis = AxisSum / AxisLength;
+
+                float MinDot = 1.f;
+                for (const glm::vec3& Normal : Normals)
+                {
+                    MinDot = std::min(MinDot, glm::dot(Normal, Current.ConeAxis));
+                }
+
+                // Wider than ~85 degrees the cone would be too conservative to ever cull
+                Current.ConeCutoff = MinDot <= .1f ? 1.f : std::sqrt(1.f - MinDot * MinDot);
+            }
+
+            Meshlets.push_back(Current);
+        }
+    }
+
+    Indices = std::move(Result);
+}
+
+void Builder::GenerateLods(uint32_t LevelCount)
+{
+    // Each level has to remove at least this fraction of the triangles of the previous one to be worth keeping
+    constexpr float MinReduction = .15f;
+
+    // Largest error accepted for a single level, relative to the size of the mesh
+    constexpr float MaxRelativeError = .05f;
+
+    Lods.clear();
+    LevelCount = std::min(LevelCount, LodLevel::MaxLevels);
+
+    if (LevelCount <= 1 || Indices.empty())
+        return;
+
+    if (SubMeshes.empty())
+    {
+        SubMeshes.push_back({0, static_cast<uint32_t>(Indices.size()), 0});
+    }
+
+    Lods.push_back({0, static_cast<uint32_t>(SubMeshes.size()), 0.f});
+
+    const float MaxError = glm::length(BoundsMax - BoundsMin) * MaxRelativeError;
+
+    while (Lods.size() < LevelCount)
+    {
+        const LodLevel Previous = Lods.back();
+
+        LodLevel Level{};
+        Level.FirstSubMesh = static_cast<uint32_t>(SubMeshes.size());
+
+        size_t PreviousIndexCount = 0;
+        size_t LevelIndexCount = 0;
+        float LevelError = 0.f;
+
+        // Every level is simplified from the previous one, sub mesh by sub mesh, so it keeps their vertex offsets
+        for (uint32_t SubMeshIdx = Previous.FirstSubMesh; SubMeshIdx < Previous.FirstSubMesh + Previous.SubMeshCount; ++SubMeshIdx)
+        {
+            const SubMesh Source = SubMeshes[SubMeshIdx];
+            const std::vector<uint32_t> SourceIndices(Indices.begin() + Source.FirstIndex, Indices.begin() + Source.FirstIndex + Source.IndexCount);
+
+            uint32_t VertexCount = 0;
+            for (const uint32_t Index : SourceIndices)
+            {
+                VertexCount = std::max(VertexCount, Index + 1);
+            }
+
+            float Error = 0.f;
+            std::vector<uint32_t> Simplified = LavaMeshSimplifier::Simplify
+                ( SourceIndices
+                , Vertices.data() + Source.VertexOffset
+                , VertexCount
+                , SourceIndices.size() / 6 * 3
+                , MaxError
+                , &Error );
+
+            LavaMeshOptimizer::OptimizeVertexCache(Simplified, VertexCount);
+
+            PreviousIndexCount += SourceIndices.size();
+            LevelIndexCount += Simplified.size();
+            LevelError = std::max(LevelError, Error);
+
+            if (Simplified.empty())
+                continue;
+
+            SubMeshes.push_back({static_cast<uint32_t>(Indices.size()), static_cast<uint32_t>(Simplified.size()), Source.VertexOffset, Source.Material});
+            Indices.insert(Indices.end(), Simplified.begin(), Simplified.end());
+        }
+
+        // Errors add up, as each level has been simplified from an already simplified one
+        Level.SubMeshCount = static_cast<uint32_t>(SubMeshes.size()) - Level.FirstSubMesh;
+        Level.Error = Previous.Error + LevelError;
+
+        if (Level.SubMeshCount == 0 || static_cast<float>(LevelIndexCount) > static_cast<float>(PreviousIndexCount) * (1.f - MinReduction))
+        {
+            if (Level.SubMeshCount > 0)
+            {
+                Indices.resize(SubMeshes[Level.FirstSubMesh].FirstIndex);
+                SubMeshes.resize(Level.FirstSubMesh);
+            }
+            break;
+        }
+
+        Lods.push_back(Level);
+    }
+
+    // A single level carries no information
+    if (Lods.size() == 1)
+    {
+        Lods.clear();
+    }
+}
+
+VkIndexType Builder::GetIndexType() const
+{
+    const auto MaxIndex = std::max_element(Indices.begin(), Indices.end());
+    return MaxIndex == Indices.end() || *MaxIndex < MaxShortIndexVertices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+void Builder::WriteTo(MeshSink& Sink) const
+{
+    if (Format == VertexFormat::Compact)
+    {
+        void* Destination = Sink.AcquireVertices(sizeof(CompactVertex), static_cast<uint32_t>(CompactVertices.size()));
+        CopyParallel(Destination, CompactVertices.data(), CompactVertices.size() * sizeof(CompactVertex));
+    }
+    else
+    {
+        void* Destination = Sink.AcquireVertices(sizeof(Vertex), static_cast<uint32_t>(Vertices.size()));
+        CopyParallel(Destination, Vertices.data(), Vertices.size() * sizeof(Vertex));
+    }
+
+    if (Indices.empty())
+        return;
+
+    const VkIndexType IndexType = GetIndexType();
+    void* Destination = Sink.AcquireIndices(IndexType, static_cast<uint32_t>(Indices.size()));
+
+    if (IndexType == VK_INDEX_TYPE_UINT32)
+    {
+        CopyParallel(Destination, Indices.data(), Indices.size() * sizeof(uint32_t));
+        return;
+    }
+
+    uint16_t* ShortIndices = static_cast<uint16_t*>(Destination);
+    ParallelFor(Indices.size(), MinParallelCopyBytes / sizeof(uint32_t), [&](size_t Begin, size_t End)
+    {
+        std::transform(Indices.begin() + Begin, Indices.begin() + End, ShortIndices + Begin, [](uint32_t Index)
+        {
+            return static_cast<uint16_t>(Index);
+        });
+    });
+}
+
+void Builder::CookFile(const std::string& Filepath, const MeshOptimizationSettings& Settings)
+{
+    LoadModel(Filepath);
+
+    if (Settings.bWeldVertices)
+    {
+        WeldVertices(Settings.WeldingTolerances);
+    }
+
+    // After welding, so that the triangles around positions that only differed by noise are smoothed together
+    if (Settings.bGenerateNormals)
+    {
+        GenerateNormals(Settings.Normals);
+    }
+
+    LavaMeshOptimizer::Optimize(*this, Settings);
+
+    if (Settings.bSplitForShortIndices)
+    {
+        SplitIntoSubMeshes();
+    }
+
+    if (Settings.bBuildMeshlets)
+    {
+        BuildMeshlets();
+    }
+
+    if (Settings.LodCount > 1)
+    {
+        GenerateLods(Settings.LodCount);
+    }
+
+    if (Settings.Format == VertexFormat::Compact)
+    {
+        Quantize();
+    }
+
+    // Shared by the cooked file, the model registry and the model, so that the data is only hashed once
+    ContentHash = LavaMeshCache::ComputeContentHash(*this);
+
+    // Failing to cook is not an error, the source will just be parsed again the next time
+    if (!LavaMeshCache::Write(LavaMeshCache::GetCachePath(Filepath), *this, LavaMeshCache::GetSourceStamp(Filepath, true), Settings))
+    {
+        std::cout << "Unable to write the cooked mesh for " << Filepath << std::endl;
+    }
+}
+
+#pragma endregion
+
+}
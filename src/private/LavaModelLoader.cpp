@@ -0,0 +1,273 @@
+//
+//  LavaModelLoader.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaModelLoader.hpp"
+#include "LavaMeshCache.hpp"
+#include "LavaPackage.hpp"
+#include "LavaUploadBatch.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace lava
+{
+
+LavaModelLoader::LavaModelLoader(LavaDevice& InDevice, uint32_t WorkerCount, LavaModelRegistry* InRegistry)
+    : Device(InDevice)
+    , Registry(InRegistry)
+{
+    if (WorkerCount == 0)
+    {
+        WorkerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    for (uint32_t WorkerIdx = 0; WorkerIdx < WorkerCount; ++WorkerIdx)
+    {
+        Workers.emplace_back(&LavaModelLoader::WorkerLoop, this);
+    }
+}
+
+LavaModelLoader::~LavaModelLoader()
+{
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        bStopping = true;
+        ReadingRequests.clear();
+        LoadingHandles.clear();
+    }
+
+    // Reads still pending are cancelled by the reader, their results are dropped by the closed queue
+    ReadCompletions.Close();
+
+    for (std::thread& Worker : Workers)
+    {
+        Worker.join();
+    }
+
+    // The models of the batches still in flight can only be released once the GPU is done writing their buffers
+    if (!InFlightBatches.empty())
+    {
+        Device.stagingRing().Wait(InFlightBatches.back().Token);
+    }
+}
+
+std::shared_ptr<LavaModelHandle> LavaModelLoader::LoadAsync
+    ( const std::string& Filepath
+    , const MeshOptimizationSettings& Settings
+    , FileReadPriority Priority )
+{
+    auto Handle = std::make_shared<LavaModelHandle>(Filepath);
+
+    // Nothing to read for the models already resident
+    if (Registry)
+    {
+        if (std::shared_ptr<LavaModel> Model = Registry->FindByPath(Filepath, Settings.GetHash()))
+        {
+            Publish(*Handle, Model);
+            return Handle;
+        }
+    }
+
+    const std::string PathKey = LavaModelRegistry::MakePathKey(Filepath, Settings.GetHash());
+
+    std::lock_guard<std::mutex> Lock{Mutex};
+
+    // The same file is never read, cooked and uploaded twice at once, nor its cooked file written by two workers
+    const auto Loading = LoadingHandles.find(PathKey);
+    if (Loading != LoadingHandles.end())
+        return Loading->second;
+
+    LoadingHandles.emplace(PathKey, Handle);
+
+    const uint64_t LoadId = NextLoadId++;
+    ReadingRequests.emplace(LoadId, LoadRequest{Filepath, Settings, Handle, PathKey});
+
+    // Packaged meshes are already mapped, so they are handed to a worker right away
+    if (LavaPackage::IsMounted(Filepath + LavaMeshCache::Extension))
+    {
+        FileReadResult NotRead{};
+        NotRead.UserData = LoadId;
+        NotRead.Filepath = Filepath;
+        ReadCompletions.Push(std::move(NotRead));
+        return Handle;
+    }
+
+    // Otherwise the cache file is read ahead of the worker
+    Handle->ReadRequestId = Reader.Read(LavaMeshCache::GetCachePath(Filepath), ReadCompletions, Priority, LoadId);
+
+    return Handle;
+}
+
+bool LavaModelLoader::Cancel(const std::shared_ptr<LavaModelHandle>& Handle)
+{
+    std::lock_guard<std::mutex> Lock{Mutex};
+    return Handle->ReadRequestId != 0 && Reader.Cancel(Handle->ReadRequestId);
+}
+
+void LavaModelLoader::WorkerLoop()
+{
+    while (true)
+    {
+        FileReadResult Read{};
+        if (!ReadCompletions.Pop(Read))
+            return;
+
+        LoadRequest Request{};
+        {
+            std::lock_guard<std::mutex> Lock{Mutex};
+            auto Found = ReadingRequests.find(Read.UserData);
+            if (bStopping || Found == ReadingRequests.end())
+                continue;
+
+            Request = std::move(Found->second);
+            ReadingRequests.erase(Found);
+            ++BusyWorkers;
+        }
+
+        if (Read.Status == FileReadStatus::Cancelled)
+        {
+            std::lock_guard<std::mutex> Lock{Mutex};
+            FailLocked(Request.PathKey, *Request.Handle, "Cancelled");
+            --BusyWorkers;
+            continue;
+        }
+
+        // A failed read only means that the model is packaged or has not been cooked yet, which the normal path takes care of
+        LavaMappedFile CookedFile{};
+        if (Read.Status == FileReadStatus::Completed)
+        {
+            CookedFile = LavaMappedFile{std::move(Read.Data)};
+        }
+
+        PendingModel Parsed{};
+        Parsed.Handle = Request.Handle;
+        Parsed.SettingsHash = Request.Settings.GetHash();
+        Parsed.PathKey = Request.PathKey;
+
+        std::string Error = "Failed to load " + Request.Filepath;
+
+        try
+        {
+            // Buffer creation and mapping only need the device, the copies are recorded later by Update
+            if (Registry)
+            {
+                Parsed.Model = Registry->Load(Device, Request.Filepath, Request.Settings, &Parsed.Uploads, std::move(CookedFile));
+            }
+            else
+            {
+                Parsed.Model = LavaModel::CreateModelFromFile(Device, Request.Filepath, Request.Settings, &Parsed.Uploads, std::move(CookedFile));
+            }
+
+        }
+        catch (const std::exception& Exception)
+        {
+            Error = Exception.what();
+            std::cout << "Unable to load " << Request.Filepath << ": " << Exception.what() << std::endl;
+        }
+
+        std::lock_guard<std::mutex> Lock{Mutex};
+        if (!Parsed.Model)
+        {
+            FailLocked(Parsed.PathKey, *Parsed.Handle, Error);
+        }
+        else if (Parsed.Uploads.empty())
+        {
+            // Shared with a model that is already resident
+            Publish(*Parsed.Handle, Parsed.Model);
+            LoadingHandles.erase(Parsed.PathKey);
+        }
+        else
+        {
+            ParsedModels.push_back(std::move(Parsed));
+        }
+        --BusyWorkers;
+    }
+}
+
+void LavaModelLoader::Update()
+{
+    // Completed batches are released in submission order, the ones still running stay for the next frame
+    LavaStagingRing& StagingRing = Device.stagingRing();
+    size_t CompletedBatches = 0;
+    while (CompletedBatches < InFlightBatches.size() && StagingRing.IsComplete(InFlightBatches[CompletedBatches].Token))
+    {
+        UploadBatch& Batch = InFlightBatches[CompletedBatches];
+        for (PendingModel& Pending : Batch.Models)
+        {
+            // Content registered by another load meanwhile wins, this copy is released with the batch
+            Publish(*Pending.Handle, Registry ? Registry->Register(Pending.Handle->GetFilepath(), Pending.SettingsHash, Pending.Model) : Pending.Model);
+        }
+
+        {
+            std::lock_guard<std::mutex> Lock{Mutex};
+            for (const PendingModel& Pending : Batch.Models)
+            {
+                LoadingHandles.erase(Pending.PathKey);
+            }
+        }
+
+        ++CompletedBatches;
+    }
+
+    // Releases the models that have not been published
+    InFlightBatches.erase(InFlightBatches.begin(), InFlightBatches.begin() + CompletedBatches);
+
+    std::vector<PendingModel> Models{};
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        Models.swap(ParsedModels);
+    }
+
+    if (!Models.empty())
+    {
+        SubmitBatch(std::move(Models));
+    }
+}
+
+bool LavaModelLoader::IsIdle()
+{
+    std::lock_guard<std::mutex> Lock{Mutex};
+    return ReadingRequests.empty() && ParsedModels.empty() && BusyWorkers == 0 && InFlightBatches.empty();
+}
+
+void LavaModelLoader::FailLocked(const std::string& PathKey, LavaModelHandle& Handle, const std::string& Error)
+{
+    Handle.Error = Error;
+    Handle.State.store(ModelLoadState::Failed, std::memory_order_release);
+    LoadingHandles.erase(PathKey);
+}
+
+void LavaModelLoader::SubmitBatch(std::vector<PendingModel>&& Models)
+{
+    UploadBatch Batch{};
+    Batch.Models = std::move(Models);
+
+    // The copies of every model parsed since the last frame go in a single submission
+    LavaUploadBatch Uploads{Device};
+    for (PendingModel& Pending : Batch.Models)
+    {
+        for (BufferUpload& Upload : Pending.Uploads)
+        {
+            Uploads.AddUpload(std::move(Upload.Staging), Upload.Dst.GetBuffer(), Upload.Dst.GetOffset());
+        }
+
+        Pending.Uploads.clear();
+        Pending.Handle->State.store(ModelLoadState::Uploading, std::memory_order_release);
+    }
+
+    Batch.Token = Uploads.Submit();
+    InFlightBatches.push_back(std::move(Batch));
+}
+
+void LavaModelLoader::Publish(LavaModelHandle& Handle, const std::shared_ptr<LavaModel>& Model)
+{
+    Handle.Model = Model;
+    Handle.State.store(ModelLoadState::Resident, std::memory_order_release);
+}
+
+}
@@ -0,0 +1,207 @@
+//
+//  LavaModelRegistry.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaModelRegistry.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#include "LavaMeshCache.hpp"
+
+namespace lava
+{
+
+LavaModelRegistry::LavaModelRegistry(size_t InRetainedModelCount)
+    : RetainedModelCount(InRetainedModelCount)
+{
+}
+
+std::shared_ptr<LavaModel> LavaModelRegistry::Load
+    ( LavaDevice& Device
+    , const std::string& Filepath
+    , const MeshOptimizationSettings& Settings
+    , std::vector<BufferUpload>* DeferredUploads
+    , LavaMappedFile CookedFile )
+{
+    const uint64_t SettingsHash = Settings.GetHash();
+    const std::string PathKey = MakePathKey(Filepath, SettingsHash);
+
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        if (std::shared_ptr<LavaModel> Model = FindByPathLocked(PathKey))
+            return Model;
+    }
+
+    // The content hash is known before creating any buffer, either from the cooked file or from the freshly cooked data
+    LavaMeshCache CookedMesh{};
+    Builder ModelBuilder{};
+    const bool bCooked = CookedMesh.Open(Filepath, SettingsHash, std::move(CookedFile));
+    if (!bCooked)
+    {
+        ModelBuilder.CookFile(Filepath, Settings);
+    }
+
+    const uint64_t ContentHash = bCooked ? CookedMesh.GetContentHash() : ModelBuilder.ContentHash;
+
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        if (std::shared_ptr<LavaModel> Model = FindByContentLocked(ContentHash))
+        {
+            ModelsByPath[PathKey] = Model;
+            std::cout << "Sharing the model of " << Filepath << " with an identical one" << std::endl;
+            return Model;
+        }
+    }
+
+    std::shared_ptr<LavaModel> Model = bCooked
+        ? std::make_shared<LavaModel>(Device, CookedMesh, DeferredUploads)
+        : std::make_shared<LavaModel>(Device, ModelBuilder, DeferredUploads);
+
+    return DeferredUploads ? Model : Register(Filepath, SettingsHash, Model);
+}
+
+std::shared_ptr<LavaModel> LavaModelRegistry::FindByPath(const std::string& Filepath, uint64_t SettingsHash)
+{
+    const std::string PathKey = MakePathKey(Filepath, SettingsHash);
+
+    std::lock_guard<std::mutex> Lock{Mutex};
+    return FindByPathLocked(PathKey);
+}
+
+std::shared_ptr<LavaModel> LavaModelRegistry::FindByContent(uint64_t ContentHash)
+{
+    std::lock_guard<std::mutex> Lock{Mutex};
+    return FindByContentLocked(ContentHash);
+}
+
+std::shared_ptr<LavaModel> LavaModelRegistry::Register(const std::string& Filepath, uint64_t SettingsHash, const std::shared_ptr<LavaModel>& Model)
+{
+    const std::string PathKey = MakePathKey(Filepath, SettingsHash);
+
+    std::lock_guard<std::mutex> Lock{Mutex};
+    RemoveExpired();
+
+    // Another user might have registered the same content while this model was loading
+    std::shared_ptr<LavaModel> Registered = FindByContentLocked(Model->GetContentHash());
+    if (!Registered)
+    {
+        Registered = Model;
+        ModelsByContent[Model->GetContentHash()] = Model;
+        Touch(Model);
+    }
+
+    ModelsByPath[PathKey] = Registered;
+    return Registered;
+}
+
+void LavaModelRegistry::SetRetainedModelCount(size_t InRetainedModelCount)
+{
+    std::lock_guard<std::mutex> Lock{Mutex};
+    RetainedModelCount = InRetainedModelCount;
+
+    while (RetainedModels.size() > RetainedModelCount)
+    {
+        RetainedPositions.erase(RetainedModels.back().get());
+        RetainedModels.pop_back();
+    }
+}
+
+void LavaModelRegistry::Clear()
+{
+    std::lock_guard<std::mutex> Lock{Mutex};
+    RetainedModels.clear();
+    RetainedPositions.clear();
+    RemoveExpired();
+}
+
+size_t LavaModelRegistry::GetModelCount()
+{
+    std::lock_guard<std::mutex> Lock{Mutex};
+    RemoveExpired();
+    return ModelsByContent.size();
+}
+
+std::string LavaModelRegistry::MakePathKey(const std::string& Filepath, uint64_t SettingsHash)
+{
+    // Different spellings of the same file (relative, with "..", through links) share the same key
+    std::error_code Error;
+    std::filesystem::path CanonicalPath = std::filesystem::weakly_canonical(Filepath, Error);
+    if (Error)
+    {
+        CanonicalPath = std::filesystem::absolute(Filepath, Error).lexically_normal();
+    }
+
+    return CanonicalPath.string() + "|" + std::to_string(SettingsHash);
+}
+
+std::shared_ptr<LavaModel> LavaModelRegistry::FindByPathLocked(const std::string& PathKey)
+{
+    const auto Found = ModelsByPath.find(PathKey);
+    if (Found == ModelsByPath.end())
+        return nullptr;
+
+    std::shared_ptr<LavaModel> Model = Found->second.lock();
+    if (Model)
+    {
+        Touch(Model);
+    }
+
+    return Model;
+}
+
+std::shared_ptr<LavaModel> LavaModelRegistry::FindByContentLocked(uint64_t ContentHash)
+{
+    const auto Found = ModelsByContent.find(ContentHash);
+    if (Found == ModelsByContent.end())
+        return nullptr;
+
+    std::shared_ptr<LavaModel> Model = Found->second.lock();
+    if (Model)
+    {
+        Touch(Model);
+    }
+
+    return Model;
+}
+
+void LavaModelRegistry::Touch(const std::shared_ptr<LavaModel>& Model)
+{
+    if (RetainedModelCount == 0)
+        return;
+
+    const auto Found = RetainedPositions.find(Model.get());
+    if (Found != RetainedPositions.end())
+    {
+        RetainedModels.splice(RetainedModels.begin(), RetainedModels, Found->second);
+        return;
+    }
+
+    RetainedModels.push_front(Model);
+    RetainedPositions[Model.get()] = RetainedModels.begin();
+
+    if (RetainedModels.size() > RetainedModelCount)
+    {
+        RetainedPositions.erase(RetainedModels.back().get());
+        RetainedModels.pop_back();
+    }
+}
+
+void LavaModelRegistry::RemoveExpired()
+{
+    for (auto It = ModelsByPath.begin(); It != ModelsByPath.end(); )
+    {
+        It = It->second.expired() ? ModelsByPath.erase(It) : std::next(It);
+    }
+
+    for (auto It = ModelsByContent.begin(); It != ModelsByContent.end(); )
+    {
+        It = It->second.expired() ? ModelsByContent.erase(It) : std::next(It);
+    }
+}
+
+}
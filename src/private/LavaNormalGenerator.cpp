@@ -0,0 +1,248 @@
+//
+//  LavaNormalGenerator.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaNormalGenerator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "LavaUtils.hpp"
+#include "LavaVertexWelder.hpp"
+
+namespace lava
+{
+
+namespace
+{
+
+constexpr uint32_t EmptyIndex = UINT32_MAX;
+
+// Assigns the same id to all the vertices sharing a position, whatever their other attributes. Returns the number of ids
+uint32_t AssignPositionIds(const std::vector<Vertex>& Vertices, std::vector<uint32_t>& PositionIds)
+{
+    size_t Capacity = 16;
+    while (Capacity < Vertices.size() * 2)
+    {
+        Capacity *= 2;
+    }
+
+    // Each slot holds the first vertex found with that position
+    std::vector<uint32_t> Slots(Capacity, EmptyIndex);
+    const size_t Mask = Capacity - 1;
+
+    PositionIds.resize(Vertices.size());
+    uint32_t PositionCount = 0;
+
+    for (uint32_t VertexIdx = 0; VertexIdx < Vertices.size(); ++VertexIdx)
+    {
+        // +0 and -0 are the same position but differ in their bits
+        const glm::vec3 Position = Vertices[VertexIdx].position + glm::vec3{0.f};
+        const uint64_t Hash = HashBytes(&Position, sizeof(Position));
+
+        for (size_t SlotIdx = Hash & Mask; ; SlotIdx = (SlotIdx + 1) & Mask)
+        {
+            if (Slots[SlotIdx] == EmptyIndex)
+            {
+                Slots[SlotIdx] = VertexIdx;
+                PositionIds[VertexIdx] = PositionCount++;
+                break;
+            }
+
+            if (Vertices[Slots[SlotIdx]].position + glm::vec3{0.f} == Position)
+            {
+                PositionIds[VertexIdx] = PositionIds[Slots[SlotIdx]];
+                break;
+            }
+        }
+    }
+
+    return PositionCount;
+}
+
+}
+
+uint32_t LavaNormalGenerator::Generate(std::vector<Vertex>& Vertices, std::vector<uint32_t>& Indices, const NormalSettings& Settings)
+{
+    const bool bAnyMissing = std::any_of(Vertices.begin(), Vertices.end(), [](const Vertex& V) { return V.normal == glm::vec3{0.f}; });
+    if (!bAnyMissing || Indices.size() < 3)
+        return 0;
+
+    const size_t TriangleCount = Indices.size() / 3;
+    const size_t CornerCount = TriangleCount * 3;
+
+    // Unit face normals and the weight of each corner. Kept as flat arrays indexed by triangle and
+    // corner, so that each pass reads and writes contiguous memory and the later passes only gather by index
+    std::vector<glm::vec3> FaceNormals(TriangleCount);
+    std::vector<float> CornerWeights(CornerCount);
+
+    ParallelFor(TriangleCount, MinRangeSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t TriangleIdx = Begin; TriangleIdx < End; ++TriangleIdx)
+        {
+            const glm::vec3& A = Vertices[Indices[TriangleIdx * 3]].position;
+            const glm::vec3& B = Vertices[Indices[TriangleIdx * 3 + 1]].position;
+            const glm::vec3& C = Vertices[Indices[TriangleIdx * 3 + 2]].position;
+
+            const glm::vec3 AB = B - A;
+            const glm::vec3 AC = C - A;
+            const glm::vec3 BC = C - B;
+
+            const glm::vec3 Cross = glm::cross(AB, AC);
+            const float DoubleArea = glm::length(Cross);
+            FaceNormals[TriangleIdx] = DoubleArea > 0.f ? Cross / DoubleArea : glm::vec3{0.f};
+
+            // Corner angles from the edge directions, clamped against rounding errors
+            const auto Angle = [](const glm::vec3& U, const glm::vec3& V)
+            {
+                const float Lengths = glm::length(U) * glm::length(V);
+                return Lengths > 0.f ? std::acos(std::clamp(glm::dot(U, V) / Lengths, -1.f, 1.f)) : 0.f;
+            };
+
+            float Weights[3] = {1.f, 1.f, 1.f};
+            if (Settings.Weighting != NormalWeighting::Area)
+            {
+                Weights[0] = Angle(AB, AC);
+                Weights[1] = Angle(-AB, BC);
+                Weights[2] = Angle(-AC, -BC);
+            }
+
+            const float AreaWeight = Settings.Weighting == NormalWeighting::Angle ? 1.f : DoubleArea;
+            for (size_t Corner = 0; Corner < 3; ++Corner)
+            {
+                CornerWeights[TriangleIdx * 3 + Corner] = Weights[Corner] * AreaWeight;
+            }
+        }
+    });
+
+    std::vector<uint32_t> PositionIds{};
+    const uint32_t PositionCount = AssignPositionIds(Vertices, PositionIds);
+
+    // Corners bucketed by position (compressed rows). Counting and filling only use atomic increments
+    std::vector<std::atomic<uint32_t>> BucketCursors(PositionCount + 1);
+    for (std::atomic<uint32_t>& Cursor : BucketCursors)
+    {
+        Cursor.store(0, std::memory_order_relaxed);
+    }
+
+    ParallelFor(CornerCount, MinRangeSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t CornerIdx = Begin; CornerIdx < End; ++CornerIdx)
+        {
+            BucketCursors[PositionIds[Indices[CornerIdx]] + 1].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    std::vector<uint32_t> BucketOffsets(PositionCount + 1, 0);
+    for (uint32_t PositionId = 0; PositionId < PositionCount; ++PositionId)
+    {
+        BucketOffsets[PositionId + 1] = BucketOffsets[PositionId] + BucketCursors[PositionId + 1].load(std::memory_order_relaxed);
+        BucketCursors[PositionId].store(BucketOffsets[PositionId], std::memory_order_relaxed);
+    }
+
+    std::vector<uint32_t> BucketCorners(CornerCount);
+    ParallelFor(CornerCount, MinRangeSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t CornerIdx = Begin; CornerIdx < End; ++CornerIdx)
+        {
+            const uint32_t Slot = BucketCursors[PositionIds[Indices[CornerIdx]]].fetch_add(1, std::memory_order_relaxed);
+            BucketCorners[Slot] = static_cast<uint32_t>(CornerIdx);
+        }
+    });
+
+    // Every position is owned by a single thread, which writes the normals of its own corners only
+    std::vector<glm::vec3> CornerNormals(CornerCount, glm::vec3{0.f});
+    const float CreaseCosine = std::cos(std::clamp(Settings.CreaseAngle, 0.f, 3.1416f));
+
+    ParallelFor(PositionCount, MinRangeSize, [&](size_t Begin, size_t End)
+    {
+        struct SmoothingGroup
+        {
+            glm::vec3 Representative; // Normal of the first triangle of the group
+            glm::vec3 Sum;
+        };
+
+        std::vector<SmoothingGroup> Groups{};
+        std::vector<uint32_t> CornerGroups{};
+
+        for (size_t PositionId = Begin; PositionId < End; ++PositionId)
+        {
+            uint32_t* const First = BucketCorners.data() + BucketOffsets[PositionId];
+            uint32_t* const Last = BucketCorners.data() + BucketOffsets[PositionId + 1];
+
+            const bool bNeedsNormals = std::any_of(First, Last, [&](uint32_t CornerIdx) { return Vertices[Indices[CornerIdx]].normal == glm::vec3{0.f}; });
+            if (!bNeedsNormals)
+                continue;
+
+            // The order of the atomic fill depends on the threads, the groups must not
+            std::sort(First, Last);
+
+            Groups.clear();
+            CornerGroups.assign(Last - First, EmptyIndex);
+
+            for (uint32_t* Corner = First; Corner != Last; ++Corner)
+            {
+                const glm::vec3& FaceNormal = FaceNormals[*Corner / 3];
+
+                // Degenerate triangles take the normal of the first group
+                if (FaceNormal == glm::vec3{0.f})
+                    continue;
+
+                uint32_t GroupIdx = 0;
+                while (GroupIdx < Groups.size() && glm::dot(Groups[GroupIdx].Representative, FaceNormal) < CreaseCosine)
+                {
+                    ++GroupIdx;
+                }
+
+                if (GroupIdx == Groups.size())
+                {
+                    Groups.push_back({FaceNormal, glm::vec3{0.f}});
+                }
+
+                Groups[GroupIdx].Sum += FaceNormal * CornerWeights[*Corner];
+                CornerGroups[Corner - First] = GroupIdx;
+            }
+
+            for (uint32_t* Corner = First; Corner != Last; ++Corner)
+            {
+                if (Groups.empty())
+                    break;
+
+                const uint32_t GroupIdx = CornerGroups[Corner - First] == EmptyIndex ? 0 : CornerGroups[Corner - First];
+                const glm::vec3& Sum = Groups[GroupIdx].Sum;
+                const float Length = glm::length(Sum);
+                CornerNormals[*Corner] = Length > 0.f ? Sum / Length : Groups[GroupIdx].Representative;
+            }
+        }
+    });
+
+    // Corners of the same vertex in different groups now need different vertices
+    std::vector<Vertex> SourceVertices{};
+    SourceVertices.swap(Vertices);
+
+    LavaVertexWelder Welder{Vertices, SourceVertices.size()};
+    uint32_t GeneratedCount = 0;
+
+    for (size_t CornerIdx = 0; CornerIdx < Indices.size(); ++CornerIdx)
+    {
+        Vertex V = SourceVertices[Indices[CornerIdx]];
+        const bool bGenerated = V.normal == glm::vec3{0.f} && CornerIdx < CornerCount;
+        if (bGenerated)
+        {
+            V.normal = CornerNormals[CornerIdx];
+        }
+
+        const size_t PreviousCount = Vertices.size();
+        Indices[CornerIdx] = Welder.Insert(V);
+        GeneratedCount += bGenerated && Vertices.size() > PreviousCount ? 1 : 0;
+    }
+
+    return GeneratedCount;
+}
+
+}
@@ -0,0 +1,719 @@
+//
+//  LavaObjParser.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaObjParser.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "LavaMappedFile.hpp"
+#include "LavaUtils.hpp"
+
+namespace lava
+{
+
+#pragma region Helpers
+
+namespace
+{
+
+// Result of the parsing of a single chunk. Indices of faces are stored as they are written in the file until
+// the merge, since negative indices are relative to the number of elements declared so far (also in previous chunks)
+struct ObjChunk
+{
+    std::vector<float> Positions{};
+    std::vector<float> Colors{};
+    std::vector<float> Normals{};
+    std::vector<float> TexCoords{};
+
+    // Faces are kept as polygons until the merge, since triangulating a quad requires its positions
+    // and they might have been declared in a previous chunk
+    std::vector<ObjIndex> Corners{};
+    std::vector<uint32_t> PolygonSizes{};
+    size_t TriangulatedCornerCount = 0;
+
+    // Corner components whose index is relative to the start of this chunk, as (CornerIdx * 3 + Component)
+    std::vector<uint32_t> RelativeCorners{};
+
+    std::vector<std::string> MaterialLibraries{};
+
+    // Names are local to the chunk until the merge. Polygons before the first usemtl of the chunk keep the
+    // material selected by the previous chunks
+    std::vector<std::string> MaterialNames{};
+
+    // usemtl records, as (first polygon they apply to, local material)
+    std::vector<std::pair<uint32_t, uint32_t>> MaterialSwitches{};
+
+    std::string Error{};
+};
+
+inline bool IsSpace(const char C)
+{
+    return C == ' ' || C == '\t';
+}
+
+inline bool IsLineEnd(const char C)
+{
+    return C == '\n' || C == '\r';
+}
+
+inline void SkipSpaces(const char*& Cursor, const char* End)
+{
+    while (Cursor < End && IsSpace(*Cursor))
+        ++Cursor;
+}
+
+inline void SkipLine(const char*& Cursor, const char* End)
+{
+    while (Cursor < End && *Cursor != '\n')
+        ++Cursor;
+
+    if (Cursor < End)
+        ++Cursor;
+}
+
+// Rest of the line, without the surrounding spaces. Advances Cursor to the end of the line
+inline std::string ParseLineString(const char*& Cursor, const char* End)
+{
+    SkipSpaces(Cursor, End);
+    const char* Start = Cursor;
+    while (Cursor < End && !IsLineEnd(*Cursor))
+        ++Cursor;
+
+    const char* Last = Cursor;
+    while (Last > Start && IsSpace(Last[-1]))
+        --Last;
+
+    return std::string(Start, Last);
+}
+
+inline bool IsKeyword(const char* Token, const char* End, const char* Keyword, size_t Length)
+{
+    return static_cast<size_t>(End - Token) > Length && std::strncmp(Token, Keyword, Length) == 0 && IsSpace(Token[Length]);
+}
+
+inline bool IsIntegerStart(const char C)
+{
+    return (C >= '0' && C <= '9') || C == '-' || C == '+';
+}
+
+// Returns false when there is no digit, or when the value does not fit in 32 bits. Out of range values saturate
+// OutValue, and Cursor is moved past all their digits
+inline bool ParseInt(const char*& Cursor, const char* End, int32_t& OutValue)
+{
+    bool bNegative = false;
+    if (Cursor < End && (*Cursor == '-' || *Cursor == '+'))
+    {
+        bNegative = *Cursor == '-';
+        ++Cursor;
+    }
+
+    const int64_t Limit = bNegative ? -static_cast<int64_t>(std::numeric_limits<int32_t>::min()) : std::numeric_limits<int32_t>::max();
+
+    const char* Start = Cursor;
+    int64_t Value = 0;
+    bool bOutOfRange = false;
+    while (Cursor < End && *Cursor >= '0' && *Cursor <= '9')
+    {
+        if (!bOutOfRange)
+        {
+            Value = Value * 10 + (*Cursor - '0');
+            bOutOfRange = Value > Limit;
+        }
+        ++Cursor;
+    }
+
+    if (bOutOfRange)
+    {
+        OutValue = bNegative ? std::numeric_limits<int32_t>::min() : std::numeric_limits<int32_t>::max();
+        return false;
+    }
+
+    OutValue = static_cast<int32_t>(bNegative ? -Value : Value);
+    return Cursor != Start;
+}
+
+// Converts the OBJ index (1-based, or negative if relative to the last element) to a 0-based index
+// Returns true when the result is relative to the start of the chunk, and must be fixed during the merge
+inline bool ResolveIndex(const int32_t RawIndex, const size_t LocalCount, int32_t& OutIndex)
+{
+    if (RawIndex > 0)
+    {
+        OutIndex = RawIndex - 1;
+        return false;
+    }
+
+    OutIndex = static_cast<int32_t>(LocalCount) + RawIndex;
+    return true;
+}
+
+// Polygon vertex, with one bit for each of its components that is relative to the chunk
+struct PolygonCorner
+{
+    ObjIndex Index{};
+    uint8_t RelativeMask = 0;
+};
+
+void ParseFace(const char*& Cursor, const char* End, ObjChunk& Chunk, std::vector<PolygonCorner>& Polygon)
+{
+    Polygon.clear();
+
+    const size_t PositionCount = Chunk.Positions.size() / 3;
+    const size_t TexCoordCount = Chunk.TexCoords.size() / 2;
+    const size_t NormalCount = Chunk.Normals.size() / 3;
+
+    while (true)
+    {
+        SkipSpaces(Cursor, End);
+        if (Cursor >= End || IsLineEnd(*Cursor) || *Cursor == '#')
+            break;
+
+        ObjIndex Index{};
+        uint8_t RelativeMask = 0;
+        int32_t RawIndex = 0;
+
+        if (!ParseInt(Cursor, End, RawIndex) || RawIndex == 0)
+        {
+            Chunk.Error = "Malformed face record";
+            return;
+        }
+        RelativeMask |= ResolveIndex(RawIndex, PositionCount, Index.vertex_index) ? 1 : 0;
+
+        if (Cursor < End && *Cursor == '/')
+        {
+            ++Cursor;
+
+            // v//vn has no texture coordinate. Empty components are skipped, numbers have to be valid indices
+            if (Cursor < End && IsIntegerStart(*Cursor))
+            {
+                if (!ParseInt(Cursor, End, RawIndex))
+                {
+                    Chunk.Error = "Malformed face record";
+                    return;
+                }
+
+                if (RawIndex != 0)
+                {
+                    RelativeMask |= ResolveIndex(RawIndex, TexCoordCount, Index.texcoord_index) ? 2 : 0;
+                }
+            }
+
+            if (Cursor < End && *Cursor == '/')
+            {
+                ++Cursor;
+                if (Cursor < End && IsIntegerStart(*Cursor))
+                {
+                    if (!ParseInt(Cursor, End, RawIndex))
+                    {
+                        Chunk.Error = "Malformed face record";
+                        return;
+                    }
+
+                    if (RawIndex != 0)
+                    {
+                        RelativeMask |= ResolveIndex(RawIndex, NormalCount, Index.normal_index) ? 4 : 0;
+                    }
+                }
+            }
+        }
+
+        Polygon.push_back({Index, RelativeMask});
+    }
+
+    // Points and lines are not supported
+    if (Polygon.size() < 3)
+        return;
+
+    for (const PolygonCorner& Corner : Polygon)
+    {
+        const uint32_t CornerIdx = static_cast<uint32_t>(Chunk.Corners.size());
+        Chunk.Corners.push_back(Corner.Index);
+
+        for (uint32_t Component = 0; Component < 3; ++Component)
+        {
+            if (Corner.RelativeMask & (1 << Component))
+            {
+                Chunk.RelativeCorners.push_back(CornerIdx * 3 + Component);
+            }
+        }
+    }
+
+    Chunk.PolygonSizes.push_back(static_cast<uint32_t>(Polygon.size()));
+    Chunk.TriangulatedCornerCount += (Polygon.size() - 2) * 3;
+}
+
+// Splits each polygon into triangles and writes their corners to Output, and their materials to MaterialOutput
+// when the file uses materials. Quads are split along their shortest diagonal (like tinyobj does), other polygons
+// as a fan around their first vertex
+void TriangulateChunk
+    ( const ObjChunk& Chunk
+    , const std::vector<float>& Positions
+    , ObjIndex* Output
+    , int32_t* MaterialOutput
+    , const std::vector<int32_t>& GlobalMaterials
+    , int32_t Material )
+{
+    auto Switch = Chunk.MaterialSwitches.begin();
+    uint32_t PolygonIdx = 0;
+
+    const auto SquaredDistance = [&Positions](const ObjIndex& A, const ObjIndex& B)
+    {
+        const float* PosA = &Positions[3 * static_cast<size_t>(A.vertex_index)];
+        const float* PosB = &Positions[3 * static_cast<size_t>(B.vertex_index)];
+        const float X = PosB[0] - PosA[0];
+        const float Y = PosB[1] - PosA[1];
+        const float Z = PosB[2] - PosA[2];
+        return X * X + Y * Y + Z * Z;
+    };
+
+    const ObjIndex* Polygon = Chunk.Corners.data();
+    for (const uint32_t PolygonSize : Chunk.PolygonSizes)
+    {
+        for (; Switch != Chunk.MaterialSwitches.end() && Switch->first == PolygonIdx; ++Switch)
+        {
+            Material = GlobalMaterials[Switch->second];
+        }
+
+        if (MaterialOutput)
+        {
+            MaterialOutput = std::fill_n(MaterialOutput, PolygonSize - 2, Material);
+        }
+
+        if (PolygonSize == 4 && SquaredDistance(Polygon[0], Polygon[2]) >= SquaredDistance(Polygon[1], Polygon[3]))
+        {
+            // [0, 1, 3], [1, 2, 3]
+            const uint32_t Order[6] = {0, 1, 3, 1, 2, 3};
+            for (const uint32_t CornerIdx : Order)
+            {
+                *Output++ = Polygon[CornerIdx];
+            }
+        }
+        else
+        {
+            for (uint32_t i = 1; i + 1 < PolygonSize; ++i)
+            {
+                *Output++ = Polygon[0];
+                *Output++ = Polygon[i];
+                *Output++ = Polygon[i + 1];
+            }
+        }
+
+        Polygon += PolygonSize;
+        ++PolygonIdx;
+    }
+}
+
+void ParseChunk(const char* Begin, const char* End, ObjChunk& Chunk)
+{
+    // Rough estimate of the number of elements, based on the average length of a line in common files
+    const size_t EstimatedLines = static_cast<size_t>(End - Begin) / 32;
+    Chunk.Positions.reserve(EstimatedLines * 3 / 2);
+    Chunk.Corners.reserve(EstimatedLines * 3 / 2);
+
+    std::vector<PolygonCorner> Polygon;
+    Polygon.reserve(16);
+
+    const char* Cursor = Begin;
+    while (Cursor < End && Chunk.Error.empty())
+    {
+        SkipSpaces(Cursor, End);
+        if (Cursor >= End)
+            break;
+
+        const char* Token = Cursor;
+
+        if (Token[0] == 'v' && Token + 1 < End && IsSpace(Token[1]))
+        {
+            Cursor += 2;
+
+            float Values[6] = {0.f, 0.f, 0.f, 1.f, 1.f, 1.f};
+            int ComponentCount = 0;
+            while (ComponentCount < 6)
+            {
+                SkipSpaces(Cursor, End);
+                if (Cursor >= End || IsLineEnd(*Cursor) || *Cursor == '#')
+                    break;
+
+                Values[ComponentCount++] = LavaObjParser::ParseFloat(Cursor, End);
+            }
+
+            Chunk.Positions.insert(Chunk.Positions.end(), Values, Values + 3);
+
+            // A vertex written as "x y z w" has no color, only a weight that we discard
+            const bool bHasColor = ComponentCount == 6;
+            Chunk.Colors.push_back(bHasColor ? Values[3] : 1.f);
+            Chunk.Colors.push_back(bHasColor ? Values[4] : 1.f);
+            Chunk.Colors.push_back(bHasColor ? Values[5] : 1.f);
+        }
+        else if (Token[0] == 'v' && Token + 2 < End && Token[1] == 'n' && IsSpace(Token[2]))
+        {
+            Cursor += 3;
+            for (int i = 0; i < 3; ++i)
+            {
+                SkipSpaces(Cursor, End);
+                Chunk.Normals.push_back(LavaObjParser::ParseFloat(Cursor, End));
+            }
+        }
+        else if (Token[0] == 'v' && Token + 2 < End && Token[1] == 't' && IsSpace(Token[2]))
+        {
+            Cursor += 3;
+            for (int i = 0; i < 2; ++i)
+            {
+                SkipSpaces(Cursor, End);
+                Chunk.TexCoords.push_back(LavaObjParser::ParseFloat(Cursor, End));
+            }
+        }
+        else if (Token[0] == 'f' && Token + 1 < End && IsSpace(Token[1]))
+        {
+            Cursor += 2;
+            ParseFace(Cursor, End, Chunk, Polygon);
+        }
+        else if (IsKeyword(Token, End, "usemtl", 6))
+        {
+            Cursor += 7;
+            const std::string Name = ParseLineString(Cursor, End);
+
+            const auto Found = std::find(Chunk.MaterialNames.begin(), Chunk.MaterialNames.end(), Name);
+            const uint32_t LocalMaterial = static_cast<uint32_t>(Found - Chunk.MaterialNames.begin());
+            if (Found == Chunk.MaterialNames.end())
+            {
+                Chunk.MaterialNames.push_back(Name);
+            }
+
+            Chunk.MaterialSwitches.push_back({static_cast<uint32_t>(Chunk.PolygonSizes.size()), LocalMaterial});
+        }
+        else if (IsKeyword(Token, End, "mtllib", 6))
+        {
+            Cursor += 7;
+            const std::string Libraries = ParseLineString(Cursor, End);
+
+            // Several libraries can be listed on the same line
+            size_t Start = 0;
+            while (Start < Libraries.size())
+            {
+                const size_t Separator = std::min(Libraries.find_first_of(" \t", Start), Libraries.size());
+                if (Separator > Start)
+                {
+                    Chunk.MaterialLibraries.push_back(Libraries.substr(Start, Separator - Start));
+                }
+                Start = Separator + 1;
+            }
+        }
+
+        // Everything else (comments, groups, smoothing groups, ...) is ignored
+        SkipLine(Cursor, End);
+    }
+}
+
+// Runs Task(ChunkIdx) for each chunk, spreading the chunks over the threads of ParallelFor
+template <typename TaskType>
+void ForEachChunk(const size_t ChunkCount, const TaskType& Task)
+{
+    ParallelFor(ChunkCount, 1, [&Task](const size_t Begin, const size_t End)
+    {
+        for (size_t ChunkIdx = Begin; ChunkIdx < End; ++ChunkIdx)
+        {
+            Task(ChunkIdx);
+        }
+    });
+}
+
+}
+
+#pragma endregion
+
+#pragma region Parsing
+
+float LavaObjParser::ParseFloat(const char*& Cursor, const char* End)
+{
+    static constexpr double PowersOf10[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* Start = Cursor;
+
+    bool bNegative = false;
+    if (Cursor < End && (*Cursor == '-' || *Cursor == '+'))
+    {
+        bNegative = *Cursor == '-';
+        ++Cursor;
+    }
+
+    // Up to 19 significant digits fit in the mantissa, the rest only moves the exponent
+    uint64_t Mantissa = 0;
+    int Exponent = 0;
+    int Digits = 0;
+    bool bAnyDigit = false;
+
+    while (Cursor < End && *Cursor >= '0' && *Cursor <= '9')
+    {
+        if (Digits < 19)
+        {
+            Mantissa = Mantissa * 10 + (*Cursor - '0');
+            Digits += Mantissa > 0 ? 1 : 0;
+        }
+        else
+        {
+            ++Exponent;
+        }
+        bAnyDigit = true;
+        ++Cursor;
+    }
+
+    if (Cursor < End && *Cursor == '.')
+    {
+        ++Cursor;
+        while (Cursor < End && *Cursor >= '0' && *Cursor <= '9')
+        {
+            if (Digits < 19)
+            {
+                Mantissa = Mantissa * 10 + (*Cursor - '0');
+                Digits += Mantissa > 0 ? 1 : 0;
+                --Exponent;
+            }
+            bAnyDigit = true;
+            ++Cursor;
+        }
+    }
+
+    if (!bAnyDigit)
+    {
+        // Not a plain decimal number (nan, inf or garbage): let the C library deal with the current token only
+        const char* TokenEnd = Start;
+        while (TokenEnd < End && !IsSpace(*TokenEnd) && !IsLineEnd(*TokenEnd))
+            ++TokenEnd;
+
+        char Buffer[64];
+        const size_t Length = std::min(static_cast<size_t>(TokenEnd - Start), sizeof(Buffer) - 1);
+        memcpy(Buffer, Start, Length);
+        Buffer[Length] = '\0';
+
+        char* ParseEnd = nullptr;
+        const float Value = strtof(Buffer, &ParseEnd);
+        Cursor = Start + (ParseEnd - Buffer);
+
+        // Always make progress, also on malformed input
+        if (Cursor == Start)
+        {
+            Cursor = TokenEnd;
+        }
+        return Value;
+    }
+
+    if (Cursor < End && (*Cursor == 'e' || *Cursor == 'E'))
+    {
+        ++Cursor;
+        // Saturated when out of range. Clamped well past the range of doubles, which still gives infinity or zero
+        int32_t ExplicitExponent = 0;
+        ParseInt(Cursor, End, ExplicitExponent);
+        Exponent += std::clamp(ExplicitExponent, -1000, 1000);
+    }
+
+    double Value = static_cast<double>(Mantissa);
+    if (Exponent < 0)
+    {
+        Value = -Exponent <= 22 ? Value / PowersOf10[-Exponent] : Value * std::pow(10.0, Exponent);
+    }
+    else if (Exponent > 0)
+    {
+        Value = Exponent <= 22 ? Value * PowersOf10[Exponent] : Value * std::pow(10.0, Exponent);
+    }
+
+    return static_cast<float>(bNegative ? -Value : Value);
+}
+
+ObjData LavaObjParser::ParseFile(const std::string& Filepath, uint32_t ThreadCount)
+{
+    LavaMappedFile File{Filepath};
+    if (!File.IsOpen())
+    {
+        throw std::runtime_error("Failed to open file: " + Filepath);
+    }
+
+    return Parse(File.GetData(), File.GetSize(), ThreadCount);
+}
+
+ObjData LavaObjParser::Parse(const char* Data, size_t Size, uint32_t ThreadCount)
+{
+    if (ThreadCount == 0)
+    {
+        ThreadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Small files are parsed on the calling thread only
+    const size_t ChunkCount = std::max<size_t>(1, std::min<size_t>(ThreadCount, Size / MinChunkSize));
+
+    // Each chunk ends right after a new line, so that no record is split between two chunks
+    std::vector<const char*> ChunkBounds(ChunkCount + 1);
+    ChunkBounds[0] = Data;
+    ChunkBounds[ChunkCount] = Data + Size;
+    for (size_t i = 1; i < ChunkCount; ++i)
+    {
+        const char* Bound = std::max(ChunkBounds[i - 1], Data + Size * i / ChunkCount);
+        const char* End = Data + Size;
+        while (Bound < End && *Bound != '\n')
+            ++Bound;
+
+        ChunkBounds[i] = Bound < End ? Bound + 1 : End;
+    }
+
+    std::vector<ObjChunk> Chunks(ChunkCount);
+    ForEachChunk(ChunkCount, [&Chunks, &ChunkBounds](const size_t ChunkIdx)
+    {
+        ParseChunk(ChunkBounds[ChunkIdx], ChunkBounds[ChunkIdx + 1], Chunks[ChunkIdx]);
+    });
+
+    for (const ObjChunk& Chunk : Chunks)
+    {
+        if (!Chunk.Error.empty())
+        {
+            throw std::runtime_error(Chunk.Error);
+        }
+    }
+
+    // Computes where each chunk is going to be placed inside the merged arrays
+    struct ChunkOffsets
+    {
+        size_t Positions = 0;
+        size_t Normals = 0;
+        size_t TexCoords = 0;
+        size_t Corners = 0;
+    };
+
+    std::vector<ChunkOffsets> Offsets(ChunkCount + 1);
+    for (size_t i = 0; i < ChunkCount; ++i)
+    {
+        Offsets[i + 1].Positions = Offsets[i].Positions + Chunks[i].Positions.size();
+        Offsets[i + 1].Normals = Offsets[i].Normals + Chunks[i].Normals.size();
+        Offsets[i + 1].TexCoords = Offsets[i].TexCoords + Chunks[i].TexCoords.size();
+        Offsets[i + 1].Corners = Offsets[i].Corners + Chunks[i].TriangulatedCornerCount;
+    }
+
+    const ChunkOffsets& Totals = Offsets[ChunkCount];
+
+    ObjData Result;
+    Result.Positions.resize(Totals.Positions);
+    Result.Colors.resize(Totals.Positions);
+    Result.Normals.resize(Totals.Normals);
+    Result.TexCoords.resize(Totals.TexCoords);
+    Result.Corners.resize(Totals.Corners);
+
+    const int64_t PositionCount = static_cast<int64_t>(Totals.Positions / 3);
+    const int64_t TexCoordCount = static_cast<int64_t>(Totals.TexCoords / 2);
+    const int64_t NormalCount = static_cast<int64_t>(Totals.Normals / 3);
+
+    std::vector<uint8_t> bOutOfBounds(ChunkCount, 0);
+
+    ForEachChunk(ChunkCount, [&](const size_t ChunkIdx)
+    {
+        ObjChunk& Chunk = Chunks[ChunkIdx];
+        const ChunkOffsets& Offset = Offsets[ChunkIdx];
+
+        std::copy(Chunk.Positions.begin(), Chunk.Positions.end(), Result.Positions.begin() + Offset.Positions);
+        std::copy(Chunk.Colors.begin(), Chunk.Colors.end(), Result.Colors.begin() + Offset.Positions);
+        std::copy(Chunk.Normals.begin(), Chunk.Normals.end(), Result.Normals.begin() + Offset.Normals);
+        std::copy(Chunk.TexCoords.begin(), Chunk.TexCoords.end(), Result.TexCoords.begin() + Offset.TexCoords);
+
+        // Relative indices only know about the elements of their own chunk
+        const int32_t ComponentOffsets[3] =
+        {
+            static_cast<int32_t>(Offset.Positions / 3),
+            static_cast<int32_t>(Offset.TexCoords / 2),
+            static_cast<int32_t>(Offset.Normals / 3)
+        };
+
+        for (const uint32_t Relative : Chunk.RelativeCorners)
+        {
+            ObjIndex& Corner = Chunk.Corners[Relative / 3];
+            int32_t* Indices[3] = {&Corner.vertex_index, &Corner.texcoord_index, &Corner.normal_index};
+            *Indices[Relative % 3] += ComponentOffsets[Relative % 3];
+
+            // Reaching before the first element, which would otherwise pass for a missing texture coordinate or normal
+            if (*Indices[Relative % 3] < 0)
+            {
+                bOutOfBounds[ChunkIdx] = 1;
+            }
+        }
+
+        for (const ObjIndex& Corner : Chunk.Corners)
+        {
+            if (Corner.vertex_index < 0 || Corner.vertex_index >= PositionCount
+                || Corner.texcoord_index >= TexCoordCount
+                || Corner.normal_index >= NormalCount)
+            {
+                bOutOfBounds[ChunkIdx] = 1;
+                break;
+            }
+        }
+    });
+
+    if (std::find(bOutOfBounds.begin(), bOutOfBounds.end(), 1) != bOutOfBounds.end())
+    {
+        throw std::runtime_error("Face index out of bounds");
+    }
+
+    // Material names become global, in the order they are first used. Each chunk starts with the material
+    // selected last by the previous ones
+    std::vector<std::vector<int32_t>> GlobalMaterials(ChunkCount);
+    std::vector<int32_t> FirstMaterials(ChunkCount, -1);
+    bool bUsesMaterials = false;
+    {
+        int32_t CurrentMaterial = -1;
+        for (size_t ChunkIdx = 0; ChunkIdx < ChunkCount; ++ChunkIdx)
+        {
+            const ObjChunk& Chunk = Chunks[ChunkIdx];
+            Result.MaterialLibraries.insert(Result.MaterialLibraries.end(), Chunk.MaterialLibraries.begin(), Chunk.MaterialLibraries.end());
+
+            for (const std::string& Name : Chunk.MaterialNames)
+            {
+                const auto Found = std::find(Result.MaterialNames.begin(), Result.MaterialNames.end(), Name);
+                GlobalMaterials[ChunkIdx].push_back(static_cast<int32_t>(Found - Result.MaterialNames.begin()));
+                if (Found == Result.MaterialNames.end())
+                {
+                    Result.MaterialNames.push_back(Name);
+                }
+            }
+
+            FirstMaterials[ChunkIdx] = CurrentMaterial;
+            if (!Chunk.MaterialSwitches.empty())
+            {
+                CurrentMaterial = GlobalMaterials[ChunkIdx][Chunk.MaterialSwitches.back().second];
+                bUsesMaterials = true;
+            }
+        }
+    }
+
+    if (bUsesMaterials)
+    {
+        Result.TriangleMaterials.resize(Totals.Corners / 3);
+    }
+
+    // Triangulation needs all the positions to be in place
+    ForEachChunk(ChunkCount, [&](const size_t ChunkIdx)
+    {
+        TriangulateChunk
+            ( Chunks[ChunkIdx]
+            , Result.Positions
+            , Result.Corners.data() + Offsets[ChunkIdx].Corners
+            , bUsesMaterials ? Result.TriangleMaterials.data() + Offsets[ChunkIdx].Corners / 3 : nullptr
+            , GlobalMaterials[ChunkIdx]
+            , FirstMaterials[ChunkIdx] );
+    });
+
+    return Result;
+}
+
+#pragma endregion
+
+}
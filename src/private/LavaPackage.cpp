@@ -0,0 +1,678 @@
+//
+//  LavaPackage.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaPackage.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+
+#include "LavaUtils.hpp"
+#include "LavaFileReader.hpp"
+
+namespace lava
+{
+
+namespace
+{
+
+// Blocks decompressed by each thread at least, smaller entries are decompressed by the calling thread alone
+constexpr size_t MinBlocksPerThread = 4;
+
+uint64_t AlignDataOffset(const uint64_t Offset)
+{
+    return (Offset + LavaPackage::DataAlignment - 1) & ~(LavaPackage::DataAlignment - 1);
+}
+
+uint64_t HashName(const std::string& Name)
+{
+    return HashBytes(Name.data(), Name.size());
+}
+
+uint32_t GetEntryBlockCount(const PackageEntry& Entry)
+{
+    return Entry.Compression == PackageCompression::Lz4 ? static_cast<uint32_t>((Entry.Size + LavaPackage::BlockSize - 1) / LavaPackage::BlockSize) : 0;
+}
+
+#pragma region Lz4
+
+// LZ4 block format: sequences of literals followed by a match (offset, length) copied from the output produced so far.
+// The last sequence only has literals. Only the block format is used, the frame format is not needed here
+
+constexpr uint32_t Lz4MinMatch = 4;
+constexpr uint32_t Lz4HashBits = 16;
+constexpr size_t Lz4MaxOffset = 65535;
+
+// The format requires the last 5 bytes to be literals, and the last match to start 12 bytes before the end at least
+constexpr size_t Lz4LastLiterals = 5;
+constexpr size_t Lz4MatchStartLimit = 12;
+
+uint32_t Read32(const uint8_t* Ptr)
+{
+    uint32_t Value;
+    std::memcpy(&Value, Ptr, sizeof(Value));
+    return Value;
+}
+
+uint8_t* WriteLength(uint8_t* Out, size_t Length)
+{
+    for (; Length >= 255; Length -= 255)
+    {
+        *Out++ = 255;
+    }
+
+    *Out++ = static_cast<uint8_t>(Length);
+    return Out;
+}
+
+// Greedy compressor with a single entry hash table. Returns the compressed size, 0 if it does not fit in Capacity
+size_t Lz4Compress(const uint8_t* Src, const size_t SrcSize, uint8_t* Dst, const size_t Capacity)
+{
+    std::vector<uint32_t> Table(size_t{1} << Lz4HashBits, 0);
+
+    const uint8_t* const SrcEnd = Src + SrcSize;
+    const uint8_t* const DstEnd = Dst + Capacity;
+    const uint8_t* Anchor = Src;
+    const uint8_t* Cursor = Src;
+    uint8_t* Out = Dst;
+
+    const auto EmitSequence = [&](const uint8_t* LiteralEnd, const size_t MatchLength, const size_t Offset, const bool bIsLast) -> bool
+    {
+        const size_t LiteralLength = static_cast<size_t>(LiteralEnd - Anchor);
+        if (static_cast<size_t>(DstEnd - Out) < 1 + LiteralLength + LiteralLength / 255 + 1 + 2 + MatchLength / 255 + 1)
+            return false;
+
+        uint8_t* Token = Out++;
+        *Token = static_cast<uint8_t>(std::min<size_t>(LiteralLength, 15) << 4);
+        if (LiteralLength >= 15)
+        {
+            Out = WriteLength(Out, LiteralLength - 15);
+        }
+
+        std::memcpy(Out, Anchor, LiteralLength);
+        Out += LiteralLength;
+
+        if (bIsLast)
+            return true;
+
+        *Out++ = static_cast<uint8_t>(Offset & 0xFF);
+        *Out++ = static_cast<uint8_t>(Offset >> 8);
+
+        const size_t LengthCode = MatchLength - Lz4MinMatch;
+        *Token |= static_cast<uint8_t>(std::min<size_t>(LengthCode, 15));
+        if (LengthCode >= 15)
+        {
+            Out = WriteLength(Out, LengthCode - 15);
+        }
+
+        return true;
+    };
+
+    if (SrcSize > Lz4MatchStartLimit)
+    {
+        const uint8_t* const MatchStartEnd = SrcEnd - Lz4MatchStartLimit;
+        const uint8_t* const MatchEnd = SrcEnd - Lz4LastLiterals;
+
+        // Incompressible data is skipped faster and faster, until a match is found again
+        uint32_t Misses = 0;
+
+        while (Cursor < MatchStartEnd)
+        {
+            const uint32_t Sequence = Read32(Cursor);
+            const uint32_t Slot = (Sequence * 2654435761u) >> (32 - Lz4HashBits);
+            const uint8_t* Candidate = Src + Table[Slot];
+            Table[Slot] = static_cast<uint32_t>(Cursor - Src);
+
+            if (Candidate >= Cursor || static_cast<size_t>(Cursor - Candidate) > Lz4MaxOffset || Read32(Candidate) != Sequence)
+            {
+                Cursor += 1 + (Misses++ >> 6);
+                continue;
+            }
+
+            const uint8_t* End = Cursor + Lz4MinMatch;
+            const uint8_t* Reference = Candidate + Lz4MinMatch;
+            while (End < MatchEnd && *End == *Reference)
+            {
+                ++End;
+                ++Reference;
+            }
+
+            if (!EmitSequence(Cursor, static_cast<size_t>(End - Cursor), static_cast<size_t>(Cursor - Candidate), false))
+                return 0;
+
+            Cursor = End;
+            Anchor = End;
+            Misses = 0;
+        }
+    }
+
+    if (!EmitSequence(SrcEnd, 0, 0, true))
+        return 0;
+
+    return static_cast<size_t>(Out - Dst);
+}
+
+// Returns false unless Src decompresses to exactly DstSize bytes. Never reads nor writes out of the buffers
+bool Lz4Decompress(const uint8_t* Src, const size_t SrcSize, uint8_t* Dst, const size_t DstSize)
+{
+    const uint8_t* const SrcEnd = Src + SrcSize;
+    uint8_t* const DstEnd = Dst + DstSize;
+    const uint8_t* In = Src;
+    uint8_t* Out = Dst;
+
+    const auto ReadLength = [&](size_t& Length) -> bool
+    {
+        uint8_t Byte = 255;
+        while (Byte == 255)
+        {
+            if (In == SrcEnd)
+                return false;
+
+            Byte = *In++;
+            Length += Byte;
+        }
+
+        return true;
+    };
+
+    while (In < SrcEnd)
+    {
+        const uint8_t Token = *In++;
+
+        size_t LiteralLength = Token >> 4;
+        if (LiteralLength == 15 && !ReadLength(LiteralLength))
+            return false;
+
+        if (LiteralLength > static_cast<size_t>(SrcEnd - In) || LiteralLength > static_cast<size_t>(DstEnd - Out))
+            return false;
+
+        std::memcpy(Out, In, LiteralLength);
+        In += LiteralLength;
+        Out += LiteralLength;
+
+        // The last sequence has no match
+        if (In == SrcEnd)
+            break;
+
+        if (SrcEnd - In < 2)
+            return false;
+
+        const size_t Offset = In[0] | (static_cast<size_t>(In[1]) << 8);
+        In += 2;
+
+        if (Offset == 0 || Offset > static_cast<size_t>(Out - Dst))
+            return false;
+
+        size_t MatchLength = Token & 15;
+        if (MatchLength == 15 && !ReadLength(MatchLength))
+            return false;
+
+        MatchLength += Lz4MinMatch;
+        if (MatchLength > static_cast<size_t>(DstEnd - Out))
+            return false;
+
+        // Overlapping matches repeat the bytes just written, so they are copied forward one at a time
+        const uint8_t* Match = Out - Offset;
+        if (Offset >= MatchLength)
+        {
+            std::memcpy(Out, Match, MatchLength);
+        }
+        else
+        {
+            for (size_t ByteIdx = 0; ByteIdx < MatchLength; ++ByteIdx)
+            {
+                Out[ByteIdx] = Match[ByteIdx];
+            }
+        }
+
+        Out += MatchLength;
+    }
+
+    return Out == DstEnd;
+}
+
+#pragma endregion
+
+#pragma region Mounting
+
+std::mutex MountMutex;
+
+// Searched from the back, so that packages mounted later override the previous ones
+std::vector<std::shared_ptr<const LavaPackage>> MountedPackages{};
+
+#pragma endregion
+
+}
+
+bool LavaPackage::Open(const std::string& Filepath)
+{
+    Header = nullptr;
+    Entries = nullptr;
+    BlockSizes = nullptr;
+    Names = nullptr;
+
+    auto MappedFile = std::make_shared<LavaMappedFile>();
+    if (!MappedFile->Open(Filepath))
+        return false;
+
+    File = std::move(MappedFile);
+    Root = std::filesystem::absolute(Filepath).lexically_normal().parent_path().string();
+
+    if (!IsValid())
+    {
+        Header = nullptr;
+        File.reset();
+        return false;
+    }
+
+    return true;
+}
+
+bool LavaPackage::IsValid()
+{
+    const uint64_t FileSize = File->GetSize();
+    if (FileSize < sizeof(PackageHeader))
+        return false;
+
+    Header = reinterpret_cast<const PackageHeader*>(File->GetData());
+    if (Header->Magic != Magic || Header->Version != Version || Header->BlockSize != BlockSize)
+        return false;
+
+    const auto IsInFile = [FileSize](const uint64_t Offset, const uint64_t Size) { return Offset <= FileSize && Size <= FileSize - Offset; };
+
+    if (Header->TocOffset % alignof(PackageEntry) != 0 || !IsInFile(Header->TocOffset, static_cast<uint64_t>(Header->EntryCount) * sizeof(PackageEntry)))
+        return false;
+
+    if (Header->BlockTableOffset % alignof(uint32_t) != 0 || !IsInFile(Header->BlockTableOffset, static_cast<uint64_t>(Header->BlockCount) * sizeof(uint32_t)))
+        return false;
+
+    if (!IsInFile(Header->NameTableOffset, Header->NameTableSize))
+        return false;
+
+    Entries = reinterpret_cast<const PackageEntry*>(File->GetData() + Header->TocOffset);
+    BlockSizes = reinterpret_cast<const uint32_t*>(File->GetData() + Header->BlockTableOffset);
+    Names = File->GetData() + Header->NameTableOffset;
+
+    for (uint32_t EntryIdx = 0; EntryIdx < Header->EntryCount; ++EntryIdx)
+    {
+        const PackageEntry& Entry = Entries[EntryIdx];
+
+        if (EntryIdx > 0 && Entries[EntryIdx - 1].NameHash > Entry.NameHash)
+            return false;
+
+        if (static_cast<uint64_t>(Entry.NameOffset) + Entry.NameSize > Header->NameTableSize || !IsInFile(Entry.Offset, Entry.StoredSize))
+            return false;
+
+        if (Entry.Compression == PackageCompression::None)
+        {
+            if (Entry.StoredSize != Entry.Size)
+                return false;
+
+            continue;
+        }
+
+        if (Entry.Compression != PackageCompression::Lz4)
+            return false;
+
+        const uint32_t EntryBlockCount = GetEntryBlockCount(Entry);
+        if (static_cast<uint64_t>(Entry.FirstBlock) + EntryBlockCount > Header->BlockCount)
+            return false;
+
+        // Blocks are contiguous, and never larger than their uncompressed size
+        uint64_t StoredSize = 0;
+        for (uint32_t BlockIdx = 0; BlockIdx < EntryBlockCount; ++BlockIdx)
+        {
+            const uint64_t RawSize = std::min<uint64_t>(BlockSize, Entry.Size - static_cast<uint64_t>(BlockIdx) * BlockSize);
+            if (BlockSizes[Entry.FirstBlock + BlockIdx] > RawSize)
+                return false;
+
+            StoredSize += BlockSizes[Entry.FirstBlock + BlockIdx];
+        }
+
+        if (StoredSize != Entry.StoredSize)
+            return false;
+    }
+
+    return true;
+}
+
+const PackageEntry* LavaPackage::Find(const std::string& Name) const
+{
+    const uint64_t NameHash = HashName(Name);
+    const PackageEntry* const End = Entries + Header->EntryCount;
+
+    const PackageEntry* Entry = std::lower_bound(Entries, End, NameHash, [](const PackageEntry& Entry, const uint64_t Hash) { return Entry.NameHash < Hash; });
+    for (; Entry != End && Entry->NameHash == NameHash; ++Entry)
+    {
+        if (Entry->NameSize == Name.size() && std::memcmp(Names + Entry->NameOffset, Name.data(), Name.size()) == 0)
+            return Entry;
+    }
+
+    return nullptr;
+}
+
+LavaMappedFile LavaPackage::Read(const PackageEntry& Entry) const
+{
+    if (Entry.Compression == PackageCompression::None)
+        return LavaMappedFile{File, Entry.Offset, Entry.Size};
+
+    const uint32_t EntryBlockCount = GetEntryBlockCount(Entry);
+
+    std::vector<uint64_t> BlockOffsets(EntryBlockCount);
+    uint64_t Offset = Entry.Offset;
+    for (uint32_t BlockIdx = 0; BlockIdx < EntryBlockCount; ++BlockIdx)
+    {
+        BlockOffsets[BlockIdx] = Offset;
+        Offset += BlockSizes[Entry.FirstBlock + BlockIdx];
+    }
+
+    std::vector<char> Contents(Entry.Size);
+    std::atomic<bool> bCorrupted{false};
+
+    ParallelFor(EntryBlockCount, MinBlocksPerThread, [&](const size_t Begin, const size_t End)
+    {
+        for (size_t BlockIdx = Begin; BlockIdx < End; ++BlockIdx)
+        {
+            const uint8_t* Stored = reinterpret_cast<const uint8_t*>(File->GetData() + BlockOffsets[BlockIdx]);
+            const size_t StoredSize = BlockSizes[Entry.FirstBlock + BlockIdx];
+            const size_t RawSize = std::min<uint64_t>(BlockSize, Entry.Size - BlockIdx * BlockSize);
+            uint8_t* Raw = reinterpret_cast<uint8_t*>(Contents.data() + BlockIdx * BlockSize);
+
+            if (StoredSize == RawSize)
+            {
+                std::memcpy(Raw, Stored, RawSize);
+            }
+            else if (!Lz4Decompress(Stored, StoredSize, Raw, RawSize))
+            {
+                bCorrupted = true;
+            }
+        }
+    });
+
+    if (bCorrupted)
+    {
+        throw std::runtime_error("Corrupted package entry: " + GetEntryName(Entry));
+    }
+
+    return LavaMappedFile{std::move(Contents)};
+}
+
+std::string LavaPackage::MakeEntryName(const std::string& Filepath, const std::string& Root)
+{
+    const std::filesystem::path Absolute = std::filesystem::absolute(Filepath).lexically_normal();
+    return Absolute.lexically_relative(std::filesystem::path(Root)).generic_string();
+}
+
+bool LavaPackage::Mount(const std::string& Filepath)
+{
+    auto Package = std::make_shared<LavaPackage>();
+    if (!Package->Open(Filepath))
+        return false;
+
+    std::lock_guard<std::mutex> Lock{MountMutex};
+    MountedPackages.push_back(std::move(Package));
+    return true;
+}
+
+void LavaPackage::UnmountAll()
+{
+    std::lock_guard<std::mutex> Lock{MountMutex};
+    MountedPackages.clear();
+}
+
+std::shared_ptr<const LavaPackage> LavaPackage::FindMounted(const std::string& Filepath, const PackageEntry*& OutEntry)
+{
+    std::lock_guard<std::mutex> Lock{MountMutex};
+    for (auto Package = MountedPackages.rbegin(); Package != MountedPackages.rend(); ++Package)
+    {
+        OutEntry = (*Package)->Find(MakeEntryName(Filepath, (*Package)->Root));
+        if (OutEntry)
+            return *Package;
+    }
+
+    return nullptr;
+}
+
+bool LavaPackage::OpenMounted(const std::string& Filepath, LavaMappedFile& OutFile)
+{
+    const PackageEntry* Entry = nullptr;
+    const std::shared_ptr<const LavaPackage> Package = FindMounted(Filepath, Entry);
+    if (!Package)
+        return false;
+
+    // Views keep the mapping alive, so the package can be unmounted meanwhile
+    OutFile = Package->Read(*Entry);
+    return true;
+}
+
+bool LavaPackage::IsMounted(const std::string& Filepath)
+{
+    const PackageEntry* Entry = nullptr;
+    return FindMounted(Filepath, Entry) != nullptr;
+}
+
+std::vector<std::vector<char>> LavaPackage::ReadAssets(const std::vector<std::string>& Filepaths)
+{
+    std::vector<std::vector<char>> Contents(Filepaths.size());
+
+    std::vector<std::string> LoosePaths{};
+    std::vector<size_t> LooseIndices{};
+    for (size_t FileIdx = 0; FileIdx < Filepaths.size(); ++FileIdx)
+    {
+        LavaMappedFile Packaged{};
+        if (OpenMounted(Filepaths[FileIdx], Packaged))
+        {
+            Contents[FileIdx].assign(Packaged.GetData(), Packaged.GetData() + Packaged.GetSize());
+        }
+        else
+        {
+            LoosePaths.push_back(Filepaths[FileIdx]);
+            LooseIndices.push_back(FileIdx);
+        }
+    }
+
+    if (!LoosePaths.empty())
+    {
+        std::vector<std::vector<char>> LooseContents = LavaFileReader::ReadFiles(LoosePaths);
+        for (size_t LooseIdx = 0; LooseIdx < LooseIndices.size(); ++LooseIdx)
+        {
+            Contents[LooseIndices[LooseIdx]] = std::move(LooseContents[LooseIdx]);
+        }
+    }
+
+    return Contents;
+}
+
+void LavaPackageWriter::Add(const std::string& Name, std::vector<char>&& Data, PackageCompression Compression)
+{
+    const auto Inserted = EntryByName.emplace(Name, Entries.size());
+    if (!Inserted.second)
+    {
+        Entries[Inserted.first->second] = {Name, std::move(Data), Compression};
+        return;
+    }
+
+    Entries.push_back({Name, std::move(Data), Compression});
+}
+
+bool LavaPackageWriter::AddFile(const std::string& Name, const std::string& Filepath, PackageCompression Compression)
+{
+    const LavaMappedFile Source{Filepath};
+    if (!Source.IsOpen())
+        return false;
+
+    Add(Name, std::vector<char>(Source.GetData(), Source.GetData() + Source.GetSize()), Compression);
+    return true;
+}
+
+bool LavaPackageWriter::Write(const std::string& Filepath) const
+{
+    constexpr uint32_t BlockSize = LavaPackage::BlockSize;
+
+    // Every block of the entries to compress is an independent job
+    struct BlockJob
+    {
+        size_t EntryIdx;
+        uint64_t RawOffset;
+        size_t RawSize;
+        std::vector<char> Stored;
+    };
+
+    std::vector<BlockJob> Jobs{};
+    std::vector<size_t> FirstJobs(Entries.size(), 0);
+    for (size_t EntryIdx = 0; EntryIdx < Entries.size(); ++EntryIdx)
+    {
+        const PendingEntry& Entry = Entries[EntryIdx];
+        FirstJobs[EntryIdx] = Jobs.size();
+        if (Entry.Compression != PackageCompression::Lz4)
+            continue;
+
+        for (uint64_t RawOffset = 0; RawOffset < Entry.Data.size(); RawOffset += BlockSize)
+        {
+            Jobs.push_back({EntryIdx, RawOffset, static_cast<size_t>(std::min<uint64_t>(BlockSize, Entry.Data.size() - RawOffset)), {}});
+        }
+    }
+
+    ParallelFor(Jobs.size(), 1, [&](const size_t Begin, const size_t End)
+    {
+        for (size_t JobIdx = Begin; JobIdx < End; ++JobIdx)
+        {
+            BlockJob& Job = Jobs[JobIdx];
+            const uint8_t* Raw = reinterpret_cast<const uint8_t*>(Entries[Job.EntryIdx].Data.data() + Job.RawOffset);
+
+            // Only blocks that get smaller are kept compressed, which is how the reader tells them apart
+            Job.Stored.resize(Job.RawSize);
+            const size_t StoredSize = Lz4Compress(Raw, Job.RawSize, reinterpret_cast<uint8_t*>(Job.Stored.data()), Job.RawSize - 1);
+            if (StoredSize == 0)
+            {
+                std::memcpy(Job.Stored.data(), Raw, Job.RawSize);
+            }
+            else
+            {
+                Job.Stored.resize(StoredSize);
+            }
+        }
+    });
+
+    // Layout of the data, entries that did not get smaller overall are stored uncompressed
+    std::vector<PackageEntry> Toc(Entries.size());
+    std::vector<uint32_t> BlockSizes{};
+    std::string NameTable{};
+    uint64_t Offset = AlignDataOffset(sizeof(PackageHeader));
+
+    for (size_t EntryIdx = 0; EntryIdx < Entries.size(); ++EntryIdx)
+    {
+        const PendingEntry& Pending = Entries[EntryIdx];
+        const size_t JobEnd = EntryIdx + 1 < Entries.size() ? FirstJobs[EntryIdx + 1] : Jobs.size();
+
+        uint64_t CompressedSize = 0;
+        for (size_t JobIdx = FirstJobs[EntryIdx]; JobIdx < JobEnd; ++JobIdx)
+        {
+            CompressedSize += Jobs[JobIdx].Stored.size();
+        }
+
+        PackageEntry& Entry = Toc[EntryIdx];
+        Entry.NameHash = HashName(Pending.Name);
+        Entry.NameOffset = static_cast<uint32_t>(NameTable.size());
+        Entry.NameSize = static_cast<uint32_t>(Pending.Name.size());
+        Entry.Offset = Offset;
+        Entry.Size = Pending.Data.size();
+        Entry.Compression = JobEnd > FirstJobs[EntryIdx] && CompressedSize < Entry.Size ? PackageCompression::Lz4 : PackageCompression::None;
+        Entry.StoredSize = Entry.Compression == PackageCompression::Lz4 ? CompressedSize : Entry.Size;
+        Entry.FirstBlock = 0;
+
+        if (Entry.Compression == PackageCompression::Lz4)
+        {
+            Entry.FirstBlock = static_cast<uint32_t>(BlockSizes.size());
+            for (size_t JobIdx = FirstJobs[EntryIdx]; JobIdx < JobEnd; ++JobIdx)
+            {
+                BlockSizes.push_back(static_cast<uint32_t>(Jobs[JobIdx].Stored.size()));
+            }
+        }
+
+        NameTable += Pending.Name;
+        Offset = AlignDataOffset(Offset + Entry.StoredSize);
+    }
+
+    PackageHeader Header{};
+    Header.Magic = LavaPackage::Magic;
+    Header.Version = LavaPackage::Version;
+    Header.EntryCount = static_cast<uint32_t>(Entries.size());
+    Header.BlockSize = BlockSize;
+    Header.TocOffset = Offset;
+    Header.BlockTableOffset = Header.TocOffset + Toc.size() * sizeof(PackageEntry);
+    Header.BlockCount = static_cast<uint32_t>(BlockSizes.size());
+    Header.NameTableOffset = Header.BlockTableOffset + BlockSizes.size() * sizeof(uint32_t);
+    Header.NameTableSize = NameTable.size();
+
+    // Data is written in the order entries were added, the table of contents is sorted for the lookups
+    std::vector<PackageEntry> SortedToc = Toc;
+    std::sort(SortedToc.begin(), SortedToc.end(), [](const PackageEntry& Lhs, const PackageEntry& Rhs) { return Lhs.NameHash < Rhs.NameHash; });
+
+    std::error_code Error;
+    const std::filesystem::path FinalPath{Filepath};
+    if (FinalPath.has_parent_path())
+    {
+        std::filesystem::create_directories(FinalPath.parent_path(), Error);
+    }
+
+    const std::string TempPath = MakeTempPath(Filepath);
+    {
+        std::ofstream FileStream(TempPath, std::ios::binary | std::ios::trunc);
+        if (!FileStream.is_open())
+            return false;
+
+        const char Zeros[LavaPackage::DataAlignment] = {};
+        FileStream.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+
+        for (size_t EntryIdx = 0; EntryIdx < Entries.size(); ++EntryIdx)
+        {
+            const PackageEntry& Entry = Toc[EntryIdx];
+            FileStream.write(Zeros, Entry.Offset - static_cast<uint64_t>(FileStream.tellp()));
+
+            if (Entry.Compression == PackageCompression::None)
+            {
+                FileStream.write(Entries[EntryIdx].Data.data(), Entry.Size);
+                continue;
+            }
+
+            const size_t JobEnd = EntryIdx + 1 < Entries.size() ? FirstJobs[EntryIdx + 1] : Jobs.size();
+            for (size_t JobIdx = FirstJobs[EntryIdx]; JobIdx < JobEnd; ++JobIdx)
+            {
+                FileStream.write(Jobs[JobIdx].Stored.data(), Jobs[JobIdx].Stored.size());
+            }
+        }
+
+        FileStream.write(Zeros, Header.TocOffset - static_cast<uint64_t>(FileStream.tellp()));
+        FileStream.write(reinterpret_cast<const char*>(SortedToc.data()), SortedToc.size() * sizeof(PackageEntry));
+        FileStream.write(reinterpret_cast<const char*>(BlockSizes.data()), BlockSizes.size() * sizeof(uint32_t));
+        FileStream.write(NameTable.data(), NameTable.size());
+
+        if (!FileStream.good())
+        {
+            FileStream.close();
+            std::filesystem::remove(TempPath, Error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(TempPath, FinalPath, Error);
+    if (Error)
+    {
+        std::filesystem::remove(TempPath, Error);
+        return false;
+    }
+
+    return true;
+}
+
+}
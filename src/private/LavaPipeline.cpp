@@ -5,12 +5,12 @@
 //  Created by Giorgio Gamba on 27/12/24.
 //
 
-#include <fstream>
 #include <iostream>
 
 #include "LavaPipeline.hpp"
 #include "LavaDevice.hpp"
 #include "LavaModel.hpp"
+#include "LavaPackage.hpp"
 
 namespace lava {
 
@@ -96,6 +96,9 @@ void LavaPipeline::defaultPipelineConfigInfo(LavaPipelineConfigInfo& ConfigInfo)
     ConfigInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(ConfigInfo.dynamicStateEnables.size());
     ConfigInfo.dynamicStateInfo.flags = 0;
     ConfigInfo.dynamicStateInfo.pNext = nullptr;
+
+    ConfigInfo.bindingDescriptions = Vertex::GetBindingDesc();
+    ConfigInfo.attributeDescriptions = Vertex::GetAttributeDescs();
 }
 
 void LavaPipeline::Bind(VkCommandBuffer CommandBuffer)
@@ -116,32 +119,12 @@ LavaPipeline::~LavaPipeline()
     vkDestroyPipeline(Device.device(), Pipeline, nullptr);
 }
 
-std::vector<char> LavaPipeline::readFile(const std::string& filePath)
-{
-    // ate makes the file stream seek to the end immediately
-    // binary makes the file read as binary (because we already compiled it)
-    std::ifstream filestream(filePath, std::ios::ate | std::ios::binary);
-    
-    if (!filestream.is_open())
-    {
-        throw std::runtime_error("Failed to open file: " + filePath);
-    }
-    
-    size_t size = static_cast<size_t>(filestream.tellg());
-    std::vector<char> buffer(size);
-    
-    filestream.seekg(0);
-    filestream.read(buffer.data(), size);
-    
-    filestream.close();
-    
-    return buffer;
-}
-
 void LavaPipeline::createPipeline(const LavaPipelineConfigInfo& configInfo, const std::string& vertexShaderPath, const std::string& fragmentShaderPath)
 {   
-    const std::vector<char>& vertexShaderCode = readFile(vertexShaderPath);
-    const std::vector<char>& fragmentShaderCode = readFile(fragmentShaderPath);
+    // Both stages come from the mounted packages, or are read from disk in a single batch
+    const std::vector<std::vector<char>> shaderCodes = LavaPackage::ReadAssets({vertexShaderPath, fragmentShaderPath});
+    const std::vector<char>& vertexShaderCode = shaderCodes[0];
+    const std::vector<char>& fragmentShaderCode = shaderCodes[1];
     
     std::cout << "Shaders allocation completed" << "\n";
     std::cout << "Vertex shader size: " << vertexShaderCode.size() << "\n";
@@ -171,16 +154,14 @@ void LavaPipeline::createPipeline(const LavaPipelineConfigInfo& configInfo, cons
     VkPipelineVertexInputStateCreateInfo VertexInputInfo{};
     VertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     
-    auto AttributeDescs = Vertex::GetAttributeDescs();
+    const auto& AttributeDescs = configInfo.attributeDescriptions;
     VertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(AttributeDescs.size());
     VertexInputInfo.pVertexAttributeDescriptions = AttributeDescs.data();
     
-    auto BindingDescs = Vertex::GetBindingDesc();
+    const auto& BindingDescs = configInfo.bindingDescriptions;
     VertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(BindingDescs.size());
     VertexInputInfo.pVertexBindingDescriptions = BindingDescs.data();
     
-    VertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(AttributeDescs.size());
-    
     VkGraphicsPipelineCreateInfo PipelineInfo{};
     PipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     PipelineInfo.pNext = nullptr;
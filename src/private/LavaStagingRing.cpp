@@ -0,0 +1,718 @@
+//
+//  LavaStagingRing.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaStagingRing.hpp"
+#include "LavaDevice.hpp"
+#include "LavaBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace lava
+{
+
+#pragma region StagingRegion
+
+StagingRegion::~StagingRegion()
+{
+    Reset();
+}
+
+StagingRegion::StagingRegion(StagingRegion&& Other) noexcept
+{
+    *this = std::move(Other);
+}
+
+StagingRegion& StagingRegion::operator=(StagingRegion&& Other) noexcept
+{
+    if (this != &Other)
+    {
+        Reset();
+
+        Ring = Other.Ring;
+        ClaimId = Other.ClaimId;
+        Buffer = Other.Buffer;
+        Offset = Other.Offset;
+        Size = Other.Size;
+        Data = Other.Data;
+        OwnBuffer = std::move(Other.OwnBuffer);
+
+        Other.Ring = nullptr;
+        Other.ClaimId = 0;
+        Other.Buffer = VK_NULL_HANDLE;
+        Other.Data = nullptr;
+    }
+
+    return *this;
+}
+
+void StagingRegion::Reset()
+{
+    if (Ring && ClaimId != 0)
+    {
+        Ring->Release(ClaimId);
+    }
+
+    Ring = nullptr;
+    ClaimId = 0;
+    Buffer = VK_NULL_HANDLE;
+    Data = nullptr;
+    OwnBuffer.reset();
+}
+
+#pragma endregion
+
+LavaStagingRing::LavaStagingRing(LavaDevice& InDevice, VkDeviceSize InCapacity)
+    : Device(InDevice)
+    , Capacity((InCapacity + ClaimAlignment - 1) & ~(ClaimAlignment - 1))
+{
+    Buffer = std::make_unique<LavaBuffer>
+        ( Device
+        , Capacity
+        , 1
+        , VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+        , VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+
+    // Stays mapped for good, claims are written in place
+    Buffer->map();
+    Mapped = static_cast<char*>(Buffer->getMappedMemory());
+
+    const QueueFamilyIndices Families = Device.findPhysicalQueueFamilies();
+    TransferFamily = Families.transferFamily;
+    GraphicsFamily = Families.graphicsFamily;
+    bTransfersOwnership = Families.hasDedicatedTransfer();
+
+    VkCommandPoolCreateInfo PoolInfo{};
+    PoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    PoolInfo.queueFamilyIndex = TransferFamily;
+    PoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkCreateCommandPool(Device.device(), &PoolInfo, nullptr, &CommandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create the staging ring command pool");
+    }
+
+    if (bTransfersOwnership)
+    {
+        PoolInfo.queueFamilyIndex = GraphicsFamily;
+        if (vkCreateCommandPool(Device.device(), &PoolInfo, nullptr, &AcquirePool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create the staging ring acquire command pool");
+        }
+    }
+}
+
+LavaStagingRing::~LavaStagingRing()
+{
+    // Copies recorded but never submitted are dropped with the pool
+    for (const Submission& Pending : InFlight)
+    {
+        vkWaitForFences(Device.device(), 1, &Pending.Fence, VK_TRUE, UINT64_MAX);
+        vkDestroyFence(Device.device(), Pending.Fence, nullptr);
+    }
+
+    for (const Submission& Free : FreeSubmissions)
+    {
+        vkDestroyFence(Device.device(), Free.Fence, nullptr);
+    }
+
+    if (Recording.Fence != VK_NULL_HANDLE)
+    {
+        vkDestroyFence(Device.device(), Recording.Fence, nullptr);
+    }
+
+    // Transfers done but never acquired are dropped with the buffers they wrote
+    for (const Acquisition& Pending : Acquisitions)
+    {
+        vkWaitForFences(Device.device(), 1, &Pending.Fence, VK_TRUE, UINT64_MAX);
+        vkDestroyFence(Device.device(), Pending.Fence, nullptr);
+    }
+
+    for (const Acquisition& Free : FreeAcquisitions)
+    {
+        vkDestroyFence(Device.device(), Free.Fence, nullptr);
+    }
+
+    vkDestroyCommandPool(Device.device(), CommandPool, nullptr);
+
+    if (AcquirePool != VK_NULL_HANDLE)
+    {
+        vkDestroyCommandPool(Device.device(), AcquirePool, nullptr);
+    }
+}
+
+StagingRegion LavaStagingRing::Claim(VkDeviceSize Size)
+{
+    StagingRegion Region{};
+    Region.Size = Size;
+
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        Retire();
+
+        if (Size <= Capacity && ClaimRange(Size, Size, Region.Offset, Region.ClaimId) == Size)
+        {
+            Region.Ring = this;
+            Region.Buffer = Buffer->getBuffer();
+            Region.Data = Mapped + Region.Offset;
+            return Region;
+        }
+    }
+
+    // No room left, the region gets a buffer of its own like every upload did before the ring
+    Region.Offset = 0;
+    Region.OwnBuffer = std::make_unique<LavaBuffer>
+        ( Device
+        , Size
+        , 1
+        , VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+        , VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+
+    Region.OwnBuffer->map();
+    Region.Buffer = Region.OwnBuffer->getBuffer();
+    Region.Data = Region.OwnBuffer->getMappedMemory();
+    return Region;
+}
+
+void LavaStagingRing::RecordCopy(StagingRegion& Region, VkBuffer Dst, VkDeviceSize DstOffset)
+{
+    assert(Region.IsValid() && "NOTE: recording the copy of an empty staging region");
+
+    VkBufferCopy CopyRegion{};
+    CopyRegion.srcOffset = Region.Offset;
+    CopyRegion.dstOffset = DstOffset;
+    CopyRegion.size = Region.Size;
+    RecordCopies(Region.Buffer, Dst, &CopyRegion, 1);
+
+    Retain(Region);
+}
+
+void LavaStagingRing::RecordCopies(VkBuffer Src, VkBuffer Dst, const VkBufferCopy* Regions, uint32_t Count)
+{
+    vkCmdCopyBuffer(GetRecordingBuffer(), Src, Dst, Count, Regions);
+
+    if (bTransfersOwnership && Count > 0)
+    {
+        // Dst may be shared with ranges the graphics family owns and uses, so only the ranges written are released.
+        // Regions that touch each other share a barrier
+        std::vector<std::pair<VkDeviceSize, VkDeviceSize>> Written;
+        Written.reserve(Count);
+        for (uint32_t RegionIdx = 0; RegionIdx < Count; ++RegionIdx)
+        {
+            Written.push_back({Regions[RegionIdx].dstOffset, Regions[RegionIdx].dstOffset + Regions[RegionIdx].size});
+        }
+        std::sort(Written.begin(), Written.end());
+
+        VkBufferMemoryBarrier Barrier{};
+        Barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.dstAccessMask = 0;
+        Barrier.srcQueueFamilyIndex = TransferFamily;
+        Barrier.dstQueueFamilyIndex = GraphicsFamily;
+        Barrier.buffer = Dst;
+
+        VkDeviceSize Begin = Written[0].first;
+        VkDeviceSize End = Written[0].second;
+        for (size_t RangeIdx = 1; RangeIdx <= Written.size(); ++RangeIdx)
+        {
+            if (RangeIdx < Written.size() && Written[RangeIdx].first <= End)
+            {
+                End = std::max(End, Written[RangeIdx].second);
+                continue;
+            }
+
+            Barrier.offset = Begin;
+            Barrier.size = End - Begin;
+            Recording.OwnershipBarriers.push_back(Barrier);
+
+            if (RangeIdx < Written.size())
+            {
+                Begin = Written[RangeIdx].first;
+                End = Written[RangeIdx].second;
+            }
+        }
+    }
+}
+
+void LavaStagingRing::RecordImageCopies(VkImage Image, VkImageAspectFlags Aspect, const LavaImageCopy* Copies, uint32_t Count, VkImageLayout FinalLayout)
+{
+    VkCommandBuffer CommandBuffer = GetRecordingBuffer();
+
+    VkImageMemoryBarrier Barrier{};
+    Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    Barrier.srcAccessMask = 0;
+    Barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.image = Image;
+    Barrier.subresourceRange.aspectMask = Aspect;
+    Barrier.subresourceRange.baseMipLevel = 0;
+    Barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    Barrier.subresourceRange.baseArrayLayer = 0;
+    Barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    vkCmdPipelineBarrier
+        ( CommandBuffer
+        , VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+        , VK_PIPELINE_STAGE_TRANSFER_BIT
+        , 0
+        , 0
+        , nullptr
+        , 0
+        , nullptr
+        , 1
+        , &Barrier );
+
+    // Consecutive copies from the same buffer share a command
+    std::vector<VkBufferImageCopy> Regions{};
+    for (uint32_t CopyIdx = 0; CopyIdx < Count; ++CopyIdx)
+    {
+        Regions.push_back(Copies[CopyIdx].Region);
+        if (CopyIdx + 1 == Count || Copies[CopyIdx + 1].Src != Copies[CopyIdx].Src)
+        {
+            vkCmdCopyBufferToImage(CommandBuffer, Copies[CopyIdx].Src, Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(Regions.size()), Regions.data());
+            Regions.clear();
+        }
+    }
+
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.newLayout = FinalLayout;
+
+    if (bTransfersOwnership)
+    {
+        // The layout transition happens with the ownership transfer
+        Barrier.dstAccessMask = 0;
+        Barrier.srcQueueFamilyIndex = TransferFamily;
+        Barrier.dstQueueFamilyIndex = GraphicsFamily;
+        Recording.ImageOwnershipBarriers.push_back(Barrier);
+    }
+    else
+    {
+        Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier
+            ( CommandBuffer
+            , VK_PIPELINE_STAGE_TRANSFER_BIT
+            , VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+            , 0
+            , 0
+            , nullptr
+            , 0
+            , nullptr
+            , 1
+            , &Barrier );
+    }
+}
+
+void LavaStagingRing::Retain(StagingRegion& Region)
+{
+    if (Region.Ring == this && Region.ClaimId != 0)
+    {
+        TieClaim(Region.ClaimId);
+    }
+
+    if (Region.OwnBuffer)
+    {
+        GetRecordingBuffer();
+        Recording.OwnBuffers.push_back(std::move(Region.OwnBuffer));
+    }
+}
+
+void LavaStagingRing::Upload(const void* Data, VkDeviceSize Size, VkBuffer Dst, VkDeviceSize DstOffset)
+{
+    const char* Source = static_cast<const char*>(Data);
+    while (Size > 0)
+    {
+        VkDeviceSize ChunkOffset = 0;
+        uint64_t ClaimId = 0;
+        VkDeviceSize ChunkSize = 0;
+        uint64_t OldestValue = 0;
+        {
+            std::lock_guard<std::mutex> Lock{Mutex};
+            Retire();
+
+            ChunkSize = ClaimRange(std::min(Size, MinUploadChunk), Size, ChunkOffset, ClaimId);
+            if (ChunkSize == 0)
+            {
+                OldestValue = !InFlight.empty() ? InFlight.front().FenceValue : (Recording.CommandBuffer != VK_NULL_HANDLE ? NextFenceValue : 0);
+            }
+        }
+
+        if (ChunkSize > 0)
+        {
+            std::memcpy(Mapped + ChunkOffset, Source, ChunkSize);
+            VkBufferCopy CopyRegion{};
+            CopyRegion.srcOffset = ChunkOffset;
+            CopyRegion.dstOffset = DstOffset;
+            CopyRegion.size = ChunkSize;
+            RecordCopies(Buffer->getBuffer(), Dst, &CopyRegion, 1);
+            TieClaim(ClaimId);
+
+            Source += ChunkSize;
+            DstOffset += ChunkSize;
+            Size -= ChunkSize;
+        }
+        else if (OldestValue != 0)
+        {
+            // The ring is full: waiting for the oldest transfer gives its range back
+            Wait(OldestValue);
+        }
+        else
+        {
+            // The whole ring is held by claims not recorded yet, the rest goes through a buffer of its own
+            StagingRegion Region = Claim(Size);
+            std::memcpy(Region.GetData(), Source, Size);
+            RecordCopy(Region, Dst, DstOffset);
+            Wait(Submit());
+            return;
+        }
+    }
+}
+
+uint64_t LavaStagingRing::Submit()
+{
+    if (Recording.CommandBuffer == VK_NULL_HANDLE)
+        return NextFenceValue - 1;
+
+    if (bTransfersOwnership)
+    {
+        // Releases the buffers to the graphics family, which acquires them with the same barriers once the fence is signaled
+        vkCmdPipelineBarrier
+            ( Recording.CommandBuffer
+            , VK_PIPELINE_STAGE_TRANSFER_BIT
+            , VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+            , 0
+            , 0
+            , nullptr
+            , static_cast<uint32_t>(Recording.OwnershipBarriers.size())
+            , Recording.OwnershipBarriers.data()
+            , static_cast<uint32_t>(Recording.ImageOwnershipBarriers.size())
+            , Recording.ImageOwnershipBarriers.data() );
+    }
+    else
+    {
+        // Everything copied here is read by the frames submitted afterwards. Uploads are only used once their fence is
+        // signaled, so this barrier never stalls them
+        VkMemoryBarrier Barrier{};
+        Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier
+            ( Recording.CommandBuffer
+            , VK_PIPELINE_STAGE_TRANSFER_BIT
+            , VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+            , 0
+            , 1
+            , &Barrier
+            , 0
+            , nullptr
+            , 0
+            , nullptr );
+    }
+
+    vkEndCommandBuffer(Recording.CommandBuffer);
+
+    VkSubmitInfo SubmitInfo{};
+    SubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    SubmitInfo.commandBufferCount = 1;
+    SubmitInfo.pCommandBuffers = &Recording.CommandBuffer;
+
+    if (vkQueueSubmit(Device.transferQueue(), 1, &SubmitInfo, Recording.Fence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to submit the staging ring command buffer");
+    }
+
+    std::lock_guard<std::mutex> Lock{Mutex};
+    Recording.FenceValue = NextFenceValue++;
+    InFlight.push_back(std::move(Recording));
+    Recording = {};
+
+    return InFlight.back().FenceValue;
+}
+
+bool LavaStagingRing::IsComplete(uint64_t FenceValue)
+{
+    std::lock_guard<std::mutex> Lock{Mutex};
+    Retire();
+
+    if (bTransfersOwnership)
+    {
+        AcquireTransferred();
+    }
+
+    return FenceValue <= CompletedValue;
+}
+
+void LavaStagingRing::Wait(uint64_t FenceValue)
+{
+    if (FenceValue >= NextFenceValue)
+    {
+        FenceValue = Submit();
+    }
+
+    // Waits for the transfer first, then for its acquisition by the graphics queue if there is one
+    while (true)
+    {
+        VkFence Fence = VK_NULL_HANDLE;
+        {
+            std::lock_guard<std::mutex> Lock{Mutex};
+            Retire();
+
+            if (bTransfersOwnership)
+            {
+                AcquireTransferred();
+            }
+
+            if (FenceValue <= CompletedValue)
+                return;
+
+            // Submissions to a queue complete in order, so the first one at or after FenceValue is enough
+            if (FenceValue > TransferredValue)
+            {
+                const auto Found = std::find_if(InFlight.begin(), InFlight.end(), [FenceValue](const Submission& Pending) { return Pending.FenceValue >= FenceValue; });
+                Fence = Found != InFlight.end() ? Found->Fence : VK_NULL_HANDLE;
+            }
+            else
+            {
+                const auto Found = std::find_if(Acquisitions.begin(), Acquisitions.end(), [FenceValue](const Acquisition& Pending) { return Pending.FenceValue >= FenceValue; });
+                Fence = Found != Acquisitions.end() ? Found->Fence : VK_NULL_HANDLE;
+            }
+        }
+
+        if (Fence == VK_NULL_HANDLE)
+            return;
+
+        // Fences are only reset by this thread, when recording again
+        vkWaitForFences(Device.device(), 1, &Fence, VK_TRUE, UINT64_MAX);
+    }
+}
+
+VkDeviceSize LavaStagingRing::ClaimRange(VkDeviceSize MinSize, VkDeviceSize Size, VkDeviceSize& OutOffset, uint64_t& OutClaimId)
+{
+    // An empty ring starts over from its beginning, so that it can hold a claim of its whole capacity
+    if (Head == Tail)
+    {
+        Head = Tail = (Head + Capacity - 1) / Capacity * Capacity;
+    }
+
+    const VkDeviceSize Free = Capacity - (Head - Tail);
+    const VkDeviceSize Position = Head % Capacity;
+
+    VkDeviceSize Start = (Position + ClaimAlignment - 1) & ~(ClaimAlignment - 1);
+    VkDeviceSize Padding = Start - Position;
+    VkDeviceSize Available = Start < Capacity && Free > Padding ? std::min(Capacity - Start, Free - Padding) : 0;
+
+    // Not enough room before the end of the ring, the claim starts over from its beginning
+    if (Available < MinSize)
+    {
+        Start = 0;
+        Padding = Capacity - Position;
+        Available = Free > Padding ? Free - Padding : 0;
+    }
+
+    if (Available < MinSize)
+        return 0;
+
+    Size = std::min(Size, Available);
+    Head += Padding + Size;
+    Claims.push_back({Head, 0, false});
+
+    OutOffset = Start;
+    OutClaimId = FirstClaimId + Claims.size() - 1;
+    return Size;
+}
+
+void LavaStagingRing::Retire()
+{
+    while (!InFlight.empty() && vkGetFenceStatus(Device.device(), InFlight.front().Fence) == VK_SUCCESS)
+    {
+        Submission& Done = InFlight.front();
+        TransferredValue = Done.FenceValue;
+
+        // The graphics queue acquires the buffers with the barriers that released them, minus the transfer accesses
+        for (VkBufferMemoryBarrier Barrier : Done.OwnershipBarriers)
+        {
+            Barrier.srcAccessMask = 0;
+            Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            PendingAcquires.push_back(Barrier);
+        }
+
+        for (VkImageMemoryBarrier Barrier : Done.ImageOwnershipBarriers)
+        {
+            Barrier.srcAccessMask = 0;
+            Barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            PendingImageAcquires.push_back(Barrier);
+        }
+
+        Done.OwnershipBarriers.clear();
+        Done.ImageOwnershipBarriers.clear();
+        Done.OwnBuffers.clear();
+        FreeSubmissions.push_back(std::move(Done));
+        InFlight.pop_front();
+    }
+
+    // Without ownership to transfer, the buffers can be used as soon as they are written
+    if (!bTransfersOwnership)
+    {
+        CompletedValue = TransferredValue;
+    }
+
+    // Ranges are given back in the order they were claimed
+    while (!Claims.empty() && (Claims.front().bReleased || (Claims.front().FenceValue != 0 && Claims.front().FenceValue <= TransferredValue)))
+    {
+        Tail = Claims.front().End;
+        Claims.pop_front();
+        ++FirstClaimId;
+    }
+}
+
+void LavaStagingRing::AcquireTransferred()
+{
+    while (!Acquisitions.empty() && vkGetFenceStatus(Device.device(), Acquisitions.front().Fence) == VK_SUCCESS)
+    {
+        CompletedValue = Acquisitions.front().FenceValue;
+        FreeAcquisitions.push_back(Acquisitions.front());
+        Acquisitions.pop_front();
+    }
+
+    if (PendingAcquires.empty() && PendingImageAcquires.empty())
+    {
+        if (Acquisitions.empty())
+        {
+            CompletedValue = TransferredValue;
+        }
+
+        return;
+    }
+
+    Acquisition Acquire{};
+    if (!FreeAcquisitions.empty())
+    {
+        Acquire = FreeAcquisitions.back();
+        FreeAcquisitions.pop_back();
+
+        vkResetCommandBuffer(Acquire.CommandBuffer, 0);
+        vkResetFences(Device.device(), 1, &Acquire.Fence);
+    }
+    else
+    {
+        CreateCommandBuffer(AcquirePool, Acquire.CommandBuffer, Acquire.Fence);
+    }
+
+    VkCommandBufferBeginInfo BeginInfo{};
+    BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(Acquire.CommandBuffer, &BeginInfo);
+
+    // The transfers are already done, the frames submitted after this only wait for the barriers themselves
+    vkCmdPipelineBarrier
+        ( Acquire.CommandBuffer
+        , VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+        , VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+        , 0
+        , 0
+        , nullptr
+        , static_cast<uint32_t>(PendingAcquires.size())
+        , PendingAcquires.data()
+        , static_cast<uint32_t>(PendingImageAcquires.size())
+        , PendingImageAcquires.data() );
+
+    vkEndCommandBuffer(Acquire.CommandBuffer);
+
+    VkSubmitInfo SubmitInfo{};
+    SubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    SubmitInfo.commandBufferCount = 1;
+    SubmitInfo.pCommandBuffers = &Acquire.CommandBuffer;
+
+    if (vkQueueSubmit(Device.graphicsQueue(), 1, &SubmitInfo, Acquire.Fence) != VK_SUCCESS)
+    {
+        FreeAcquisitions.push_back(Acquire);
+        throw std::runtime_error("Failed to submit the staging ring acquire command buffer");
+    }
+
+    Acquire.FenceValue = TransferredValue;
+    Acquisitions.push_back(Acquire);
+    PendingAcquires.clear();
+    PendingImageAcquires.clear();
+}
+
+void LavaStagingRing::Release(uint64_t ClaimId)
+{
+    std::lock_guard<std::mutex> Lock{Mutex};
+
+    // Recorded claims are given back by their fence, possibly before their region is destroyed
+    if (ClaimId < FirstClaimId)
+        return;
+
+    Claimed& Claim = Claims[ClaimId - FirstClaimId];
+    if (Claim.FenceValue == 0)
+    {
+        Claim.bReleased = true;
+        Retire();
+    }
+}
+
+void LavaStagingRing::TieClaim(uint64_t ClaimId)
+{
+    std::lock_guard<std::mutex> Lock{Mutex};
+    Claims[ClaimId - FirstClaimId].FenceValue = NextFenceValue;
+}
+
+VkCommandBuffer LavaStagingRing::GetRecordingBuffer()
+{
+    if (Recording.CommandBuffer != VK_NULL_HANDLE)
+        return Recording.CommandBuffer;
+
+    {
+        std::lock_guard<std::mutex> Lock{Mutex};
+        if (!FreeSubmissions.empty())
+        {
+            Recording = std::move(FreeSubmissions.back());
+            FreeSubmissions.pop_back();
+        }
+    }
+
+    if (Recording.CommandBuffer == VK_NULL_HANDLE)
+    {
+        CreateCommandBuffer(CommandPool, Recording.CommandBuffer, Recording.Fence);
+    }
+    else
+    {
+        vkResetCommandBuffer(Recording.CommandBuffer, 0);
+        vkResetFences(Device.device(), 1, &Recording.Fence);
+    }
+
+    VkCommandBufferBeginInfo BeginInfo{};
+    BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(Recording.CommandBuffer, &BeginInfo);
+
+    return Recording.CommandBuffer;
+}
+
+void LavaStagingRing::CreateCommandBuffer(VkCommandPool Pool, VkCommandBuffer& OutCommandBuffer, VkFence& OutFence)
+{
+    VkCommandBufferAllocateInfo AllocInfo{};
+    AllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    AllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    AllocInfo.commandPool = Pool;
+    AllocInfo.commandBufferCount = 1;
+
+    VkFenceCreateInfo FenceInfo{};
+    FenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if (vkAllocateCommandBuffers(Device.device(), &AllocInfo, &OutCommandBuffer) != VK_SUCCESS
+        || vkCreateFence(Device.device(), &FenceInfo, nullptr, &OutFence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create the staging ring command buffer");
+    }
+}
+
+}
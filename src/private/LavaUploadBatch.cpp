@@ -0,0 +1,101 @@
+//
+//  LavaUploadBatch.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaUploadBatch.hpp"
+#include "LavaDevice.hpp"
+
+#include <cassert>
+
+namespace lava
+{
+
+LavaUploadBatch::LavaUploadBatch(LavaDevice& InDevice)
+    : Device(InDevice)
+{
+}
+
+void LavaUploadBatch::AddBufferCopy(VkBuffer Src, VkBuffer Dst, const VkBufferCopy& Region)
+{
+    const auto Inserted = BufferCopyIndices.emplace(std::make_pair(Src, Dst), BufferCopies.size());
+    if (Inserted.second)
+    {
+        BufferCopies.push_back({Src, Dst, {}});
+    }
+
+    BufferCopies[Inserted.first->second].Regions.push_back(Region);
+}
+
+void LavaUploadBatch::AddUpload(StagingRegion&& Staging, VkBuffer Dst, VkDeviceSize DstOffset)
+{
+    assert(Staging.IsValid() && "NOTE: uploading an empty staging region");
+
+    VkBufferCopy Region{};
+    Region.srcOffset = Staging.GetOffset();
+    Region.dstOffset = DstOffset;
+    Region.size = Staging.GetSize();
+    AddBufferCopy(Staging.GetBuffer(), Dst, Region);
+
+    StagingRegions.push_back(std::move(Staging));
+}
+
+void LavaUploadBatch::AddImageCopy(VkBuffer Src, VkImage Image, const VkBufferImageCopy& Region, VkImageLayout FinalLayout)
+{
+    const auto Inserted = ImageCopyIndices.emplace(Image, ImageCopies.size());
+    if (Inserted.second)
+    {
+        ImageCopies.push_back({Image, 0, FinalLayout, {}});
+    }
+
+    ImageCopyGroup& Group = ImageCopies[Inserted.first->second];
+    Group.Aspect |= Region.imageSubresource.aspectMask;
+    Group.FinalLayout = FinalLayout;
+    Group.Copies.push_back({Src, Region});
+}
+
+void LavaUploadBatch::AddImageUpload(StagingRegion&& Staging, VkImage Image, VkBufferImageCopy Region, VkImageLayout FinalLayout)
+{
+    assert(Staging.IsValid() && "NOTE: uploading an empty staging region");
+
+    Region.bufferOffset += Staging.GetOffset();
+    AddImageCopy(Staging.GetBuffer(), Image, Region, FinalLayout);
+
+    StagingRegions.push_back(std::move(Staging));
+}
+
+LavaUploadToken LavaUploadBatch::Submit()
+{
+    LavaStagingRing& StagingRing = Device.stagingRing();
+
+    for (const BufferCopyGroup& Group : BufferCopies)
+    {
+        StagingRing.RecordCopies(Group.Src, Group.Dst, Group.Regions.data(), static_cast<uint32_t>(Group.Regions.size()));
+    }
+
+    for (const ImageCopyGroup& Group : ImageCopies)
+    {
+        StagingRing.RecordImageCopies(Group.Image, Group.Aspect, Group.Copies.data(), static_cast<uint32_t>(Group.Copies.size()), Group.FinalLayout);
+    }
+
+    // Every copy is recorded, the regions can follow the submission
+    for (StagingRegion& Region : StagingRegions)
+    {
+        StagingRing.Retain(Region);
+    }
+
+    LavaUploadToken Token{};
+    Token.FenceValue = StagingRing.Submit();
+
+    BufferCopies.clear();
+    BufferCopyIndices.clear();
+    ImageCopies.clear();
+    ImageCopyIndices.clear();
+    StagingRegions.clear();
+
+    return Token;
+}
+
+}
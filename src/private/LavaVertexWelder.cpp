@@ -0,0 +1,289 @@
+//
+//  LavaVertexWelder.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#include "LavaVertexWelder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lava
+{
+
+static_assert(sizeof(Vertex) == 11 * sizeof(float), "NOTE: Vertex is compared and hashed as raw bytes, it must not contain padding");
+
+LavaVertexWelder::LavaVertexWelder(std::vector<Vertex>& InVertices, size_t ExpectedCount)
+    : Vertices(InVertices)
+{
+    // Vertices already in the array are added to the table as well
+    Vertices.reserve(Vertices.size() + ExpectedCount);
+    Reserve(Vertices.size() + ExpectedCount);
+}
+
+uint64_t LavaVertexWelder::HashVertex(const Vertex& V)
+{
+    constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+
+    uint64_t Words[6] = {};
+    std::memcpy(Words, &V, sizeof(Vertex));
+
+    // Pairs of words are mixed independently and then folded together
+    uint64_t Hash = sizeof(Vertex);
+    for (int i = 0; i < 6; i += 2)
+    {
+        const uint64_t Mixed = (Words[i] ^ Prime1) * ((Words[i + 1] ^ Prime2) | 1);
+        Hash = (Hash ^ Mixed ^ (Mixed >> 29)) * Prime1;
+    }
+
+    Hash ^= Hash >> 32;
+    Hash *= Prime2;
+    Hash ^= Hash >> 29;
+
+    return Hash;
+}
+
+uint32_t LavaVertexWelder::Insert(const Vertex& V)
+{
+    // +0 and -0 are equal vertices but differ in their bits
+    Vertex Key = V;
+    float* Components = reinterpret_cast<float*>(&Key);
+    for (size_t i = 0; i < sizeof(Vertex) / sizeof(float); ++i)
+    {
+        Components[i] += 0.f;
+    }
+
+    const uint64_t Hash = HashVertex(Key);
+    const uint32_t Tag = static_cast<uint32_t>(Hash >> 32);
+
+    for (size_t SlotIdx = Hash & Mask; ; SlotIdx = (SlotIdx + 1) & Mask)
+    {
+        Slot& Current = Slots[SlotIdx];
+
+        if (Current.Index == EmptyIndex)
+        {
+            const uint32_t Index = static_cast<uint32_t>(Vertices.size());
+            Current = {Tag, Index};
+            Vertices.push_back(Key);
+
+            if (Vertices.size() * 2 > Slots.size())
+            {
+                Reserve(Vertices.size() * 2);
+            }
+
+            return Index;
+        }
+
+        if (Current.Hash == Tag && std::memcmp(&Vertices[Current.Index], &Key, sizeof(Vertex)) == 0)
+            return Current.Index;
+    }
+}
+
+void LavaVertexWelder::Reserve(size_t Count)
+{
+    size_t Capacity = 16;
+    while (Capacity < Count * 2)
+    {
+        Capacity *= 2;
+    }
+
+    if (Capacity <= Slots.size())
+        return;
+
+    Slots.assign(Capacity, Slot{0, EmptyIndex});
+    Mask = Capacity - 1;
+
+    // Tags only hold the upper bits, so hashes are recomputed when the table grows
+    for (uint32_t Index = 0; Index < Vertices.size(); ++Index)
+    {
+        const uint64_t Hash = HashVertex(Vertices[Index]);
+        for (size_t SlotIdx = Hash & Mask; ; SlotIdx = (SlotIdx + 1) & Mask)
+        {
+            if (Slots[SlotIdx].Index == EmptyIndex)
+            {
+                Slots[SlotIdx] = {static_cast<uint32_t>(Hash >> 32), Index};
+                break;
+            }
+        }
+    }
+}
+
+uint32_t LavaVertexWelder::WeldNearby
+    ( std::vector<Vertex>& Vertices
+    , std::vector<uint32_t>& Indices
+    , const WeldTolerances& Tolerances
+    , std::vector<SubMesh>* Ranges )
+{
+    if (Vertices.empty())
+        return 0;
+
+    // Cells are never smaller than 2^-19 of the largest coordinate, so that cell coordinates fit in 21 bits each and
+    // the three of them can be packed into a single key. A smaller tolerance just makes the cells hold more vertices
+    float MaxCoordinate = 0.f;
+    for (const Vertex& V : Vertices)
+    {
+        MaxCoordinate = std::max({MaxCoordinate, std::abs(V.position.x), std::abs(V.position.y), std::abs(V.position.z)});
+    }
+
+    const float CellSize = std::max({Tolerances.Position, MaxCoordinate / float(1 << 19), 1e-30f});
+    const float InverseCellSize = 1.f / CellSize;
+    constexpr int64_t CellBias = (1 << 19) + 1;
+
+    const auto MakeCellKey = [](int64_t X, int64_t Y, int64_t Z)
+    {
+        return (static_cast<uint64_t>(X + CellBias) << 42) | (static_cast<uint64_t>(Y + CellBias) << 21) | static_cast<uint64_t>(Z + CellBias);
+    };
+
+    // Flat table from cell keys to the last kept vertex inserted in that cell. The other vertices of the cell are
+    // chained through NextInCell
+    struct Cell
+    {
+        uint64_t Key;
+        uint32_t Head;
+    };
+
+    constexpr uint64_t EmptyKey = UINT64_MAX;
+
+    size_t Capacity = 16;
+    while (Capacity < Vertices.size() * 2)
+    {
+        Capacity *= 2;
+    }
+
+    std::vector<Cell> Cells(Capacity, Cell{EmptyKey, EmptyIndex});
+    const size_t CellMask = Capacity - 1;
+
+    const auto FindCell = [&Cells, CellMask](uint64_t Key) -> Cell&
+    {
+        const uint64_t Hash = (Key ^ (Key >> 29)) * 0x9E3779B185EBCA87ull;
+        for (size_t CellIdx = (Hash >> 32) & CellMask; ; CellIdx = (CellIdx + 1) & CellMask)
+        {
+            if (Cells[CellIdx].Key == Key || Cells[CellIdx].Key == EmptyKey)
+                return Cells[CellIdx];
+        }
+    };
+
+    const float PositionTolerance2 = Tolerances.Position * Tolerances.Position;
+    const float NormalCosine = std::cos(Tolerances.NormalAngle);
+
+    // Colors are never merged beyond half a unorm8 step, which would be visible once quantized
+    constexpr float ColorTolerance = .5f / 255.f;
+
+    const auto IsClose = [&](const Vertex& A, const Vertex& B)
+    {
+        const glm::vec3 Delta = A.position - B.position;
+        if (glm::dot(Delta, Delta) > PositionTolerance2)
+            return false;
+
+        if (std::abs(A.uv.x - B.uv.x) > Tolerances.TexCoord || std::abs(A.uv.y - B.uv.y) > Tolerances.TexCoord)
+            return false;
+
+        const glm::vec3 ColorDelta = glm::abs(A.color - B.color);
+        if (std::max({ColorDelta.x, ColorDelta.y, ColorDelta.z}) > ColorTolerance)
+            return false;
+
+        // Vertices without a normal only match each other
+        const float LengthA = glm::length(A.normal);
+        const float LengthB = glm::length(B.normal);
+        if (LengthA == 0.f || LengthB == 0.f)
+            return LengthA == LengthB;
+
+        return glm::dot(A.normal, B.normal) >= NormalCosine * LengthA * LengthB;
+    };
+
+    // Kept vertices are compacted to the front of the array as they are found
+    std::vector<uint32_t> Remap(Vertices.size());
+    std::vector<uint32_t> NextInCell(Vertices.size(), EmptyIndex);
+    uint32_t KeptCount = 0;
+
+    for (uint32_t VertexIdx = 0; VertexIdx < Vertices.size(); ++VertexIdx)
+    {
+        const Vertex V = Vertices[VertexIdx];
+
+        // Non finite positions have no cell, they are only kept
+        if (!std::isfinite(V.position.x) || !std::isfinite(V.position.y) || !std::isfinite(V.position.z))
+        {
+            Remap[VertexIdx] = KeptCount;
+            Vertices[KeptCount++] = V;
+            continue;
+        }
+
+        const int64_t CellX = static_cast<int64_t>(std::floor(V.position.x * InverseCellSize));
+        const int64_t CellY = static_cast<int64_t>(std::floor(V.position.y * InverseCellSize));
+        const int64_t CellZ = static_cast<int64_t>(std::floor(V.position.z * InverseCellSize));
+
+        uint32_t Match = EmptyIndex;
+        for (int64_t X = CellX - 1; X <= CellX + 1 && Match == EmptyIndex; ++X)
+        {
+            for (int64_t Y = CellY - 1; Y <= CellY + 1 && Match == EmptyIndex; ++Y)
+            {
+                for (int64_t Z = CellZ - 1; Z <= CellZ + 1 && Match == EmptyIndex; ++Z)
+                {
+                    for (uint32_t Kept = FindCell(MakeCellKey(X, Y, Z)).Head; Kept != EmptyIndex; Kept = NextInCell[Kept])
+                    {
+                        if (IsClose(Vertices[Kept], V))
+                        {
+                            Match = Kept;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (Match != EmptyIndex)
+        {
+            Remap[VertexIdx] = Match;
+            continue;
+        }
+
+        Cell& Current = FindCell(MakeCellKey(CellX, CellY, CellZ));
+        Current.Key = MakeCellKey(CellX, CellY, CellZ);
+        NextInCell[KeptCount] = Current.Head;
+        Current.Head = KeptCount;
+
+        Remap[VertexIdx] = KeptCount;
+        Vertices[KeptCount++] = V;
+    }
+
+    const uint32_t RemovedCount = static_cast<uint32_t>(Vertices.size()) - KeptCount;
+    Vertices.resize(KeptCount);
+
+    // Triangles with two corners merged into the same vertex have no area left. Ranges are in index order,
+    // so they can be compacted in place one after the other
+    std::vector<SubMesh> WholeMesh{{0, static_cast<uint32_t>(Indices.size()), 0}};
+    std::vector<SubMesh>& Compacted = Ranges && !Ranges->empty() ? *Ranges : WholeMesh;
+
+    size_t WriteIdx = 0;
+    for (SubMesh& Range : Compacted)
+    {
+        const size_t FirstIndex = WriteIdx;
+        for (size_t TriangleIdx = Range.FirstIndex; TriangleIdx + 2 < Range.FirstIndex + Range.IndexCount; TriangleIdx += 3)
+        {
+            const uint32_t A = Remap[Indices[TriangleIdx]];
+            const uint32_t B = Remap[Indices[TriangleIdx + 1]];
+            const uint32_t C = Remap[Indices[TriangleIdx + 2]];
+
+            if (A == B || B == C || A == C)
+                continue;
+
+            Indices[WriteIdx++] = A;
+            Indices[WriteIdx++] = B;
+            Indices[WriteIdx++] = C;
+        }
+
+        Range.FirstIndex = static_cast<uint32_t>(FirstIndex);
+        Range.IndexCount = static_cast<uint32_t>(WriteIdx - FirstIndex);
+    }
+    Indices.resize(WriteIdx);
+
+    Compacted.erase(std::remove_if(Compacted.begin(), Compacted.end(), [](const SubMesh& Range) { return Range.IndexCount == 0; }), Compacted.end());
+
+    return RemovedCount;
+}
+
+}
@@ -7,21 +7,75 @@
 
 #include "RenderSystem.hpp"
 
+#include "LavaSwapChain.hpp"
+#include "LavaUtils.hpp"
+
 #define GLM_FORCE_RADIANS // expects angles to be defined in radians
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <filesystem>
 
 namespace lava {
 
+namespace
+{
+
+// Everything needed to cull the meshlets of a single object
+struct MeshletCullingContext
+{
+    const std::array<glm::vec4, 6>& FrustumPlanes;
+    glm::vec3 CameraPosition;
+    glm::mat4 ModelMatrix;
+    glm::mat3 NormalMatrix;
+    float MaxScale;
+
+    // Non uniform scales change the angles between normals, so the cones are not valid anymore
+    bool bConeCulling;
+};
+
+// What every sub mesh of a visible object is drawn with
+struct VisibleObject
+{
+    PushConstant3DData PushConstant;
+    MeshletCullingContext CullingContext;
+};
+
+bool IsMeshletVisible(const Meshlet& Cluster, const MeshletCullingContext& Context)
+{
+    const glm::vec3 Center = glm::vec3{Context.ModelMatrix * glm::vec4{Cluster.Center, 1.f}};
+    const float Radius = Cluster.Radius * Context.MaxScale;
+
+    for (const glm::vec4& Plane : Context.FrustumPlanes)
+    {
+        if (glm::dot(glm::vec3{Plane}, Center) + Plane.w < -Radius)
+            return false;
+    }
+
+    if (Context.bConeCulling && Cluster.ConeCutoff < 1.f)
+    {
+        // Back facing if the direction from the camera falls inside the normal cone, accounting for the sphere size
+        const glm::vec3 Axis = glm::normalize(Context.NormalMatrix * Cluster.ConeAxis);
+        const glm::vec3 ViewDirection = Center - Context.CameraPosition;
+        if (glm::dot(ViewDirection, Axis) >= Cluster.ConeCutoff * glm::length(ViewDirection) + Radius)
+            return false;
+    }
+
+    return true;
+}
+
+}
+
 #pragma region Lifecycle
 
 RenderSystem::RenderSystem(LavaDevice& InDevice, VkRenderPass InRenderPass, VkDescriptorSetLayout GlobalSetLayout)
 : Device(InDevice)
 {
+    CreateMaterialResources();
     CreatePipelineLayout(GlobalSetLayout);
     CreatePipeline(InRenderPass);
 }
@@ -42,7 +96,7 @@ void RenderSystem::CreatePipelineLayout(VkDescriptorSetLayout GlobalSetLayout)
     PushConstantRange.offset = 0;
     PushConstantRange.size = sizeof(PushConstantRange);
 
-    std::vector<VkDescriptorSetLayout> DescriptorSetLayouts{GlobalSetLayout};
+    std::vector<VkDescriptorSetLayout> DescriptorSetLayouts{GlobalSetLayout, MaterialSetLayout->getDescriptorSetLayout()};
     
     VkPipelineLayoutCreateInfo PipelineLayoutInfo{};
     PipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -71,6 +125,12 @@ void RenderSystem::CreatePipeline(VkRenderPass& RenderPass)
     const std::filesystem::path vertexShaderAbsPath = std::filesystem::absolute("shaders/vertex_shader.vert.spv");
     const std::filesystem::path fragmentShaderAbsPath = std::filesystem::absolute("shaders/fragment_shader.frag.spv");
     Pipeline = std::make_unique<LavaPipeline>(Device, PipelineConfigInfo, vertexShaderAbsPath, fragmentShaderAbsPath);
+
+    // Models using quantized vertices need a different input layout and have to decode their normals
+    PipelineConfigInfo.bindingDescriptions = CompactVertex::GetBindingDesc();
+    PipelineConfigInfo.attributeDescriptions = CompactVertex::GetAttributeDescs();
+    const std::filesystem::path compactVertexShaderAbsPath = std::filesystem::absolute("shaders/vertex_shader_compact.vert.spv");
+    CompactPipeline = std::make_unique<LavaPipeline>(Device, PipelineConfigInfo, compactVertexShaderAbsPath, fragmentShaderAbsPath);
 }
 
 #pragma endregion
@@ -80,7 +140,76 @@ void RenderSystem::CreatePipeline(VkRenderPass& RenderPass)
 
 void RenderSystem::RenderGameObjects(const FrameDescriptor& FrameDesc)
 {
-    Pipeline->Bind(FrameDesc.CommandBuffer);
+    const std::array<glm::vec4, 6> FrustumPlanes = FrameDesc.Camera.GetFrustumPlanes();
+
+    std::vector<VisibleObject> VisibleObjects{};
+    VisibleObjects.reserve(FrameDesc.Objects.size());
+
+    DrawItems.clear();
+    FrameMaterials.clear();
+    FrameMaterialSlots.clear();
+
+    // Objects are culled and their draws gathered first, then recorded sorted by state
+    for (auto& GameObject : FrameDesc.Objects)
+    {
+        const std::shared_ptr<LavaModel> Model = GameObject.second.GetModel();
+        if (!Model)
+            continue;
+
+        const glm::mat4 ModelMatrix = GameObject.second.Transform.mat4();
+        const BoundingSphere WorldSphere = Model->GetBoundingSphere().Transform(ModelMatrix);
+
+        // Whole objects outside the frustum skip the draw, and the culling of their meshlets
+        const bool bOutsideFrustum = std::any_of(FrustumPlanes.begin(), FrustumPlanes.end(), [&WorldSphere](const glm::vec4& Plane)
+        {
+            return glm::dot(glm::vec3{Plane}, WorldSphere.Center) + Plane.w < -WorldSphere.Radius;
+        });
+        if (bOutsideFrustum)
+            continue;
+
+        PushConstant3DData PushConstant{};
+        // Quantized positions are brought back to model space before applying the object transform
+        PushConstant.ModelMatrix = ModelMatrix * Model->GetDequantizationMatrix();
+        PushConstant.normalMatrix = GameObject.second.Transform.normalMatrix(); // Automatically padded to 4x4 matrix
+
+        // Meshlet bounds are in model space, before dequantization
+        const glm::vec3 Scale = glm::abs(GameObject.second.Transform.Scale);
+        const float MaxScale = glm::max(Scale.x, glm::max(Scale.y, Scale.z));
+        const float MinScale = glm::min(Scale.x, glm::min(Scale.y, Scale.z));
+
+        const MeshletCullingContext CullingContext
+        {
+            FrustumPlanes,
+            FrameDesc.Camera.GetPosition(),
+            ModelMatrix,
+            GameObject.second.Transform.normalMatrix(),
+            MaxScale,
+            MaxScale - MinScale <= 1e-3f * MaxScale
+        };
+
+        const uint32_t ObjectIdx = static_cast<uint32_t>(VisibleObjects.size());
+        VisibleObjects.push_back({PushConstant, CullingContext});
+
+        // Both pipelines share the same layout, so the bound descriptor sets stay valid when switching
+        LavaPipeline* ModelPipeline = Model->GetVertexFormat() == VertexFormat::Compact ? CompactPipeline.get() : Pipeline.get();
+
+        // Meshlets only cover the full detail level
+        const uint32_t Lod = SelectLod(*Model, WorldSphere, GameObject.second.Transform.Scale, FrameDesc.Camera);
+        const bool bMeshlets = Lod == 0 && Model->HasMeshlets();
+
+        const LodLevel& Level = Model->GetLod(Lod);
+        for (uint32_t SubMeshIdx = Level.FirstSubMesh; SubMeshIdx < Level.FirstSubMesh + Level.SubMeshCount; ++SubMeshIdx)
+        {
+            const Material& Constants = Model->GetMaterials()[Model->GetSubMesh(SubMeshIdx).Material];
+            DrawItems.push_back({ModelPipeline, FindMaterialSlot(Constants), Model.get(), ObjectIdx, SubMeshIdx, bMeshlets});
+        }
+    }
+
+    if (DrawItems.empty())
+        return;
+
+    UploadMaterials(FrameDesc.FrameIdx);
+    std::sort(DrawItems.begin(), DrawItems.end());
 
     // At each frame we can bind multiple sets at time, but you must point the starting set
     // also if you are adding a set in previous positions
@@ -93,25 +222,178 @@ void RenderSystem::RenderGameObjects(const FrameDescriptor& FrameDesc)
         , &FrameDesc.GlobalDescriptorSet
         , 0
         , nullptr);
-    
-    for (auto& GameObject : FrameDesc.Objects)
+
+    const VkDeviceSize MaterialStride = MaterialBuffers[FrameDesc.FrameIdx]->getAlignmentSize();
+
+    LavaPipeline* BoundPipeline = nullptr;
+    uint32_t BoundMaterialSlot = UINT32_MAX;
+    LavaGeometryBinding BoundGeometry{};
+    uint32_t BoundObjectIdx = UINT32_MAX;
+
+    for (const DrawItem& Item : DrawItems)
     {
-        PushConstant3DData PushConstant{};       
-        PushConstant.ModelMatrix = GameObject.second.Transform.mat4();
-        PushConstant.normalMatrix = GameObject.second.Transform.normalMatrix(); // Automatically padded to 4x4 matrix
-        
-        vkCmdPushConstants(FrameDesc.CommandBuffer, PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstant3DData), &PushConstant);
-        
-        const std::shared_ptr<LavaModel> Model = GameObject.second.GetModel();
-        if (Model)
+        if (Item.Pipeline != BoundPipeline)
+        {
+            Item.Pipeline->Bind(FrameDesc.CommandBuffer);
+            BoundPipeline = Item.Pipeline;
+        }
+
+        if (Item.MaterialSlot != BoundMaterialSlot)
         {
-            Model->Bind(FrameDesc.CommandBuffer);
-            Model->Draw(FrameDesc.CommandBuffer);
+            const uint32_t DynamicOffset = static_cast<uint32_t>(Item.MaterialSlot * MaterialStride);
+            vkCmdBindDescriptorSets
+                ( FrameDesc.CommandBuffer
+                , VK_PIPELINE_BIND_POINT_GRAPHICS
+                , PipelineLayout
+                , 1
+                , 1
+                , &MaterialDescriptorSets[FrameDesc.FrameIdx]
+                , 1
+                , &DynamicOffset);
+            BoundMaterialSlot = Item.MaterialSlot;
         }
+
+        // Models share the buffers of the geometry pool, so they are only bound again when the format or the page changes
+        const LavaGeometryBinding Geometry = Item.Model->GetBinding();
+        if (Geometry != BoundGeometry)
+        {
+            Item.Model->Bind(FrameDesc.CommandBuffer);
+            BoundGeometry = Geometry;
+        }
+
+        const VisibleObject& Object = VisibleObjects[Item.ObjectIdx];
+        if (Item.ObjectIdx != BoundObjectIdx)
+        {
+            vkCmdPushConstants(FrameDesc.CommandBuffer, PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstant3DData), &Object.PushConstant);
+            BoundObjectIdx = Item.ObjectIdx;
+        }
+
+        if (!Item.bMeshlets)
+        {
+            Item.Model->DrawSubMesh(FrameDesc.CommandBuffer, Item.SubMeshIdx);
+            continue;
+        }
+
+        Item.Model->DrawMeshlets(FrameDesc.CommandBuffer, Item.SubMeshIdx, [&Object](const Meshlet& Cluster)
+        {
+            return IsMeshletVisible(Cluster, Object.CullingContext);
+        });
     }
 }
 
+uint32_t RenderSystem::SelectLod(const LavaModel& Model, const BoundingSphere& WorldSphere, const glm::vec3& Scale, const LavaCamera& Camera) const
+{
+    const uint32_t LodCount = Model.GetLodCount();
+    if (LodCount <= 1)
+        return 0;
+
+    // LOD errors are in model space, before dequantization
+    const float MaxScale = glm::max(glm::abs(Scale.x), glm::max(glm::abs(Scale.y), glm::abs(Scale.z)));
+
+    // The closest point of the bounds is the one where the error looks the largest
+    const float Distance = glm::length(WorldSphere.Center - Camera.GetPosition()) - WorldSphere.Radius;
+    const float ScreenScale = Camera.GetScreenScale(Distance) * MaxScale;
+
+    // Errors grow with the level, so the first one that is too coarse ends the search
+    uint32_t Lod = 0;
+    while (Lod + 1 < LodCount && Model.GetLod(Lod + 1).Error * ScreenScale <= MaxScreenError)
+    {
+        ++Lod;
+    }
+
+    return static_cast<uint32_t>(glm::clamp(static_cast<int>(Lod) + LodBias, 0, static_cast<int>(LodCount) - 1));
+}
+
 #pragma endregion
 
+#pragma region Materials
+
+size_t RenderSystem::MaterialHasher::operator()(const Material& Constants) const
+{
+    return static_cast<size_t>(HashBytes(&Constants, sizeof(Material)));
+}
+
+void RenderSystem::CreateMaterialResources()
+{
+    // The offset of the material is given when binding the set, so a single set per frame serves all of them
+    MaterialSetLayout = LavaDescriptorSetLayout::Builder(Device)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+        .build();
+
+    MaterialPool = LavaDescriptorPool::Builder(Device)
+        .setMaxSets(LavaSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, LavaSwapChain::MAX_FRAMES_IN_FLIGHT)
+        .build();
+
+    MaterialBuffers.resize(LavaSwapChain::MAX_FRAMES_IN_FLIGHT);
+    MaterialDescriptorSets.resize(LavaSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+    for (size_t FrameIdx = 0; FrameIdx < MaterialBuffers.size(); ++FrameIdx)
+    {
+        MaterialBuffers[FrameIdx] = std::make_unique<LavaBuffer>
+            ( Device
+            , sizeof(Material)
+            , InitialMaterialCapacity
+            , VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+            , VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            , Device.properties.limits.minUniformBufferOffsetAlignment );
+
+        MaterialBuffers[FrameIdx]->map();
+
+        // The range is a single material, the dynamic offset selects which one
+        auto BufferInfo = MaterialBuffers[FrameIdx]->descriptorInfo(sizeof(Material), 0);
+        LavaDescriptorWriter(*MaterialSetLayout, *MaterialPool)
+            .writeBuffer(0, &BufferInfo)
+            .build(MaterialDescriptorSets[FrameIdx]);
+    }
+}
+
+uint32_t RenderSystem::FindMaterialSlot(const Material& Constants)
+{
+    const auto Inserted = FrameMaterialSlots.insert({Constants, static_cast<uint32_t>(FrameMaterials.size())});
+    if (Inserted.second)
+    {
+        FrameMaterials.push_back(Constants);
+    }
+
+    return Inserted.first->second;
 }
 
+void RenderSystem::UploadMaterials(const int FrameIdx)
+{
+    std::unique_ptr<LavaBuffer>& Buffer = MaterialBuffers[FrameIdx];
+
+    // The previous use of this frame's buffer has completed, so it can be replaced and its set rewritten
+    if (FrameMaterials.size() > Buffer->getInstanceCount())
+    {
+        uint32_t Capacity = Buffer->getInstanceCount();
+        while (Capacity < FrameMaterials.size())
+        {
+            Capacity *= 2;
+        }
+
+        Buffer = std::make_unique<LavaBuffer>
+            ( Device
+            , sizeof(Material)
+            , Capacity
+            , VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+            , VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            , Device.properties.limits.minUniformBufferOffsetAlignment );
+
+        Buffer->map();
+
+        auto BufferInfo = Buffer->descriptorInfo(sizeof(Material), 0);
+        LavaDescriptorWriter(*MaterialSetLayout, *MaterialPool)
+            .writeBuffer(0, &BufferInfo)
+            .overwrite(MaterialDescriptorSets[FrameIdx]);
+    }
+
+    for (size_t Slot = 0; Slot < FrameMaterials.size(); ++Slot)
+    {
+        Buffer->writeToIndex(&FrameMaterials[Slot], static_cast<int>(Slot));
+    }
+}
+
+#pragma endregion
+
+}
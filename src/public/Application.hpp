@@ -18,6 +18,8 @@
 #include "LavaRenderer.hpp"
 #include "LavaGameObject.hpp"
 #include "LavaDescriptor.hpp"
+#include "LavaModelLoader.hpp"
+#include "LavaModelRegistry.hpp"
 
 namespace lava {
 
@@ -68,6 +70,13 @@ private:
     LavaDevice Device{Window};
     
     LavaRenderer Renderer{Window, Device};
+
+    // Shares the models between the objects using the same geometry. A few of them are kept around after their
+    // last object is gone, as scenes often reload the same props
+    LavaModelRegistry ModelRegistry{16};
+
+    // Parses and uploads models in the background, so that loading never stalls the frame loop
+    LavaModelLoader ModelLoader{Device, 0, &ModelRegistry};
     
 #pragma endregion
     
@@ -0,0 +1,81 @@
+//
+//  LavaBounds.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <cstddef>
+
+#define GLM_FORCE_RADIANS // expects angles to be defined in radians
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace lava
+{
+
+#pragma region Types
+
+// Axis aligned bounding box
+struct BoundingBox
+{
+    glm::vec3 Min{};
+    glm::vec3 Max{};
+
+    glm::vec3 GetCenter() const { return (Min + Max) * .5f; }
+    glm::vec3 GetExtent() const { return (Max - Min) * .5f; }
+
+    /**
+     Axis aligned box enclosing this one once transformed by Matrix (Arvo). Each half extent of the result is the
+     sum of the old half extents scaled by the absolute values of the matrix row, so no corner is transformed
+     */
+    BoundingBox Transform(const glm::mat4& Matrix) const
+    {
+        const glm::vec3 Center = glm::vec3{Matrix * glm::vec4{GetCenter(), 1.f}};
+        const glm::mat3 AbsMatrix{glm::abs(glm::vec3{Matrix[0]}), glm::abs(glm::vec3{Matrix[1]}), glm::abs(glm::vec3{Matrix[2]})};
+        const glm::vec3 Extent = AbsMatrix * GetExtent();
+
+        return {Center - Extent, Center + Extent};
+    }
+};
+
+struct BoundingSphere
+{
+    glm::vec3 Center{};
+    float Radius = 0.f;
+
+    /** Sphere enclosing this one once transformed by Matrix. The radius grows with the largest scale of the matrix */
+    BoundingSphere Transform(const glm::mat4& Matrix) const
+    {
+        const float MaxScale2 = glm::max
+            ( glm::dot(glm::vec3{Matrix[0]}, glm::vec3{Matrix[0]})
+            , glm::max(glm::dot(glm::vec3{Matrix[1]}, glm::vec3{Matrix[1]}), glm::dot(glm::vec3{Matrix[2]}, glm::vec3{Matrix[2]})) );
+
+        return {glm::vec3{Matrix * glm::vec4{Center, 1.f}}, Radius * glm::sqrt(MaxScale2)};
+    }
+};
+
+#pragma endregion
+
+/**
+ Bounds of vertex positions. Positions are read through a byte stride, so that they can be taken straight from
+ interleaved vertices. The box is computed four components at a time with SSE or NEON, whichever is available
+ */
+class LavaBounds
+{
+public:
+
+    /**
+     Positions are 3 floats each, Stride bytes apart, and at least 16 bytes must be readable from each of them. NaN
+     positions are ignored. An empty set gives an empty box at the origin
+     */
+    static BoundingBox ComputeBox(const float* Positions, size_t Count, size_t Stride);
+
+    /** Sphere centered in the box, with the radius of the farthest position */
+    static BoundingSphere ComputeSphere(const float* Positions, size_t Count, size_t Stride, const BoundingBox& Box);
+};
+
+}
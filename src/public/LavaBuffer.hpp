@@ -27,6 +27,8 @@ public:
     /**
      * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
      *
+     * @note Host visible memory stays mapped by the allocator, this only points into its mapping
+     *
      * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
      * buffer range.
      * @param offset (Optional) Byte offset from beginning
@@ -38,7 +40,7 @@ public:
     /**
      * Unmap a mapped memory range
      *
-     * @note Does not return a result as vkUnmapMemory can't fail
+     * @note The memory itself stays mapped as long as the other buffers of its block use it
      */
     void unmap();
 
@@ -130,10 +132,11 @@ public:
     void* getMappedMemory() const { return mapped; }
     uint32_t getInstanceCount() const { return instanceCount; }
     VkDeviceSize getInstanceSize() const { return instanceSize; }
-    VkDeviceSize getAlignmentSize() const { return instanceSize; }
+    VkDeviceSize getAlignmentSize() const { return alignmentSize; }
     VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
     VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
     VkDeviceSize getBufferSize() const { return bufferSize; }
+    const LavaMemoryAllocation& getAllocation() const { return allocation; }
 
 private:
 
@@ -151,7 +154,7 @@ private:
     LavaDevice& Device;
     void* mapped = nullptr;
     VkBuffer buffer = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    LavaMemoryAllocation allocation{};
 
     VkDeviceSize bufferSize;
     uint32_t instanceCount;
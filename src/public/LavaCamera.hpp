@@ -11,6 +11,8 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <array>
+
 namespace lava
 {
 
@@ -42,6 +44,14 @@ public:
     glm::mat4 GetProjectionMat() const { return ProjectionMat; }
     
     glm::mat4 GetViewMat() const { return ViewMatrix; }
+
+    glm::vec3 GetPosition() const { return Position; }
+
+    /** World space frustum planes (left, right, bottom, top, near, far) as (normal, distance), with normals pointing inside **/
+    std::array<glm::vec4, 6> GetFrustumPlanes() const;
+
+    /** Fraction of the viewport height covered by a length of one unit placed at Distance from the camera **/
+    float GetScreenScale(const float Distance) const;
     
 private:
     
@@ -49,6 +59,8 @@ private:
     glm::mat4 ProjectionMat{1.f};
     
     glm::mat4 ViewMatrix{1.f};
+
+    glm::vec3 Position{0.f};
 };
 
 }
@@ -1,8 +1,12 @@
 #pragma once
 
 #include "LavaWindow.hpp"
+#include "LavaMemoryAllocator.hpp"
+#include "LavaStagingRing.hpp"
+#include "LavaGeometryPool.hpp"
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -19,9 +23,14 @@ struct QueueFamilyIndices
 {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // Family without graphics support when the device has one, so that uploads run alongside rendering. Falls back to
+  // the graphics family
+  uint32_t transferFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
+  bool hasDedicatedTransfer() const { return transferFamilyHasValue && transferFamily != graphicsFamily; }
 };
 
 class LavaDevice
@@ -46,6 +55,7 @@ class LavaDevice
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VkQueue transferQueue() { return transferQueue_; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -53,15 +63,17 @@ class LavaDevice
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
-  // Buffer Helper Functions
+  // Buffer Helper Functions. Memory is sub-allocated from the blocks of the allocator, and released with freeMemory
   void createBuffer(
       VkDeviceSize size,
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      LavaMemoryAllocation &bufferAllocation);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+
+  // Copy and wait for completion. Many copies should go through a LavaUploadBatch, which submits them together
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
   void copyBufferToImage(
       VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
@@ -70,7 +82,16 @@ class LavaDevice
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      LavaMemoryAllocation &imageAllocation);
+
+  void freeMemory(LavaMemoryAllocation &allocation) { allocator->Free(allocation); }
+  LavaMemoryAllocator &memoryAllocator() { return *allocator; }
+
+  // Shared by the uploads to device local buffers
+  LavaStagingRing &stagingRing() { return *stagingRing_; }
+
+  // Shared vertex and index buffers of the models
+  LavaGeometryPool &geometryPool() { return *geometryPool_; }
 
   VkPhysicalDeviceProperties properties;
 
@@ -103,6 +124,11 @@ class LavaDevice
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+
+  std::unique_ptr<LavaMemoryAllocator> allocator;
+  std::unique_ptr<LavaStagingRing> stagingRing_;
+  std::unique_ptr<LavaGeometryPool> geometryPool_;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -0,0 +1,168 @@
+//
+//  LavaFileReader.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <unordered_set>
+#include <cstdint>
+
+namespace lava
+{
+
+#pragma region Types
+
+// Requests of a higher priority are always started before the ones of a lower priority
+enum class FileReadPriority : uint32_t
+{
+    Background,
+    Normal,
+    Urgent,
+
+    Count
+};
+
+enum class FileReadStatus : uint32_t
+{
+    Completed,
+    Failed,
+    Cancelled
+};
+
+struct FileReadResult
+{
+    uint64_t RequestId = 0;
+    uint64_t UserData = 0;
+    std::string Filepath{};
+
+    FileReadStatus Status = FileReadStatus::Failed;
+
+    // Whole content of the file, empty unless the read has completed
+    std::vector<char> Data{};
+
+    // Reason of the failure, only valid in the Failed state
+    std::string Error{};
+};
+
+/**
+ Thread safe queue the results of the reads are completed into. Every request pushes exactly one result, whatever its
+ outcome, so consumers can track their requests until the end
+ */
+class FileReadQueue
+{
+public:
+
+    void Push(FileReadResult&& Result);
+
+    /** Waits for a result. Returns false once the queue has been closed */
+    bool Pop(FileReadResult& Result);
+
+    /** Returns false when no result is available */
+    bool TryPop(FileReadResult& Result);
+
+    /** Wakes up the consumers waiting on the queue. Results pushed afterwards are dropped */
+    void Close();
+
+private:
+
+    std::mutex Mutex;
+    std::condition_variable ResultAvailable;
+    std::deque<FileReadResult> Results{};
+    bool bClosed = false;
+};
+
+#pragma endregion
+
+class IoRing;
+
+/**
+ Reads whole files asynchronously. On Linux the reads are batched through an io_uring instance, driven by a single
+ thread that keeps up to QueueDepth reads in flight. Elsewhere, or when io_uring is not available (old kernels,
+ sandboxes), the reads run on a pool of threads issuing positional reads. Pending requests are started by priority,
+ and can be cancelled until their result has been pushed
+ */
+class LavaFileReader
+{
+public:
+
+    /** QueueDepth is the number of reads in flight, which is also the size of the thread pool (capped to 8) */
+    explicit LavaFileReader(uint32_t QueueDepth = 32, bool bAllowIoUring = true);
+
+    /** Cancels the pending requests and waits for the ones in flight */
+    ~LavaFileReader();
+
+    LavaFileReader(const LavaFileReader&) = delete;
+    LavaFileReader& operator=(const LavaFileReader&) = delete;
+
+    /** Queues the read of Filepath, whose result is pushed into Completions. Returns the id of the request */
+    uint64_t Read(const std::string& Filepath, FileReadQueue& Completions, FileReadPriority Priority = FileReadPriority::Normal, uint64_t UserData = 0);
+
+    /**
+     Cancels a request. Pending requests complete as cancelled right away, the ones in flight as soon as their read
+     returns. Returns false when the result has already been pushed
+     */
+    bool Cancel(uint64_t RequestId);
+
+    bool UsesIoUring() const { return Ring != nullptr && !bRingFailed; }
+
+    /** Reads all the files in a single batch and waits for them. Throws if any of them cannot be read */
+    static std::vector<std::vector<char>> ReadFiles(const std::vector<std::string>& Filepaths);
+
+private:
+
+    struct Request
+    {
+        uint64_t Id = 0;
+        std::string Filepath{};
+        FileReadQueue* Completions = nullptr;
+        uint64_t UserData = 0;
+    };
+
+    // Reader behind ReadFiles, created on first use
+    static LavaFileReader& GetShared();
+
+    // Takes the oldest request of the highest priority. Expects Mutex to be locked
+    bool PopPendingLocked(Request& Out);
+
+    // Pushes the result of a request that has been started, which is cancelled if requested meanwhile
+    void Complete(const Request& Started, FileReadResult&& Result);
+
+    // Thread pool backend
+    void WorkerLoop();
+
+    // io_uring backend
+    void RingLoop();
+
+    // Wakes up the thread driving the ring, or one of the workers
+    void Wake();
+
+    std::unique_ptr<IoRing> Ring;
+    uint32_t QueueDepth = 0;
+
+    // Set by the ring thread when io_uring stops working, it then serves the requests left as a single worker
+    std::atomic<bool> bRingFailed{false};
+
+    std::vector<std::thread> Threads{};
+
+    std::mutex Mutex;
+    std::condition_variable RequestAvailable;
+    std::deque<Request> Pending[static_cast<size_t>(FileReadPriority::Count)];
+    std::unordered_set<uint64_t> InFlight{};
+    std::unordered_set<uint64_t> CancelledInFlight{};
+    uint64_t NextRequestId = 1;
+    bool bStopping = false;
+};
+
+}
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "LavaModel.hpp"
+#include "LavaModelLoader.hpp"
 
 #include <unordered_map>
 
@@ -79,7 +80,7 @@ struct TransformComponent
     // Optimized representation
     // This basically makes the Y * X * Z matrix computation and gets the formula for each resulting matrix position
     // making the same calculus but in a more efficient way because already knowing the components
-    glm::mat4 mat4()
+    glm::mat4 mat4() const
     {
         const float c3 = glm::cos(Rotation.z);
         const float s3 = glm::sin(Rotation.z);
@@ -174,9 +175,24 @@ public:
     
     id_t GetId() const { return Id; }
     
-    std::shared_ptr<LavaModel> GetModel() const { return Model; }
-    void SetModel(const std::shared_ptr<LavaModel>& InModel) { Model = InModel; }
+    // Objects whose model is still loading have no model, so they are not drawn
+    std::shared_ptr<LavaModel> GetModel() const { return Model ? Model : (PendingModel ? PendingModel->GetModel() : nullptr); }
+    void SetModel(const std::shared_ptr<LavaModel>& InModel) { Model = InModel; PendingModel.reset(); }
+    void SetModel(const std::shared_ptr<LavaModelHandle>& InModel) { Model.reset(); PendingModel = InModel; }
     
+    // World space bounds of the model, empty while the model is not available
+    BoundingBox GetWorldBounds() const
+    {
+        const std::shared_ptr<LavaModel> CurrentModel = GetModel();
+        return CurrentModel ? CurrentModel->GetBounds().Transform(Transform.mat4()) : BoundingBox{Transform.Translation, Transform.Translation};
+    }
+
+    BoundingSphere GetWorldBoundingSphere() const
+    {
+        const std::shared_ptr<LavaModel> CurrentModel = GetModel();
+        return CurrentModel ? CurrentModel->GetBoundingSphere().Transform(Transform.mat4()) : BoundingSphere{Transform.Translation, 0.f};
+    }
+
     glm::vec3 GetColor() const { return Color; }
     void SetColor(const glm::vec3& InColor) { Color = InColor; }
     
@@ -191,6 +207,7 @@ private:
     id_t Id;
     
     std::shared_ptr<LavaModel> Model{};
+    std::shared_ptr<LavaModelHandle> PendingModel{};
     glm::vec3 Color{};
     
 };
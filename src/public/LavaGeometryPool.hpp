@@ -0,0 +1,162 @@
+//
+//  LavaGeometryPool.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+namespace lava
+{
+
+class LavaDevice;
+struct LavaGeometryPage;
+struct LavaGeometryHeap;
+
+#pragma region Types
+
+// Current place of an allocation. Owned by the pool, which moves it around when compacting
+struct LavaGeometrySlot
+{
+    VkBuffer Buffer = VK_NULL_HANDLE;
+
+    // In elements of the heap, vertices or indices
+    uint32_t First = 0;
+    uint32_t Count = 0;
+    uint32_t ElementSize = 0;
+
+    LavaGeometryHeap* Heap = nullptr;
+    LavaGeometryPage* Page = nullptr;
+    bool bUsed = false;
+};
+
+/**
+ Range of vertices or indices handed out by LavaGeometryPool. It only refers to its slot, so that it follows the range
+ when the pool is compacted: the buffer and the offsets have to be read again every time they are recorded
+ */
+class LavaGeometryAllocation
+{
+public:
+
+    bool IsValid() const { return Slot != nullptr; }
+
+    VkBuffer GetBuffer() const { return Slot->Buffer; }
+
+    // Index of the first element, to be added to the firstIndex or vertexOffset of the draws
+    uint32_t GetFirst() const { return Slot->First; }
+    uint32_t GetCount() const { return Slot->Count; }
+
+    // Byte offset of the first element inside GetBuffer()
+    VkDeviceSize GetOffset() const { return static_cast<VkDeviceSize>(Slot->First) * Slot->ElementSize; }
+
+private:
+
+    friend class LavaGeometryPool;
+
+    LavaGeometrySlot* Slot = nullptr;
+};
+
+// Buffers to bind for drawing a model. Models with equal bindings are drawn without binding anything in between
+struct LavaGeometryBinding
+{
+    VkBuffer VertexBuffer = VK_NULL_HANDLE;
+    VkBuffer IndexBuffer = VK_NULL_HANDLE;
+    VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+
+    bool operator==(const LavaGeometryBinding& Other) const
+    {
+        return VertexBuffer == Other.VertexBuffer && IndexBuffer == Other.IndexBuffer && IndexType == Other.IndexType;
+    }
+
+    bool operator!=(const LavaGeometryBinding& Other) const { return !(*this == Other); }
+};
+
+struct LavaGeometryStats
+{
+    uint32_t PageCount = 0;
+    uint32_t AllocationCount = 0;
+
+    // Holes between the allocations, the free space at the end of the pages is not one
+    uint32_t FreeRangeCount = 0;
+
+    VkDeviceSize UsedSize = 0;
+    VkDeviceSize ReservedSize = 0;
+};
+
+#pragma endregion
+
+/**
+ Shared device local vertex and index buffers the models suballocate their geometry from, so that all the models of a
+ vertex format and index type are drawn through a single binding. Every vertex stride and index type has its own heap
+ of large pages, each page being one buffer whose free ranges are kept sorted and merged with their neighbours when
+ freed. Ranges are placed in the first page and range they fit in, allocations larger than a page get a page of their
+ own. Allocating and freeing are thread safe, so that the loader workers can place their models.
+
+ Freed ranges are reused right away, like destroyed buffers: models can only be released once the frames drawing
+ them are done. Holes left by the released models are closed by Compact
+ */
+class LavaGeometryPool
+{
+public:
+
+    static constexpr VkDeviceSize DefaultPageSize = 32ull << 20;
+
+    LavaGeometryPool(LavaDevice& InDevice, VkDeviceSize InPageSize = DefaultPageSize);
+    ~LavaGeometryPool();
+
+    LavaGeometryPool(const LavaGeometryPool&) = delete;
+    LavaGeometryPool& operator=(const LavaGeometryPool&) = delete;
+
+    /** Allocates Count vertices of Stride bytes. Throws if the device is out of memory */
+    LavaGeometryAllocation AllocateVertices(uint32_t Stride, uint32_t Count);
+
+    LavaGeometryAllocation AllocateIndices(VkIndexType Type, uint32_t Count);
+
+    /** Returns the range of Allocation to its page, and resets it. Freeing an invalid allocation does nothing */
+    void Free(LavaGeometryAllocation& Allocation);
+
+    /**
+     Moves every allocation of the fragmented heaps into new, tightly packed pages, and destroys the old ones. The
+     uploads recorded or in flight are waited for, and so is the whole device, so it is meant for loading screens and
+     level transitions. Thread owning the graphics queue, with no frame being recorded
+     */
+    void Compact();
+
+    LavaGeometryStats GetStats() const;
+
+    VkDeviceSize GetPageSize() const { return PageSize; }
+
+private:
+
+    LavaGeometryAllocation Allocate(VkBufferUsageFlags Usage, uint32_t ElementSize, uint32_t Count);
+
+    // Page of Heap holding at least Count elements, all free
+    std::unique_ptr<LavaGeometryPage> CreatePage(const LavaGeometryHeap& Heap, uint32_t Count);
+
+    // Whether repacking the allocations of Heap would free anything. Mutex held
+    bool IsFragmented(const LavaGeometryHeap& Heap) const;
+
+    LavaDevice& Device;
+    VkDeviceSize PageSize = 0;
+
+    // One for each usage and element size, there are only a few of them
+    std::vector<std::unique_ptr<LavaGeometryHeap>> Heaps{};
+
+    // Addresses stay the same as long as the pool lives, the allocations point to them
+    std::deque<LavaGeometrySlot> Slots{};
+    std::vector<LavaGeometrySlot*> FreeSlots{};
+
+    mutable std::mutex Mutex;
+};
+
+}
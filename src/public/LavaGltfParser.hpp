@@ -0,0 +1,117 @@
+//
+//  LavaGltfParser.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "LavaModel.hpp"
+#include "LavaMappedFile.hpp"
+
+namespace lava
+{
+
+#pragma region Types
+
+// Component types of the accessors, with the values of their OpenGL constants
+enum class GltfComponentType : uint32_t
+{
+    Byte          = 5120,
+    UnsignedByte  = 5121,
+    Short         = 5122,
+    UnsignedShort = 5123,
+    UnsignedInt   = 5125,
+    Float         = 5126
+};
+
+// Typed and strided view of the binary chunk. Elements are not aligned in general, so they are read through memcpy
+struct GltfAccessor
+{
+    const char* Data = nullptr; // First element, nullptr when the primitive does not have the attribute
+    uint32_t Count = 0;
+    uint32_t Stride = 0;        // Bytes between two consecutive elements
+    GltfComponentType ComponentType = GltfComponentType::Float;
+    uint32_t ComponentCount = 0;
+    bool bNormalized = false;
+
+    bool IsValid() const { return Data != nullptr; }
+
+    // Tightly packed or interleaved Components floats, which can be copied without any conversion
+    bool IsFloat(const uint32_t Components) const { return ComponentType == GltfComponentType::Float && ComponentCount == Components; }
+
+    /** Element Idx converted to floats. Normalized integers are mapped to [0, 1] or [-1, 1], missing components are 0 (w is 1) */
+    glm::vec4 ReadFloat(const uint32_t Idx) const;
+
+    uint32_t ReadIndex(const uint32_t Idx) const;
+};
+
+// Triangles sharing a material. Only the attributes the engine has a place for are kept
+struct GltfPrimitive
+{
+    GltfAccessor Positions{};
+    GltfAccessor Normals{};
+    GltfAccessor TexCoords{};  // TEXCOORD_0
+    GltfAccessor Colors{};     // COLOR_0
+    GltfAccessor Indices{};    // Vertices are drawn in order when missing
+
+    // Index inside GltfData::Materials, -1 for the default material
+    int32_t Material = -1;
+
+    // From the min and max of the position accessor, which the format requires
+    glm::vec3 BoundsMin{};
+    glm::vec3 BoundsMax{};
+};
+
+// Mesh placed in the default scene, drawn through the primitives [FirstPrimitive, FirstPrimitive + PrimitiveCount)
+struct GltfMeshInstance
+{
+    uint32_t FirstPrimitive = 0;
+    uint32_t PrimitiveCount = 0;
+    glm::mat4 Transform{1.f};
+};
+
+struct GltfData
+{
+    // Accessors point inside the mapped file, which lives as long as the data
+    LavaMappedFile File{};
+
+    std::vector<GltfPrimitive> Primitives{};
+    std::vector<GltfMeshInstance> Instances{};
+    std::vector<Material> Materials{};
+
+    // True when every instance is placed with the identity, so primitives can be used as they are in the file
+    bool HasIdentityTransforms() const;
+};
+
+#pragma endregion
+
+/**
+ Binary glTF 2.0 (.glb) parser. Only the JSON chunk is parsed: accessors are resolved to pointers inside the mapped
+ binary chunk, so that vertex and index data is never read before being copied to its destination. Only triangle
+ primitives stored inside the file are supported, external buffers, sparse accessors and compressed meshes are not
+ */
+class LavaGltfParser
+{
+public:
+
+    /** Maps and parses the file at Filepath. Throws on failure */
+    static GltfData ParseFile(const std::string& Filepath);
+
+    /** True for the files this parser can read, which are told apart by their extension */
+    static bool IsGltfFile(const std::string& Filepath);
+
+private:
+
+    static constexpr uint32_t Magic = 0x46546C67;     // "glTF"
+    static constexpr uint32_t JsonChunkType = 0x4E4F534A; // "JSON"
+    static constexpr uint32_t BinChunkType = 0x004E4942;  // "BIN\0"
+};
+
+}
@@ -0,0 +1,65 @@
+//
+//  LavaMappedFile.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace lava
+{
+
+/**
+ Read-only view of a whole file. On POSIX systems the file is memory mapped, so pages are loaded lazily by the OS
+ and no copy into user memory is ever made. On other platforms the file is read into an owned buffer
+ */
+class LavaMappedFile
+{
+public:
+
+    LavaMappedFile() = default;
+    explicit LavaMappedFile(const std::string& Filepath);
+
+    // Takes ownership of the content of a file that has already been read
+    explicit LavaMappedFile(std::vector<char>&& Contents);
+
+    // View of [Offset, Offset + InSize) inside Source, which is kept alive as long as the view
+    LavaMappedFile(std::shared_ptr<const LavaMappedFile> InSource, size_t Offset, size_t InSize);
+    ~LavaMappedFile();
+
+    LavaMappedFile(const LavaMappedFile&) = delete;
+    LavaMappedFile& operator=(const LavaMappedFile&) = delete;
+
+    LavaMappedFile(LavaMappedFile&& Other) noexcept;
+    LavaMappedFile& operator=(LavaMappedFile&& Other) noexcept;
+
+    /** Maps the file at Filepath, releasing any previous mapping. Returns false if the file cannot be opened */
+    bool Open(const std::string& Filepath);
+
+    void Close();
+
+    bool IsOpen() const { return bIsOpen; }
+
+    const char* GetData() const { return Data; }
+    size_t GetSize() const { return Size; }
+
+private:
+
+    const char* Data = nullptr;
+    size_t Size = 0;
+    bool bIsOpen = false;
+
+    // Used when memory mapping is not available, or when the content has been read by someone else
+    std::vector<char> FallbackBuffer;
+
+    // Owner of the data of a view, which is neither mapped nor copied by the view itself
+    std::shared_ptr<const LavaMappedFile> Source;
+};
+
+}
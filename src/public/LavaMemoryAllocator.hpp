@@ -0,0 +1,120 @@
+//
+//  LavaMemoryAllocator.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+namespace lava
+{
+
+class LavaMemoryBlock;
+
+#pragma region Types
+
+/**
+ Range of device memory handed out by LavaMemoryAllocator. Resources are bound at Offset in Memory, which they share
+ with the other allocations of the same block
+ */
+struct LavaMemoryAllocation
+{
+    VkDeviceMemory Memory = VK_NULL_HANDLE;
+    VkDeviceSize Offset = 0;
+    VkDeviceSize Size = 0;
+
+    // Host address of Offset if the memory is host visible. Blocks stay mapped as long as they live, since a memory
+    // object can only be mapped once
+    void* Mapped = nullptr;
+
+    // Owning block, nullptr for the allocations that got their own memory object
+    LavaMemoryBlock* Block = nullptr;
+    uint32_t RangeIdx = 0;
+
+    bool IsValid() const { return Memory != VK_NULL_HANDLE; }
+};
+
+struct LavaMemoryStats
+{
+    uint32_t BlockCount = 0;
+    uint32_t DedicatedCount = 0;
+    uint32_t AllocationCount = 0;
+
+    // Bytes handed out, and bytes allocated from the device
+    VkDeviceSize UsedSize = 0;
+    VkDeviceSize ReservedSize = 0;
+};
+
+#pragma endregion
+
+/**
+ Sub-allocates device memory out of large blocks, so that the number of vkAllocateMemory calls stays far below the
+ driver limit whatever the number of buffers. Every memory type has its own blocks, split again between linear
+ (buffers) and optimal (images) resources so that bufferImageGranularity never has to be honored inside a block.
+ Ranges are placed with a TLSF allocator: free ranges are binned into size classes, so that allocating and freeing
+ take constant time. Allocations too large for a block get their own memory object. Thread safe
+ */
+class LavaMemoryAllocator
+{
+public:
+
+    LavaMemoryAllocator(VkPhysicalDevice PhysicalDevice, VkDevice Device);
+    ~LavaMemoryAllocator();
+
+    LavaMemoryAllocator(const LavaMemoryAllocator&) = delete;
+    LavaMemoryAllocator& operator=(const LavaMemoryAllocator&) = delete;
+
+    /** Allocates memory for Requirements in a type with Properties. Throws if the device is out of memory */
+    LavaMemoryAllocation Allocate(const VkMemoryRequirements& Requirements, VkMemoryPropertyFlags Properties, bool bIsLinear);
+
+    /** Returns Allocation to its block, and resets it. Freeing an invalid allocation does nothing */
+    void Free(LavaMemoryAllocation& Allocation);
+
+    /** Range of memory flushes and invalidations have to cover for Size bytes at Offset in Allocation, VK_WHOLE_SIZE for all of it */
+    VkMappedMemoryRange GetMappedRange(const LavaMemoryAllocation& Allocation, VkDeviceSize Size, VkDeviceSize Offset) const;
+
+    uint32_t FindMemoryType(uint32_t TypeFilter, VkMemoryPropertyFlags Properties) const;
+
+    LavaMemoryStats GetStats() const;
+
+    // Default size of the blocks, heaps smaller than 512 MiB get blocks of an eighth of their size
+    static constexpr VkDeviceSize BlockSize = 64ull << 20;
+
+    // Granularity of the ranges: every allocation is at least this large and aligned
+    static constexpr VkDeviceSize MinAlignment = 256;
+
+private:
+
+    // Blocks of a memory type holding either linear or optimal resources
+    struct MemoryPool
+    {
+        std::vector<std::unique_ptr<LavaMemoryBlock>> Blocks{};
+        VkDeviceSize BlockSize = 0;
+    };
+
+    VkDeviceMemory AllocateMemory(uint32_t MemoryType, VkDeviceSize Size, void*& OutMapped);
+    void FreeMemory(VkDeviceMemory Memory, void* Mapped);
+
+    VkDevice Device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties MemoryProperties{};
+    VkDeviceSize NonCoherentAtomSize = 1;
+
+    // Indexed by memory type * 2 + optimal
+    std::vector<MemoryPool> Pools{};
+
+    uint32_t DedicatedCount = 0;
+    VkDeviceSize DedicatedSize = 0;
+
+    mutable std::mutex Mutex;
+};
+
+}
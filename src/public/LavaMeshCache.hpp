@@ -0,0 +1,209 @@
+//
+//  LavaMeshCache.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <cstdint>
+
+#include "LavaModel.hpp"
+#include "LavaMappedFile.hpp"
+
+// Cooked mesh (.lavamesh) file layout. Everything is little endian and every section starts on a 16 bytes boundary
+// so that it can be read in place from the mapped file
+//
+// | MeshCacheHeader | MeshCacheSection[SectionCount] | section data ... |
+//
+// The header stores the vertex layout the data was cooked with and the identity of the source file. A cache is
+// only used if both still match, otherwise the source is parsed again and the cache overwritten
+
+namespace lava
+{
+
+struct MeshOptimizationSettings;
+
+#pragma region Types
+
+enum class MeshCacheSectionType : uint32_t
+{
+    Vertices  = 0,
+    Indices   = 1, // 16 or 32 bit, depending on the element size
+    SubMeshes = 2, // Optional
+    Meshlets  = 3, // Optional
+    Lods      = 4, // Optional
+    Materials = 5, // Optional
+
+    // Replace Vertices and Indices in meshes cooked with bEncodeMesh (LavaMeshCodec streams)
+    EncodedVertices = 6,
+    EncodedIndices  = 7
+};
+
+struct MeshCacheSection
+{
+    MeshCacheSectionType Type;
+    uint32_t ElementSize;
+    uint64_t Offset; // from the beginning of the file
+    uint64_t Size;   // in bytes
+};
+
+struct MeshCacheAttribute
+{
+    uint32_t Location;
+    uint32_t Format; // VkFormat
+    uint32_t Offset;
+};
+
+// Identifies the content of the file a mesh has been cooked from
+struct MeshSourceStamp
+{
+    uint64_t Size = 0;
+    int64_t ModifiedTime = 0;
+    uint64_t Hash = 0;
+};
+
+struct MeshCacheHeader
+{
+    static constexpr uint32_t MaxAttributes = 8;
+
+    uint32_t Magic;
+    uint32_t Version;
+
+    MeshSourceStamp Source;
+
+    // Hash of all the sections, identifies the cooked data regardless of the file it comes from
+    uint64_t ContentHash;
+
+    // Vertex layout
+    VertexFormat Format;
+    uint32_t VertexStride;
+    uint32_t AttributeCount;
+    MeshCacheAttribute Attributes[MaxAttributes];
+
+    uint32_t VertexCount;
+    uint32_t IndexCount;
+
+    // Also used to dequantize compact vertices
+    float BoundsMin[3];
+    float BoundsMax[3];
+
+    // Bounding sphere, center and radius
+    float Sphere[4];
+
+    uint32_t SectionCount;
+
+    // MeshOptimizationSettings flags the data has been processed with
+    uint32_t ProcessingFlags;
+
+    uint32_t Padding;
+
+    // MeshOptimizationSettings::GetHash of the settings the data has been processed with, parameters included
+    uint64_t SettingsHash;
+};
+
+#pragma endregion
+
+/**
+ Read-only view of a cooked mesh. The file stays mapped as long as the object is alive, so the vertex and index
+ data can be copied straight into the staging buffers
+ */
+class LavaMeshCache
+{
+public:
+
+    static constexpr uint32_t Magic = 0x48534D4C; // "LMSH"
+    static constexpr uint32_t Version = 11;
+    static constexpr const char* Extension = ".lavamesh";
+
+    /** Cooked files are written next to their source by default. A non-empty directory collects all of them */
+    static void SetCacheDirectory(const std::string& Directory);
+
+    static std::string GetCachePath(const std::string& SourcePath);
+
+    /** Size and modification time of the source file. The content hash is only computed when requested */
+    static MeshSourceStamp GetSourceStamp(const std::string& SourcePath, bool bComputeHash);
+
+    /** Same hash stored in the header of the file Builder would be cooked into. 16 bit indices are narrowed on the fly */
+    static uint64_t ComputeContentHash(const Builder& Builder);
+
+    /**
+     Writes the content of Builder, processed with Settings, to CachePath. Vertices and indices are encoded by
+     LavaMeshCodec if Settings.bEncodeMesh is set. The file is first written aside and then renamed, so that readers
+     never see a partial file
+     */
+    static bool Write(const std::string& CachePath, const Builder& Builder, const MeshSourceStamp& Source, const MeshOptimizationSettings& Settings);
+
+    /**
+     Maps the cooked file for SourcePath, if any. Returns false if it is missing, corrupted, cooked with a different
+     vertex layout or optimization settings, or if the source changed since it has been cooked. A source whose mtime changed
+     but whose content hash still matches is considered up to date. Only the .obj file is tracked, so edits to its
+     material libraries require cooking it again. The copy stored in a mounted LavaPackage, as SourcePath followed by
+     the extension, is preferred to the cache file. CookedFile is the content of the cache file when it has already
+     been read (by a LavaFileReader for instance), otherwise the file is mapped
+     */
+    bool Open(const std::string& SourcePath, uint64_t SettingsHash, LavaMappedFile CookedFile = {});
+
+    const MeshCacheHeader& GetHeader() const { return *Header; }
+
+    uint64_t GetContentHash() const { return Header->ContentHash; }
+
+    VertexFormat GetVertexFormat() const { return Header->Format; }
+    uint32_t GetVertexStride() const { return Header->VertexStride; }
+
+    /** Copies, or decodes, the vertices into Destination. Returns false if the encoded data is corrupted */
+    bool ReadVertices(void* Destination) const;
+    uint32_t GetVertexCount() const { return Header->VertexCount; }
+
+    bool ReadIndices(void* Destination) const;
+    VkIndexType GetIndexType() const;
+    uint32_t GetIndexCount() const { return Header->IndexCount; }
+
+    const SubMesh* GetSubMeshes() const;
+    uint32_t GetSubMeshCount() const;
+
+    const Meshlet* GetMeshlets() const;
+    uint32_t GetMeshletCount() const;
+
+    const LodLevel* GetLods() const;
+    uint32_t GetLodCount() const;
+
+    const Material* GetMaterials() const;
+    uint32_t GetMaterialCount() const;
+
+    glm::vec3 GetBoundsMin() const { return {Header->BoundsMin[0], Header->BoundsMin[1], Header->BoundsMin[2]}; }
+    glm::vec3 GetBoundsMax() const { return {Header->BoundsMax[0], Header->BoundsMax[1], Header->BoundsMax[2]}; }
+    BoundingSphere GetBoundingSphere() const { return {{Header->Sphere[0], Header->Sphere[1], Header->Sphere[2]}, Header->Sphere[3]}; }
+
+    bool IsEncoded() const { return FindSection(MeshCacheSectionType::EncodedVertices) != nullptr; }
+
+    /** Returns the section of the given type, nullptr if the file has none */
+    const MeshCacheSection* FindSection(const MeshCacheSectionType Type) const;
+
+    const void* GetSectionData(const MeshCacheSection& Section) const { return File.GetData() + Section.Offset; }
+
+private:
+
+    // Validates CookedFile, or the file mapped from CachePath when it is not open. An empty CachePath never touches the disk
+    bool OpenCooked(const std::string& SourcePath, uint64_t SettingsHash, LavaMappedFile&& CookedFile, const std::string& CachePath);
+
+    bool IsValid();
+
+    // Whether every index drawn, by the sub meshes or the meshlets, points to a vertex of the mesh
+    bool AreIndicesInRange(const void* Indices) const;
+
+    // Plain or encoded, whichever the file has
+    const MeshCacheSection* GetVertexSection() const;
+    const MeshCacheSection* GetIndexSection() const;
+
+    LavaMappedFile File;
+    const MeshCacheHeader* Header = nullptr;
+    const MeshCacheSection* Sections = nullptr;
+
+    static std::string CacheDirectory;
+};
+
+}
@@ -0,0 +1,57 @@
+//
+//  LavaMeshCodec.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Encoded vertex and index streams. Elements are coded in groups of 16, each group starting with 2 bit modes that
+// give the width of each of its byte planes
+//
+// | version | group | group | ... |          group: | modes | plane 0 | plane 1 | ... |
+//
+// A plane holds the same byte of the 16 elements, zigzag coded, in 0 (all zeros), 2, 4 or 8 bits per element.
+// Vertices are delta coded byte by byte from the previous vertex, so planes of attributes that change slowly shrink
+// to a few bits. Indices are delta coded as integers from the previous index, which optimized meshes keep small
+
+namespace lava
+{
+
+/**
+ Compresses cooked vertex and index data. Encoding only happens when cooking, decoding is SIMD (SSE2 or NEON, with a
+ scalar fallback) and writes whole groups at once, so that it can target write-combined staging memory directly
+ */
+class LavaMeshCodec
+{
+public:
+
+    static constexpr uint8_t VertexVersion = 0xA1;
+    static constexpr uint8_t IndexVersion = 0xB1;
+
+    // Vertex strides must be a multiple of 4, up to MaxVertexStride
+    static constexpr size_t MaxVertexStride = 256;
+
+    static bool CanEncodeVertices(size_t Stride) { return Stride > 0 && Stride % 4 == 0 && Stride <= MaxVertexStride; }
+
+    static std::vector<uint8_t> EncodeVertices(const void* Vertices, size_t Count, size_t Stride);
+
+    /** Decodes Count vertices into Destination. Returns false if Encoded is corrupted or does not hold exactly Count vertices */
+    static bool DecodeVertices(void* Destination, size_t Count, size_t Stride, const void* Encoded, size_t EncodedSize);
+
+    /** IndexSize is 2 or 4 bytes */
+    static std::vector<uint8_t> EncodeIndices(const void* Indices, size_t Count, size_t IndexSize);
+
+    static bool DecodeIndices(void* Destination, size_t Count, size_t IndexSize, const void* Encoded, size_t EncodedSize);
+
+    /** Instruction set the decoder has been compiled for */
+    static const char* GetDecoderName();
+};
+
+}
@@ -0,0 +1,128 @@
+//
+//  LavaMeshOptimizer.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "LavaModel.hpp"
+#include "LavaVertexWelder.hpp"
+#include "LavaNormalGenerator.hpp"
+
+namespace lava
+{
+
+#pragma region Types
+
+// Steps run on a model after it has been loaded and before it is cooked
+struct MeshOptimizationSettings
+{
+    // Merges the vertices closer than WeldingTolerances, on top of the bitwise identical ones merged while loading
+    bool bWeldVertices = false;
+    WeldTolerances WeldingTolerances{};
+
+    // Generates the normals missing from the source, which would otherwise be left at zero
+    bool bGenerateNormals = true;
+    NormalSettings Normals{};
+
+    // Reorders triangles to maximize the reuse of the post-transform vertex cache (Forsyth)
+    bool bOptimizeVertexCache = true;
+
+    // Reorders clusters of triangles so that the ones most likely to be occluders are drawn first (Tipsy)
+    bool bOptimizeOverdraw = true;
+
+    // Renumbers vertices in the order they are first referenced, so that vertex fetches are linear
+    bool bOptimizeVertexFetch = true;
+
+    // How much the vertex cache efficiency (ACMR) of a cluster can be traded for a finer overdraw sorting
+    float OverdrawThreshold = 1.05f;
+
+    // Meshes with more than 65536 vertices are split into sub meshes that can use 16 bit indices
+    bool bSplitForShortIndices = false;
+
+    // Partitions the mesh into meshlets with their own bounds, so that they can be culled individually
+    bool bBuildMeshlets = false;
+
+    // Number of detail levels, including the original mesh. 1 disables the LOD generation
+    uint32_t LodCount = 4;
+
+    // Compact vertices are quantized once all the other steps are done
+    VertexFormat Format = VertexFormat::Full;
+
+    // Stores the vertices and indices of the cooked mesh compressed (LavaMeshCodec), which are decoded straight into
+    // the staging memory when loaded. Not part of the flags, as encoded and plain meshes are loaded the same way
+    bool bEncodeMesh = false;
+
+    static MeshOptimizationSettings None()
+    {
+        MeshOptimizationSettings Settings{};
+        Settings.bOptimizeVertexCache = false;
+        Settings.bOptimizeOverdraw = false;
+        Settings.bOptimizeVertexFetch = false;
+        Settings.LodCount = 1;
+        return Settings;
+    }
+
+    // Packed representation of the enabled steps, written into the cooked meshes and their manifest
+    uint32_t GetFlags() const
+    {
+        return (bOptimizeVertexCache ? 1u : 0u)
+            | (bOptimizeOverdraw ? 2u : 0u)
+            | (bOptimizeVertexFetch ? 4u : 0u)
+            | (Format == VertexFormat::Compact ? 8u : 0u)
+            | (bSplitForShortIndices ? 16u : 0u)
+            | (bBuildMeshlets ? 32u : 0u)
+            | (bWeldVertices ? 64u : 0u)
+            | (bGenerateNormals ? 128u : 0u)
+            | (std::min(LodCount, LodLevel::MaxLevels) << 8);
+    }
+
+    // Flags and parameters of the enabled steps, stored into cooked meshes to detect any change of settings
+    uint64_t GetHash() const;
+};
+
+// Average Cache Miss Ratio (transformed vertices per triangle, 0.5 is the best achievable on regular grids)
+// and Average Transformed Vertex Ratio (transformed vertices per vertex, 1 is the best)
+struct VertexCacheStats
+{
+    float ACMR = 0.f;
+    float ATVR = 0.f;
+};
+
+#pragma endregion
+
+class LavaMeshOptimizer
+{
+public:
+
+    /** Runs the enabled steps on Builder and prints the vertex cache statistics before and after */
+    static void Optimize(Builder& Builder, const MeshOptimizationSettings& Settings);
+
+    /** Simulates a FIFO post-transform cache of CacheSize entries, like the one found on most GPUs */
+    static VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& Indices, size_t VertexCount, uint32_t CacheSize = 16);
+
+    static void OptimizeVertexCache(std::vector<uint32_t>& Indices, size_t VertexCount);
+
+    /** Expects Indices to be already optimized for the vertex cache */
+    static void OptimizeOverdraw(std::vector<uint32_t>& Indices, const std::vector<Vertex>& Vertices, float Threshold);
+
+    static void OptimizeVertexFetch(std::vector<Vertex>& Vertices, std::vector<uint32_t>& Indices);
+
+private:
+
+    // Cache size modeled by the vertex cache optimization. Forsyth's scoring works on an LRU cache which
+    // behaves well also on FIFO caches of a smaller size
+    static constexpr uint32_t ForsythCacheSize = 32;
+
+    // Cache size used to split the mesh into clusters during overdraw optimization
+    static constexpr uint32_t ClusterCacheSize = 16;
+};
+
+}
@@ -0,0 +1,42 @@
+//
+//  LavaMeshSimplifier.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <cstdint>
+
+#include "LavaModel.hpp"
+
+namespace lava
+{
+
+/**
+ Quadric error metric simplification (Garland-Heckbert). Edges are collapsed onto one of their endpoints, never
+ onto a new position, so that the simplified triangles keep indexing the original vertex buffer and all the LODs
+ of a model can share it. Vertices on open borders and on attribute seams (vertices sharing the same position with
+ different attributes) are locked, so that the silhouette and the texture mapping are preserved
+ */
+class LavaMeshSimplifier
+{
+public:
+
+    /**
+     Collapses edges of the triangles in Indices until TargetIndexCount indices are left, or until the cheapest collapse
+     would move the surface by more than TargetError (in model space units). OutError receives the largest error introduced
+     */
+    static std::vector<uint32_t> Simplify
+        ( const std::vector<uint32_t>& Indices
+        , const Vertex* Vertices
+        , size_t VertexCount
+        , size_t TargetIndexCount
+        , float TargetError
+        , float* OutError = nullptr );
+};
+
+}
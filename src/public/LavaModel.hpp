@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <vector>
 #include <memory>
+#include <functional>
 
 #define GLM_FORCE_RADIANS // expects angles to be defined in radians
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -17,6 +18,8 @@
 
 #include "LavaDevice.hpp"
 #include "LavaBuffer.hpp"
+#include "LavaBounds.hpp"
+#include "LavaMappedFile.hpp"
 
 // Vertex Buffer
 
@@ -41,6 +44,12 @@
 namespace lava
 {
 
+class LavaMeshCache;
+struct GltfData;
+struct MeshOptimizationSettings;
+struct WeldTolerances;
+struct NormalSettings;
+
 #pragma region Types
 
 // Interleaved implementation which alternates position and color inside the same buffer
@@ -63,47 +72,335 @@ struct Vertex
     }
 };
 
+// Layout of the vertex buffer of a model
+enum class VertexFormat : uint32_t
+{
+    Full,   // Vertex, 44 bytes
+    Compact // CompactVertex, 20 bytes
+};
+
+// Quantized version of Vertex. Positions are normalized inside the bounds of the mesh and are brought back
+// to model space by the matrix returned by GetDequantizationMatrix, which is folded into the model matrix.
+// Normals are octahedral encoded, so they need the compact variant of the vertex shader
+struct CompactVertex
+{
+    static std::vector<VkVertexInputBindingDescription> GetBindingDesc();
+    static std::vector<VkVertexInputAttributeDescription> GetAttributeDescs();
+
+    static CompactVertex Encode(const Vertex& V, const glm::vec3& BoundsCenter, const glm::vec3& InverseBoundsExtent);
+
+    // Maps the [-1, 1] quantized positions back to the bounds they have been quantized into
+    static glm::mat4 GetDequantizationMatrix(const glm::vec3& BoundsMin, const glm::vec3& BoundsMax);
+
+    int16_t position[4]{}; // snorm16 (w is padding, 3 components formats are rarely supported for vertex input)
+    int16_t normal[2]{};   // snorm16 octahedral encoding
+    uint8_t color[4]{};    // unorm8 (a is padding)
+    uint16_t uv[2]{};      // half float, so that tiling coordinates outside [0, 1] are preserved
+};
+
+// Range of the index buffer drawn with its own vertex offset and material. Meshes have a sub mesh for each of
+// their materials, which are split further so that each of them references at most 65536 vertices and can use
+// 16 bit indices
+struct SubMesh
+{
+    uint32_t FirstIndex = 0;
+    uint32_t IndexCount = 0;
+    int32_t VertexOffset = 0;
+
+    // Index inside the material table of the model
+    uint32_t Material = 0;
+};
+
+// Constants of a material, as read from .mtl files. Laid out as a std140 uniform block, so that it can be
+// copied as it is into the material buffers. The renderer does not sample textures, so texture maps are not kept
+struct Material
+{
+    glm::vec4 Diffuse{1.f};  // Kd, with the dissolve (d) in w
+    glm::vec4 Specular{0.f}; // Ks, with the shininess (Ns) in w
+    glm::vec4 Emissive{0.f}; // Ke, w is unused
+
+    bool operator==(const Material& Other) const
+    {
+        return Diffuse == Other.Diffuse && Specular == Other.Specular && Emissive == Other.Emissive;
+    }
+};
+
+// Small cluster of triangles, contiguous in the index buffer, which can be culled on its own
+struct Meshlet
+{
+    static constexpr uint32_t MaxVertices = 64;
+    static constexpr uint32_t MaxTriangles = 124;
+
+    // Bounding sphere, in model space
+    glm::vec3 Center{};
+    float Radius = 0.f;
+
+    // Normal cone. The meshlet is back facing for every camera position that sees it along its axis within
+    // the cone. The cutoff is 1 when the normals are too spread to ever cull the meshlet this way
+    glm::vec3 ConeAxis{};
+    float ConeCutoff = 1.f;
+
+    uint32_t FirstIndex = 0;
+    uint32_t IndexCount = 0;
+    int32_t VertexOffset = 0;
+    uint32_t VertexCount = 0;
+};
+
+// Simplified version of the mesh, drawn through its own sub meshes. All the levels share the same vertex buffer
+struct LodLevel
+{
+    static constexpr uint32_t MaxLevels = 8;
+
+    uint32_t FirstSubMesh = 0;
+    uint32_t SubMeshCount = 0;
+
+    // Largest distance, in model space, between the simplified surface and the original one
+    float Error = 0.f;
+};
+
+// Copy from the staging ring into the geometry pool, recorded by the owner of the upload instead of being submitted
+// right away. The destination is only resolved when recorded, since compacting the pool may move it until then.
+// The staging region is released by the ring once the transfer has completed
+struct BufferUpload
+{
+    StagingRegion Staging;
+    LavaGeometryAllocation Dst{};
+};
+
+// Destination of the final vertex and index data of a mesh. Each buffer is acquired once with its exact size, and the
+// returned memory is written sequentially and never read back, so it can be write-combined mapped memory
+class MeshSink
+{
+public:
+
+    virtual ~MeshSink() = default;
+
+    // Return Count * Stride (or Count indices of Type) writable bytes
+    virtual void* AcquireVertices(const uint32_t Stride, const uint32_t Count) = 0;
+    virtual void* AcquireIndices(const VkIndexType Type, const uint32_t Count) = 0;
+};
+
+// Parser used to read .obj files. Binary glTF (.glb) files are always read by LavaGltfParser
+enum class ObjLoader
+{
+    Parallel, // Memory mapped, multithreaded LavaObjParser
+    TinyObj   // Reference single threaded tinyobj::LoadObj
+};
+
 struct Builder
 {
-    void LoadModel(const std::string& Filename);
+    void LoadModel(const std::string& Filename, const ObjLoader Loader = ObjLoader::Parallel);
+
+    // Loads Filepath, runs the steps enabled in Settings and writes the cooked version next to the source (or into
+    // the mesh cache directory). Only uses the CPU, so that it can run in offline tools
+    void CookFile(const std::string& Filepath, const MeshOptimizationSettings& Settings);
 
     std::vector<Vertex> Vertices{};
     std::vector<uint32_t> Indices{};
+
+    // Merges the vertices that only differ by less than Tolerances, returning how many have been removed.
+    // Must run before any other step, since it changes both the vertices and the triangles
+    uint32_t WeldVertices(const WeldTolerances& Tolerances);
+
+    // Generates the normals of the vertices loaded without one, returning how many vertices received a normal.
+    // Rebuilds the vertices and the triangles as well, so it must run before the optimization steps
+    uint32_t GenerateNormals(const NormalSettings& Settings);
+
+    // Axis aligned bounds of the vertex positions
+    glm::vec3 BoundsMin{};
+    glm::vec3 BoundsMax{};
+
+    // Computed together with the box, centered in it
+    BoundingSphere Sphere{};
+
+    // Encodes Vertices into CompactVertices. The model is then uploaded with the compact format
+    void Quantize();
+
+    VertexFormat Format = VertexFormat::Full;
+    std::vector<CompactVertex> CompactVertices{};
+
+    // Splits the mesh into sub meshes of at most MaxVertices vertices each, duplicating the ones
+    // shared between them. Indices become relative to the VertexOffset of their sub mesh. Each material
+    // range is split on its own
+    void SplitIntoSubMeshes(uint32_t MaxVertices = MaxShortIndexVertices);
+
+    // One range for each material, split further by SplitIntoSubMeshes. Empty if the mesh uses a single material
+    // and has not been split
+    std::vector<SubMesh> SubMeshes{};
+
+    // Materials referenced by the sub meshes, only the ones used by some triangle. Empty if the source has no material
+    std::vector<Material> Materials{};
+
+    // Reorders the triangles of each sub mesh into meshlets grown over the mesh adjacency, and computes their bounds.
+    // Must run after the other index reordering steps, that would break the meshlet ranges
+    void BuildMeshlets();
+
+    std::vector<Meshlet> Meshlets{};
+
+    // Appends up to LevelCount - 1 simplified copies of the index buffer, each with about half the triangles of the
+    // previous one, and describes them in Lods (level 0 being the original mesh). Must run after the sub meshes and
+    // the meshlets have been built, as those only cover the original mesh
+    void GenerateLods(uint32_t LevelCount);
+
+    // Empty if no LOD has been generated
+    std::vector<LodLevel> Lods{};
+
+    // Hash of the final data (see LavaMeshCache::ComputeContentHash), computed once by CookFile. 0 until then
+    uint64_t ContentHash = 0;
+
+    // 16 bit indices are used whenever all the indices fit in them
+    VkIndexType GetIndexType() const;
+
+    // Writes the vertices, in Format, and the indices, in GetIndexType(), straight into Sink. Indices are narrowed
+    // while being written, and large buffers are split between threads, so no intermediate copy is ever built
+    void WriteTo(MeshSink& Sink) const;
+
+    static constexpr uint32_t MaxShortIndexVertices = 1 << 16;
+
+private:
+
+    void ComputeBounds();
+
+    // Sorts the triangles by material and describes each material range with a sub mesh. TriangleMaterials holds
+    // an index inside SourceMaterials for each triangle, or -1 for the ones using the default material
+    void GroupByMaterial(const std::vector<Material>& SourceMaterials, const std::vector<int32_t>& TriangleMaterials);
+
+    // Appends the primitives of every mesh instance, transformed into model space, and the material of each triangle
+    void AppendGltf(const GltfData& Data, std::vector<int32_t>& TriangleMaterials);
+
+    // Builds the vertices referenced by each face corner and appends them, without duplicates, to Vertices and Indices
+    // IndexType can be either an ObjIndex or a tinyobj::index_t
+    template <typename IndexType>
+    void AppendCorners
+        ( const std::vector<float>& Positions
+        , const std::vector<float>& Colors
+        , const std::vector<float>& Normals
+        , const std::vector<float>& TexCoords
+        , const std::vector<IndexType>& Corners );
 };
 
 #pragma endregion
 
-class LavaModel
+// Vertex and index data are written once, from the builder or the mapped cooked file, into staging buffers that stay
+// mapped for their whole life, and then copied into ranges of the shared buffers of the geometry pool. Draws add the
+// first vertex and index of those ranges to their own offsets, so that every model of the same vertex format and
+// index type is drawn through the same binding
+class LavaModel : private MeshSink
 {
 public:
     
-    LavaModel(LavaDevice& InDevice, const Builder& Builder);
+    // When DeferredUploads is provided the buffers are only filled once the uploads appended to it have been executed,
+    // otherwise the constructors wait for the copies to complete
+    LavaModel(LavaDevice& InDevice, const Builder& Builder, std::vector<BufferUpload>* DeferredUploads = nullptr);
+    LavaModel(LavaDevice& InDevice, const LavaMeshCache& CookedMesh, std::vector<BufferUpload>* DeferredUploads = nullptr);
+
+    // Uploads the primitives of a .glb file as they are, each one drawn as its own sub mesh. Buffer views already laid
+    // out like Vertex, and indices already in the index type of the model, are copied with a single memcpy
+    LavaModel(LavaDevice& InDevice, const GltfData& Gltf, std::vector<BufferUpload>* DeferredUploads = nullptr);
     ~LavaModel();
     
     LavaModel(const LavaModel&) = delete;
     LavaModel& operator=(const LavaModel&) = delete;
 
+    /**
+     Loads the cooked version of the file if it is up to date, otherwise parses the file, optimizes it according
+     to Settings and cooks it for the next time. Binary glTF files that Settings would leave untouched are uploaded
+     straight from the file instead. CookedFile is the content of the cooked file, when the caller has already read it
+     */
     static std::unique_ptr<LavaModel> CreateModelFromFile(LavaDevice& Device, const std::string& Filepath);
+    static std::unique_ptr<LavaModel> CreateModelFromFile
+        ( LavaDevice& Device
+        , const std::string& Filepath
+        , const MeshOptimizationSettings& Settings
+        , std::vector<BufferUpload>* DeferredUploads = nullptr
+        , LavaMappedFile CookedFile = {} );
     
     void Bind(const VkCommandBuffer& CommandBuffer);
-    void Draw(const VkCommandBuffer& CommandBuffer);
+
+    /** Buffers bound by Bind, shared with the other models of the same vertex format and index type */
+    LavaGeometryBinding GetBinding() const;
+
+    void Draw(const VkCommandBuffer& CommandBuffer, const uint32_t Lod = 0);
+
+    /** Draws a single sub mesh, so that the caller can set its material first */
+    void DrawSubMesh(const VkCommandBuffer& CommandBuffer, const uint32_t SubMeshIdx);
+
+    /** Draws only the meshlets for which IsVisible returns true, merging consecutive ones into a single draw */
+    void DrawMeshlets(const VkCommandBuffer& CommandBuffer, const std::function<bool(const Meshlet&)>& IsVisible);
+
+    /** Same as above, limited to the meshlets of a sub mesh of the full detail level */
+    void DrawMeshlets(const VkCommandBuffer& CommandBuffer, const uint32_t SubMeshIdx, const std::function<bool(const Meshlet&)>& IsVisible);
+
+    bool HasMeshlets() const { return !Meshlets.empty(); }
+    const std::vector<Meshlet>& GetMeshlets() const { return Meshlets; }
+
+    // Level 0 is the full detail mesh, and the only one covered by meshlets
+    uint32_t GetLodCount() const { return static_cast<uint32_t>(Lods.size()); }
+    const LodLevel& GetLod(const uint32_t Lod) const { return Lods[Lod]; }
+
+    // Levels reference the sub meshes they are drawn with, each of them using a single material
+    uint32_t GetSubMeshCount() const { return static_cast<uint32_t>(SubMeshes.size()); }
+    const SubMesh& GetSubMesh(const uint32_t SubMeshIdx) const { return SubMeshes[SubMeshIdx]; }
+
+    // Never empty, models loaded without materials use the default one
+    const std::vector<Material>& GetMaterials() const { return Materials; }
+
+    // Model space bounds, before dequantization. They are the ones the model matrix has to transform
+    const BoundingBox& GetBounds() const { return Bounds; }
+    const BoundingSphere& GetBoundingSphere() const { return Sphere; }
+
+    const glm::vec3& GetBoundsMin() const { return Bounds.Min; }
+    const glm::vec3& GetBoundsMax() const { return Bounds.Max; }
+
+    VertexFormat GetVertexFormat() const { return Format; }
+
+    VkIndexType GetIndexType() const { return IndexType; }
+
+    // Identifies the data of the model, equal for models cooked into the same vertices and indices
+    uint64_t GetContentHash() const { return ContentHash; }
+
+    // To be applied before the model matrix. Identity unless the model uses the compact vertex format
+    const glm::mat4& GetDequantizationMatrix() const { return DequantizationMatrix; }
     
 private:
     
     LavaDevice& Device;
-    
-    void ClearBufferAndMemory(VkBuffer& Buffer, VkDeviceMemory& Memory);
+
+    // Copies the staging buffers into the device local ones, or hands them to DeferredUploads
+    void SubmitUploads(std::vector<BufferUpload>* DeferredUploads);
+
+    std::vector<BufferUpload> PendingUploads{};
+
+    // Gives the ranges back to the geometry pool, the constructors call it as well before throwing
+    void ReleaseGeometry();
+
+    // Fills in the defaults for what the model has been loaded without, and assigns the meshlets to their sub meshes
+    void InitializeRanges();
+
+    void DrawMeshletRange(const VkCommandBuffer& CommandBuffer, const uint32_t First, const uint32_t Last, const std::function<bool(const Meshlet&)>& IsVisible);
+
+    // Added to the vertex offset of every indexed draw
+    int32_t GetVertexBase() const { return static_cast<int32_t>(VertexAllocation.GetFirst()); }
+
+    BoundingBox Bounds{};
+    BoundingSphere Sphere{};
+
+    VertexFormat Format = VertexFormat::Full;
+    glm::mat4 DequantizationMatrix{1.f};
+
+    uint64_t ContentHash = 0;
     
 #pragma region Vertex Buffer
 
 private:
     
-    void CreateVertexBuffers(const std::vector<Vertex>& Vertices);
+    // Allocate the range of the geometry pool and return its mapped staging memory, which has to be filled before SubmitUploads
+    void* AcquireVertices(const uint32_t Stride, const uint32_t Count) override;
     
-    bool bHasIndexBuffer;
+    bool bHasIndexBuffer = false;
     
-    std::unique_ptr<LavaBuffer> VertexBuffer;
-    uint32_t VertexCount;
+    LavaGeometryAllocation VertexAllocation{};
+    uint32_t VertexCount = 0;
     
 #pragma endregion
     
@@ -111,11 +408,26 @@ private:
     
 private:
     
-    void CreateIndexBuffers(const std::vector<uint32_t>& Indices);
-    
-    std::unique_ptr<LavaBuffer> IndexBuffer;
-    uint32_t IndexCount;
+    void* AcquireIndices(const VkIndexType Type, const uint32_t Count) override;
     
+    LavaGeometryAllocation IndexAllocation{};
+    uint32_t IndexCount = 0;
+    VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+
+    // Always contains at least one sub mesh covering the whole index buffer
+    std::vector<SubMesh> SubMeshes{};
+
+    // Empty if the model has not been partitioned
+    std::vector<Meshlet> Meshlets{};
+
+    // Always contains at least the full detail level, covering all the sub meshes when no LOD has been generated
+    std::vector<LodLevel> Lods{};
+
+    // First and last meshlet of each sub mesh of the full detail level, empty if the model has not been partitioned
+    std::vector<std::pair<uint32_t, uint32_t>> SubMeshMeshlets{};
+
+    std::vector<Material> Materials{};
+
 #pragma endregion
     
 };
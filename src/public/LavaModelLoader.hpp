@@ -0,0 +1,174 @@
+//
+//  LavaModelLoader.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "LavaModel.hpp"
+#include "LavaMeshOptimizer.hpp"
+#include "LavaModelRegistry.hpp"
+#include "LavaFileReader.hpp"
+
+namespace lava
+{
+
+#pragma region Types
+
+enum class ModelLoadState : uint32_t
+{
+    Loading,   // Reading the cooked file, waiting for a worker, or being parsed and cooked
+    Uploading, // Buffers created, copies submitted to the GPU
+    Resident,  // Ready to be drawn
+    Failed
+};
+
+/**
+ Model requested to a LavaModelLoader. It can be handed to game objects right away, which draw nothing until the
+ model is resident
+ */
+class LavaModelHandle
+{
+public:
+
+    explicit LavaModelHandle(const std::string& InFilepath) : Filepath(InFilepath) {}
+
+    ModelLoadState GetState() const { return State.load(std::memory_order_acquire); }
+
+    bool IsResident() const { return GetState() == ModelLoadState::Resident; }
+
+    /** nullptr until the model is resident */
+    std::shared_ptr<LavaModel> GetModel() const { return IsResident() ? Model : nullptr; }
+
+    const std::string& GetFilepath() const { return Filepath; }
+
+    /** Reason of the failure, only valid in the Failed state */
+    const std::string& GetError() const { return Error; }
+
+private:
+
+    friend class LavaModelLoader;
+
+    std::string Filepath;
+    std::string Error{};
+
+    // Published by the state, never read before it becomes Resident
+    std::shared_ptr<LavaModel> Model{};
+
+    std::atomic<ModelLoadState> State{ModelLoadState::Loading};
+
+    // Read of the cooked file, which can be cancelled until it completes. 0 when there is nothing to read
+    uint64_t ReadRequestId = 0;
+};
+
+#pragma endregion
+
+/**
+ Loads models without blocking the frame loop. Cooked files are read ahead by a LavaFileReader, by priority, and the
+ workers pick the models up as their reads complete. Files are then parsed, optimized and cooked on the workers, which
+ also create the buffers and fill their staging copies in the staging ring of the device. Update, called once per frame
+ from the thread owning the graphics queue, records the pending copies of all the parsed models into the transfer command
+ buffer of the ring and submits it. Models become resident in a later Update, once its fence value has been reached
+ */
+class LavaModelLoader
+{
+public:
+
+    /**
+     A WorkerCount of 0 uses all the hardware threads but one, left to the frame loop. With a Registry, models already
+     loaded are shared instead of being loaded again, and the loaded ones are registered once resident
+     */
+    LavaModelLoader(LavaDevice& InDevice, uint32_t WorkerCount = 0, LavaModelRegistry* InRegistry = nullptr);
+    ~LavaModelLoader();
+
+    LavaModelLoader(const LavaModelLoader&) = delete;
+    LavaModelLoader& operator=(const LavaModelLoader&) = delete;
+
+    /**
+     Loads of a file that is already loading with the same settings return the handle of that load, which is then
+     shared by all the callers (cancelling it cancels it for all of them)
+     */
+    std::shared_ptr<LavaModelHandle> LoadAsync
+        ( const std::string& Filepath
+        , const MeshOptimizationSettings& Settings = MeshOptimizationSettings{}
+        , FileReadPriority Priority = FileReadPriority::Normal );
+
+    /** Stops a load whose file is still being read, which ends in the Failed state. Returns false when it is too late */
+    bool Cancel(const std::shared_ptr<LavaModelHandle>& Handle);
+
+    /** Submits the uploads of the models parsed since the last call and publishes the ones whose upload completed */
+    void Update();
+
+    /** True when no request is queued, being parsed or uploading */
+    bool IsIdle();
+
+private:
+
+    struct LoadRequest
+    {
+        std::string Filepath;
+        MeshOptimizationSettings Settings;
+        std::shared_ptr<LavaModelHandle> Handle;
+        std::string PathKey;
+    };
+
+    // Model whose buffers exist, but are not filled yet
+    struct PendingModel
+    {
+        std::shared_ptr<LavaModel> Model;
+        std::vector<BufferUpload> Uploads;
+        std::shared_ptr<LavaModelHandle> Handle;
+        uint64_t SettingsHash = 0;
+        std::string PathKey;
+    };
+
+    struct UploadBatch
+    {
+        LavaUploadToken Token{};
+        std::vector<PendingModel> Models;
+    };
+
+    void WorkerLoop();
+
+    void SubmitBatch(std::vector<PendingModel>&& Models);
+
+    static void Publish(LavaModelHandle& Handle, const std::shared_ptr<LavaModel>& Model);
+
+    // Marks the handle as failed and forgets the load. Expects Mutex to be locked
+    void FailLocked(const std::string& PathKey, LavaModelHandle& Handle, const std::string& Error);
+
+    LavaDevice& Device;
+
+    LavaModelRegistry* Registry = nullptr;
+
+    std::vector<std::thread> Workers{};
+
+    // Reads complete into the queue the workers wait on. It outlives the reader, which pushes into it until destroyed
+    FileReadQueue ReadCompletions{};
+    LavaFileReader Reader{};
+
+    // Protects everything shared with the workers
+    std::mutex Mutex;
+    std::unordered_map<uint64_t, LoadRequest> ReadingRequests{}; // By load id, the user data of their read
+    std::unordered_map<std::string, std::shared_ptr<LavaModelHandle>> LoadingHandles{}; // By path key, until published or failed
+    uint64_t NextLoadId = 1;
+    std::vector<PendingModel> ParsedModels{};
+    uint32_t BusyWorkers = 0;
+    bool bStopping = false;
+
+    // Only accessed by the thread calling Update
+    std::vector<UploadBatch> InFlightBatches{};
+};
+
+}
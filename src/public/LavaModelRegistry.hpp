@@ -0,0 +1,86 @@
+//
+//  LavaModelRegistry.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "LavaModel.hpp"
+#include "LavaMeshOptimizer.hpp"
+
+namespace lava
+{
+
+/**
+ Shares LavaModel instances between all their users. Models are found by the canonical path of their source (together
+ with the settings they have been processed with) and by the hash of their cooked data, so that the same geometry
+ exported under different names is uploaded only once. The registry does not own the models: they are released as soon
+ as their last user drops them, unless they are among the most recently used ones, which are retained. Thread safe
+ */
+class LavaModelRegistry
+{
+public:
+
+    explicit LavaModelRegistry(size_t InRetainedModelCount = 0);
+
+    /**
+     Returns the registered model for Filepath or for its content, otherwise loads it. Without DeferredUploads the new model
+     is registered right away. Otherwise the caller has to Register it once its uploads have completed, so that other
+     users never get a model that is not resident yet. A model that is returned without appending any upload is resident.
+     CookedFile is the content of the cooked file, when the caller has already read it
+     */
+    std::shared_ptr<LavaModel> Load
+        ( LavaDevice& Device
+        , const std::string& Filepath
+        , const MeshOptimizationSettings& Settings = MeshOptimizationSettings{}
+        , std::vector<BufferUpload>* DeferredUploads = nullptr
+        , LavaMappedFile CookedFile = {} );
+
+    std::shared_ptr<LavaModel> FindByPath(const std::string& Filepath, uint64_t SettingsHash);
+    std::shared_ptr<LavaModel> FindByContent(uint64_t ContentHash);
+
+    /** Registers Model for Filepath. If a model with the same content is already registered, that one is returned instead */
+    std::shared_ptr<LavaModel> Register(const std::string& Filepath, uint64_t SettingsHash, const std::shared_ptr<LavaModel>& Model);
+
+    /** Number of models kept alive after their last user released them. Least recently used ones are dropped first */
+    void SetRetainedModelCount(size_t InRetainedModelCount);
+
+    /** Releases the retained models */
+    void Clear();
+
+    /** Models still alive */
+    size_t GetModelCount();
+
+    /** Identifies a file loaded with the given settings, the same for every spelling of its path */
+    static std::string MakePathKey(const std::string& Filepath, uint64_t SettingsHash);
+
+private:
+
+    // Expects Mutex to be locked
+    std::shared_ptr<LavaModel> FindByPathLocked(const std::string& PathKey);
+    std::shared_ptr<LavaModel> FindByContentLocked(uint64_t ContentHash);
+    void Touch(const std::shared_ptr<LavaModel>& Model);
+    void RemoveExpired();
+
+    std::mutex Mutex;
+
+    std::unordered_map<std::string, std::weak_ptr<LavaModel>> ModelsByPath{};
+    std::unordered_map<uint64_t, std::weak_ptr<LavaModel>> ModelsByContent{};
+
+    // Most recently used first
+    std::list<std::shared_ptr<LavaModel>> RetainedModels{};
+    std::unordered_map<const LavaModel*, std::list<std::shared_ptr<LavaModel>>::iterator> RetainedPositions{};
+    size_t RetainedModelCount = 0;
+};
+
+}
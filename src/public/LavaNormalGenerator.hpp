@@ -0,0 +1,63 @@
+//
+//  LavaNormalGenerator.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <cstdint>
+
+#include "LavaModel.hpp"
+
+namespace lava
+{
+
+#pragma region Types
+
+// How much each triangle around a vertex contributes to its normal
+enum class NormalWeighting : uint32_t
+{
+    Area,        // Large triangles count more, cheap but biased by the tessellation
+    Angle,       // Triangles count as much as the angle of their corner at the vertex (Thürmer and Wüthrich)
+    AreaAndAngle
+};
+
+struct NormalSettings
+{
+    // Triangles around a vertex whose normals are further apart than this angle, in radians, are not smoothed
+    // together and the vertex is split along the crease. 0 gives flat shading, pi smooth shading everywhere
+    float CreaseAngle = 0.785f;
+
+    NormalWeighting Weighting = NormalWeighting::Angle;
+};
+
+#pragma endregion
+
+/**
+ Generates the normals of the vertices that have none, as loaded from files without vn records. Triangles around
+ each position are grouped by the crease angle and every group gets its own weighted normal, so that hard edges stay
+ sharp and texture seams do not show up in the lighting. Face normals and corner angles are computed over the
+ triangles in parallel. Corners are then bucketed by position with atomic counters, so that every position is
+ processed by a single thread and the normals are gathered without locks
+ */
+class LavaNormalGenerator
+{
+public:
+
+    /**
+     Fills the missing normals, splitting the vertices that lie on a crease. Vertices and Indices are rebuilt in the
+     order of first reference. Returns the number of vertices that received a generated normal
+     */
+    static uint32_t Generate(std::vector<Vertex>& Vertices, std::vector<uint32_t>& Indices, const NormalSettings& Settings);
+
+private:
+
+    // Below this amount of triangles or positions, a range is not worth a thread
+    static constexpr size_t MinRangeSize = 1 << 14;
+};
+
+}
@@ -0,0 +1,77 @@
+//
+//  LavaObjParser.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace lava
+{
+
+#pragma region Types
+
+// Attribute indices of a single face corner. Indices are 0-based and already resolved (also the negative, relative, ones)
+// A missing attribute is represented with -1, like tinyobj::index_t does
+struct ObjIndex
+{
+    int32_t vertex_index = -1;
+    int32_t texcoord_index = -1;
+    int32_t normal_index = -1;
+};
+
+// Flat attribute arrays, laid out as tinyobj::attrib_t so that the Builder can consume both
+struct ObjData
+{
+    std::vector<float> Positions{}; // xyz
+    std::vector<float> Colors{};    // rgb, one for each position. White when the file defines none
+    std::vector<float> Normals{};   // xyz
+    std::vector<float> TexCoords{}; // uv
+
+    // Faces are triangulated like tinyobj does (quads along their shortest diagonal, the rest as a fan),
+    // so every 3 consecutive corners define a triangle
+    std::vector<ObjIndex> Corners{};
+
+    // Material libraries (mtllib), as written in the file
+    std::vector<std::string> MaterialLibraries{};
+
+    // Materials selected by usemtl, in the order they are first used
+    std::vector<std::string> MaterialNames{};
+
+    // Index inside MaterialNames for each triangle, -1 before the first usemtl. Empty if the file selects no material
+    std::vector<int32_t> TriangleMaterials{};
+};
+
+#pragma endregion
+
+/**
+ Wavefront OBJ parser that works on a memory mapped file. The file is split into chunks at line boundaries
+ and each chunk is parsed on its own thread; the partial results are then merged (in parallel as well) into a single ObjData.
+ Only geometry records (v, vn, vt, f) and material records (mtllib, usemtl) are parsed, everything else is skipped
+ */
+class LavaObjParser
+{
+public:
+
+    /** Parses the file at Filepath. A ThreadCount of 0 means "use all the available cores". Throws on failure */
+    static ObjData ParseFile(const std::string& Filepath, uint32_t ThreadCount = 0);
+
+    /** Parses an in-memory OBJ text */
+    static ObjData Parse(const char* Data, size_t Size, uint32_t ThreadCount = 0);
+
+    /** Fast float parsing. Advances Cursor after the parsed number */
+    static float ParseFloat(const char*& Cursor, const char* End);
+
+private:
+
+    // Below this size a chunk is not worth a thread
+    static constexpr size_t MinChunkSize = 1 << 20;
+};
+
+}
@@ -0,0 +1,178 @@
+//
+//  LavaPackage.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+
+#include "LavaMappedFile.hpp"
+
+// Asset package (.lavapak) file layout. Everything is little endian and the package is read in place from the mapped
+// file, so opening it costs a single open() whatever the number of assets it holds
+//
+// | PackageHeader | entry data ... | PackageEntry[EntryCount] | block sizes | names |
+//
+// Entries are named by their path relative to the directory holding the package, with '/' separators. The table of
+// contents is sorted by the hash of the names, so lookups are a binary search. Compressed entries are split into
+// blocks of BlockSize bytes compressed independently (LZ4 block format), which are decompressed in parallel
+
+namespace lava
+{
+
+#pragma region Types
+
+enum class PackageCompression : uint32_t
+{
+    None = 0,
+    Lz4  = 1
+};
+
+struct PackageHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+
+    uint32_t EntryCount;
+
+    // Uncompressed size of the blocks, the last block of an entry can be smaller
+    uint32_t BlockSize;
+
+    // PackageEntry[EntryCount], sorted by NameHash
+    uint64_t TocOffset;
+
+    // uint32_t stored size of every block of the compressed entries. A block whose stored size is its uncompressed
+    // size did not compress, and is stored as it is
+    uint64_t BlockTableOffset;
+    uint32_t BlockCount;
+
+    uint32_t Padding;
+
+    uint64_t NameTableOffset;
+    uint64_t NameTableSize;
+};
+
+struct PackageEntry
+{
+    uint64_t NameHash;
+    uint32_t NameOffset; // in the name table
+    uint32_t NameSize;
+
+    uint64_t Offset;     // of the data, from the beginning of the file
+    uint64_t StoredSize; // in the file
+    uint64_t Size;       // once decompressed
+
+    PackageCompression Compression;
+
+    // Index of the first block of the entry in the block table, compressed entries only
+    uint32_t FirstBlock;
+};
+
+#pragma endregion
+
+/**
+ Read-only view of an asset package. Packages are usually mounted once at startup: the loaders then look up shaders and
+ cooked meshes in the mounted packages first, and only fall back to loose files for the assets they do not hold
+ */
+class LavaPackage
+{
+public:
+
+    static constexpr uint32_t Magic = 0x4B41504C; // "LPAK"
+    static constexpr uint32_t Version = 1;
+    static constexpr uint32_t BlockSize = 256 << 10;
+    static constexpr uint64_t DataAlignment = 64;
+    static constexpr const char* Extension = ".lavapak";
+
+    /** Maps the package at Filepath. Returns false if it is missing or corrupted */
+    bool Open(const std::string& Filepath);
+
+    bool IsOpen() const { return Header != nullptr; }
+
+    /** Returns the entry called Name, nullptr if the package has none */
+    const PackageEntry* Find(const std::string& Name) const;
+
+    uint32_t GetEntryCount() const { return Header->EntryCount; }
+    const PackageEntry* GetEntries() const { return Entries; }
+
+    std::string GetEntryName(const PackageEntry& Entry) const { return std::string(Names + Entry.NameOffset, Entry.NameSize); }
+
+    /**
+     Content of Entry. Uncompressed entries are views of the mapping, which stays alive as long as the returned file,
+     compressed ones are decompressed in parallel into an owned buffer. Throws if the data is corrupted
+     */
+    LavaMappedFile Read(const PackageEntry& Entry) const;
+
+    /** Name of the entry Filepath is stored as in a package placed in Root */
+    static std::string MakeEntryName(const std::string& Filepath, const std::string& Root);
+
+    /** Adds the package at Filepath to the ones searched by OpenMounted. Packages mounted last are searched first */
+    static bool Mount(const std::string& Filepath);
+
+    static void UnmountAll();
+
+    /** Opens the entry storing Filepath in the mounted packages. Returns false if none of them has it */
+    static bool OpenMounted(const std::string& Filepath, LavaMappedFile& OutFile);
+
+    static bool IsMounted(const std::string& Filepath);
+
+    /** Reads Filepaths from the mounted packages, and the ones they do not hold from disk in a single batch. Throws on failure */
+    static std::vector<std::vector<char>> ReadAssets(const std::vector<std::string>& Filepaths);
+
+private:
+
+    bool IsValid();
+
+    // Returns the mounted package holding Filepath, and the entry storing it
+    static std::shared_ptr<const LavaPackage> FindMounted(const std::string& Filepath, const PackageEntry*& OutEntry);
+
+    std::shared_ptr<const LavaMappedFile> File;
+    const PackageHeader* Header = nullptr;
+    const PackageEntry* Entries = nullptr;
+    const uint32_t* BlockSizes = nullptr;
+    const char* Names = nullptr;
+
+    // Directory the names of the entries are relative to
+    std::string Root{};
+};
+
+/**
+ Builds a package from files or in-memory data. Blocks are compressed in parallel when the package is written
+ */
+class LavaPackageWriter
+{
+public:
+
+    /** Adds an entry, replacing any previous one with the same name */
+    void Add(const std::string& Name, std::vector<char>&& Data, PackageCompression Compression);
+
+    /** Adds the file at Filepath. Returns false if it cannot be read */
+    bool AddFile(const std::string& Name, const std::string& Filepath, PackageCompression Compression);
+
+    size_t GetEntryCount() const { return Entries.size(); }
+
+    /** Writes the package to Filepath. The file is first written aside and then renamed, so that readers never see a partial package */
+    bool Write(const std::string& Filepath) const;
+
+private:
+
+    struct PendingEntry
+    {
+        std::string Name;
+        std::vector<char> Data;
+        PackageCompression Compression;
+    };
+
+    std::vector<PendingEntry> Entries{};
+    std::unordered_map<std::string, size_t> EntryByName{};
+};
+
+}
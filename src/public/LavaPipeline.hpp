@@ -38,6 +38,11 @@ struct LavaPipelineConfigInfo
     std::vector<VkDynamicState> dynamicStateEnables;
     VkPipelineDynamicStateCreateInfo dynamicStateInfo;
     VkPipelineLayout pipelineLayout = nullptr;
+
+    // Vertex input layout, the full Vertex one by default
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
     VkRenderPass renderPass = nullptr;
     uint32_t subpass = 0;
 };
@@ -60,8 +65,6 @@ public:
     
 private:
     
-    static std::vector<char> readFile(const std::string& filePath);
-    
     void createPipeline(const LavaPipelineConfigInfo& configInfo, const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
     
     void createShaderModule(const std::vector<char>& code, VkShaderModule* Module);
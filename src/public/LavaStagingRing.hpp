@@ -0,0 +1,253 @@
+//
+//  LavaStagingRing.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+namespace lava
+{
+
+class LavaDevice;
+class LavaBuffer;
+class LavaStagingRing;
+
+#pragma region Types
+
+/**
+ Host visible memory an upload is written to before being copied to its device local buffer. It is either a range of
+ the staging ring or a buffer of its own when the ring had no room left, and is released once the copy it is recorded
+ into has completed, whether the region is still alive or not. A region destroyed before being recorded gives its
+ memory back right away
+ */
+class StagingRegion
+{
+public:
+
+    StagingRegion() = default;
+    ~StagingRegion();
+
+    StagingRegion(StagingRegion&& Other) noexcept;
+    StagingRegion& operator=(StagingRegion&& Other) noexcept;
+
+    StagingRegion(const StagingRegion&) = delete;
+    StagingRegion& operator=(const StagingRegion&) = delete;
+
+    bool IsValid() const { return Data != nullptr; }
+
+    void* GetData() const { return Data; }
+    VkBuffer GetBuffer() const { return Buffer; }
+    VkDeviceSize GetOffset() const { return Offset; }
+    VkDeviceSize GetSize() const { return Size; }
+
+private:
+
+    friend class LavaStagingRing;
+
+    void Reset();
+
+    LavaStagingRing* Ring = nullptr;
+    uint64_t ClaimId = 0;
+
+    VkBuffer Buffer = VK_NULL_HANDLE;
+    VkDeviceSize Offset = 0;
+    VkDeviceSize Size = 0;
+    void* Data = nullptr;
+
+    // Only set for the regions the ring could not hold
+    std::unique_ptr<LavaBuffer> OwnBuffer{};
+};
+
+/** Completion of a submission of the staging ring, checked with IsComplete or waited for with Wait */
+struct LavaUploadToken
+{
+    uint64_t FenceValue = 0;
+};
+
+struct LavaImageCopy
+{
+    VkBuffer Src = VK_NULL_HANDLE;
+    VkBufferImageCopy Region{};
+};
+
+#pragma endregion
+
+/**
+ Persistently mapped staging buffer, shared by every upload. Space is claimed from it in order and given back in order
+ once the transfers reading it are done, tracked by fence values: each submission of the shared transfer command
+ buffer gets the next value, and is complete once its fence is signaled.
+
+ Copies run on the transfer queue of the device. When it belongs to a family of its own, the destination buffers are
+ released by the transfer submission and acquired back by the graphics queue. The acquisition is only submitted once
+ the transfer fence is signaled, so that rendering never waits on a transfer: a submission is complete once both have
+ run, and the frames submitted afterwards see its buffers.
+
+ Claims can be made from any thread and never block, so that the loader workers cannot stall on the GPU. Recording,
+ submitting and waiting belong to the thread owning the graphics queue
+ */
+class LavaStagingRing
+{
+public:
+
+    static constexpr VkDeviceSize DefaultCapacity = 64ull << 20;
+
+    // Claims start on this boundary, which suits the copy offsets of every device
+    static constexpr VkDeviceSize ClaimAlignment = 256;
+
+    LavaStagingRing(LavaDevice& InDevice, VkDeviceSize InCapacity = DefaultCapacity);
+    ~LavaStagingRing();
+
+    LavaStagingRing(const LavaStagingRing&) = delete;
+    LavaStagingRing& operator=(const LavaStagingRing&) = delete;
+
+    /** Claims Size contiguous bytes. When the ring has no room left, the region gets a staging buffer of its own */
+    StagingRegion Claim(VkDeviceSize Size);
+
+    /**
+     Records the copy of Region into Dst, at DstOffset, in the transfer command buffer of the next submission. The
+     submission takes over the buffer of a region the ring could not hold, which must not be written anymore
+     */
+    void RecordCopy(StagingRegion& Region, VkBuffer Dst, VkDeviceSize DstOffset = 0);
+
+    /** Records Count copies from Src into Dst, in a single command */
+    void RecordCopies(VkBuffer Src, VkBuffer Dst, const VkBufferCopy* Regions, uint32_t Count);
+
+    /**
+     Records Count copies into Image, between a single pair of layout transitions. The image is written whole: what it
+     held before is discarded, and it ends up in FinalLayout
+     */
+    void RecordImageCopies(VkImage Image, VkImageAspectFlags Aspect, const LavaImageCopy* Copies, uint32_t Count, VkImageLayout FinalLayout);
+
+    /** Ties Region to the next submission, which gives it back once done. The copies reading it must be recorded already */
+    void Retain(StagingRegion& Region);
+
+    /**
+     Copies Size bytes of Data into Dst through the ring. Uploads larger than the space left are split across the wraps
+     of the ring, submitting and waiting for earlier transfers as needed. The copies are recorded like RecordCopy ones
+     */
+    void Upload(const void* Data, VkDeviceSize Size, VkBuffer Dst, VkDeviceSize DstOffset = 0);
+
+    /** Submits the copies recorded so far. Returns the fence value they complete with, the last one if there was nothing to submit */
+    uint64_t Submit();
+
+    /** Whether the buffers written by the submission of FenceValue can be used by the graphics queue */
+    bool IsComplete(uint64_t FenceValue);
+    bool IsComplete(const LavaUploadToken& Token) { return IsComplete(Token.FenceValue); }
+
+    /** Waits for the submission of FenceValue, submitting the recorded copies first if they belong to it */
+    void Wait(uint64_t FenceValue);
+    void Wait(const LavaUploadToken& Token) { Wait(Token.FenceValue); }
+
+    VkDeviceSize GetCapacity() const { return Capacity; }
+
+private:
+
+    friend class StagingRegion;
+
+    struct Claimed
+    {
+        uint64_t End;        // Position in the ring once claimed, including the padding before it
+        uint64_t FenceValue; // Submission copying it, 0 until recorded
+        bool bReleased;      // Dropped without being recorded
+    };
+
+    struct Submission
+    {
+        VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+        VkFence Fence = VK_NULL_HANDLE;
+        uint64_t FenceValue = 0;
+
+        // Staging buffers of the regions the ring could not hold, destroyed once the submission completes
+        std::vector<std::unique_ptr<LavaBuffer>> OwnBuffers{};
+
+        // Destination buffers and images handed over to the graphics family, when the transfer one is separate
+        std::vector<VkBufferMemoryBarrier> OwnershipBarriers{};
+        std::vector<VkImageMemoryBarrier> ImageOwnershipBarriers{};
+    };
+
+    // Graphics queue submission acquiring the buffers of the transfers up to FenceValue
+    struct Acquisition
+    {
+        VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+        VkFence Fence = VK_NULL_HANDLE;
+        uint64_t FenceValue = 0;
+    };
+
+    // Pieces of Upload are at least this large, unless what is left is smaller
+    static constexpr VkDeviceSize MinUploadChunk = 64 << 10;
+
+    // Largest claim between MinSize and Size that fits right now, 0 bytes if there is no room. Mutex held
+    VkDeviceSize ClaimRange(VkDeviceSize MinSize, VkDeviceSize Size, VkDeviceSize& OutOffset, uint64_t& OutClaimId);
+
+    // Gives back the ranges whose transfers completed. Mutex held
+    void Retire();
+
+    // Submits the acquisition of the buffers transferred since the last one, and completes the acquired submissions.
+    // Thread owning the graphics queue, mutex held
+    void AcquireTransferred();
+
+    void Release(uint64_t ClaimId);
+
+    // Gives the claim back once the next submission completes
+    void TieClaim(uint64_t ClaimId);
+
+    VkCommandBuffer GetRecordingBuffer();
+
+    void CreateCommandBuffer(VkCommandPool Pool, VkCommandBuffer& OutCommandBuffer, VkFence& OutFence);
+
+    LavaDevice& Device;
+
+    VkDeviceSize Capacity = 0;
+    std::unique_ptr<LavaBuffer> Buffer{};
+    char* Mapped = nullptr;
+
+    // Of the transfer family
+    VkCommandPool CommandPool = VK_NULL_HANDLE;
+
+    uint32_t TransferFamily = 0;
+    uint32_t GraphicsFamily = 0;
+    bool bTransfersOwnership = false;
+
+    // Of the graphics family, only created along bTransfersOwnership
+    VkCommandPool AcquirePool = VK_NULL_HANDLE;
+
+    // Monotonic positions: the ring holds the bytes between Tail and Head
+    uint64_t Head = 0;
+    uint64_t Tail = 0;
+
+    // Claims still holding their range, Claims[0] being FirstClaimId
+    std::deque<Claimed> Claims{};
+    uint64_t FirstClaimId = 1;
+
+    // Transfer command buffer being recorded, submitted with NextFenceValue
+    Submission Recording;
+    uint64_t NextFenceValue = 1;
+
+    std::deque<Submission> InFlight{};
+    std::vector<Submission> FreeSubmissions{};
+
+    // Transfers up to TransferredValue are done, their buffers being usable up to CompletedValue
+    uint64_t TransferredValue = 0;
+    uint64_t CompletedValue = 0;
+
+    // Barriers of the transferred submissions not acquired yet
+    std::vector<VkBufferMemoryBarrier> PendingAcquires{};
+    std::vector<VkImageMemoryBarrier> PendingImageAcquires{};
+    std::deque<Acquisition> Acquisitions{};
+    std::vector<Acquisition> FreeAcquisitions{};
+
+    std::mutex Mutex;
+};
+
+}
@@ -88,7 +88,7 @@ private:
     VkRenderPass renderPass;
     
     std::vector<VkImage> depthImages;
-    std::vector<VkDeviceMemory> depthImageMemorys;
+    std::vector<LavaMemoryAllocation> depthImageAllocations;
     std::vector<VkImageView> depthImageViews;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
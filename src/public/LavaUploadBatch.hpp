@@ -0,0 +1,85 @@
+//
+//  LavaUploadBatch.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <map>
+#include <utility>
+
+#include <vulkan/vulkan.h>
+
+#include "LavaStagingRing.hpp"
+
+namespace lava
+{
+
+class LavaDevice;
+
+/**
+ Collects the copies of many resources and records them all at once into the transfer command buffer of the staging
+ ring, so that a whole scene goes to the GPU in a single submission instead of a blocking round trip per resource.
+ Copies between the same two buffers share a command, and each image gets a single pair of layout transitions.
+ Belongs to the thread owning the graphics queue
+ */
+class LavaUploadBatch
+{
+public:
+
+    explicit LavaUploadBatch(LavaDevice& InDevice);
+
+    LavaUploadBatch(const LavaUploadBatch&) = delete;
+    LavaUploadBatch& operator=(const LavaUploadBatch&) = delete;
+
+    void AddBufferCopy(VkBuffer Src, VkBuffer Dst, const VkBufferCopy& Region);
+
+    /** Copies the whole of Staging into Dst, at DstOffset. The batch holds the region until it is submitted */
+    void AddUpload(StagingRegion&& Staging, VkBuffer Dst, VkDeviceSize DstOffset = 0);
+
+    /** Images are written whole, see LavaStagingRing::RecordImageCopies. They all end up in the FinalLayout of their last copy */
+    void AddImageCopy(VkBuffer Src, VkImage Image, const VkBufferImageCopy& Region, VkImageLayout FinalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    /** Same as AddImageCopy, with the bufferOffset of Region relative to Staging */
+    void AddImageUpload(StagingRegion&& Staging, VkImage Image, VkBufferImageCopy Region, VkImageLayout FinalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    bool IsEmpty() const { return BufferCopies.empty() && ImageCopies.empty(); }
+
+    /** Records every copy and submits them together. The batch is empty afterwards, and can be filled again */
+    LavaUploadToken Submit();
+
+private:
+
+    struct BufferCopyGroup
+    {
+        VkBuffer Src = VK_NULL_HANDLE;
+        VkBuffer Dst = VK_NULL_HANDLE;
+        std::vector<VkBufferCopy> Regions{};
+    };
+
+    struct ImageCopyGroup
+    {
+        VkImage Image = VK_NULL_HANDLE;
+        VkImageAspectFlags Aspect = 0;
+        VkImageLayout FinalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        std::vector<LavaImageCopy> Copies{};
+    };
+
+    LavaDevice& Device;
+
+    // In the order they were first added
+    std::vector<BufferCopyGroup> BufferCopies{};
+    std::map<std::pair<VkBuffer, VkBuffer>, size_t> BufferCopyIndices{};
+
+    std::vector<ImageCopyGroup> ImageCopies{};
+    std::map<VkImage, size_t> ImageCopyIndices{};
+
+    // Read by the copies above, handed over to the ring when submitted
+    std::vector<StagingRegion> StagingRegions{};
+};
+
+}
@@ -3,6 +3,15 @@
 #pragma once
 
 #include <functional>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace lava
 {
@@ -16,4 +25,96 @@ namespace lava
         (HashCombine(Seed, Args), ...);
     };
 
-}
\ No newline at end of file
+    // Fast 64bit hash of a block of memory. Processes 32 bytes per iteration on 4 independent lanes,
+    // so it is suited for hashing whole files or vertices
+    inline uint64_t HashBytes(const void* Data, size_t Size, uint64_t Seed = 0)
+    {
+        constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr uint64_t Prime3 = 0x165667B19E3779F9ull;
+
+        const auto Rotate = [](uint64_t X, int Bits) { return (X << Bits) | (X >> (64 - Bits)); };
+        const auto Round = [&](uint64_t Acc, uint64_t Input) { return Rotate(Acc + Input * Prime2, 31) * Prime1; };
+        const auto Read64 = [](const unsigned char* Ptr) { uint64_t Value; std::memcpy(&Value, Ptr, sizeof(Value)); return Value; };
+
+        const unsigned char* Cursor = static_cast<const unsigned char*>(Data);
+        const unsigned char* const End = Cursor + Size;
+
+        uint64_t Hash = Seed + Prime3 + Size;
+
+        if (Size >= 32)
+        {
+            uint64_t Lanes[4] = {Seed + Prime1 + Prime2, Seed + Prime2, Seed, Seed - Prime1};
+
+            for (; Cursor + 32 <= End; Cursor += 32)
+            {
+                Lanes[0] = Round(Lanes[0], Read64(Cursor));
+                Lanes[1] = Round(Lanes[1], Read64(Cursor + 8));
+                Lanes[2] = Round(Lanes[2], Read64(Cursor + 16));
+                Lanes[3] = Round(Lanes[3], Read64(Cursor + 24));
+            }
+
+            Hash = Rotate(Lanes[0], 1) + Rotate(Lanes[1], 7) + Rotate(Lanes[2], 12) + Rotate(Lanes[3], 18) + Size;
+            for (const uint64_t Lane : Lanes)
+            {
+                Hash = (Hash ^ Round(0, Lane)) * Prime1 + Prime3;
+            }
+        }
+
+        for (; Cursor + 8 <= End; Cursor += 8)
+        {
+            Hash = Rotate(Hash ^ Round(0, Read64(Cursor)), 27) * Prime1 + Prime3;
+        }
+
+        for (; Cursor < End; ++Cursor)
+        {
+            Hash = Rotate(Hash ^ (*Cursor * Prime3), 11) * Prime1;
+        }
+
+        // Final avalanche
+        Hash ^= Hash >> 33;
+        Hash *= Prime2;
+        Hash ^= Hash >> 29;
+        Hash *= Prime3;
+        Hash ^= Hash >> 32;
+
+        return Hash;
+    }
+
+    // Splits [0, Count) into contiguous ranges of at least MinRangeSize elements, one for each hardware thread at most,
+    // and runs Task(Begin, End) on each of them. The calling thread runs the first range
+    template <typename TaskType>
+    void ParallelFor(size_t Count, size_t MinRangeSize, const TaskType& Task)
+    {
+        const size_t MaxRanges = std::max<size_t>(1, std::thread::hardware_concurrency());
+        const size_t RangeCount = std::max<size_t>(1, std::min(MaxRanges, Count / std::max<size_t>(MinRangeSize, 1)));
+
+        std::vector<std::thread> Workers;
+        Workers.reserve(RangeCount - 1);
+
+        for (size_t RangeIdx = 1; RangeIdx < RangeCount; ++RangeIdx)
+        {
+            Workers.emplace_back(Task, Count * RangeIdx / RangeCount, Count * (RangeIdx + 1) / RangeCount);
+        }
+
+        Task(size_t{0}, Count / RangeCount);
+
+        for (std::thread& Worker : Workers)
+        {
+            Worker.join();
+        }
+    }
+
+    // Path next to Path to write a file aside before renaming it over Path. Never the same for two writers, whether
+    // they run on other threads or in other processes (a tool cooking while the application loads)
+    inline std::string MakeTempPath(const std::string& Path)
+    {
+        static const uint64_t ProcessTag = (static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}();
+        static std::atomic<uint64_t> WriterCount{0};
+
+        char Suffix[48];
+        std::snprintf(Suffix, sizeof(Suffix), ".%016llx.%llu.tmp", static_cast<unsigned long long>(ProcessTag), static_cast<unsigned long long>(WriterCount++));
+        return Path + Suffix;
+    }
+
+}
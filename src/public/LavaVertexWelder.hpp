@@ -0,0 +1,89 @@
+//
+//  LavaVertexWelder.hpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <cstdint>
+
+#include "LavaModel.hpp"
+
+namespace lava
+{
+
+#pragma region Types
+
+// Largest differences between two vertices that are still merged by LavaVertexWelder::WeldNearby
+struct WeldTolerances
+{
+    // Distance between the positions, in model space
+    float Position = 1e-4f;
+
+    // Angle between the normals, in radians
+    float NormalAngle = 0.0175f;
+
+    // Difference of each texture coordinate, about a tenth of a texel on a 1024 texture
+    float TexCoord = 1e-4f;
+};
+
+#pragma endregion
+
+/**
+ Merges bitwise identical vertices. Unique vertices are appended to the output array and their indices are
+ tracked by a flat open addressing table (linear probing, power of two capacity), so each insertion costs
+ a single probe sequence over a contiguous array instead of a node based map lookup
+ */
+class LavaVertexWelder
+{
+public:
+
+    /** ExpectedCount is an upper bound of the unique vertices, used to size the table once */
+    LavaVertexWelder(std::vector<Vertex>& InVertices, size_t ExpectedCount);
+
+    LavaVertexWelder(const LavaVertexWelder&) = delete;
+    LavaVertexWelder& operator=(const LavaVertexWelder&) = delete;
+
+    /** Returns the index of V inside the vertex array, appending it if it is not there yet */
+    uint32_t Insert(const Vertex& V);
+
+    static uint64_t HashVertex(const Vertex& V);
+
+    /**
+     Merges the vertices that differ by less than Tolerances, which bitwise welding keeps apart when the exporter
+     added some noise. Vertices are bucketed into a spatial hash grid whose cells are as large as the position
+     tolerance, so each of them is only compared with the ones in the 27 cells around it. Every vertex is merged
+     into the first kept vertex it matches, so that errors do not accumulate along chains of close vertices.
+     Triangles collapsed by the merge are removed, and the Ranges of indices (if any) shrink accordingly, dropping
+     the ones left empty. Returns the number of removed vertices
+     */
+    static uint32_t WeldNearby
+        ( std::vector<Vertex>& Vertices
+        , std::vector<uint32_t>& Indices
+        , const WeldTolerances& Tolerances
+        , std::vector<SubMesh>* Ranges = nullptr );
+
+private:
+
+    struct Slot
+    {
+        uint32_t Hash;  // Upper bits of the vertex hash, checked before comparing the whole vertex
+        uint32_t Index; // EmptyIndex if the slot is free
+    };
+
+    static constexpr uint32_t EmptyIndex = UINT32_MAX;
+
+    // Tables are kept at most half full to keep probe sequences short
+    void Reserve(size_t Count);
+
+    std::vector<Vertex>& Vertices;
+
+    std::vector<Slot> Slots{};
+    size_t Mask = 0;
+};
+
+}
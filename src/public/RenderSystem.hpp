@@ -19,9 +19,14 @@
 #include <stdio.h>
 #include <string>
 #include <memory>
+#include <vector>
+#include <unordered_map>
+#include <tuple>
 
 // Local Includes
 #include "LavaPipeline.hpp"
+#include "LavaDescriptor.hpp"
+#include "LavaBuffer.hpp"
 #include "LavaGameObject.hpp"
 #include "LavaCamera.hpp"
 #include "LavaTypes.hpp"
@@ -56,6 +61,72 @@ public:
 
     // Camera passed in argument in order to be shared between various systems
     void RenderGameObjects(const FrameDescriptor& FrameDesc);
+
+    /** Levels added to the one picked for every object. Positive values trade detail for speed, negative ones the opposite */
+    void SetLodBias(const int InLodBias) { LodBias = InLodBias; }
+    int GetLodBias() const { return LodBias; }
+
+private:
+
+    // A sub mesh of a visible object. Draws are sorted by pipeline first and then by material, so that each
+    // material is bound once per pipeline and frame whatever the number of objects using it
+    struct DrawItem
+    {
+        LavaPipeline* Pipeline;
+        uint32_t MaterialSlot;
+        LavaModel* Model;
+        uint32_t ObjectIdx;
+        uint32_t SubMeshIdx;
+        bool bMeshlets;
+
+        bool operator<(const DrawItem& Other) const
+        {
+            return std::tie(Pipeline, MaterialSlot, Model, ObjectIdx, SubMeshIdx) < std::tie(Other.Pipeline, Other.MaterialSlot, Other.Model, Other.ObjectIdx, Other.SubMeshIdx);
+        }
+    };
+
+    // Coarsest level of Model whose simplification error stays below MaxScreenError once projected by the camera
+    uint32_t SelectLod(const LavaModel& Model, const BoundingSphere& WorldSphere, const glm::vec3& Scale, const LavaCamera& Camera) const;
+
+    // Fraction of the viewport height, about one pixel at 1080p
+    static constexpr float MaxScreenError = 1.f / 1080.f;
+
+    int LodBias = 0;
+
+    // Reused from frame to frame
+    std::vector<DrawItem> DrawItems{};
+    
+#pragma endregion
+
+#pragma region Materials
+
+private:
+
+    struct MaterialHasher
+    {
+        size_t operator()(const Material& Constants) const;
+    };
+
+    void CreateMaterialResources();
+
+    // Slot of Constants inside the material buffer of the frame, shared by all the sub meshes with the same constants
+    uint32_t FindMaterialSlot(const Material& Constants);
+
+    // Copies the materials gathered for the frame into its buffer, growing it when they do not fit
+    void UploadMaterials(const int FrameIdx);
+
+    std::unique_ptr<LavaDescriptorSetLayout> MaterialSetLayout;
+    std::unique_ptr<LavaDescriptorPool> MaterialPool;
+
+    // One buffer and descriptor set for each frame in flight, holding the materials of the frame one after the other
+    // and selected through a dynamic offset
+    std::vector<std::unique_ptr<LavaBuffer>> MaterialBuffers{};
+    std::vector<VkDescriptorSet> MaterialDescriptorSets{};
+
+    std::vector<Material> FrameMaterials{};
+    std::unordered_map<Material, uint32_t, MaterialHasher> FrameMaterialSlots{};
+
+    static constexpr uint32_t InitialMaterialCapacity = 64;
     
 #pragma endregion
     
@@ -63,11 +134,15 @@ public:
     
 private:
     
+    // Set 0 holds the global uniform buffer, set 1 the material of the draw
     void CreatePipelineLayout(VkDescriptorSetLayout GlobalSetLayout);
     
     void CreatePipeline(VkRenderPass& RenderPass);
     
     std::unique_ptr<LavaPipeline> Pipeline;
+
+    // Used by models with VertexFormat::Compact
+    std::unique_ptr<LavaPipeline> CompactPipeline;
     
     VkPipelineLayout PipelineLayout;
     
@@ -0,0 +1,634 @@
+//
+//  LavaCook.cpp
+//  lava
+//
+//  Created by Giorgio Gamba on 17/10/26.
+//
+
+// Offline cooker: turns every .obj and .glb file found under a directory into a .lavamesh file, so that clients never
+// parse or process meshes at startup. The cooked meshes, along with any other asset, can then be packed into a single
+// .lavapak file. It only links the CPU side of the models, no window nor device is created.
+// With --bench it instead times the OBJ parsers against each other on a large generated file
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "LavaModel.hpp"
+#include "LavaMeshCache.hpp"
+#include "LavaMeshOptimizer.hpp"
+#include "LavaPackage.hpp"
+#include "LavaObjParser.hpp"
+#include "TinyObjLoader.h"
+
+namespace
+{
+
+struct CookOptions
+{
+    std::filesystem::path InputDirectory{};
+    std::filesystem::path OutputDirectory{};
+    std::filesystem::path ManifestPath{};
+    std::filesystem::path PackagePath{};
+    std::vector<std::filesystem::path> PackagedPaths{};
+    lava::MeshOptimizationSettings Settings{};
+    uint32_t JobCount = 0;
+    bool bForce = false;
+    bool bCompress = false;
+
+    // Triangles of the generated OBJ file, 0 when not benchmarking
+    uint32_t BenchTriangleCount = 0;
+};
+
+struct CookResult
+{
+    std::string SourcePath{};
+    std::string CookedPath{};
+    std::string Error{};
+    bool bSucceeded = false;
+    bool bUpToDate = false;
+    bool bEncoded = false;
+    float CookTimeMs = 0.f;
+
+    lava::MeshCacheHeader Header{};
+    uint32_t SubMeshCount = 0;
+    uint32_t MaterialCount = 0;
+    uint32_t MeshletCount = 0;
+    uint32_t LodCount = 0;
+
+    // Source of the first file cooked into the same data, empty if this one is unique
+    std::string DuplicateOf{};
+};
+
+void PrintUsage()
+{
+    std::cout
+        << "Usage: lava-cook <models directory> [options]\n"
+        << "       lava-cook --bench [triangles] [--output <directory>]\n"
+        << "  --output <directory>   Writes the cooked files there instead of next to their sources\n"
+        << "  --manifest <path>      Manifest location, lava-cook.manifest.json in the output directory by default\n"
+        << "  --jobs <count>         Files cooked in parallel, all the hardware threads by default\n"
+        << "  --compact              Quantizes vertices to the compact format\n"
+        << "  --meshlets             Partitions meshes into meshlets\n"
+        << "  --split                Splits meshes so that they can use 16 bit indices\n"
+        << "  --lods <count>         Detail levels, including the original mesh (1 disables them)\n"
+        << "  --weld                 Merges the vertices that only differ by float noise\n"
+        << "  --weld-distance <d>    Largest distance between welded positions, in model units (implies --weld)\n"
+        << "  --no-optimize          Skips the vertex cache, overdraw and vertex fetch optimizations\n"
+        << "  --encode               Compresses the vertices and indices of the cooked meshes (decoded when loaded)\n"
+        << "  --force                Cooks again files that are already up to date\n"
+        << "  --package <path>       Packs the cooked meshes into a single .lavapak file, placed where the client runs\n"
+        << "  --add <path>           Also packs this file, or every file under this directory (shaders, scenes, ...)\n"
+        << "  --compress             Compresses the packed files that get smaller (LZ4)\n"
+        << "  --bench [triangles]    Generates an OBJ file (2M triangles by default) in the output or temporary directory\n"
+        << "                         and times the parallel parser against tinyobj on it\n";
+}
+
+bool ParseOptions(int Argc, char** Argv, CookOptions& Options)
+{
+    for (int ArgIdx = 1; ArgIdx < Argc; ++ArgIdx)
+    {
+        const std::string Arg = Argv[ArgIdx];
+        const bool bHasValue = ArgIdx + 1 < Argc;
+
+        if (Arg == "--output" && bHasValue)
+        {
+            Options.OutputDirectory = Argv[++ArgIdx];
+        }
+        else if (Arg == "--manifest" && bHasValue)
+        {
+            Options.ManifestPath = Argv[++ArgIdx];
+        }
+        else if (Arg == "--package" && bHasValue)
+        {
+            Options.PackagePath = Argv[++ArgIdx];
+        }
+        else if (Arg == "--add" && bHasValue)
+        {
+            Options.PackagedPaths.push_back(Argv[++ArgIdx]);
+        }
+        else if (Arg == "--jobs" && bHasValue)
+        {
+            Options.JobCount = static_cast<uint32_t>(std::max(std::atoi(Argv[++ArgIdx]), 1));
+        }
+        else if (Arg == "--lods" && bHasValue)
+        {
+            Options.Settings.LodCount = static_cast<uint32_t>(std::max(std::atoi(Argv[++ArgIdx]), 1));
+        }
+        else if (Arg == "--weld-distance" && bHasValue)
+        {
+            Options.Settings.bWeldVertices = true;
+            Options.Settings.WeldingTolerances.Position = static_cast<float>(std::atof(Argv[++ArgIdx]));
+        }
+        else if (Arg == "--weld")
+        {
+            Options.Settings.bWeldVertices = true;
+        }
+        else if (Arg == "--compact")
+        {
+            Options.Settings.Format = lava::VertexFormat::Compact;
+        }
+        else if (Arg == "--meshlets")
+        {
+            Options.Settings.bBuildMeshlets = true;
+        }
+        else if (Arg == "--split")
+        {
+            Options.Settings.bSplitForShortIndices = true;
+        }
+        else if (Arg == "--no-optimize")
+        {
+            Options.Settings.bOptimizeVertexCache = false;
+            Options.Settings.bOptimizeOverdraw = false;
+            Options.Settings.bOptimizeVertexFetch = false;
+        }
+        else if (Arg == "--encode")
+        {
+            Options.Settings.bEncodeMesh = true;
+        }
+        else if (Arg == "--force")
+        {
+            Options.bForce = true;
+        }
+        else if (Arg == "--compress")
+        {
+            Options.bCompress = true;
+        }
+        else if (Arg == "--bench")
+        {
+            Options.BenchTriangleCount = 2000000;
+            if (bHasValue && std::isdigit(static_cast<unsigned char>(Argv[ArgIdx + 1][0])))
+            {
+                Options.BenchTriangleCount = static_cast<uint32_t>(std::max(std::atoi(Argv[++ArgIdx]), 2));
+            }
+        }
+        else if (!Arg.empty() && Arg[0] != '-' && Options.InputDirectory.empty())
+        {
+            Options.InputDirectory = Arg;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return !Options.InputDirectory.empty() || Options.BenchTriangleCount > 0;
+}
+
+std::vector<std::string> FindSources(const std::filesystem::path& Directory)
+{
+    std::vector<std::string> Sources{};
+    for (const auto& Entry : std::filesystem::recursive_directory_iterator(Directory))
+    {
+        std::string Extension = Entry.path().extension().string();
+        std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](unsigned char Char) { return static_cast<char>(std::tolower(Char)); });
+
+        if (Entry.is_regular_file() && (Extension == ".obj" || Extension == ".glb"))
+        {
+            Sources.push_back(Entry.path().string());
+        }
+    }
+
+    // Stable manifests, whatever the order of the file system
+    std::sort(Sources.begin(), Sources.end());
+    return Sources;
+}
+
+CookResult CookSource(const std::string& SourcePath, const CookOptions& Options)
+{
+    CookResult Result{};
+    Result.SourcePath = SourcePath;
+    Result.CookedPath = lava::LavaMeshCache::GetCachePath(SourcePath);
+
+    const auto StartTime = std::chrono::high_resolution_clock::now();
+    const uint64_t SettingsHash = Options.Settings.GetHash();
+
+    try
+    {
+        lava::LavaMeshCache CookedMesh{};
+        // Encoding is not part of the settings hash, a mesh stored the other way is cooked again
+        Result.bUpToDate = !Options.bForce && CookedMesh.Open(SourcePath, SettingsHash) && CookedMesh.IsEncoded() == Options.Settings.bEncodeMesh;
+
+        if (!Result.bUpToDate)
+        {
+            lava::Builder ModelBuilder{};
+            ModelBuilder.CookFile(SourcePath, Options.Settings);
+
+            if (!CookedMesh.Open(SourcePath, SettingsHash))
+                throw std::runtime_error("unable to write " + Result.CookedPath);
+        }
+
+        if (CookedMesh.GetIndexCount() == 0)
+            throw std::runtime_error("no triangles found");
+
+        Result.Header = CookedMesh.GetHeader();
+        Result.bEncoded = CookedMesh.IsEncoded();
+        Result.SubMeshCount = CookedMesh.GetSubMeshCount();
+        Result.MaterialCount = CookedMesh.GetMaterialCount();
+        Result.MeshletCount = CookedMesh.GetMeshletCount();
+        Result.LodCount = CookedMesh.GetLodCount();
+        Result.bSucceeded = true;
+    }
+    catch (const std::exception& Exception)
+    {
+        Result.Error = Exception.what();
+    }
+
+    Result.CookTimeMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - StartTime).count();
+    return Result;
+}
+
+std::string EscapeJson(const std::string& Value)
+{
+    std::ostringstream Stream;
+    for (const char Char : Value)
+    {
+        switch (Char)
+        {
+            case '"': Stream << "\\\""; break;
+            case '\\': Stream << "\\\\"; break;
+            case '\n': Stream << "\\n"; break;
+            case '\t': Stream << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(Char) < 0x20)
+                {
+                    Stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(Char) << std::dec;
+                }
+                else
+                {
+                    Stream << Char;
+                }
+        }
+    }
+
+    return Stream.str();
+}
+
+bool WriteManifest(const std::filesystem::path& ManifestPath, const std::vector<CookResult>& Results, const CookOptions& Options)
+{
+    std::ofstream Stream(ManifestPath, std::ios::trunc);
+    if (!Stream.is_open())
+        return false;
+
+    Stream << "{\n";
+    Stream << "  \"version\": " << lava::LavaMeshCache::Version << ",\n";
+    Stream << "  \"processing_flags\": " << Options.Settings.GetFlags() << ",\n";
+    Stream << "  \"settings_hash\": \"" << std::hex << std::setw(16) << std::setfill('0') << Options.Settings.GetHash() << std::dec << "\",\n";
+    Stream << "  \"assets\": [";
+
+    for (size_t ResultIdx = 0; ResultIdx < Results.size(); ++ResultIdx)
+    {
+        const CookResult& Result = Results[ResultIdx];
+
+        Stream << (ResultIdx == 0 ? "\n" : ",\n") << "    {\n";
+        Stream << "      \"source\": \"" << EscapeJson(Result.SourcePath) << "\",\n";
+
+        if (!Result.bSucceeded)
+        {
+            Stream << "      \"error\": \"" << EscapeJson(Result.Error) << "\"\n    }";
+            continue;
+        }
+
+        const lava::MeshCacheHeader& Header = Result.Header;
+
+        Stream << "      \"cooked\": \"" << EscapeJson(Result.CookedPath) << "\",\n";
+        Stream << "      \"content_hash\": \"" << std::hex << std::setw(16) << std::setfill('0') << Header.ContentHash << std::dec << "\",\n";
+        if (!Result.DuplicateOf.empty())
+        {
+            Stream << "      \"duplicate_of\": \"" << EscapeJson(Result.DuplicateOf) << "\",\n";
+        }
+        Stream << "      \"format\": \"" << (Header.Format == lava::VertexFormat::Compact ? "compact" : "full") << "\",\n";
+        Stream << "      \"encoded\": " << (Result.bEncoded ? "true" : "false") << ",\n";
+        Stream << "      \"vertices\": " << Header.VertexCount << ",\n";
+        Stream << "      \"indices\": " << Header.IndexCount << ",\n";
+        Stream << "      \"sub_meshes\": " << Result.SubMeshCount << ",\n";
+        Stream << "      \"materials\": " << Result.MaterialCount << ",\n";
+        Stream << "      \"meshlets\": " << Result.MeshletCount << ",\n";
+        Stream << "      \"lods\": " << Result.LodCount << ",\n";
+        Stream << "      \"bounds_min\": [" << Header.BoundsMin[0] << ", " << Header.BoundsMin[1] << ", " << Header.BoundsMin[2] << "],\n";
+        Stream << "      \"bounds_max\": [" << Header.BoundsMax[0] << ", " << Header.BoundsMax[1] << ", " << Header.BoundsMax[2] << "],\n";
+        Stream << "      \"bounding_sphere\": [" << Header.Sphere[0] << ", " << Header.Sphere[1] << ", " << Header.Sphere[2] << ", " << Header.Sphere[3] << "]\n";
+        Stream << "    }";
+    }
+
+    Stream << (Results.empty() ? "]\n" : "\n  ]\n") << "}\n";
+    return Stream.good();
+}
+
+// Entries are named after their path relative to the package, which is where the client looks them up
+bool WritePackage(const std::vector<CookResult>& Results, const CookOptions& Options)
+{
+    const std::string Root = std::filesystem::absolute(Options.PackagePath).lexically_normal().parent_path().string();
+    const lava::PackageCompression Compression = Options.bCompress ? lava::PackageCompression::Lz4 : lava::PackageCompression::None;
+
+    lava::LavaPackageWriter Writer{};
+
+    const auto AddFile = [&](const std::string& Name, const std::string& Filepath)
+    {
+        if (Writer.AddFile(Name, Filepath, Compression))
+            return true;
+
+        std::cout << "Unable to read " << Filepath << std::endl;
+        return false;
+    };
+
+    // Meshes are stored as their source followed by the cache extension, wherever the cooked file has been written
+    for (const CookResult& Result : Results)
+    {
+        if (Result.bSucceeded && !AddFile(lava::LavaPackage::MakeEntryName(Result.SourcePath + lava::LavaMeshCache::Extension, Root), Result.CookedPath))
+            return false;
+    }
+
+    for (const std::filesystem::path& Path : Options.PackagedPaths)
+    {
+        std::vector<std::string> Files{};
+        if (std::filesystem::is_directory(Path))
+        {
+            for (const auto& Entry : std::filesystem::recursive_directory_iterator(Path))
+            {
+                if (Entry.is_regular_file())
+                {
+                    Files.push_back(Entry.path().string());
+                }
+            }
+
+            std::sort(Files.begin(), Files.end());
+        }
+        else
+        {
+            Files.push_back(Path.string());
+        }
+
+        for (const std::string& File : Files)
+        {
+            if (!AddFile(lava::LavaPackage::MakeEntryName(File, Root), File))
+                return false;
+        }
+    }
+
+    if (!Writer.Write(Options.PackagePath.string()))
+    {
+        std::cout << "Unable to write the package " << Options.PackagePath.string() << std::endl;
+        return false;
+    }
+
+    std::cout << Writer.GetEntryCount() << " files packed into " << Options.PackagePath.string() << std::endl;
+    return true;
+}
+
+// Square grid of quads, each one split into two triangles by the parsers. Every corner references a position, a texture
+// coordinate and a normal, so that the whole index path is exercised. Returns the size of the file
+size_t WriteBenchmarkObj(const std::filesystem::path& Path, uint32_t TriangleCount)
+{
+    const uint32_t Side = std::max(1u, static_cast<uint32_t>(std::sqrt(TriangleCount / 2.0)));
+    const uint32_t Row = Side + 1;
+
+    std::ofstream Stream(Path, std::ios::binary | std::ios::trunc);
+    if (!Stream.is_open())
+        throw std::runtime_error("unable to write " + Path.string());
+
+    // Formatted by hand and written in large blocks, the file would otherwise take longer to write than to parse
+    std::string Block;
+    char Line[160];
+    const auto Append = [&](int Length)
+    {
+        Block.append(Line, static_cast<size_t>(Length));
+        if (Block.size() > (4 << 20))
+        {
+            Stream.write(Block.data(), static_cast<std::streamsize>(Block.size()));
+            Block.clear();
+        }
+    };
+
+    Append(std::snprintf(Line, sizeof(Line), "# lava-cook benchmark, %u x %u quads\n", Side, Side));
+
+    for (uint32_t Y = 0; Y <= Side; ++Y)
+    {
+        for (uint32_t X = 0; X <= Side; ++X)
+        {
+            const float U = static_cast<float>(X) / Side;
+            const float V = static_cast<float>(Y) / Side;
+            const float Height = 0.05f * std::sin(U * 37.f) * std::cos(V * 23.f);
+            Append(std::snprintf(Line, sizeof(Line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n", U * 100.f, Height, V * 100.f, U, V, -Height, 1.f, Height));
+        }
+    }
+
+    for (uint32_t Y = 0; Y < Side; ++Y)
+    {
+        for (uint32_t X = 0; X < Side; ++X)
+        {
+            const uint32_t A = Y * Row + X + 1;
+            const uint32_t B = A + 1;
+            const uint32_t C = A + Row + 1;
+            const uint32_t D = A + Row;
+            Append(std::snprintf(Line, sizeof(Line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", A, A, A, B, B, B, C, C, C, D, D, D));
+        }
+    }
+
+    Stream.write(Block.data(), static_cast<std::streamsize>(Block.size()));
+    return Stream.good() ? static_cast<size_t>(Stream.tellp()) : 0;
+}
+
+// Fastest of a few runs, so that the page cache is warm for both parsers
+template <typename TaskType>
+float TimeBestOf(uint32_t RunCount, const TaskType& Task)
+{
+    float BestMs = 0.f;
+    for (uint32_t RunIdx = 0; RunIdx < RunCount; ++RunIdx)
+    {
+        const auto StartTime = std::chrono::high_resolution_clock::now();
+        Task();
+        const float ElapsedMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - StartTime).count();
+        BestMs = RunIdx == 0 ? ElapsedMs : std::min(BestMs, ElapsedMs);
+    }
+
+    return BestMs;
+}
+
+int RunBenchmark(const CookOptions& Options)
+{
+    constexpr uint32_t RunCount = 3;
+
+    const std::filesystem::path Directory = Options.OutputDirectory.empty() ? std::filesystem::temp_directory_path() : Options.OutputDirectory;
+    const std::filesystem::path ObjPath = Directory / "lava-cook-bench.obj";
+    const std::string Filepath = ObjPath.string();
+
+    try
+    {
+        const size_t FileSize = WriteBenchmarkObj(ObjPath, Options.BenchTriangleCount);
+        if (FileSize == 0)
+            throw std::runtime_error("unable to write " + Filepath);
+
+        std::cout << "Benchmark file " << Filepath << ": " << (FileSize >> 20) << " MiB, best of " << RunCount << " runs" << std::endl;
+
+        // Parsing alone, then the whole Builder::LoadModel which adds the vertex deduplication both paths share
+        size_t ParallelCorners = 0;
+        const float ParallelParseMs = TimeBestOf(RunCount, [&]()
+        {
+            ParallelCorners = lava::LavaObjParser::ParseFile(Filepath).Corners.size();
+        });
+
+        size_t TinyObjCorners = 0;
+        const float TinyObjParseMs = TimeBestOf(RunCount, [&]()
+        {
+            tinyobj::attrib_t Attrib;
+            std::vector<tinyobj::shape_t> Shapes;
+            std::vector<tinyobj::material_t> Materials;
+            std::string Warning;
+            std::string Error;
+            if (!tinyobj::LoadObj(&Attrib, &Shapes, &Materials, &Warning, &Error, Filepath.c_str()))
+                throw std::runtime_error(Warning + Error);
+
+            TinyObjCorners = 0;
+            for (const tinyobj::shape_t& Shape : Shapes)
+            {
+                TinyObjCorners += Shape.mesh.indices.size();
+            }
+        });
+
+        lava::Builder ParallelBuilder{};
+        const float ParallelLoadMs = TimeBestOf(RunCount, [&]() { ParallelBuilder.LoadModel(Filepath, lava::ObjLoader::Parallel); });
+
+        lava::Builder TinyObjBuilder{};
+        const float TinyObjLoadMs = TimeBestOf(RunCount, [&]() { TinyObjBuilder.LoadModel(Filepath, lava::ObjLoader::TinyObj); });
+
+        const bool bSameResult = ParallelCorners == TinyObjCorners
+            && ParallelBuilder.Vertices == TinyObjBuilder.Vertices
+            && ParallelBuilder.Indices == TinyObjBuilder.Indices;
+
+        std::cout << std::fixed << std::setprecision(1)
+            << "  parse      parallel " << ParallelParseMs << " ms, tinyobj " << TinyObjParseMs << " ms (" << TinyObjParseMs / std::max(ParallelParseMs, 0.001f) << "x)\n"
+            << "  LoadModel  parallel " << ParallelLoadMs << " ms, tinyobj " << TinyObjLoadMs << " ms (" << TinyObjLoadMs / std::max(ParallelLoadMs, 0.001f) << "x)\n"
+            << "  " << ParallelBuilder.Vertices.size() << " vertices, " << ParallelBuilder.Indices.size() / 3 << " triangles, "
+            << (bSameResult ? "identical results" : "RESULTS DIFFER") << std::endl;
+
+        std::filesystem::remove(ObjPath);
+        return bSameResult ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (const std::exception& Exception)
+    {
+        std::cout << "Benchmark failed: " << Exception.what() << std::endl;
+        std::error_code Error;
+        std::filesystem::remove(ObjPath, Error);
+        return EXIT_FAILURE;
+    }
+}
+
+}
+
+int main(int Argc, char** Argv)
+{
+    CookOptions Options{};
+    if (!ParseOptions(Argc, Argv, Options))
+    {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    if (Options.BenchTriangleCount > 0)
+        return RunBenchmark(Options);
+
+    if (!std::filesystem::is_directory(Options.InputDirectory))
+    {
+        std::cout << Options.InputDirectory.string() << " is not a directory" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!Options.OutputDirectory.empty())
+    {
+        lava::LavaMeshCache::SetCacheDirectory(Options.OutputDirectory.string());
+    }
+
+    if (Options.ManifestPath.empty())
+    {
+        const std::filesystem::path& ManifestDirectory = Options.OutputDirectory.empty() ? Options.InputDirectory : Options.OutputDirectory;
+        Options.ManifestPath = ManifestDirectory / "lava-cook.manifest.json";
+    }
+
+    const std::vector<std::string> Sources = FindSources(Options.InputDirectory);
+    std::vector<CookResult> Results(Sources.size());
+
+    const auto StartTime = std::chrono::high_resolution_clock::now();
+
+    // Files are handed to the workers one at a time, so that a few large meshes do not serialize the rest
+    const uint32_t JobCount = Options.JobCount > 0 ? Options.JobCount : std::max(std::thread::hardware_concurrency(), 1u);
+    std::atomic<size_t> NextSource{0};
+    std::mutex OutputMutex;
+
+    std::vector<std::thread> Workers{};
+    for (uint32_t JobIdx = 0; JobIdx < std::min<size_t>(JobCount, Sources.size()); ++JobIdx)
+    {
+        Workers.emplace_back([&]()
+        {
+            for (size_t SourceIdx = NextSource++; SourceIdx < Sources.size(); SourceIdx = NextSource++)
+            {
+                Results[SourceIdx] = CookSource(Sources[SourceIdx], Options);
+
+                const CookResult& Result = Results[SourceIdx];
+                std::lock_guard<std::mutex> Lock{OutputMutex};
+                if (!Result.bSucceeded)
+                {
+                    std::cout << "[failed] " << Result.SourcePath << ": " << Result.Error << std::endl;
+                }
+                else
+                {
+                    std::cout << (Result.bUpToDate ? "[up to date] " : "[cooked] ") << Result.SourcePath << " (" << Result.CookTimeMs << " ms)" << std::endl;
+                }
+            }
+        });
+    }
+
+    for (std::thread& Worker : Workers)
+    {
+        Worker.join();
+    }
+
+    // Files cooked into the same data are flagged, so that the content pipeline can drop the copies
+    std::unordered_map<uint64_t, const CookResult*> FirstByContent{};
+    uint32_t FailedCount = 0;
+    uint32_t DuplicateCount = 0;
+    for (CookResult& Result : Results)
+    {
+        if (!Result.bSucceeded)
+        {
+            ++FailedCount;
+            continue;
+        }
+
+        const auto Inserted = FirstByContent.emplace(Result.Header.ContentHash, &Result);
+        if (!Inserted.second)
+        {
+            Result.DuplicateOf = Inserted.first->second->SourcePath;
+            ++DuplicateCount;
+        }
+    }
+
+    if (!WriteManifest(Options.ManifestPath, Results, Options))
+    {
+        std::cout << "Unable to write the manifest " << Options.ManifestPath.string() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!Options.PackagePath.empty() && !WritePackage(Results, Options))
+        return EXIT_FAILURE;
+
+    const float ElapsedMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - StartTime).count();
+    std::cout << Sources.size() << " files, " << FailedCount << " failed, " << DuplicateCount << " duplicated, "
+        << ElapsedMs << " ms. Manifest written to " << Options.ManifestPath.string() << std::endl;
+
+    return FailedCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}